@@ -0,0 +1,496 @@
+#pragma once
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define GBGP_RESTRICT __restrict
+#else
+#define GBGP_RESTRICT
+#endif
+
+namespace gbgp
+{
+    //*********************************
+    //*         Batch kernels         *
+    //********************************/
+
+    /// Element-wise operations over columns of values, for the batch semantic actions. Every kernel reads n values
+    /// from each input and writes n values to an output that must not overlap the inputs. The loops are simple enough
+    /// for the compiler to vectorize them. Comparisons and logic operations use 1 for true and 0 for false, and treat
+    /// any non-zero input as true.
+    struct BatchKernels
+    {
+        /// Applies a binary operation to every pair of values.
+        template<typename Op> static void Map(const double* GBGP_RESTRICT a, const double* GBGP_RESTRICT b,
+                                              double* GBGP_RESTRICT out, size_t n, Op op)
+        {
+            for (size_t i = 0; i < n; i++)
+                out[i] = op(a[i], b[i]);
+        }
+
+        /// Applies a unary operation to every value.
+        template<typename Op> static void Map(const double* GBGP_RESTRICT a, double* GBGP_RESTRICT out, size_t n, Op op)
+        {
+            for (size_t i = 0; i < n; i++)
+                out[i] = op(a[i]);
+        }
+
+        static void Add(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x + y; });
+        }
+
+        static void Subtract(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x - y; });
+        }
+
+        static void Multiply(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x * y; });
+        }
+
+        /// Protected division, which returns 1 where the divisor is 0.
+        static void Divide(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return y != 0.0 ? x / y : 1.0; });
+        }
+
+        static void Min(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return y < x ? y : x; });
+        }
+
+        static void Max(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x < y ? y : x; });
+        }
+
+        static void Negate(const double* a, double* out, size_t n)
+        {
+            Map(a, out, n, [](double x) { return -x; });
+        }
+
+        static void Greater(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x > y ? 1.0 : 0.0; });
+        }
+
+        static void GreaterEqual(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x >= y ? 1.0 : 0.0; });
+        }
+
+        static void Less(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x < y ? 1.0 : 0.0; });
+        }
+
+        static void LessEqual(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x <= y ? 1.0 : 0.0; });
+        }
+
+        static void Equal(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return x == y ? 1.0 : 0.0; });
+        }
+
+        static void And(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return (x != 0.0) & (y != 0.0) ? 1.0 : 0.0; });
+        }
+
+        static void Or(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return (x != 0.0) | (y != 0.0) ? 1.0 : 0.0; });
+        }
+
+        static void Xor(const double* a, const double* b, double* out, size_t n)
+        {
+            Map(a, b, out, n, [](double x, double y) { return (x != 0.0) != (y != 0.0) ? 1.0 : 0.0; });
+        }
+
+        static void Not(const double* a, double* out, size_t n)
+        {
+            Map(a, out, n, [](double x) { return x == 0.0 ? 1.0 : 0.0; });
+        }
+
+        /// Chooses between two values by a condition.
+        static void Select(const double* GBGP_RESTRICT condition, const double* GBGP_RESTRICT a,
+                           const double* GBGP_RESTRICT b, double* GBGP_RESTRICT out, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                out[i] = condition[i] != 0.0 ? a[i] : b[i];
+        }
+
+        /// Sets every value to a constant.
+        static void Fill(double value, double* out, size_t n)
+        {
+            for (size_t i = 0; i < n; i++)
+                out[i] = value;
+        }
+    };
+
+    /// Bitwise operations over bit-sliced boolean columns, which pack the values of 64 rows in each word. A single
+    /// operation evaluates 64 rows, and the loops are simple enough for the compiler to vectorize them to the widest
+    /// registers of the target, such as 256 bits with AVX2. The bits past the last row of a column are unspecified.
+    struct BitKernels
+    {
+        /// Number of rows packed in each word.
+        static constexpr size_t RowsPerWord = 64;
+
+        static void And(const uint64_t* GBGP_RESTRICT a, const uint64_t* GBGP_RESTRICT b, uint64_t* GBGP_RESTRICT out, size_t words)
+        {
+            for (size_t i = 0; i < words; i++)
+                out[i] = a[i] & b[i];
+        }
+
+        static void Or(const uint64_t* GBGP_RESTRICT a, const uint64_t* GBGP_RESTRICT b, uint64_t* GBGP_RESTRICT out, size_t words)
+        {
+            for (size_t i = 0; i < words; i++)
+                out[i] = a[i] | b[i];
+        }
+
+        static void Xor(const uint64_t* GBGP_RESTRICT a, const uint64_t* GBGP_RESTRICT b, uint64_t* GBGP_RESTRICT out, size_t words)
+        {
+            for (size_t i = 0; i < words; i++)
+                out[i] = a[i] ^ b[i];
+        }
+
+        static void Not(const uint64_t* GBGP_RESTRICT a, uint64_t* GBGP_RESTRICT out, size_t words)
+        {
+            for (size_t i = 0; i < words; i++)
+                out[i] = ~a[i];
+        }
+
+        /// Counts the set bits of a word.
+        static unsigned Popcount(uint64_t word)
+        {
+#if defined(__GNUC__)
+            return static_cast<unsigned>(__builtin_popcountll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+            return static_cast<unsigned>(__popcnt64(word));
+#else
+            word = word - ((word >> 1) & 0x5555555555555555ULL);
+            word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+            word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+            return static_cast<unsigned>((word * 0x0101010101010101ULL) >> 56);
+#endif
+        }
+
+        /// Counts the rows where two columns differ.
+        /// \param a The first column.
+        /// \param b The second column.
+        /// \param rows The number of rows. The bits past the last row are ignored.
+        /// \return The Hamming distance between both columns.
+        static size_t HammingDistance(const uint64_t* a, const uint64_t* b, size_t rows)
+        {
+            const size_t fullWords = rows / RowsPerWord;
+            size_t distance = 0;
+            for (size_t i = 0; i < fullWords; i++)
+                distance += Popcount(a[i] ^ b[i]);
+
+            if (const size_t remainder = rows % RowsPerWord)
+                distance += Popcount((a[fullWords] ^ b[fullWords]) & ((1ULL << remainder) - 1));
+            return distance;
+        }
+
+        /// Builds the column of an input variable of a truth table, where the bit of the variable at row r is the
+        /// bit at position variable of r.
+        /// \param variable The index of the variable.
+        /// \param rows The number of rows of the truth table.
+        /// \return The bit-sliced column.
+        static std::vector<uint64_t> TruthTableColumn(unsigned variable, size_t rows)
+        {
+            std::vector<uint64_t> column((rows + RowsPerWord - 1) / RowsPerWord, 0);
+            for (size_t row = 0; row < rows; row++)
+            {
+                if ((row >> variable) & 1)
+                    column[row / RowsPerWord] |= 1ULL << (row % RowsPerWord);
+            }
+            return column;
+        }
+
+        /// Builds a bit-sliced column from a value per row.
+        /// \param values The values.
+        /// \return The bit-sliced column.
+        static std::vector<uint64_t> Pack(const std::vector<bool>& values)
+        {
+            std::vector<uint64_t> column((values.size() + RowsPerWord - 1) / RowsPerWord, 0);
+            for (size_t row = 0; row < values.size(); row++)
+            {
+                if (values[row])
+                    column[row / RowsPerWord] |= 1ULL << (row % RowsPerWord);
+            }
+            return column;
+        }
+    };
+
+    //*********************************
+    //*   Batch evaluation context    *
+    //********************************/
+
+    class SyntaxTree;
+    class CompiledSyntaxTree;
+
+    /// Evaluation context that evaluates a tree for many data rows at once. The semantic values are columns with
+    /// one value per row, and the batch semantic action of each production rule computes the column of its node from
+    /// the columns of its children, usually with a BatchKernels function. The data is given as named input columns.
+    /// A Terminal whose value names an input column evaluates to that column, and any other Terminal is parsed as a
+    /// constant. The columns of the intermediate results are taken from a pool and reused between evaluations.
+    /// \tparam T The type of the elements of the columns. A floating point type holds one row per element, and an
+    /// unsigned integer type holds bit-sliced booleans, one row per bit.
+    template<typename T> class BasicBatchEvaluationContext
+    {
+    public:
+        /// Number of rows held by each element of a column.
+        static constexpr size_t RowsPerElement = std::is_integral_v<T> ? sizeof(T) * CHAR_BIT : 1;
+
+    private:
+        /// A column of the evaluation stack. Columns computed by a semantic action own a buffer of the pool.
+        struct StackColumn
+        {
+            const T* data;
+            int buffer;
+        };
+
+        /// Semantic value of a production element. Terminals keep a reference to their value.
+        struct Slot
+        {
+            StackColumn column;
+            const std::string* terminal;
+        };
+
+        /// Number of rows of every column.
+        size_t _rows;
+
+        /// Number of elements of every column.
+        size_t _size;
+
+        /// The input columns by name.
+        std::unordered_map<std::string, std::vector<T>> _inputs;
+
+        /// Columns of the constants found in the Terminals.
+        std::unordered_map<std::string, std::vector<T>> _constants;
+
+        /// Buffers of the computed columns, and the indexes of the unused ones.
+        std::vector<std::vector<T>> _buffers;
+        std::vector<int> _freeBuffers;
+
+        /// The semantic values used at each semantic action.
+        std::vector<Slot> _slots;
+
+        /// The result of each semantic action.
+        StackColumn _result{ nullptr, -1 };
+
+        /// Columns of the evaluated NonTerminals waiting for their parent.
+        std::vector<StackColumn> _stack;
+
+        friend class SyntaxTree;
+        friend class CompiledSyntaxTree;
+
+        /// Takes a buffer from the pool.
+        int AcquireBuffer()
+        {
+            if (_freeBuffers.empty())
+            {
+                _buffers.emplace_back(_size);
+                return static_cast<int>(_buffers.size()) - 1;
+            }
+
+            int buffer = _freeBuffers.back();
+            _freeBuffers.pop_back();
+            return buffer;
+        }
+
+        /// Starts an evaluation, returning every buffer to the pool.
+        void Begin()
+        {
+            for (const StackColumn& column : _stack)
+            {
+                if (column.buffer >= 0)
+                    _freeBuffers.push_back(column.buffer);
+            }
+            _stack.clear();
+        }
+
+        /// Pushes the column of the stack at the specified position as the next semantic value.
+        void PushStackValue(size_t position)
+        {
+            _slots.push_back({ _stack[position], nullptr });
+        }
+
+        /// Replaces the columns of the stack from first with the result of the semantic action. The buffers that
+        /// are not referenced by the result go back to the pool.
+        void FinishAction(size_t first)
+        {
+            for (size_t i = first; i < _stack.size(); i++)
+            {
+                if (_stack[i].buffer >= 0 && _stack[i].buffer != _result.buffer)
+                    _freeBuffers.push_back(_stack[i].buffer);
+            }
+            _stack.resize(first);
+
+            if (_result.data == nullptr)
+                throw std::runtime_error("The batch semantic action did not set a result.");
+            _stack.push_back(_result);
+        }
+
+    public:
+        /// Creates a context for a number of rows.
+        /// \param rows The number of rows of every column.
+        explicit BasicBatchEvaluationContext(size_t rows)
+            : _rows(rows), _size((rows + RowsPerElement - 1) / RowsPerElement) {}
+
+        virtual ~BasicBatchEvaluationContext() = default;
+
+        /// Get the number of rows of every column.
+        [[nodiscard]]
+        size_t NumberOfRows() const
+        {
+            return _rows;
+        }
+
+        /// Get the number of elements of every column, which is the number of rows for floating point columns and
+        /// the number of words for bit-sliced columns.
+        [[nodiscard]]
+        size_t ColumnSize() const
+        {
+            return _size;
+        }
+
+        /// Sets an input column.
+        /// \param name The name of the column, as written in the Terminals that refer to it.
+        /// \param values The elements of the column.
+        void SetColumn(const std::string& name, std::vector<T> values)
+        {
+            if (values.size() != _size)
+                throw std::runtime_error("Column " + name + " does not have " + std::to_string(_size) + " elements.");
+            _inputs[name] = std::move(values);
+        }
+
+        /// Get an input column.
+        /// \param name The name of the column.
+        /// \return Pointer to the values of the column. Null if there is no column with that name.
+        [[nodiscard]]
+        const T* GetColumn(const std::string& name) const
+        {
+            auto it = _inputs.find(name);
+            return it != _inputs.end() ? it->second.data() : nullptr;
+        }
+
+        /// Get the column of the semantic value at the specified index of the associated ProductionRule. For a
+        /// Terminal, it is the input column named by its value or a column filled with the parsed value.
+        /// \param index Index of the production element.
+        /// \return Pointer to the values of the column.
+        [[nodiscard]]
+        const T* Column(unsigned index)
+        {
+            const Slot& slot = _slots.at(index);
+            if (slot.terminal == nullptr)
+                return slot.column.data;
+
+            if (const T* input = GetColumn(*slot.terminal))
+                return input;
+
+            auto it = _constants.find(*slot.terminal);
+            if (it == _constants.end())
+                it = _constants.emplace(*slot.terminal, std::vector<T>(_size, ParseValue(*slot.terminal))).first;
+            return it->second.data();
+        }
+
+        /// Get the value of the Terminal at the specified index of the associated ProductionRule.
+        /// \param index Index of the production element.
+        /// \return Reference to the value of the Terminal.
+        [[nodiscard]]
+        const std::string& TerminalValue(unsigned index) const
+        {
+            const Slot& slot = _slots.at(index);
+            if (slot.terminal == nullptr)
+                throw std::runtime_error("The semantic value at index " + std::to_string(index) + " is a NonTerminal.");
+            return *slot.terminal;
+        }
+
+        /// Push the value of a Terminal for later use inside a semantic action. The referenced string must outlive
+        /// the evaluation.
+        /// \param value Value to push.
+        void PushTerminalValue(const std::string& value)
+        {
+            _slots.push_back({ { nullptr, -1 }, &value });
+        }
+
+        /// Get the total number of semantic values.
+        [[nodiscard]]
+        unsigned NumberOfSemanticValues() const
+        {
+            return _slots.size();
+        }
+
+        /// Get a new column for the result of the semantic action.
+        /// \return Pointer to the values of the result, to be written by the semantic action.
+        T* Result()
+        {
+            int buffer = AcquireBuffer();
+            _result = { _buffers[buffer].data(), buffer };
+            return _buffers[buffer].data();
+        }
+
+        /// Uses the column of a semantic value as the result, without copying it.
+        /// \param index The semantic value index.
+        void TransferColumnToResult(unsigned index = 0)
+        {
+            const Slot& slot = _slots.at(index);
+            _result = slot.terminal == nullptr ? slot.column : StackColumn{ Column(index), -1 };
+        }
+
+        /// Get the result of the last evaluation. It stays valid until the next evaluation with this context.
+        /// \return Pointer to the values of the result, one per row. Null if nothing was evaluated.
+        [[nodiscard]]
+        const T* GetResultColumn() const
+        {
+            return _stack.empty() ? nullptr : _stack.back().data;
+        }
+
+        /// Converts the value of a Terminal that does not name an input column to the elements of a constant column.
+        /// Bit-sliced columns accept "1" or "true" for a column of ones and "0" or "false" for a column of zeros.
+        /// \param value The value of the Terminal.
+        /// \return The converted value.
+        virtual T ParseValue(const std::string& value) const
+        {
+            if constexpr (std::is_integral_v<T>)
+            {
+                if (value == "1" || value == "true")
+                    return static_cast<T>(~T{});
+                if (value == "0" || value == "false")
+                    return T{};
+                throw std::runtime_error("There is no boolean conversion for the terminal value " + value);
+            }
+            else
+                return static_cast<T>(std::stod(value));
+        }
+
+        /// Virtual function that is executed before each evaluation of a semantic action.
+        virtual void Prepare()
+        {
+            _slots.clear();
+            _result = { nullptr, -1 };
+        }
+    };
+
+    /// Batch context with one double per row.
+    using BatchEvaluationContext = BasicBatchEvaluationContext<double>;
+
+    /// Batch context for boolean grammars, with 64 rows per word.
+    using BitSlicedEvaluationContext = BasicBatchEvaluationContext<uint64_t>;
+}
@@ -0,0 +1,235 @@
+#pragma once
+#include <array>
+#include <type_traits>
+#include "syntax_tree.h"
+
+namespace gbgp
+{
+    /// Type of the values computed by the closures for a kind of evaluation context.
+    template<typename Context> struct ClosureValue { using Type = std::string; };
+    template<typename T> struct ClosureValue<TypedEvaluationContext<T>> { using Type = T; };
+
+    /// Syntax tree compiled to a tree of pre-bound callables. Each NonTerminal becomes a closure that holds the
+    /// closures of its children, the values of its Terminals and the semantic action of its rule, so an evaluation
+    /// goes straight from one semantic action to the next: the rules are not looked up, the children are not
+    /// matched against the production elements and Prepare is not called. The structure of the tree is validated
+    /// once, when it is compiled.
+    /// The rules and values are taken from the symbol table, where the compiled tree keeps them, so it does not refer
+    /// to the nodes of the tree, which can be modified or destroyed after compiling. The compiled tree is never modified after
+    /// construction and the partial values live in the stack of the evaluation, so it can be evaluated from many
+    /// threads at once, each with its own context. As Prepare is not called, contexts that override it to do more
+    /// than clearing the semantic values are not supported.
+    /// \tparam Context The evaluation context, either EvaluationContext or TypedEvaluationContext<T>.
+    template<typename Context> class BasicClosureSyntaxTree
+    {
+    public:
+        /// The type of the values of the NonTerminals.
+        using Value = typename ClosureValue<Context>::Type;
+
+        /// Evaluates a subtree and returns its value.
+        using Closure = std::function<Value(Context&)>;
+
+    private:
+        static constexpr bool IsTyped = !std::is_same_v<Context, EvaluationContext>;
+
+        /// Semantic value of a production element. Either the closure of a NonTerminal child or the value of a
+        /// Terminal child.
+        struct Operand
+        {
+            Closure closure;
+            const std::string* value;
+        };
+
+        /// The closure of the root.
+        Closure _root;
+
+        /// Number of closures, one per NonTerminal of the compiled tree.
+        size_t _numberOfClosures = 0;
+
+        /// References to the rules and values bound to the closures, which keep them in the symbol table.
+        std::vector<SymbolReference> _symbols;
+
+        /// Clears the semantic values and the result of the context, as Prepare does.
+        static void BeginAction(Context& ctx)
+        {
+            ctx._semanticValues.clear();
+            ctx._result.clear();
+            if constexpr (IsTyped)
+            {
+                ctx._slots.clear();
+                ctx._typedResult = Value{};
+            }
+        }
+
+        /// Pushes the value of a NonTerminal.
+        static void PushValue(Context& ctx, Value&& value)
+        {
+            if constexpr (IsTyped)
+                ctx._slots.push_back({ std::move(value), nullptr });
+            else
+                ctx._semanticValues.push_back(std::move(value));
+        }
+
+        /// Pushes the value of a Terminal.
+        static void PushTerminalValue(Context& ctx, const std::string& value)
+        {
+            if constexpr (IsTyped)
+                ctx._slots.push_back({ Value{}, &value });
+            else
+                ctx._semanticValues.push_back(value);
+        }
+
+        /// Takes the result of the semantic action from the context.
+        static Value TakeResult(Context& ctx)
+        {
+            if constexpr (IsTyped)
+                return ctx._typedResult;
+            else
+                return std::move(ctx._result);
+        }
+
+        /// Binds a semantic action to a fixed number of operands, so the values of the children are kept in the
+        /// stack of the evaluation.
+        /// \tparam N The number of operands.
+        /// \param semanticAction The semantic action of the rule, owned by the symbol table.
+        /// \param operands The operands.
+        /// \return The closure.
+        template<size_t N> static Closure Bind(const std::function<void(EvaluationContext&)>* semanticAction,
+                                               std::vector<Operand>& operands)
+        {
+            std::array<Operand, N> bound;
+            std::move(operands.begin(), operands.end(), bound.begin());
+
+            return [semanticAction, bound = std::move(bound)](Context& ctx) -> Value {
+                std::array<Value, N> values{};
+                for (size_t k = 0; k < N; k++)
+                {
+                    if (bound[k].value == nullptr)
+                        values[k] = bound[k].closure(ctx);
+                }
+
+                BeginAction(ctx);
+                for (size_t k = 0; k < N; k++)
+                {
+                    if (bound[k].value != nullptr)
+                        PushTerminalValue(ctx, *bound[k].value);
+                    else
+                        PushValue(ctx, std::move(values[k]));
+                }
+
+                (*semanticAction)(ctx);
+                return TakeResult(ctx);
+            };
+        }
+
+        /// Binds a semantic action to any number of operands.
+        /// \param semanticAction The semantic action of the rule, owned by the symbol table.
+        /// \param operands The operands.
+        /// \return The closure.
+        static Closure BindAny(const std::function<void(EvaluationContext&)>* semanticAction,
+                               std::vector<Operand>& operands)
+        {
+            return [semanticAction, bound = std::move(operands)](Context& ctx) -> Value {
+                std::vector<Value> values(bound.size());
+                for (size_t k = 0; k < bound.size(); k++)
+                {
+                    if (bound[k].value == nullptr)
+                        values[k] = bound[k].closure(ctx);
+                }
+
+                BeginAction(ctx);
+                for (size_t k = 0; k < bound.size(); k++)
+                {
+                    if (bound[k].value != nullptr)
+                        PushTerminalValue(ctx, *bound[k].value);
+                    else
+                        PushValue(ctx, std::move(values[k]));
+                }
+
+                (*semanticAction)(ctx);
+                return TakeResult(ctx);
+            };
+        }
+
+        /// Compiles a subtree.
+        /// \param node The root of the subtree, which must be a NonTerminal.
+        /// \return The closure that evaluates the subtree.
+        Closure Compile(const TreeNode* node)
+        {
+            const ProductionRule& rule = node->GetGeneratorPR();
+            node->ValidateChildren(rule, "compilation");
+            if (rule.semanticAction == nullptr)
+                throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
+            _symbols.emplace_back(SymbolKind::Rule, node->generatorPRID);
+
+            std::vector<Operand> operands(rule.to.size());
+            for (size_t i = 0; i < rule.to.size(); i++)
+            {
+                const TreeNode* child = node->children[i].get();
+                if (child->type == NodeType::NonTerminal)
+                    operands[i] = { Compile(child), nullptr };
+                else
+                {
+                    operands[i] = { nullptr, &child->GetValue() };
+                    _symbols.emplace_back(SymbolKind::Value, child->termValueID);
+                }
+            }
+
+            _numberOfClosures++;
+            switch (operands.size())
+            {
+                case 1:
+                    return Bind<1>(&rule.semanticAction, operands);
+                case 2:
+                    return Bind<2>(&rule.semanticAction, operands);
+                case 3:
+                    return Bind<3>(&rule.semanticAction, operands);
+                default:
+                    return BindAny(&rule.semanticAction, operands);
+            }
+        }
+
+    public:
+        /// Creates an empty compiled tree.
+        BasicClosureSyntaxTree() = default;
+
+        /// Compiles a tree.
+        /// \param tree The tree to compile.
+        explicit BasicClosureSyntaxTree(const SyntaxTree& tree)
+        {
+            if (!tree.IsEmpty() && tree.Root()->HasChildren())
+                _root = Compile(tree.Root());
+        }
+
+        /// Check if the compiled tree has no closures.
+        [[nodiscard]]
+        bool IsEmpty() const
+        {
+            return _root == nullptr;
+        }
+
+        /// Get the number of closures, which is the number of NonTerminals of the compiled tree.
+        [[nodiscard]]
+        size_t NumberOfClosures() const
+        {
+            return _numberOfClosures;
+        }
+
+        /// Evaluates the compiled tree using the semantic actions of the grammar. The result is stored in the
+        /// context, in the typed result for typed contexts.
+        /// \param ctx Reference to the evaluation context.
+        void Evaluate(Context& ctx) const
+        {
+            if (_root == nullptr)
+                return;
+
+            if constexpr (IsTyped)
+                ctx._typedResult = _root(ctx);
+            else
+                ctx._result = _root(ctx);
+        }
+    };
+
+    using ClosureSyntaxTree = BasicClosureSyntaxTree<EvaluationContext>;
+    template<typename T> using TypedClosureSyntaxTree = BasicClosureSyntaxTree<TypedEvaluationContext<T>>;
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <cctype>
+#include "grammar.h"
+#include "native_function.h"
+
+namespace gbgp
+{
+    /// Generates self-contained C++ source code for syntax trees, so evolved individuals can be deployed without
+    /// the interpreter. Each NonTerminal is translated with the code template of its production rule, registered
+    /// with Grammar::SetCodeTemplate, and its value is stored in a local variable. The generated function has C
+    /// linkage, takes the configured parameters, which the code templates can refer to, and returns the value of
+    /// the root. The source can also be compiled and loaded at runtime with CompileNative, which takes a fraction of
+    /// a second and is only worth it for trees that are evaluated many times, such as long-lived elites.
+    class CodeGenerator
+    {
+    private:
+        Grammar _grammar;
+        std::string _returnType;
+        std::string _parameters;
+        std::string _preamble;
+
+        /// Replaces the placeholders of a code template with the operands of a node.
+        /// \param codeTemplate The code template.
+        /// \param operands The code of each production element.
+        /// \param rule The production rule of the node.
+        /// \return The expanded code.
+        static std::string ExpandTemplate(const std::string& codeTemplate, const std::vector<std::string>& operands,
+                                          const ProductionRule& rule)
+        {
+            std::string code;
+            for (size_t i = 0; i < codeTemplate.size(); i++)
+            {
+                if (codeTemplate[i] != '$')
+                {
+                    code += codeTemplate[i];
+                    continue;
+                }
+
+                if (i + 1 < codeTemplate.size() && codeTemplate[i + 1] == '$')
+                {
+                    code += '$';
+                    i++;
+                    continue;
+                }
+
+                size_t end = i + 1;
+                while (end < codeTemplate.size() && std::isdigit(static_cast<unsigned char>(codeTemplate[end])))
+                    end++;
+                if (end == i + 1)
+                    throw std::runtime_error("Missing production element index in the code template of rule " + rule.ToString());
+
+                const size_t index = std::stoul(codeTemplate.substr(i + 1, end - i - 1));
+                if (index >= operands.size())
+                    throw std::runtime_error("The code template of rule " + rule.ToString() + " refers to the missing production element " + std::to_string(index));
+
+                code += operands[index];
+                i = end - 1;
+            }
+            return code;
+        }
+
+        /// Get the rule of the grammar that a node refers to. The values of the Terminals are checked against this
+        /// rule, and not against the rule stored in the node, which comes from the tree.
+        /// \param rule The production rule of a node.
+        /// \return The rule of the grammar with the same identity and structure.
+        [[nodiscard]]
+        const ProductionRule& GetGrammarRule(const ProductionRule& rule) const
+        {
+            for (size_t i = 0; i < _grammar.Size(); i++)
+            {
+                const ProductionRule& grammarRule = _grammar.GetRule(i);
+                if (grammarRule.uid == rule.uid && grammarRule.SameRule(rule))
+                    return grammarRule;
+            }
+            throw std::runtime_error("The rule " + rule.ToString() + " is not a rule of the grammar");
+        }
+
+        /// Check that a name can be used as the name of a C function.
+        /// \param name The name.
+        static void CheckIdentifier(const std::string& name)
+        {
+            bool valid = !name.empty() && !std::isdigit(static_cast<unsigned char>(name.front()));
+            for (char c : name)
+                valid = valid && (std::isalnum(static_cast<unsigned char>(c)) || c == '_');
+            if (!valid)
+                throw std::runtime_error("The function name '" + name + "' is not a valid identifier");
+        }
+
+        /// Recursive implementation. Generates the statements that compute the value of a node.
+        /// \param node The node, which must be a NonTerminal.
+        /// \param body The function body where the statements are appended.
+        /// \param numberOfVariables The number of variables declared so far.
+        /// \return The name of the variable that holds the value of the node.
+        std::string GenerateNode(const TreeNode* node, std::string& body, size_t& numberOfVariables) const
+        {
+            const ProductionRule& rule = node->GetGeneratorPR();
+            node->ValidateChildren(rule, "code generation");
+
+            const std::optional<std::string> codeTemplate = _grammar.GetCodeTemplate(rule);
+            if (!codeTemplate.has_value())
+                throw std::runtime_error("There is no code template for rule " + rule.ToString());
+            const ProductionRule& grammarRule = GetGrammarRule(rule);
+
+            std::vector<std::string> operands(rule.to.size());
+            for (size_t i = 0; i < rule.to.size(); i++)
+            {
+                const TreeNode* child = node->children[i].get();
+                if (child->type == NodeType::NonTerminal)
+                    operands[i] = GenerateNode(child, body, numberOfVariables);
+                else
+                {
+                    // The value is pasted into the source, so only the values declared by the grammar are accepted.
+                    const std::string& value = child->GetValue();
+                    if (!vector_contains_q(grammarRule.to[i].term.values, value))
+                        throw std::runtime_error("The value '" + value + "' is not a value of the Term " + child->GetTerminal().label + " in the grammar");
+                    operands[i] = value;
+                }
+            }
+
+            const std::string variable = "v" + std::to_string(numberOfVariables++);
+            body += "    const auto " + variable + " = " + ExpandTemplate(codeTemplate.value(), operands, rule) + ";\n";
+            return variable;
+        }
+
+    public:
+        /// Creates a code generator.
+        /// \param grammar The grammar that contains the code templates.
+        /// \param returnType The return type of the generated functions.
+        /// \param parameters The parameter list of the generated functions, for instance "const double* x".
+        /// \param preamble Code placed before the generated functions, such as includes and helper functions.
+        CodeGenerator(const Grammar& grammar, std::string returnType, std::string parameters, std::string preamble = "")
+            : _grammar(grammar), _returnType(std::move(returnType)), _parameters(std::move(parameters)),
+              _preamble(std::move(preamble)) {}
+
+        /// Generates a function that evaluates a tree.
+        /// \param tree The tree.
+        /// \param functionName The name of the function.
+        /// \return The source code of the function.
+        [[nodiscard]]
+        std::string GenerateFunction(const SyntaxTree& tree, const std::string& functionName) const
+        {
+            if (tree.IsEmpty())
+                throw std::runtime_error("Cannot generate code for an empty tree");
+            CheckIdentifier(functionName);
+
+            std::string body;
+            size_t numberOfVariables = 0;
+            const std::string result = GenerateNode(tree.Root(), body, numberOfVariables);
+
+            return "extern \"C\" " + _returnType + " " + functionName + "(" + _parameters + ")\n{\n" + body
+                   + "    return " + result + ";\n}\n";
+        }
+
+        /// Generates a self-contained source file with the preamble and a function that evaluates a tree.
+        /// \param tree The tree.
+        /// \param functionName The name of the function.
+        /// \return The source code.
+        [[nodiscard]]
+        std::string GenerateSource(const SyntaxTree& tree, const std::string& functionName) const
+        {
+            return _preamble + "\n" + GenerateFunction(tree, functionName);
+        }
+
+#if defined(GBGP_NATIVE_COMPILATION)
+        /// Compiles a tree to native code with a locally installed compiler and loads it.
+        /// \tparam Signature The signature of the generated function, which must match the return type and
+        /// parameters of the generator.
+        /// \param tree The tree.
+        /// \param compiler The compiler command, including the optimization flags.
+        /// \return The loaded function.
+        template<typename Signature> NativeFunction<Signature> CompileNative(
+                const SyntaxTree& tree, const std::string& compiler = NativeFunction<Signature>::DefaultCompiler()) const
+        {
+            return NativeFunction<Signature>::Compile(GenerateSource(tree, "gbgp_evaluate"), "gbgp_evaluate", compiler);
+        }
+#endif
+    };
+}
@@ -0,0 +1,223 @@
+#pragma once
+#include <cstdint>
+#include "syntax_tree.h"
+
+namespace gbgp
+{
+    /// Syntax tree lowered to a linear program for repeated evaluation, for instance against every row of a data set.
+    /// The program is a sequence of instructions in post-order, one per NonTerminal of the tree. Each instruction
+    /// refers to the production rule of its node and to its operands, which are either the value of a Terminal or
+    /// the result of a previous instruction, taken from a stack. The structure of the tree is validated and the rules
+    /// and values are resolved once, when the program is compiled, so an evaluation only runs the semantic actions.
+    /// The program does not refer to the nodes of the tree, which can be modified or destroyed after compiling, and
+    /// keeps its rules and values in the symbol table.
+    class CompiledSyntaxTree
+    {
+    private:
+        /// Executes the semantic action of a production rule.
+        struct Instruction
+        {
+            /// The production rule whose semantic action is executed.
+            const ProductionRule* rule;
+
+            /// Position of the first operand in the operand list.
+            uint32_t firstOperand;
+
+            /// Number of operands, one per production element of the rule.
+            uint32_t numberOfOperands;
+
+            /// Number of operands that are taken from the stack.
+            uint32_t numberOfValues;
+        };
+
+        /// The instructions, in the order they are executed.
+        std::vector<Instruction> _instructions;
+
+        /// The operands of all the instructions. The value of a Terminal operand, or null for an operand that is
+        /// taken from the stack.
+        std::vector<const std::string*> _operands;
+
+        /// Maximum number of values held by the stack during an evaluation.
+        size_t _maxStackSize = 0;
+
+        /// References to the rules and values of the instructions, which keep them in the symbol table.
+        std::vector<SymbolReference> _symbols;
+
+        /// Lowers a tree to a program.
+        /// \param tree The tree to compile.
+        void Compile(const SyntaxTree& tree)
+        {
+            if (tree.IsEmpty() || !tree.Root()->HasChildren())
+                return;
+
+            size_t stackSize = 0;
+            for (TreeNode* node : tree.PostOrder())
+            {
+                if (node->type != NodeType::NonTerminal)
+                    continue;
+
+                const ProductionRule& rule = node->GetGeneratorPR();
+                node->ValidateChildren(rule, "compilation");
+                _symbols.emplace_back(SymbolKind::Rule, node->generatorPRID);
+                Instruction instruction{ &rule, static_cast<uint32_t>(_operands.size()),
+                                         static_cast<uint32_t>(rule.to.size()), 0 };
+
+                for (const auto& child : node->children)
+                {
+                    if (child->type == NodeType::NonTerminal)
+                    {
+                        _operands.push_back(nullptr);
+                        instruction.numberOfValues++;
+                    }
+                    else
+                    {
+                        _operands.push_back(&child->GetValue());
+                        _symbols.emplace_back(SymbolKind::Value, child->termValueID);
+                    }
+                }
+
+                stackSize = stackSize - instruction.numberOfValues + 1;
+                _maxStackSize = std::max(_maxStackSize, stackSize);
+                _instructions.push_back(instruction);
+            }
+        }
+
+    public:
+        /// Creates an empty program.
+        CompiledSyntaxTree() = default;
+
+        /// Compiles a tree.
+        /// \param tree The tree to compile.
+        explicit CompiledSyntaxTree(const SyntaxTree& tree)
+        {
+            Compile(tree);
+        }
+
+        /// Check if the program has no instructions.
+        [[nodiscard]]
+        bool IsEmpty() const
+        {
+            return _instructions.empty();
+        }
+
+        /// Get the number of instructions, which is the number of NonTerminals of the compiled tree.
+        [[nodiscard]]
+        size_t NumberOfInstructions() const
+        {
+            return _instructions.size();
+        }
+
+        /// Evaluates the program using the semantic actions of the grammar. The result is stored in the context.
+        /// \param ctx Reference to the evaluation context.
+        void Evaluate(EvaluationContext& ctx) const
+        {
+            std::vector<std::string> stack;
+            stack.reserve(_maxStackSize);
+
+            for (size_t i = 0; i < _instructions.size(); i++)
+            {
+                const Instruction& instruction = _instructions[i];
+                const size_t first = stack.size() - instruction.numberOfValues;
+                size_t next = first;
+
+                ctx.Prepare();
+                const std::string* const* operands = _operands.data() + instruction.firstOperand;
+                for (uint32_t k = 0; k < instruction.numberOfOperands; k++)
+                {
+                    if (operands[k] != nullptr)
+                        ctx.PushSemanticValue(*operands[k]);
+                    else
+                        ctx.PushSemanticValue(std::move(stack[next++]));
+                }
+                stack.resize(first);
+
+                if (instruction.rule->semanticAction == nullptr)
+                    throw std::runtime_error("There is no semantic action for rule " + instruction.rule->ToString());
+                instruction.rule->semanticAction(ctx);
+
+                // The result of the last instruction stays in the context.
+                if (i + 1 < _instructions.size())
+                    stack.push_back(std::move(ctx.result()));
+            }
+        }
+
+        /// Evaluates the program with natively typed semantic values. The result is stored in the typed result of
+        /// the context.
+        /// \param ctx Reference to the typed evaluation context.
+        template<typename T> void Evaluate(TypedEvaluationContext<T>& ctx) const
+        {
+            std::vector<T>& stack = ctx._stack;
+            stack.clear();
+
+            for (const Instruction& instruction : _instructions)
+            {
+                const size_t first = stack.size() - instruction.numberOfValues;
+                size_t next = first;
+
+                ctx.Prepare();
+                const std::string* const* operands = _operands.data() + instruction.firstOperand;
+                for (uint32_t k = 0; k < instruction.numberOfOperands; k++)
+                {
+                    if (operands[k] != nullptr)
+                        ctx.PushTerminalValue(*operands[k]);
+                    else
+                        ctx.PushTypedSemanticValue(stack[next++]);
+                }
+                stack.resize(first);
+
+                if (instruction.rule->semanticAction == nullptr)
+                    throw std::runtime_error("There is no semantic action for rule " + instruction.rule->ToString());
+                instruction.rule->semanticAction(ctx);
+                stack.push_back(ctx.typedResult());
+            }
+        }
+
+        /// Evaluates the program for every row of the context at once, using the batch semantic actions of the
+        /// grammar. The result is given by the GetResultColumn method of the context.
+        /// \param ctx Reference to the batch evaluation context.
+        template<typename T> void Evaluate(BasicBatchEvaluationContext<T>& ctx) const
+        {
+            ctx.Begin();
+            for (const Instruction& instruction : _instructions)
+            {
+                const size_t first = ctx._stack.size() - instruction.numberOfValues;
+                size_t next = first;
+
+                ctx.Prepare();
+                const std::string* const* operands = _operands.data() + instruction.firstOperand;
+                for (uint32_t k = 0; k < instruction.numberOfOperands; k++)
+                {
+                    if (operands[k] != nullptr)
+                        ctx.PushTerminalValue(*operands[k]);
+                    else
+                        ctx.PushStackValue(next++);
+                }
+
+                const auto& batchSemanticAction = instruction.rule->BatchSemanticAction<T>();
+                if (batchSemanticAction == nullptr)
+                    throw std::runtime_error("There is no batch semantic action for rule " + instruction.rule->ToString());
+                batchSemanticAction(ctx);
+                ctx.FinishAction(first);
+            }
+        }
+
+        /// Get a string representation of the program, one instruction per line.
+        [[nodiscard]]
+        std::string ToString() const
+        {
+            std::string output;
+            for (const Instruction& instruction : _instructions)
+            {
+                output += instruction.rule->ToString() + " [";
+                for (uint32_t k = 0; k < instruction.numberOfOperands; k++)
+                {
+                    const std::string* operand = _operands[instruction.firstOperand + k];
+                    output += operand != nullptr ? "'" + *operand + "'" : std::string("pop");
+                    output += k + 1 < instruction.numberOfOperands ? ", " : "";
+                }
+                output += "]\n";
+            }
+            return output;
+        }
+    };
+}
@@ -16,14 +16,69 @@ namespace gbgp
         RuntimeMode _runtimeMode;
         Population _population;
 
+        /// Hits and misses of the fitness cache in each optimized generation.
+        std::vector<FitnessCacheStatistics> _fitnessCacheHistory;
+
+        /// Makespan and idle time of the evaluation of the population in each optimized generation.
+        std::vector<ExecutorStatistics> _evaluationHistory;
+
+        /// The random stream of the run, which is split into one stream per generation. Without a seed, the run draws
+        /// its random numbers from the shared random generator instead.
+        std::optional<RandomStream> _random;
+
+        /// Number of optimized generations.
+        uint64_t _generation = 0;
+
         /// Generates new immigrant individuals.
         /// \param n The number of individuals.
-        std::vector<Individual> GenerateImmigrationIndividuals(unsigned n)
+        /// \param random The random stream, or none to use the shared random generator.
+        std::vector<Individual> GenerateImmigrationIndividuals(unsigned n, std::optional<RandomStream>& random)
         {
-            Population immigrants(_population.GetGeneratingGrammar(), _population.GetFitnessFunction());
-            immigrants.Initialize(n);
+            Population immigrants = _population.CreateEmptyCopy();
+            if (random.has_value())
+                immigrants.Initialize(n, _runtimeMode, *random);
+            else
+                immigrants.Initialize(n, _runtimeMode);
             immigrants.Evaluate(_runtimeMode);
-            return immigrants.GetIndividuals();
+            return std::move(immigrants.GetIndividuals());
+        }
+
+        /// Environment constructor.
+        /// \param grammar The grammar used for creating and mutating individuals.
+        /// \param fitnessFunction The fitness function for evaluating individuals.
+        /// \param populationSize The size of the population.
+        /// \param survivorsPerGeneration The number of individuals that survive the selection operator.
+        /// \param eliteIndividuals The number of individuals that automatically survive to the next generation.
+        /// \param immigrationIndividuals The number of new individuals to be inserted on the population on each generation.
+        /// \param mutationProbability The probability that an individual mutates over a generation.
+        /// \param runtimeMode Whether to evaluate the population on a single thread or in a thread pool.
+        /// \param executor The worker threads used in the multithread mode.
+        /// \param random The random stream of the run, or none to use the shared random generator.
+        Environment(const Grammar& grammar, const std::function<double(SyntaxTree&)>& fitnessFunction,
+                    int populationSize, int survivorsPerGeneration, int eliteIndividuals,
+                    int immigrationIndividuals, double mutationProbability,
+                    RuntimeMode runtimeMode, const std::shared_ptr<Executor>& executor,
+                    const std::optional<RandomStream>& random)
+                    : _population(grammar, fitnessFunction), _random(random)
+        {
+            _populationSize = populationSize;
+            _survivorsPerGeneration = survivorsPerGeneration;
+            _eliteIndividuals = eliteIndividuals;
+            _immigrationIndividuals = immigrationIndividuals;
+            _mutationProbability = mutationProbability;
+            _runtimeMode = runtimeMode;
+
+            _childrenByPair = _populationSize / _survivorsPerGeneration;
+
+            _population.SetExecutor(executor);
+            if (_random.has_value())
+            {
+                RandomStream initialization = _random->Split(0);
+                _population.Initialize(_populationSize, _runtimeMode, initialization);
+            }
+            else
+                _population.Initialize(_populationSize, _runtimeMode);
+            _population.Evaluate(_runtimeMode);
         }
 
     public:
@@ -53,21 +108,47 @@ namespace gbgp
         Environment(const Grammar& grammar, const std::function<double(SyntaxTree&)>& fitnessFunction,
                     int populationSize, int survivorsPerGeneration, int eliteIndividuals,
                     int immigrationIndividuals, double mutationProbability,
-                    RuntimeMode runtimeMode)
-                    : _population(grammar, fitnessFunction)
-        {
-            _populationSize = populationSize;
-            _survivorsPerGeneration = survivorsPerGeneration;
-            _eliteIndividuals = eliteIndividuals;
-            _immigrationIndividuals = immigrationIndividuals;
-            _mutationProbability = mutationProbability;
-            _runtimeMode = runtimeMode;
+                    RuntimeMode runtimeMode) :
+                Environment(grammar, fitnessFunction, populationSize, survivorsPerGeneration, eliteIndividuals,
+                            immigrationIndividuals, mutationProbability, runtimeMode, nullptr) {}
 
-            _childrenByPair = _populationSize / _survivorsPerGeneration;
+        /// Environment constructor.
+        /// \param grammar The grammar used for creating and mutating individuals.
+        /// \param fitnessFunction The fitness function for evaluating individuals.
+        /// \param populationSize The size of the population.
+        /// \param survivorsPerGeneration The number of individuals that survive the selection operator.
+        /// \param eliteIndividuals The number of individuals that automatically survive to the next generation.
+        /// \param immigrationIndividuals The number of new individuals to be inserted on the population on each generation.
+        /// \param mutationProbability The probability that an individual mutates over a generation.
+        /// \param runtimeMode Whether to evaluate the population on a single thread or in a thread pool.
+        /// \param executor The worker threads used in the multithread mode, which are reused by every generation and
+        /// can be shared with other environments. Null creates an executor with one thread per hardware thread.
+        Environment(const Grammar& grammar, const std::function<double(SyntaxTree&)>& fitnessFunction,
+                    int populationSize, int survivorsPerGeneration, int eliteIndividuals,
+                    int immigrationIndividuals, double mutationProbability,
+                    RuntimeMode runtimeMode, const std::shared_ptr<Executor>& executor) :
+                Environment(grammar, fitnessFunction, populationSize, survivorsPerGeneration, eliteIndividuals,
+                            immigrationIndividuals, mutationProbability, runtimeMode, executor, std::nullopt) {}
 
-            _population.Initialize(_populationSize);
-            _population.Evaluate(_runtimeMode);
-        }
+        /// Environment constructor.
+        /// \param grammar The grammar used for creating and mutating individuals.
+        /// \param fitnessFunction The fitness function for evaluating individuals.
+        /// \param populationSize The size of the population.
+        /// \param survivorsPerGeneration The number of individuals that survive the selection operator.
+        /// \param eliteIndividuals The number of individuals that automatically survive to the next generation.
+        /// \param immigrationIndividuals The number of new individuals to be inserted on the population on each generation.
+        /// \param mutationProbability The probability that an individual mutates over a generation.
+        /// \param runtimeMode Whether to evaluate the population on a single thread or in a thread pool.
+        /// \param executor The worker threads used in the multithread mode, which are reused by every generation and
+        /// can be shared with other environments. Null creates an executor with one thread per hardware thread.
+        /// \param seed The seed of the random stream of the run. Two runs with the same seed evolve the same
+        /// individuals, with any runtime mode and any number of threads.
+        Environment(const Grammar& grammar, const std::function<double(SyntaxTree&)>& fitnessFunction,
+                    int populationSize, int survivorsPerGeneration, int eliteIndividuals,
+                    int immigrationIndividuals, double mutationProbability,
+                    RuntimeMode runtimeMode, const std::shared_ptr<Executor>& executor, uint64_t seed) :
+                Environment(grammar, fitnessFunction, populationSize, survivorsPerGeneration, eliteIndividuals,
+                            immigrationIndividuals, mutationProbability, runtimeMode, executor, RandomStream(seed)) {}
 
         /// Population getter.
         [[nodiscard]]
@@ -76,6 +157,50 @@ namespace gbgp
             return _population;
         }
 
+        /// Sets the cache used to skip the evaluation of individuals identical to one already evaluated, in this and
+        /// in the following generations.
+        /// \param fitnessCache The cache, which must hold values of the fitness function of this environment. Null
+        /// disables the cache.
+        void SetFitnessCache(const std::shared_ptr<FitnessCache>& fitnessCache)
+        {
+            _population.SetFitnessCache(fitnessCache);
+        }
+
+        /// Sets the worker threads used in the multithread mode, in this and in the following generations.
+        /// \param executor The executor, which can be shared with other environments.
+        void SetExecutor(const std::shared_ptr<Executor>& executor)
+        {
+            _population.SetExecutor(executor);
+        }
+
+        /// Executor getter.
+        [[nodiscard]]
+        std::shared_ptr<Executor> GetExecutor() const
+        {
+            return _population.GetExecutor();
+        }
+
+        /// Sets the order in which the individuals are evaluated in the multithread mode.
+        /// \param schedulingPolicy The scheduling policy.
+        void SetSchedulingPolicy(SchedulingPolicy schedulingPolicy)
+        {
+            _population.SetSchedulingPolicy(schedulingPolicy);
+        }
+
+        /// Get the makespan and idle time of the workers in the evaluation of each optimized generation.
+        [[nodiscard]]
+        const std::vector<ExecutorStatistics>& GetEvaluationHistory() const
+        {
+            return _evaluationHistory;
+        }
+
+        /// Get the hits and misses of the fitness cache in each generation optimized with it.
+        [[nodiscard]]
+        const std::vector<FitnessCacheStatistics>& GetFitnessCacheHistory() const
+        {
+            return _fitnessCacheHistory;
+        }
+
         /// Optimizes a population via genetic optimization.
         void Optimize()
         {
@@ -88,22 +213,49 @@ namespace gbgp
         {
             for (unsigned i = 0; i < generations; i++)
             {
+                const std::shared_ptr<FitnessCache> fitnessCache = _population.GetFitnessCache();
+                const FitnessCacheStatistics before = fitnessCache ? fitnessCache->GetStatistics() : FitnessCacheStatistics();
+
                 // Store the fittest individuals.
                 std::vector<Individual> elite = _population.GetNthFittestByRank(_eliteIndividuals);
 
                 // Apply the genetic operators and evaluate generation-
-                GeneticOperators::Selection(_population, _survivorsPerGeneration);
-                GeneticOperators::Crossover(_population, _childrenByPair);
-                GeneticOperators::Mutation(_population, _mutationProbability);
+                std::optional<RandomStream> immigrationRandom;
+                if (_random.has_value())
+                {
+                    // Every operator of the generation gets its own stream, so the draws of one do not shift the others.
+                    const RandomStream generation = _random->Split(++_generation);
+                    RandomStream selectionRandom = generation.Split(0);
+                    RandomStream crossoverRandom = generation.Split(1);
+                    RandomStream mutationRandom = generation.Split(2);
+                    immigrationRandom = generation.Split(3);
+
+                    GeneticOperators::Selection(_population, _survivorsPerGeneration, selectionRandom);
+                    GeneticOperators::Crossover(_population, _childrenByPair, _runtimeMode, crossoverRandom);
+                    GeneticOperators::Mutation(_population, _mutationProbability, 0.5, _runtimeMode, mutationRandom);
+                }
+                else
+                {
+                    GeneticOperators::Selection(_population, _survivorsPerGeneration);
+                    GeneticOperators::Crossover(_population, _childrenByPair, _runtimeMode);
+                    GeneticOperators::Mutation(_population, _mutationProbability, 0.5, _runtimeMode);
+                }
                 _population.Evaluate(_runtimeMode);
+                _evaluationHistory.push_back(_population.GetEvaluationStatistics());
 
                 // Replace worst of generation by elite individuals.
                 _population.RemoveWorst(_eliteIndividuals + _immigrationIndividuals);
-                _population.AddIndividuals(elite);
-                _population.AddIndividuals(GenerateImmigrationIndividuals(_immigrationIndividuals));
+                _population.AddIndividuals(std::move(elite));
+                _population.AddIndividuals(GenerateImmigrationIndividuals(_immigrationIndividuals, immigrationRandom));
 
                 // Prune generation.
-                _population.Prune();
+                _population.Prune(_runtimeMode);
+
+                if (fitnessCache != nullptr)
+                {
+                    const FitnessCacheStatistics after = fitnessCache->GetStatistics();
+                    _fitnessCacheHistory.push_back({ after.hits - before.hits, after.misses - before.misses });
+                }
             }
         }
 
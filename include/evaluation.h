@@ -1,9 +1,15 @@
 #pragma once
+#include <cstdint>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace gbgp
 {
+    template<typename Context> class BasicClosureSyntaxTree;
+
     //*********************************
     //*      Evaluation context       *
     //********************************/
@@ -19,6 +25,8 @@ namespace gbgp
         /// The semantic values used at each semantic action.
         std::vector<std::string> _semanticValues;
 
+        template<typename Context> friend class BasicClosureSyntaxTree;
+
     public:
 
         // Shorthand getter/setter
@@ -51,6 +59,13 @@ namespace gbgp
             _semanticValues.push_back(value);
         }
 
+        /// Push the evaluation result of a ProductionRule for later use inside a semantic action.
+        /// \param value Value to move into the context.
+        void PushSemanticValue(std::string&& value)
+        {
+            _semanticValues.push_back(std::move(value));
+        }
+
         /// Get the total number of semantic values.
         [[nodiscard]]
         unsigned NumberOfSemanticValues() const
@@ -60,7 +75,7 @@ namespace gbgp
 
         /// Transfer the semantic value at the specified index to the result.
         /// \param index The semantic value index.
-        void TransferSemanticValueToResult(unsigned index = 0)
+        virtual void TransferSemanticValueToResult(unsigned index = 0)
         {
             result() = SemanticValue(index);
         }
@@ -80,4 +95,141 @@ namespace gbgp
                    + vector_to_string(GetSemanticValues()) + ")";
         }
     };
-}
\ No newline at end of file
+
+    //*********************************
+    //*   Typed evaluation context    *
+    //********************************/
+
+    class SyntaxTree;
+    class CompiledSyntaxTree;
+
+    /// Evaluation context whose semantic values are stored natively as T instead of as strings. It is evaluated
+    /// with SyntaxTree::Evaluate like any other context, and the same production rules can be used as long as their
+    /// semantic actions only use the typed accessors or the default transfer action. Inside a semantic action,
+    /// TypedSemanticValue gives access to the value of a NonTerminal and TerminalValue to the value of a Terminal,
+    /// both without copies. The values of the NonTerminals are not stored in the nodes.
+    /// \tparam T The type of the semantic values. Usually double, int64_t or bool.
+    template<typename T> class TypedEvaluationContext : public EvaluationContext
+    {
+    private:
+        /// Semantic value of a production element. Terminals keep a reference to their value.
+        struct Slot
+        {
+            T value;
+            const std::string* terminal;
+        };
+
+        /// The result value of each semantic action.
+        T _typedResult{};
+
+        /// The semantic values used at each semantic action.
+        std::vector<Slot> _slots;
+
+        /// Values of the evaluated NonTerminals waiting for their parent. Kept here to reuse its memory.
+        std::vector<T> _stack;
+
+        friend class SyntaxTree;
+        friend class CompiledSyntaxTree;
+        template<typename Context> friend class BasicClosureSyntaxTree;
+
+    public:
+
+        // Shorthand getter/setter
+        auto typedResult()                     -> T&       { return _typedResult; }
+        [[nodiscard]] auto typedResult() const -> const T& { return _typedResult; }
+
+        T GetTypedResult() const { return _typedResult; }
+        void SetTypedResult(const T& value) { _typedResult = value; }
+
+        /// Get the value of the NonTerminal at the specified index of the associated ProductionRule.
+        /// \param index Index of the production element.
+        /// \return Reference to the evaluated value.
+        [[nodiscard]]
+        const T& TypedSemanticValue(unsigned index) const
+        {
+            const Slot& slot = _slots.at(index);
+            if (slot.terminal != nullptr)
+                throw std::runtime_error("The semantic value at index " + std::to_string(index) + " is a Terminal.");
+            return slot.value;
+        }
+
+        /// Get the value of the Terminal at the specified index of the associated ProductionRule.
+        /// \param index Index of the production element.
+        /// \return Reference to the value of the Terminal.
+        [[nodiscard]]
+        const std::string& TerminalValue(unsigned index) const
+        {
+            const Slot& slot = _slots.at(index);
+            if (slot.terminal == nullptr)
+                throw std::runtime_error("The semantic value at index " + std::to_string(index) + " is a NonTerminal.");
+            return *slot.terminal;
+        }
+
+        /// Push the evaluation result of a NonTerminal for later use inside a semantic action.
+        /// \param value Value to push.
+        void PushTypedSemanticValue(const T& value)
+        {
+            _slots.push_back({ value, nullptr });
+        }
+
+        /// Push the value of a Terminal for later use inside a semantic action. The referenced string must outlive
+        /// the semantic action.
+        /// \param value Value to push.
+        void PushTerminalValue(const std::string& value)
+        {
+            _slots.push_back({ T{}, &value });
+        }
+
+        /// Get the total number of typed semantic values.
+        [[nodiscard]]
+        unsigned NumberOfTypedSemanticValues() const
+        {
+            return _slots.size();
+        }
+
+        /// Transfer the semantic value at the specified index to the typed result. The values of Terminals are
+        /// converted with ParseValue. When the context is evaluated as a plain EvaluationContext, the semantic
+        /// values are strings and the string value is transferred to the result instead.
+        /// \param index The semantic value index.
+        void TransferSemanticValueToResult(unsigned index = 0) override
+        {
+            if (_slots.empty() && NumberOfSemanticValues() > 0)
+            {
+                EvaluationContext::TransferSemanticValueToResult(index);
+                return;
+            }
+
+            const Slot& slot = _slots.at(index);
+            _typedResult = slot.terminal != nullptr ? ParseValue(*slot.terminal) : slot.value;
+        }
+
+        /// Converts the value of a Terminal to T. Override it for grammars with Terminals that are not literals.
+        /// \param value The value of the Terminal.
+        /// \return The converted value.
+        virtual T ParseValue(const std::string& value) const
+        {
+            if constexpr (std::is_same_v<T, bool>)
+                return value == "true" || value == "1";
+            else if constexpr (std::is_integral_v<T>)
+                return static_cast<T>(std::stoll(value));
+            else if constexpr (std::is_floating_point_v<T>)
+                return static_cast<T>(std::stod(value));
+            else if constexpr (std::is_constructible_v<T, const std::string&>)
+                return T(value);
+            else
+                throw std::runtime_error("There is no conversion for the terminal value " + value);
+        }
+
+        /// Virtual function that is executed before each evaluation of a semantic action.
+        void Prepare() override
+        {
+            EvaluationContext::Prepare();
+            _slots.clear();
+            _typedResult = T{};
+        }
+    };
+
+    using DoubleEvaluationContext = TypedEvaluationContext<double>;
+    using IntEvaluationContext = TypedEvaluationContext<int64_t>;
+    using BoolEvaluationContext = TypedEvaluationContext<bool>;
+}
@@ -0,0 +1,341 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace gbgp
+{
+    /// Time spent by the workers of an executor on a parallel loop.
+    struct ExecutorStatistics
+    {
+        /// Number of worker threads that ran the loop.
+        unsigned threads = 0;
+
+        /// Number of indexes of the loop.
+        size_t tasks = 0;
+
+        /// Number of chunks of indexes the loop was split into.
+        size_t chunks = 0;
+
+        /// Number of chunks taken from the deque of another worker.
+        size_t steals = 0;
+
+        /// Seconds from the start of the loop until its last index finished.
+        double makespan = 0.0;
+
+        /// Seconds the workers spent running the loop, added over all the workers.
+        double busyTime = 0.0;
+
+        /// Seconds the workers spent without a task of the loop before it finished, added over all the workers.
+        double idleTime = 0.0;
+
+        /// Get the fraction of the available worker time that was wasted while waiting for the loop to finish.
+        [[nodiscard]]
+        double IdleFraction() const
+        {
+            const double available = busyTime + idleTime;
+            return available > 0.0 ? idleTime / available : 0.0;
+        }
+    };
+
+    /// A long-lived pool of worker threads shared by the populations of an environment. The threads are created
+    /// once and reused by every parallel phase of every generation, so cheap fitness functions do not pay the cost
+    /// of spawning and joining threads on each evaluation.
+    /// The indexes of a loop are ordered by decreasing cost and grouped into chunks of similar total cost, so tiny
+    /// tasks do not pay the scheduling overhead one by one. The chunks are dealt to per-worker deques. Each worker
+    /// runs its own chunks from the front, largest first, and when it runs out it steals from the back of the other
+    /// deques, so the expensive tasks start early and no worker stays idle while there is work left.
+    class Executor
+    {
+    private:
+        /// A parallel loop submitted by a caller, which lives in the stack of the caller until it finishes.
+        struct Job
+        {
+            const std::function<void(size_t)>* function = nullptr;
+            std::vector<size_t> order;
+            std::atomic<size_t> remainingChunks{ 0 };
+            std::atomic<size_t> steals{ 0 };
+            std::atomic<long long> busyNanoseconds{ 0 };
+            std::exception_ptr error;
+            bool finished = false;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+
+        /// A chunk of consecutive positions of the order of a job.
+        struct Chunk
+        {
+            Job* job = nullptr;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Chunk> chunks;
+        };
+
+        /// Number of chunks per worker the loops are split into, if the costs allow it. More chunks balance the
+        /// load better, fewer chunks have less scheduling overhead.
+        static constexpr size_t ChunksPerWorker = 8;
+
+        std::vector<std::unique_ptr<Worker>> _workers;
+        std::vector<std::thread> _threads;
+
+        std::mutex _sleepMutex;
+        std::condition_variable _wake;
+        std::atomic<size_t> _pendingChunks{ 0 };
+        bool _stopping = false;
+
+        /// The executor whose worker is the current thread, or null.
+        static const Executor*& CurrentExecutor()
+        {
+            thread_local const Executor* current = nullptr;
+            return current;
+        }
+
+        /// Takes the next chunk of a worker, or steals one from another worker.
+        /// \param worker The index of the worker.
+        /// \param chunk The taken chunk.
+        /// \return True if a chunk was taken.
+        bool TakeChunk(size_t worker, Chunk& chunk)
+        {
+            {
+                Worker& own = *_workers[worker];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.chunks.empty())
+                {
+                    chunk = own.chunks.front();
+                    own.chunks.pop_front();
+                    return true;
+                }
+            }
+
+            for (size_t i = 1; i < _workers.size(); i++)
+            {
+                Worker& victim = *_workers[(worker + i) % _workers.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.chunks.empty())
+                {
+                    chunk = victim.chunks.back();
+                    victim.chunks.pop_back();
+                    chunk.job->steals++;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Runs a chunk and signals its job if it was the last one.
+        static void RunChunk(const Chunk& chunk)
+        {
+            Job& job = *chunk.job;
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                for (size_t i = chunk.begin; i < chunk.end; i++)
+                    (*job.function)(job.order[i]);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if (job.error == nullptr)
+                    job.error = std::current_exception();
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            job.busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+            if (--job.remainingChunks == 0)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.finished = true;
+                job.done.notify_all();
+            }
+        }
+
+        void WorkerLoop(size_t worker)
+        {
+            CurrentExecutor() = this;
+
+            while (true)
+            {
+                Chunk chunk;
+                if (TakeChunk(worker, chunk))
+                {
+                    _pendingChunks--;
+                    RunChunk(chunk);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(_sleepMutex);
+                _wake.wait(lock, [this]() { return _stopping || _pendingChunks > 0; });
+                if (_stopping && _pendingChunks == 0)
+                    return;
+            }
+        }
+
+        /// Runs a job in the workers and waits until it finishes.
+        /// \param job The job, whose function and order are set.
+        /// \param costs The cost of each position of the order, which is sorted by decreasing cost.
+        /// \return The statistics of the job.
+        ExecutorStatistics Run(Job& job, const std::vector<double>& costs)
+        {
+            ExecutorStatistics statistics;
+            statistics.threads = GetThreadCount();
+            statistics.tasks = job.order.size();
+
+            // Group consecutive tasks until they reach the cost of a chunk. Expensive tasks get a chunk of their own.
+            const double totalCost = std::accumulate(costs.begin(), costs.end(), 0.0);
+            const double chunkCost = totalCost / static_cast<double>(_workers.size() * ChunksPerWorker);
+            std::vector<Chunk> chunks;
+            size_t begin = 0;
+            double cost = 0.0;
+            for (size_t i = 0; i < costs.size(); i++)
+            {
+                cost += costs[i];
+                if (cost >= chunkCost || i + 1 == costs.size())
+                {
+                    chunks.push_back({ &job, begin, i + 1 });
+                    begin = i + 1;
+                    cost = 0.0;
+                }
+            }
+            statistics.chunks = chunks.size();
+            job.remainingChunks = chunks.size();
+
+            // Count the chunks before publishing them. A worker that is already awake can take a chunk as soon as
+            // it is in a deque, and it must not decrement the counter below zero.
+            const auto start = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+                _pendingChunks += chunks.size();
+            }
+
+            // Deal the chunks round-robin, so every worker starts with one of the most expensive ones.
+            for (size_t i = 0; i < chunks.size(); i++)
+            {
+                Worker& worker = *_workers[i % _workers.size()];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.chunks.push_back(chunks[i]);
+            }
+            _wake.notify_all();
+
+            std::unique_lock<std::mutex> lock(job.mutex);
+            job.done.wait(lock, [&job]() { return job.finished; });
+
+            const std::chrono::duration<double> makespan = std::chrono::steady_clock::now() - start;
+            statistics.makespan = makespan.count();
+            statistics.busyTime = static_cast<double>(job.busyNanoseconds.load()) * 1e-9;
+            statistics.idleTime = std::max(0.0, statistics.makespan * statistics.threads - statistics.busyTime);
+            statistics.steals = job.steals;
+
+            if (job.error != nullptr)
+                std::rethrow_exception(job.error);
+
+            return statistics;
+        }
+
+    public:
+        /// Creates an executor.
+        /// \param threadCount The number of worker threads. Zero uses the hardware concurrency.
+        explicit Executor(unsigned threadCount = 0)
+        {
+            if (threadCount == 0)
+                threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+            for (unsigned i = 0; i < threadCount; i++)
+                _workers.push_back(std::make_unique<Worker>());
+            for (unsigned i = 0; i < threadCount; i++)
+                _threads.emplace_back([this, i]() { WorkerLoop(i); });
+        }
+
+        Executor(const Executor&) = delete;
+        Executor& operator=(const Executor&) = delete;
+
+        ~Executor()
+        {
+            {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+                _stopping = true;
+            }
+            _wake.notify_all();
+
+            for (std::thread& thread : _threads)
+                thread.join();
+        }
+
+        /// Calls a function for every index of a range in the current thread.
+        /// \param n The number of indexes.
+        /// \param function The function, which receives the index.
+        /// \return The time spent on the loop.
+        static ExecutorStatistics SequentialFor(size_t n, const std::function<void(size_t)>& function)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < n; i++)
+                function(i);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            ExecutorStatistics statistics;
+            statistics.threads = 1;
+            statistics.tasks = n;
+            statistics.chunks = n > 0 ? 1 : 0;
+            statistics.makespan = elapsed.count();
+            statistics.busyTime = elapsed.count();
+            return statistics;
+        }
+
+        /// Get the number of worker threads.
+        [[nodiscard]]
+        unsigned GetThreadCount() const
+        {
+            return static_cast<unsigned>(_threads.size());
+        }
+
+        /// Calls a function for every index of a range in the worker threads, and waits until all the calls finish.
+        /// The tasks of other callers sharing the executor are not waited for. When it is called from a task of this
+        /// executor the calls run in the current thread, as blocking a worker on its own pool could deadlock.
+        /// \param n The number of indexes, which are assumed to have the same cost.
+        /// \param function The function, which receives the index.
+        /// \return The time spent by the workers on the loop.
+        ExecutorStatistics ParallelFor(size_t n, const std::function<void(size_t)>& function)
+        {
+            return ParallelFor(std::vector<double>(n, 1.0), function);
+        }
+
+        /// Calls a function for every index of a range in the worker threads, starting with the most expensive
+        /// ones, and waits until all the calls finish. When it is called from a task of this executor the calls run
+        /// in the current thread, as blocking a worker on its own pool could deadlock.
+        /// \param costs The estimated cost of each index, in any unit.
+        /// \param function The function, which receives the index.
+        /// \return The time spent by the workers on the loop.
+        ExecutorStatistics ParallelFor(const std::vector<double>& costs, const std::function<void(size_t)>& function)
+        {
+            if (costs.size() <= 1 || CurrentExecutor() == this)
+                return SequentialFor(costs.size(), function);
+
+            Job job;
+            job.function = &function;
+            job.order.resize(costs.size());
+            std::iota(job.order.begin(), job.order.end(), 0);
+            std::stable_sort(job.order.begin(), job.order.end(), [&costs](size_t a, size_t b) {
+                return costs[a] > costs[b];
+            });
+
+            std::vector<double> sortedCosts(costs.size());
+            for (size_t i = 0; i < costs.size(); i++)
+                sortedCosts[i] = std::max(0.0, costs[job.order[i]]);
+
+            return Run(job, sortedCosts);
+        }
+    };
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "syntax_tree.h"
+
+namespace gbgp
+{
+    /// Hits and misses of the fitness cache during one generation.
+    struct FitnessCacheStatistics
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+
+        /// Get the fraction of evaluations that were found in the cache.
+        [[nodiscard]]
+        double HitRate() const
+        {
+            return hits + misses > 0 ? static_cast<double>(hits) / static_cast<double>(hits + misses) : 0.0;
+        }
+    };
+
+    /// A cached fitness value together with the snapshot of the tree.
+    struct CachedFitness
+    {
+        std::shared_ptr<const SubtreeSnapshot> snapshot;
+        double fitness;
+    };
+
+    /// Cache of fitness values keyed by the structural hash and size of the trees, so identical individuals are only
+    /// evaluated once. The hash covers the rules of the trees, and every entry keeps a snapshot of its tree, so trees
+    /// with colliding hashes never share a value. Elites, offspring of identical parents and mutations that choose the
+    /// same value produce duplicates in every generation. The cache can be shared by populations and generations
+    /// evaluated with the same fitness function, and by the threads of a MultiThread evaluation.
+    class FitnessCache : public ShardedCache<CachedFitness>
+    {
+    public:
+        /// Creates an empty cache.
+        /// \param capacity The maximum number of cached fitness values.
+        /// \param numberOfShards The number of independently locked parts of the cache.
+        explicit FitnessCache(size_t capacity, size_t numberOfShards = 16)
+            : ShardedCache<CachedFitness>(capacity, numberOfShards) {}
+
+        /// Looks up the fitness of a tree.
+        /// \param tree The tree.
+        /// \param fitness Receives the cached fitness, if found.
+        /// \return True if the fitness was found.
+        bool Find(const SyntaxTree& tree, double& fitness)
+        {
+            CachedFitness cached{};
+            const TreeNode* root = tree.Root();
+            if (!ShardedCache<CachedFitness>::Find({ tree.StructuralHash(), tree.Size(), 0 }, cached,
+                                                   [root](const CachedFitness& entry) {
+                    return entry.snapshot == nullptr ? root == nullptr : root != nullptr && entry.snapshot->Matches(root);
+                }))
+                return false;
+
+            fitness = cached.fitness;
+            return true;
+        }
+
+        /// Stores the fitness of a tree.
+        /// \param tree The tree.
+        /// \param fitness The fitness value.
+        void Insert(const SyntaxTree& tree, double fitness)
+        {
+            const TreeNode* root = tree.Root();
+            ShardedCache<CachedFitness>::Insert({ tree.StructuralHash(), tree.Size(), 0 },
+                                                { root != nullptr ? SubtreeSnapshot::Create(root) : nullptr, fitness });
+        }
+
+        /// Get the current hit and miss counters.
+        [[nodiscard]]
+        FitnessCacheStatistics GetStatistics() const
+        {
+            return { Hits(), Misses() };
+        }
+    };
+}
@@ -0,0 +1,484 @@
+#pragma once
+#include "grammar.h"
+
+namespace gbgp
+{
+    /// Compact representation of a syntax tree stored as contiguous arrays in depth first pre-order. Each node is
+    /// described by the index of its generator rule in the grammar, the index of its terminal value and the size of
+    /// its subtree. Terminals are resolved through the production rule of their parent, so a node never owns any
+    /// grammar data and a whole tree lives in three allocations.
+    class FlatSyntaxTree
+    {
+    private:
+        /// The grammar that resolves the rule indexes.
+        const Grammar* _grammar;
+
+        /// Index of the generator rule of each node in the grammar. Terminal nodes have a value of -1.
+        std::vector<int> _rules;
+
+        /// Index of the value of each terminal node in the values of its Terminal. NonTerminal nodes have a value of -1.
+        std::vector<int> _values;
+
+        /// Number of nodes of the subtree that starts at each node, including itself.
+        std::vector<unsigned> _sizes;
+
+        /// Append a node at the end of the arrays.
+        /// \param rule The rule index.
+        /// \param value The terminal value index.
+        /// \return The position of the new node.
+        size_t PushNode(int rule, int value)
+        {
+            _rules.push_back(rule);
+            _values.push_back(value);
+            _sizes.push_back(1);
+            return _rules.size() - 1;
+        }
+
+        /// Recursive implementation. Appends the subtree of a TreeNode in pre-order.
+        /// \param node The root of the subtree.
+        void AppendTreeNode(const TreeNode* node)
+        {
+            if (node->type == NodeType::Terminal)
+            {
+                const std::vector<std::string>& values = node->GetTerminal().values;
+                const auto value = std::find(values.begin(), values.end(), node->GetValue());
+                if (value == values.end())
+                    throw std::runtime_error("Terminal value " + node->GetValue() + " is not a value of " + node->GetTerminal().label);
+
+                PushNode(-1, static_cast<int>(std::distance(values.begin(), value)));
+                return;
+            }
+
+            const std::optional<size_t> rule = _grammar->FindRuleIndex(node->GetGeneratorPR());
+            if (!rule.has_value())
+                throw std::runtime_error("The rule " + node->GetGeneratorPR().ToString() + " is not part of the grammar");
+
+            const size_t position = PushNode(static_cast<int>(rule.value()), -1);
+            for (const auto& child : node->children)
+                AppendTreeNode(child.get());
+
+            _sizes[position] = static_cast<unsigned>(_rules.size() - position);
+        }
+
+        /// Recursive implementation. Adds the children of the node at position to a TreeNode.
+        /// \param position The position of the NonTerminal node.
+        /// \param target The node where the children will be created.
+        void BuildTreeNode(size_t position, TreeNode* target) const
+        {
+            const ProductionRule& rule = _grammar->GetRule(_rules[position]);
+            size_t child = position + 1;
+
+            for (const ProductionElement& pe : rule.to)
+            {
+                if (pe.type == ProductionElementType::Terminal)
+                    target->AddChildTerm(pe.term, pe.term.values[_values[child]]);
+                else
+                    BuildTreeNode(child, target->AddChildTerm(pe.nonterm, _grammar->GetRule(_rules[child])));
+
+                child += _sizes[child];
+            }
+        }
+
+        /// Recursive implementation. Appends a random subtree generated from a rule.
+        /// \param rule The rule index of the root of the subtree.
+        /// \param depth The depth of the root of the subtree.
+        /// \param maxDepth Maximum allowed tree depth.
+        /// \return True if creation is successful, false if not.
+        bool TryAppendRandomSubtree(size_t rule, int depth, int maxDepth)
+        {
+            const size_t position = PushNode(static_cast<int>(rule), -1);
+
+            for (const ProductionElement& pe : _grammar->GetRule(rule).to)
+            {
+                if (pe.type == ProductionElementType::Terminal)
+                    PushNode(-1, RandomValueIndex(pe.term));
+                else if (pe.type == ProductionElementType::NonTerminal)
+                {
+                    if (depth == maxDepth)
+                        return false;
+
+                    const size_t childRule = _grammar->GetRandomCompatibleRuleIndex(pe.nonterm.id);
+                    if (!TryAppendRandomSubtree(childRule, depth + 1, maxDepth))
+                        return false;
+                }
+                else
+                    throw std::runtime_error("Unassigned production element type");
+            }
+
+            _sizes[position] = static_cast<unsigned>(_rules.size() - position);
+            return true;
+        }
+
+        /// Recursive implementation. Calls f with the position and Terminal of every terminal node of a subtree.
+        /// \param position The position of the NonTerminal root of the subtree.
+        /// \param f The function that receives the terminal nodes.
+        template<typename F> void ForEachTerminal(size_t position, F&& f) const
+        {
+            const ProductionRule& rule = _grammar->GetRule(_rules[position]);
+            size_t child = position + 1;
+
+            for (const ProductionElement& pe : rule.to)
+            {
+                if (pe.type == ProductionElementType::Terminal)
+                    f(child, pe.term);
+                else
+                    ForEachTerminal(child, f);
+
+                child += _sizes[child];
+            }
+        }
+
+        /// Recursive implementation. Evaluates the subtree at position and leaves its result on top of the stack.
+        /// \param position The position of the NonTerminal root of the subtree.
+        /// \param ctx The evaluation context.
+        /// \param stack The stack of semantic values shared by the whole evaluation.
+        void EvaluateNode(size_t position, EvaluationContext& ctx, std::vector<std::string>& stack) const
+        {
+            const ProductionRule& rule = _grammar->GetRule(_rules[position]);
+            const size_t base = stack.size();
+            size_t child = position + 1;
+
+            for (const ProductionElement& pe : rule.to)
+            {
+                if (pe.type == ProductionElementType::Terminal)
+                    stack.push_back(pe.term.values[_values[child]]);
+                else
+                    EvaluateNode(child, ctx, stack);
+
+                child += _sizes[child];
+            }
+
+            if (rule.semanticAction == nullptr)
+                throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
+
+            ctx.Prepare();
+            for (size_t i = base; i < stack.size(); i++)
+                ctx.PushSemanticValue(stack[i]);
+            rule.semanticAction(ctx);
+
+            stack.resize(base);
+            stack.push_back(ctx.result());
+        }
+
+        /// Get the NonTerminal type of the node at position.
+        [[nodiscard]]
+        int NonTerminalType(size_t position) const
+        {
+            return _grammar->GetRule(_rules[position]).from.id;
+        }
+
+        /// Get the depth of every node. The root has depth 0.
+        [[nodiscard]]
+        std::vector<int> NodeDepths() const
+        {
+            // The ends of the subtrees that contain the current position, from the root down.
+            std::vector<size_t> ends;
+            std::vector<int> depths(_rules.size());
+            for (size_t i = 0; i < _rules.size(); i++)
+            {
+                while (!ends.empty() && ends.back() <= i)
+                    ends.pop_back();
+                depths[i] = static_cast<int>(ends.size());
+                ends.push_back(i + _sizes[i]);
+            }
+            return depths;
+        }
+
+        /// Get the positions of the NonTerminal nodes that can be replaced, that is, every NonTerminal but the root.
+        [[nodiscard]]
+        std::vector<size_t> MutableNonTerminalPositions() const
+        {
+            std::vector<size_t> positions;
+            for (size_t i = 1; i < _rules.size(); i++)
+            {
+                if (_rules[i] >= 0)
+                    positions.push_back(i);
+            }
+            return positions;
+        }
+
+        /// Get a random value index of a terminal.
+        /// \param term The Terminal.
+        /// \return The index of the random value.
+        static int RandomValueIndex(const Terminal& term)
+        {
+            if (term.values.size() == 1)
+                return 0;
+
+            std::uniform_int_distribution<int> dis(0, static_cast<int>(term.values.size()) - 1);
+            return dis(random_generator());
+        }
+
+        /// Replace the subtree at position with the subtree of source that starts at sourcePosition.
+        /// \param position The position of the subtree that will be replaced.
+        /// \param source The tree that contains the inserted subtree.
+        /// \param sourcePosition The position of the inserted subtree in source.
+        void ReplaceSubtree(size_t position, const FlatSyntaxTree& source, size_t sourcePosition)
+        {
+            const size_t oldSize = _sizes[position];
+            const size_t newSize = source._sizes[sourcePosition];
+            const long delta = static_cast<long>(newSize) - static_cast<long>(oldSize);
+
+            // Every node that contains position is an ancestor and its subtree changes size.
+            for (size_t i = 0; i < position; i++)
+            {
+                if (i + _sizes[i] > position)
+                    _sizes[i] = static_cast<unsigned>(static_cast<long>(_sizes[i]) + delta);
+            }
+
+            auto splice = [&](auto& target, const auto& from) {
+                target.erase(target.begin() + position, target.begin() + position + oldSize);
+                target.insert(target.begin() + position, from.begin() + sourcePosition,
+                              from.begin() + sourcePosition + newSize);
+            };
+            splice(_rules, source._rules);
+            splice(_values, source._values);
+            splice(_sizes, source._sizes);
+        }
+
+    public:
+        /// Creates an empty tree bound to a grammar. The grammar must outlive the tree.
+        /// \param grammar The grammar that resolves the rules of the tree.
+        explicit FlatSyntaxTree(const Grammar& grammar) : _grammar(&grammar) {}
+
+        /// Builds the flat representation of a SyntaxTree. Every rule of the tree must be part of the grammar.
+        /// \param grammar The grammar that resolves the rules of the tree.
+        /// \param syntaxTree The source tree.
+        FlatSyntaxTree(const Grammar& grammar, const SyntaxTree& syntaxTree) : _grammar(&grammar)
+        {
+            if (!syntaxTree.IsEmpty())
+                AppendTreeNode(syntaxTree.Root());
+        }
+
+        bool operator==(const FlatSyntaxTree& other) const
+        {
+            return _rules == other._rules && _values == other._values;
+        }
+
+        bool operator!=(const FlatSyntaxTree& other) const
+        {
+            return !(*this == other);
+        }
+
+        /// Get the number of nodes.
+        [[nodiscard]]
+        size_t Size() const
+        {
+            return _rules.size();
+        }
+
+        /// Check if the tree is empty.
+        [[nodiscard]]
+        bool IsEmpty() const
+        {
+            return _rules.empty();
+        }
+
+        /// Getter for the grammar.
+        [[nodiscard]]
+        const Grammar& GetGrammar() const
+        {
+            return *_grammar;
+        }
+
+        /// Rule indexes of the nodes in pre-order. Terminal nodes have a value of -1.
+        [[nodiscard]]
+        const std::vector<int>& GetRules() const
+        {
+            return _rules;
+        }
+
+        /// Terminal value indexes of the nodes in pre-order. NonTerminal nodes have a value of -1.
+        [[nodiscard]]
+        const std::vector<int>& GetValues() const
+        {
+            return _values;
+        }
+
+        /// Subtree sizes of the nodes in pre-order.
+        [[nodiscard]]
+        const std::vector<unsigned>& GetSubtreeSizes() const
+        {
+            return _sizes;
+        }
+
+        //************************
+        //*      Conversions     *
+        //***********************/
+
+        /// Rebuilds the pointer based representation of the tree.
+        /// \param syntaxTree The target tree. Its previous content is destroyed.
+        void ToSyntaxTree(SyntaxTree& syntaxTree) const
+        {
+            syntaxTree.Destroy();
+            if (IsEmpty())
+                return;
+
+            syntaxTree.SetRootRule(_grammar->GetRule(_rules.front()));
+            BuildTreeNode(0, syntaxTree.Root());
+        }
+
+        /// Rebuilds the pointer based representation of the tree.
+        /// \return The SyntaxTree.
+        [[nodiscard]]
+        SyntaxTree ToSyntaxTree() const
+        {
+            SyntaxTree syntaxTree;
+            ToSyntaxTree(syntaxTree);
+            return syntaxTree;
+        }
+
+        //******************************
+        //*   Random tree generation   *
+        //*****************************/
+
+        /// Create random tree safely by creating random trees until there is a success. The NonTerminals are at most
+        /// maxDepth levels below the root.
+        /// \param maxDepth Maximum allowed tree depth.
+        /// \param rootRule The index of the rule of the root in the grammar. Use 0 for the root rule of the grammar.
+        void CreateRandom(int maxDepth, size_t rootRule)
+        {
+            bool success = false;
+            while (!success)
+            {
+                _rules.clear();
+                _values.clear();
+                _sizes.clear();
+                success = TryAppendRandomSubtree(rootRule, 0, maxDepth);
+            }
+        }
+
+        //***************************
+        //*     Tree evaluation     *
+        //**************************/
+
+        /// Synthesizes the tree by appending its terminal values to output.
+        /// \param output The string where the expression will be appended.
+        void SynthesizeExpression(std::string& output) const
+        {
+            if (!IsEmpty())
+                ForEachTerminal(0, [&](size_t position, const Terminal& term) { output += term.values[_values[position]]; });
+        }
+
+        /// Synthesizes the tree into an expression.
+        /// \return The synthesized expression as a std::string.
+        [[nodiscard]]
+        std::string SynthesizeExpression() const
+        {
+            std::string output;
+            SynthesizeExpression(output);
+            return output;
+        }
+
+        /// Evaluates the tree using the semantic actions of the grammar. The result is stored in the context.
+        /// \param ctx Reference to the evaluation context.
+        void Evaluate(EvaluationContext& ctx) const
+        {
+            if (IsEmpty())
+                return;
+
+            std::vector<std::string> stack;
+            EvaluateNode(0, ctx, stack);
+        }
+
+        //***************************
+        //*    Genetic operators    *
+        //**************************/
+
+        /// Generates a new offspring by replacing a random subtree of parent1 with a subtree of the same NonTerminal
+        /// type of parent2.
+        /// \param parent1 The first parent.
+        /// \param parent2 The second parent.
+        /// \return The offspring. If the parents share no NonTerminal type, a copy of parent1.
+        static FlatSyntaxTree Crossover(const FlatSyntaxTree& parent1, const FlatSyntaxTree& parent2)
+        {
+            const std::vector<size_t> candidates1 = parent1.MutableNonTerminalPositions();
+            const std::vector<size_t> candidates2 = parent2.MutableNonTerminalPositions();
+
+            // Positions of parent1 whose type is also present on parent2.
+            std::vector<size_t> shared;
+            for (size_t p1 : candidates1)
+            {
+                for (size_t p2 : candidates2)
+                {
+                    if (parent1.NonTerminalType(p1) == parent2.NonTerminalType(p2))
+                    {
+                        shared.push_back(p1);
+                        break;
+                    }
+                }
+            }
+
+            FlatSyntaxTree offspring = parent1;
+            if (shared.empty())
+                return offspring;
+
+            const size_t position1 = *random_choice(shared.begin(), shared.end());
+            const int type = parent1.NonTerminalType(position1);
+
+            std::vector<size_t> sameType;
+            std::copy_if(candidates2.begin(), candidates2.end(), std::back_inserter(sameType),
+                         [&](size_t p2) { return parent2.NonTerminalType(p2) == type; });
+            const size_t position2 = *random_choice(sameType.begin(), sameType.end());
+
+            offspring.ReplaceSubtree(position1, parent2, position2);
+            return offspring;
+        }
+
+        /// Mutates the value of a random terminal that has more than one possible value.
+        void MutateTerminal()
+        {
+            if (IsEmpty())
+                return;
+
+            std::vector<std::pair<size_t, const Terminal*>> mutableTerminals;
+            ForEachTerminal(0, [&](size_t position, const Terminal& term) {
+                if (term.IsMutable())
+                    mutableTerminals.emplace_back(position, &term);
+            });
+
+            if (mutableTerminals.empty())
+                return;
+
+            const auto& [position, term] = *random_choice(mutableTerminals.begin(), mutableTerminals.end());
+            _values[position] = RandomValueIndex(*term);
+        }
+
+        /// Replaces a random NonTerminal, other than the root, with a new random subtree built from the same rule.
+        /// The new subtree is limited to the depth left below the node, so the tree stays within maxDepth.
+        /// \param maxDepth Maximum allowed tree depth.
+        void MutateNonTerminal(int maxDepth = 50)
+        {
+            // A node is only replaced if its current subtree fits in maxDepth, which shows that a subtree built from
+            // its rule can fit in the depth left below it.
+            const std::vector<int> depths = NodeDepths();
+            std::vector<size_t> candidates;
+            for (size_t position : MutableNonTerminalPositions())
+            {
+                int deepest = depths[position];
+                for (size_t i = position; i < position + _sizes[position]; i++)
+                {
+                    if (_rules[i] >= 0)
+                        deepest = std::max(deepest, depths[i]);
+                }
+                if (deepest <= maxDepth)
+                    candidates.push_back(position);
+            }
+            if (candidates.empty())
+                return;
+
+            const size_t position = *random_choice(candidates.begin(), candidates.end());
+
+            FlatSyntaxTree replacement(*_grammar);
+            replacement.CreateRandom(maxDepth - depths[position], _rules[position]);
+            ReplaceSubtree(position, replacement, 0);
+        }
+
+        /// Get a string representation.
+        [[nodiscard]]
+        std::string ToString() const
+        {
+            return "FlatSyntaxTree(nodes='" + std::to_string(Size()) + "', expression='" + SynthesizeExpression() + "')";
+        }
+    };
+}
@@ -1,2 +1,7 @@
 #pragma once
-#include "environment.h"
\ No newline at end of file
+#include "environment.h"
+#include "island_model.h"
+#include "code_generator.h"
+#include "flat_syntax_tree.h"
+#include "shared_syntax_tree.h"
+#include "compiled_syntax_tree.h"
\ No newline at end of file
@@ -10,11 +10,13 @@ namespace gbgp
     private:
         /// Get a random bool with probability p of being true.
         /// \param p The probability of returning true.
+        /// \param random The random number generator.
         /// \return The random bool.
-        static bool RandomBool(const double p = 0.5)
+        template<typename RandomGenerator>
+        static bool RandomBool(const double p, RandomGenerator& random)
         {
-            static auto dist = std::uniform_real_distribution<double>(0,1);
-            return (dist(random_generator()) < p);
+            std::uniform_real_distribution<double> dist(0, 1);
+            return (dist(random) < p);
         }
 
         /// Get a list of the mutable terminal nodes. For a terminal node to be mutable it needs to have more than one
@@ -25,7 +27,7 @@ namespace gbgp
         {
             std::vector<TreeNode*> mutableNodes;
             for (auto node : terminalNodes)
-                if (node->termInstance.IsMutable())
+                if (node->GetTerminal().IsMutable())
                     mutableNodes.push_back(node);
 
             return mutableNodes;
@@ -58,31 +60,35 @@ namespace gbgp
 
         /// Operator to mutate a random terminal from an individual.
         /// \param individual The target individual.
-        static void MutateIndividualTerminal(Individual& individual)
+        /// \param random The random number generator.
+        template<typename RandomGenerator>
+        static void MutateIndividualTerminal(Individual& individual, RandomGenerator& random)
         {
             // Select random terminal.
             std::vector<TreeNode*> mutableTerminals = GetMutableTermsOfType(individual.GetTree(), NodeType::Terminal);
-            TreeNode* randomTerminalNode = *random_choice(mutableTerminals.begin(), mutableTerminals.end());
-            Terminal randomTerminal = randomTerminalNode->termInstance;
+            TreeNode* randomTerminalNode = *random_choice(mutableTerminals.begin(), mutableTerminals.end(), random);
+            const Terminal& randomTerminal = randomTerminalNode->GetTerminal();
 
-            randomTerminalNode->termValue = randomTerminal.GetRandomValue();
+            randomTerminalNode->SetValue(randomTerminal.GetRandomValue(random));
         }
 
         /// Operator to mutate a random non-terminal from an individual.
         /// \param individual The target individual.
         /// \param grammar The grammar rules to build the mutated branch.
-        static void MutateIndividualNonTerminal(Individual& individual, const Grammar& grammar)
+        /// \param random The random number generator.
+        template<typename RandomGenerator>
+        static void MutateIndividualNonTerminal(Individual& individual, const Grammar& grammar, RandomGenerator& random)
         {
             SyntaxTree& tree = individual.GetTree();
 
             // Select random non-terminal.
             std::vector<TreeNode*> mutableNonTerminals = GetMutableTermsOfType(tree, NodeType::NonTerminal);
-            TreeNode* randomNonTerm = *random_choice(mutableNonTerminals.begin(), mutableNonTerminals.end());
+            TreeNode* randomNonTerm = *random_choice(mutableNonTerminals.begin(), mutableNonTerminals.end(), random);
 
             // Remove branch and create subtree.
             tree.DeleteSubtree(randomNonTerm);
             SyntaxTree replacement;
-            grammar.CreateRandomTree(replacement, 50, randomNonTerm->generatorPR);
+            grammar.CreateRandomTree(replacement, 50, randomNonTerm->GetGeneratorPR(), random);
             tree.InsertSubtree(randomNonTerm, replacement);
         }
 
@@ -96,13 +102,13 @@ namespace gbgp
             std::vector<NonTerminal> shared;
             for (auto n1 : nodesParent1)
             {
-                if (!vector_contains_q(shared, n1->nonTermInstance))
+                if (!vector_contains_q(shared, n1->GetNonTerminal()))
                 {
                     for (auto n2 : nodesParent2)
                     {
-                        if (n1->nonTermInstance == n2->nonTermInstance)
+                        if (n1->GetNonTerminal() == n2->GetNonTerminal())
                         {
-                            shared.push_back(n1->nonTermInstance);
+                            shared.push_back(n1->GetNonTerminal());
                             break;
                         }
                     }
@@ -114,54 +120,60 @@ namespace gbgp
         /// Returns a random node of the specified type.
         /// \param nodes The list of nodes.
         /// \param type The node type (Terminal/NonTerminal).
+        /// \param random The random number generator.
         /// \return A randomly selected node of the specified type.
-        static TreeNode* GetRandomNodeOfType(const std::vector<TreeNode*>& nodes, const NonTerminal& type)
+        template<typename RandomGenerator>
+        static TreeNode* GetRandomNodeOfType(const std::vector<TreeNode*>& nodes, const NonTerminal& type, RandomGenerator& random)
         {
-            std::vector<size_t> indexes = find_indexes_if(nodes,[type](TreeNode* node){ return  type == node->nonTermInstance; });
-            size_t randomSelection = *random_choice(indexes.begin(), indexes.end());
+            std::vector<size_t> indexes = find_indexes_if(nodes,[type](TreeNode* node){ return  type == node->GetNonTerminal(); });
+            size_t randomSelection = *random_choice(indexes.begin(), indexes.end(), random);
             return nodes[randomSelection];
         }
 
         /// Returns a random node from any of the specified type.
         /// \param nodes The list of nodes.
         /// \param types The node type (Terminal/NonTerminal).
+        /// \param random The random number generator.
         /// \return A randomly selected node with any of the specified types.
-        static TreeNode* GetRandomNodeOfType(const std::vector<TreeNode*>& nodes, const std::vector<NonTerminal>& types)
+        template<typename RandomGenerator>
+        static TreeNode* GetRandomNodeOfType(const std::vector<TreeNode*>& nodes, const std::vector<NonTerminal>& types,
+                                             RandomGenerator& random)
         {
-            std::vector<size_t> indexes = find_indexes_if(nodes,[types](TreeNode* node){ return vector_contains_q(types, node->nonTermInstance); });
-            size_t randomSelection = *random_choice(indexes.begin(), indexes.end());
+            std::vector<size_t> indexes = find_indexes_if(nodes,[types](TreeNode* node){ return vector_contains_q(types, node->GetNonTerminal()); });
+            size_t randomSelection = *random_choice(indexes.begin(), indexes.end(), random);
             return nodes[randomSelection];
         }
 
-    public:
-
         /// Generates a new offspring individual that combines genome features from both parents.
         /// \param parent1 The first parent.
         /// \param parent2 The second parent.
+        /// \param random The random number generator.
         /// \return A new offspring individual.
-        static Individual IndividualsCrossover(Individual& parent1, Individual& parent2)
+        template<typename RandomGenerator>
+        static Individual CreateOffspring(Individual& parent1, Individual& parent2, RandomGenerator& random)
         {
             SyntaxTree treeParent1 = parent1.GetTree();
-            SyntaxTree treeParent2 = parent2.GetTree();
+            const SyntaxTree& treeParent2 = parent2.GetTree();
 
             std::vector<TreeNode*> mutableNonTerminalsParent1 = GetMutableTermsOfType(treeParent1, NodeType::NonTerminal);
             std::vector<TreeNode*> mutableNonTerminalsParent2 = GetMutableTermsOfType(treeParent2, NodeType::NonTerminal);
 
             std::vector<NonTerminal> sharedNonTerminals = GetSharedNonTerminals(mutableNonTerminalsParent1, mutableNonTerminalsParent2);
-            TreeNode* randomNonTermParent1 = GetRandomNodeOfType(mutableNonTerminalsParent1, sharedNonTerminals);
-            TreeNode* randomNonTermParent2 = GetRandomNodeOfType(mutableNonTerminalsParent2, randomNonTermParent1->nonTermInstance);
+            TreeNode* randomNonTermParent1 = GetRandomNodeOfType(mutableNonTerminalsParent1, sharedNonTerminals, random);
+            TreeNode* randomNonTermParent2 = GetRandomNodeOfType(mutableNonTerminalsParent2, randomNonTermParent1->GetNonTerminal(), random);
 
             treeParent1.DeleteSubtree(randomNonTermParent1);
             treeParent1.InsertSubtree(randomNonTermParent1, randomNonTermParent2);
 
-            return Individual(parent1.GetFitnessFunction(), treeParent1);
+            return Individual(parent1.GetFitnessFunction(), std::move(treeParent1));
         }
 
-        /// The selection operator. Reduces the population to its fittest individuals.
-        /// Implemented as proportionate ranked selection.
+        /// Reduces the population to its fittest individuals. Implemented as proportionate ranked selection.
         /// \param population The target population.
         /// \param size The number of individuals that will survive.
-        static void Selection(Population& population, int size)
+        /// \param random The random number generator.
+        template<typename RandomGenerator>
+        static void SelectSurvivors(Population& population, int size, RandomGenerator& random)
         {
             std::vector<double> fitnessScores = population.GetFitness();
             const int populationSize = static_cast<int>(fitnessScores.size());
@@ -169,11 +181,66 @@ namespace gbgp
 
             // Weighted sample
             std::vector<int> weights = range(populationSize, 0, -1);
-            std::vector<size_t> sampledIndexes = random_weighted_sample_indexes(weights, size);
+            std::vector<size_t> sampledIndexes = random_weighted_sample_indexes(weights, size, random);
 
             population.ReducePopulation(sampledIndexes);
         }
 
+        /// Mutates a random terminal or a random non-terminal of an individual.
+        /// \param individual The target individual.
+        /// \param grammar The generating grammar used for NonTerminal mutation.
+        /// \param nonTermMutationProb The probability that the mutation is applied over a NonTerminal.
+        /// \param random The random number generator.
+        template<typename RandomGenerator>
+        static void MutateIndividualTerm(Individual& individual, const Grammar& grammar, double nonTermMutationProb,
+                                         RandomGenerator& random)
+        {
+            if (RandomBool(nonTermMutationProb, random))
+                MutateIndividualNonTerminal(individual, grammar, random);
+            else
+                MutateIndividualTerminal(individual, random);
+        }
+
+    public:
+
+        /// Generates a new offspring individual that combines genome features from both parents.
+        /// \param parent1 The first parent.
+        /// \param parent2 The second parent.
+        /// \return A new offspring individual.
+        static Individual IndividualsCrossover(Individual& parent1, Individual& parent2)
+        {
+            return CreateOffspring(parent1, parent2, random_generator());
+        }
+
+        /// Generates a new offspring individual that combines genome features from both parents.
+        /// \param parent1 The first parent.
+        /// \param parent2 The second parent.
+        /// \param random The random stream.
+        /// \return A new offspring individual.
+        static Individual IndividualsCrossover(Individual& parent1, Individual& parent2, RandomStream& random)
+        {
+            return CreateOffspring(parent1, parent2, random);
+        }
+
+        /// The selection operator. Reduces the population to its fittest individuals.
+        /// Implemented as proportionate ranked selection.
+        /// \param population The target population.
+        /// \param size The number of individuals that will survive.
+        static void Selection(Population& population, int size)
+        {
+            SelectSurvivors(population, size, random_generator());
+        }
+
+        /// The selection operator. Reduces the population to its fittest individuals.
+        /// Implemented as proportionate ranked selection.
+        /// \param population The target population.
+        /// \param size The number of individuals that will survive.
+        /// \param random The random stream.
+        static void Selection(Population& population, int size, RandomStream& random)
+        {
+            SelectSurvivors(population, size, random);
+        }
+
         /// The crossover operator. Creates a new generation by reproduction of the individuals.
         /// \param population The target population.
         static void Crossover(Population& population)
@@ -186,22 +253,69 @@ namespace gbgp
         /// \param offspringSize The number of children individuals produced by each parent pair.
         static void Crossover(Population& population, unsigned offspringSize)
         {
-            Population newGeneration(population.GetGeneratingGrammar(), population.GetFitnessFunction());
+            Crossover(population, offspringSize, RuntimeMode::SingleThread);
+        }
+
+        /// The crossover operator. Creates a new generation by reproduction of the individuals. On a single thread,
+        /// the offspring draw their random numbers from the shared random generator, one after the other. In the
+        /// executor, they draw them from a stream seeded by the shared random generator.
+        /// \param population The target population.
+        /// \param offspringSize The number of children individuals produced by each parent pair.
+        /// \param runtimeMode Whether to create the offspring on a single thread or in the executor of the population.
+        static void Crossover(Population& population, unsigned offspringSize, RuntimeMode runtimeMode)
+        {
+            if (runtimeMode == RuntimeMode::MultiThread)
+            {
+                RandomStream random(random_generator()());
+                Crossover(population, offspringSize, runtimeMode, random);
+                return;
+            }
+
+            Population newGeneration = population.CreateEmptyCopy();
 
             std::vector<size_t> randomPairings = range(population.Size());
             shuffle(randomPairings);
 
-            for (size_t i = 0; i < randomPairings.size(); i += 2)
+            std::vector<Individual> offspring;
+            offspring.reserve((randomPairings.size() / 2) * offspringSize);
+            for (size_t i = 0; i + 1 < randomPairings.size(); i += 2)
             {
-                Individual& parent1 = population.GetIndividual(i);
-                Individual& parent2 = population.GetIndividual(i+1);
-
-                // Generate offspring.
                 for (unsigned j = 0; j < offspringSize; j++)
-                    newGeneration.AddIndividual(IndividualsCrossover(parent1, parent2));
+                    offspring.push_back(IndividualsCrossover(population.GetIndividual(randomPairings[i]),
+                                                             population.GetIndividual(randomPairings[i + 1])));
             }
+            newGeneration.AddIndividuals(std::move(offspring));
 
-            population = newGeneration;
+            population = std::move(newGeneration);
+        }
+
+        /// The crossover operator. Creates a new generation by reproduction of the individuals.
+        /// \param population The target population.
+        /// \param offspringSize The number of children individuals produced by each parent pair.
+        /// \param runtimeMode Whether to create the offspring on a single thread or in the executor of the population.
+        /// \param random The random stream, which is split into one stream per offspring.
+        static void Crossover(Population& population, unsigned offspringSize, RuntimeMode runtimeMode, RandomStream& random)
+        {
+            Population newGeneration = population.CreateEmptyCopy();
+
+            std::vector<size_t> randomPairings = range(population.Size());
+            shuffle(randomPairings, random);
+
+            // Each parent is read by several tasks at once, so the metadata of its nodes is computed beforehand.
+            for (Individual& ind : population.GetIndividuals())
+                (void)ind.GetTree().Size();
+
+            // Generate offspring into their slots.
+            std::vector<Individual> offspring((randomPairings.size() / 2) * offspringSize);
+            population.ParallelFor(offspring.size(), runtimeMode, random,
+                                   [&population, &offspring, &randomPairings, offspringSize](size_t k, RandomStream& offspringRandom) {
+                const size_t i = 2 * (k / offspringSize);
+                offspring[k] = IndividualsCrossover(population.GetIndividual(randomPairings[i]),
+                                                    population.GetIndividual(randomPairings[i + 1]), offspringRandom);
+            });
+            newGeneration.AddIndividuals(std::move(offspring));
+
+            population = std::move(newGeneration);
         }
 
         /// Mutation operator that acts over an individual. Mutation probability is 50%.
@@ -218,10 +332,18 @@ namespace gbgp
         /// \param nonTermMutationProb The probability that the mutation is applied over a NonTerminal.
         static void MutateIndividual(Individual& individual, const Grammar& grammar, double nonTermMutationProb)
         {
-            if (RandomBool(nonTermMutationProb))
-                MutateIndividualNonTerminal(individual, grammar);
-            else
-                MutateIndividualTerminal(individual);
+            MutateIndividualTerm(individual, grammar, nonTermMutationProb, random_generator());
+        }
+
+        /// Mutation operator that acts over an individual.
+        /// \param individual The target individual.
+        /// \param grammar The generating grammar used for NonTerminal mutation.
+        /// \param nonTermMutationProb The probability that the mutation is applied over a NonTerminal.
+        /// \param random The random stream.
+        static void MutateIndividual(Individual& individual, const Grammar& grammar, double nonTermMutationProb,
+                                     RandomStream& random)
+        {
+            MutateIndividualTerm(individual, grammar, nonTermMutationProb, random);
         }
 
         /// Mutation operator that acts over a population.
@@ -238,11 +360,48 @@ namespace gbgp
         /// \param nonTermMutationProbability The probability that the mutation is applied over a NonTerminal.
         static void Mutation(Population& population, double mutationProbability, double nonTermMutationProbability)
         {
+            Mutation(population, mutationProbability, nonTermMutationProbability, RuntimeMode::SingleThread);
+        }
+
+        /// Mutation operator that acts over a population. On a single thread, the individuals draw their random numbers
+        /// from the shared random generator, one after the other. In the executor, they draw them from a stream
+        /// seeded by the shared random generator.
+        /// \param population The target population.
+        /// \param mutationProbability The probability that a mutation is applied over an individual.
+        /// \param nonTermMutationProbability The probability that the mutation is applied over a NonTerminal.
+        /// \param runtimeMode Whether to mutate the individuals on a single thread or in the executor of the population.
+        static void Mutation(Population& population, double mutationProbability, double nonTermMutationProbability,
+                             RuntimeMode runtimeMode)
+        {
+            if (runtimeMode == RuntimeMode::MultiThread)
+            {
+                RandomStream random(random_generator()());
+                Mutation(population, mutationProbability, nonTermMutationProbability, runtimeMode, random);
+                return;
+            }
+
+            const Grammar grammar = population.GetGeneratingGrammar();
             for (size_t i = 0; i < population.Size(); i++)
             {
-                if (RandomBool(mutationProbability))
-                    MutateIndividual(population.GetIndividual(i), population.GetGeneratingGrammar(), nonTermMutationProbability);
+                if (RandomBool(mutationProbability, random_generator()))
+                    MutateIndividual(population.GetIndividual(i), grammar, nonTermMutationProbability);
             }
         }
+
+        /// Mutation operator that acts over a population.
+        /// \param population The target population.
+        /// \param mutationProbability The probability that a mutation is applied over an individual.
+        /// \param nonTermMutationProbability The probability that the mutation is applied over a NonTerminal.
+        /// \param runtimeMode Whether to mutate the individuals on a single thread or in the executor of the population.
+        /// \param random The random stream, which is split into one stream per individual.
+        static void Mutation(Population& population, double mutationProbability, double nonTermMutationProbability,
+                             RuntimeMode runtimeMode, RandomStream& random)
+        {
+            const Grammar grammar = population.GetGeneratingGrammar();
+            population.ParallelFor(population.Size(), runtimeMode, random, [&](size_t i, RandomStream& individualRandom) {
+                if (RandomBool(mutationProbability, individualRandom))
+                    MutateIndividual(population.GetIndividual(i), grammar, nonTermMutationProbability, individualRandom);
+            });
+        }
     };
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <unordered_map>
 #include <utility>
 #include "prune_rule.h"
 
@@ -11,19 +12,20 @@ namespace gbgp
         std::vector<ProductionRule> _grammarRules;
         std::vector<PruneRule> _pruneRules;
 
+        /// Code templates used to generate source code, indexed by the identity of their production rule.
+        std::unordered_map<size_t, std::string> _codeTemplates;
+
         /// Applies sequentially all the prune rules of the grammar.
         /// \param syntaxTree The target syntax tree that will be pruned.
+        /// \param treeTraversal Reusable buffer for the traversals of the tree.
         /// \return True if a prune rule could be applied, false otherwise.
-        bool ApplyPruneRules(SyntaxTree& syntaxTree) const
+        bool ApplyPruneRules(SyntaxTree& syntaxTree, Traversal& treeTraversal) const
         {
             bool wasPruned = false;
-            for (auto pruneRule : _pruneRules)
+            for (const PruneRule& pruneRule : _pruneRules)
             {
-                if (pruneRule.CanBeApplied(syntaxTree))
-                {
-                    pruneRule.Apply(syntaxTree);
+                if (pruneRule.TryApply(syntaxTree, treeTraversal))
                     wasPruned = true;
-                }
             }
             return wasPruned;
         }
@@ -46,12 +48,31 @@ namespace gbgp
 
         /// Gets a random rule that is compatible with the specified Non-Terminal type.
         /// \param fromNonTermType The type of the Non-Terminal to find an appropriate rule.
+        /// \param random The random number generator.
         /// \return The selected random rule.
+        template<typename RandomGenerator>
         [[nodiscard]]
-        ProductionRule GetRandomCompatibleRule(int fromNonTermType) const
+        ProductionRule GetRandomCompatibleRule(int fromNonTermType, RandomGenerator& random) const
         {
             std::vector<ProductionRule> compatibleRules = this->GetCompatibleRules(fromNonTermType);
-            return *random_choice(compatibleRules.begin(), compatibleRules.end());
+            return *random_choice(compatibleRules.begin(), compatibleRules.end(), random);
+        }
+
+        /// Create random tree safely by creating random trees until there is a success.
+        /// \param syntaxTree The target tree.
+        /// \param maxDepth Maximum allowed tree depth.
+        /// \param rootRule The root rule of the grammar.
+        /// \param random The random number generator.
+        template<typename RandomGenerator>
+        void RetryCreateRandomTree(SyntaxTree& syntaxTree, int maxDepth, const std::optional<ProductionRule>& rootRule,
+                                   RandomGenerator& random) const
+        {
+            bool success = false;
+            while (!success)
+            {
+                syntaxTree.Destroy();
+                success = this->TryCreateRandomTree(syntaxTree, maxDepth, rootRule, random);
+            }
         }
 
     public:
@@ -103,6 +124,71 @@ namespace gbgp
             return static_cast<unsigned>(_grammarRules.size());
         }
 
+        /// Get the production rule at the specified index.
+        /// \param index The index of the rule.
+        /// \return A reference to the rule.
+        [[nodiscard]]
+        const ProductionRule& GetRule(size_t index) const
+        {
+            return _grammarRules.at(index);
+        }
+
+        /// Find the index of a production rule of this grammar.
+        /// \param rule The rule to find.
+        /// \return The index of the first rule that is the same as rule. If there is none, returns nullopt.
+        [[nodiscard]]
+        std::optional<size_t> FindRuleIndex(const ProductionRule& rule) const
+        {
+            for (size_t i = 0; i < _grammarRules.size(); i++)
+            {
+                if (_grammarRules[i].SameRule(rule))
+                    return i;
+            }
+            return std::nullopt;
+        }
+
+        /// Gets the index of a random rule that is compatible with the specified Non-Terminal type.
+        /// \param fromNonTermType The type of the Non-Terminal to find an appropriate rule.
+        /// \return The index of the selected random rule.
+        [[nodiscard]]
+        size_t GetRandomCompatibleRuleIndex(int fromNonTermType) const
+        {
+            std::vector<size_t> compatibleRules;
+            for (size_t i = 0; i < _grammarRules.size(); i++)
+            {
+                if (_grammarRules[i].from.id == fromNonTermType)
+                    compatibleRules.push_back(i);
+            }
+
+            if (compatibleRules.empty())
+                throw std::runtime_error("There is no rule for the NonTerminal type " + std::to_string(fromNonTermType));
+
+            return *random_choice(compatibleRules.begin(), compatibleRules.end());
+        }
+
+        /// Sets the code template used to generate the source code of the nodes built with a production rule. The
+        /// template is an expression of the target language where $0, $1, ... stand for the production elements
+        /// of the rule: the value of a Terminal, or the variable that holds the value of a NonTerminal. Use $$ for
+        /// a literal dollar sign.
+        /// \param rule The production rule.
+        /// \param codeTemplate The code template.
+        void SetCodeTemplate(const ProductionRule& rule, const std::string& codeTemplate)
+        {
+            _codeTemplates[rule.uid] = codeTemplate;
+        }
+
+        /// Get the code template of a production rule.
+        /// \param rule The production rule.
+        /// \return The code template. If there is none, returns nullopt.
+        [[nodiscard]]
+        std::optional<std::string> GetCodeTemplate(const ProductionRule& rule) const
+        {
+            auto it = _codeTemplates.find(rule.uid);
+            if (it == _codeTemplates.end())
+                return std::nullopt;
+            return it->second;
+        }
+
         //*******************************
         //*   Random tree generation    *
         //******************************/
@@ -111,20 +197,22 @@ namespace gbgp
         /// \param maxDepth Maximum allowed tree depth.
         /// \param depth Current depth. If while creating a random tree, the depth reaches the maxDepth value, it will fail and return false.
         /// \param node Node from where the random tree will be created.
+        /// \param random The random number generator.
         /// \return True if creation is successful, false if not.
-        bool TryCreateRandomTree(int maxDepth, int depth, TreeNode* node) const
+        template<typename RandomGenerator>
+        bool TryCreateRandomTree(int maxDepth, int depth, TreeNode* node, RandomGenerator& random) const
         {
             // TODO: Enforce a terminal node selection when limit is reached.
             if (node->type == NodeType::NonTerminal)
             {
                 // Create children nodes based on the current node production rule.
                 std::vector<TreeNode*> newNodes;
-                for (const ProductionElement& pe : node->generatorPR.to)
+                for (const ProductionElement& pe : node->GetGeneratorPR().to)
                 {
                     if (pe.type == ProductionElementType::NonTerminal)
-                        newNodes.push_back(node->AddChildTerm(pe.nonterm, GetRandomCompatibleRule(pe.nonterm.id)));
+                        newNodes.push_back(node->AddChildTerm(pe.nonterm, GetRandomCompatibleRule(pe.nonterm.id, random)));
                     if (pe.type == ProductionElementType::Terminal)
-                        newNodes.push_back(node->AddChildTerm(pe.term));
+                        newNodes.push_back(node->AddChildTerm(pe.term, pe.term.GetRandomValue(random)));
                     if (pe.type == ProductionElementType::Unassigned)
                         throw std::runtime_error("Unassigned production element type");
                 }
@@ -134,7 +222,7 @@ namespace gbgp
                 {
                     for (TreeNode* n : newNodes)
                     {
-                        bool branchCreationSuccess = TryCreateRandomTree(maxDepth, depth + 1, n);
+                        bool branchCreationSuccess = TryCreateRandomTree(maxDepth, depth + 1, n, random);
                         if (!branchCreationSuccess)
                             return false;
                     }
@@ -143,33 +231,36 @@ namespace gbgp
                     return false;
             }
             else
-                node->termValue = node->termInstance.GetRandomValue();
+                node->SetValue(node->GetTerminal().GetRandomValue(random));
 
             return true;
         }
 
         /// Create random tree based on the production rules described in the variable _grammarRules.
         /// \param maxDepth Maximum allowed tree depth.
+        /// \param random The random number generator.
         /// \return True if creation is successful, false if not.
-        bool TryCreateRandomTree(SyntaxTree& syntaxTree, int maxDepth, const std::optional<ProductionRule>& rootRule) const
+        template<typename RandomGenerator>
+        bool TryCreateRandomTree(SyntaxTree& syntaxTree, int maxDepth, const std::optional<ProductionRule>& rootRule,
+                                 RandomGenerator& random) const
         {
             syntaxTree.SetRootRule(rootRule.has_value() ? rootRule.value() : GetRootRule());
 
             // Create children nodes based on the selected rule.
             std::vector<TreeNode*> newNodes;
-            for (const ProductionElement& pe : syntaxTree.Root()->generatorPR.to)
+            for (const ProductionElement& pe : syntaxTree.Root()->GetGeneratorPR().to)
             {
                 if (pe.type == ProductionElementType::NonTerminal)
-                    newNodes.push_back(syntaxTree.Root()->AddChildTerm(pe.nonterm, GetRandomCompatibleRule(pe.nonterm.id)));
+                    newNodes.push_back(syntaxTree.Root()->AddChildTerm(pe.nonterm, GetRandomCompatibleRule(pe.nonterm.id, random)));
                 if (pe.type == ProductionElementType::Terminal)
-                    newNodes.push_back(syntaxTree.Root()->AddChildTerm(pe.term));
+                    newNodes.push_back(syntaxTree.Root()->AddChildTerm(pe.term, pe.term.GetRandomValue(random)));
                 if (pe.type == ProductionElementType::Unassigned)
                     throw std::runtime_error("Unassigned production element type");
             }
 
             for (TreeNode* n : newNodes)
             {
-                bool branchCreationSuccess = TryCreateRandomTree(maxDepth, 1, n);
+                bool branchCreationSuccess = TryCreateRandomTree(maxDepth, 1, n, random);
                 if (!branchCreationSuccess)
                     return false;
             }
@@ -192,27 +283,49 @@ namespace gbgp
             CreateRandomTree(syntaxTree, maxDepth, std::nullopt);
         }
 
-        /// Create random tree safely by creating random trees until there is a success.
+        /// Create random tree safely by creating random trees until there is a success. The random numbers come from
+        /// the shared random generator.
         /// \param syntaxTree The target tree.
         /// \param maxDepth Maximum allowed tree depth.
         /// \param rootRule The root rule of the grammar.
         void CreateRandomTree(SyntaxTree& syntaxTree, int maxDepth, const std::optional<ProductionRule>& rootRule) const
         {
-            bool success = false;
-            while (!success)
-            {
-                syntaxTree.Destroy();
-                success = this->TryCreateRandomTree(syntaxTree, maxDepth, rootRule);
-            }
+            CreateRandomTree(syntaxTree, maxDepth, rootRule, random_generator());
+        }
+
+        /// Create random tree safely by creating random trees until there is a success.
+        /// \param syntaxTree The target tree.
+        /// \param maxDepth Maximum allowed tree depth.
+        /// \param rootRule The root rule of the grammar.
+        /// \param random The random number generator.
+        void CreateRandomTree(SyntaxTree& syntaxTree, int maxDepth, const std::optional<ProductionRule>& rootRule,
+                              std::mt19937& random) const
+        {
+            RetryCreateRandomTree(syntaxTree, maxDepth, rootRule, random);
+        }
+
+        /// Create random tree safely by creating random trees until there is a success.
+        /// \param syntaxTree The target tree.
+        /// \param maxDepth Maximum allowed tree depth.
+        /// \param rootRule The root rule of the grammar.
+        /// \param random The random stream.
+        void CreateRandomTree(SyntaxTree& syntaxTree, int maxDepth, const std::optional<ProductionRule>& rootRule,
+                              RandomStream& random) const
+        {
+            RetryCreateRandomTree(syntaxTree, maxDepth, rootRule, random);
         }
 
         /// Applies the grammar prune rules repeatedly until no further simplification can be performed.
         /// \param syntaxTree The target syntax tree that will be pruned.
         void PruneTree(SyntaxTree& syntaxTree) const
         {
+            if (_pruneRules.empty())
+                return;
+
+            Traversal treeTraversal;
             bool canBePruned = false;
             do
-                canBePruned = ApplyPruneRules(syntaxTree);
+                canBePruned = ApplyPruneRules(syntaxTree, treeTraversal);
             while (canBePruned);
         }
 
@@ -222,8 +335,8 @@ namespace gbgp
             return "Grammar(rules='" + std::to_string(_grammarRules.size()) + "')";
         }
 
-        /// Since functions cannot be serialized-deserialized, this utility restore the correct semanticAction to the
-        /// target production rule.
+        /// Since functions cannot be serialized-deserialized, this utility restore the correct semantic actions to
+        /// the target production rule.
         /// \param target The target production rule.
         /// \return True if a match was found and the semantic action was restored. False otherwise.
         bool RestoreSemanticAction(ProductionRule& target) const
@@ -233,6 +346,9 @@ namespace gbgp
                 if (rule.SameRule(target))
                 {
                     target.semanticAction = rule.semanticAction;
+                    target.batchSemanticAction = rule.batchSemanticAction;
+                    target.bitSlicedSemanticAction = rule.bitSlicedSemanticAction;
+                    target.lazySemanticAction = rule.lazySemanticAction;
                     return true;
                 }
             }
@@ -246,7 +362,16 @@ namespace gbgp
         /// \return True if a match was found and the semantic action was restored. False otherwise.
         bool RestoreSemanticAction(Node& target) const
         {
-            return RestoreSemanticAction(target.generatorPR);
+            for (const ProductionRule& rule : _grammarRules)
+            {
+                if (rule.SameRule(target.GetGeneratorPR()))
+                {
+                    target.SetGeneratorPR(rule);
+                    return true;
+                }
+            }
+
+            return false;
         }
 
         /// Restores the unserializable function pointer of the ProductionRule of nodes inside a graph.
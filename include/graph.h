@@ -2,6 +2,8 @@
 #include <utility>
 #include <numeric>
 #include <map>
+#include <memory>
+#include <stdexcept>
 #include "tree_node.h"
 
 namespace gbgp
@@ -69,31 +71,58 @@ namespace gbgp
             return labels;
         }
 
-        /// Rebuild the TreeNode pointer chain from this graph.
-        /// \return A list of pointers to the instantiated tree nodes.
+        /// Rebuild the TreeNode pointer chain from this graph. The first node is the root.
+        /// \return The root of the rebuilt tree, which owns all the other nodes. Null if the graph is empty.
         [[nodiscard]]
-        std::vector<TreeNode*> GetTreeNodes() const
+        std::unique_ptr<TreeNode> BuildTree() const
         {
-            std::vector<TreeNode*> treeNodes;
+            if (_nodes.empty())
+                return nullptr;
+
+            // Validate that the edges describe a tree rooted at the first node before linking any node, so that a
+            // malformed graph cannot produce shared or cyclic ownership.
+            const int nodesSize = static_cast<int>(_nodes.size());
+            std::vector<int> parents(_nodes.size(), -1);
+            for (const auto& edge : _edges)
+            {
+                if (edge.first < 0 || edge.first >= nodesSize || edge.second <= 0 || edge.second >= nodesSize)
+                    throw std::runtime_error("Graph edge " + EdgeToString(edge) + " is not valid for a tree.");
+                if (parents[edge.second] != -1)
+                    throw std::runtime_error("Graph node " + std::to_string(edge.second) + " has more than one parent.");
+                parents[edge.second] = edge.first;
+            }
+
+            for (int i = 1; i < nodesSize; i++)
+            {
+                int ancestor = i;
+                for (int steps = 0; ancestor > 0; steps++)
+                {
+                    if (steps == nodesSize || parents[ancestor] == -1)
+                        throw std::runtime_error("Graph node " + std::to_string(i) + " is not connected to the root.");
+                    ancestor = parents[ancestor];
+                }
+            }
+
+            std::vector<std::unique_ptr<TreeNode>> treeNodes;
             treeNodes.reserve(_nodes.size());
+            for (const auto& node : _nodes)
+                treeNodes.push_back(std::make_unique<TreeNode>(node));
 
-            for (const auto & _node : _nodes)
-                treeNodes.push_back(new TreeNode(_node));
+            std::vector<TreeNode*> references(_nodes.size());
+            for (int i = 0; i < nodesSize; i++)
+                references[i] = treeNodes[i].get();
 
-            const int treeNodesSize = static_cast<int>(treeNodes.size());
-            for (int i = 0; i < treeNodesSize; i++)
+            // Children are linked in the order of the edges of each parent.
+            for (int i = 0; i < nodesSize; i++)
             {
-                for (auto & _edge : _edges)
+                for (const auto& edge : _edges)
                 {
-                    if (i == _edge.first)
-                    {
-                        int childIndex = _edge.second;
-                        treeNodes[i]->AddChildNode(treeNodes[childIndex]);
-                    }
+                    if (i == edge.first)
+                        references[i]->AddChildNode(treeNodes[edge.second].release());
                 }
             }
 
-            return treeNodes;
+            return std::move(treeNodes.front());
         }
 
         /// Get string representation.
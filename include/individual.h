@@ -1,5 +1,7 @@
 #pragma once
 #include "grammar.h"
+#include "closure_syntax_tree.h"
+#include "fitness_cache.h"
 
 namespace gbgp
 {
@@ -16,6 +18,17 @@ namespace gbgp
         /// The evaluated fitness value.
         std::optional<double> _fitnessValue = std::nullopt;
 
+        /// The tree compiled to closures, shared by the copies of the individual.
+        std::shared_ptr<const ClosureSyntaxTree> _closureTree;
+
+        /// The modification counter of the tree when it was compiled.
+        uint64_t _closureTreeModification = 0;
+
+        /// The seconds the last evaluation took, and the structural hash and size of the tree when it was measured.
+        std::optional<double> _evaluationTime = std::nullopt;
+        size_t _evaluationTimeHash = 0;
+        size_t _evaluationTimeSize = 0;
+
     public:
         /// Default constructor.
         Individual() = default;
@@ -36,13 +49,16 @@ namespace gbgp
             _tree = syntaxTree;
         }
 
-        /// Copy constructor.
-        Individual(const Individual& other)
-        {
-            _tree = other._tree;
-            _fitnessFunction = other._fitnessFunction;
-            _fitnessValue = other._fitnessValue;
-        }
+        /// Constructor that takes ownership of an already built syntax tree.
+        /// \param fitnessFunction The fitness function to evaluate this individual.
+        /// \param syntaxTree The syntax tree of the individual.
+        explicit Individual(const std::function<double(SyntaxTree&)>& fitnessFunction, SyntaxTree&& syntaxTree)
+            : _tree(std::move(syntaxTree)), _fitnessFunction(fitnessFunction) {}
+
+        Individual(const Individual& other) = default;
+        Individual(Individual&& other) = default;
+        Individual& operator=(const Individual& other) = default;
+        Individual& operator=(Individual&& other) = default;
 
         /// Fitness function setter.
         void SetFitnessFunction(const std::function<double(SyntaxTree&)>& fitnessFunction)
@@ -94,6 +110,59 @@ namespace gbgp
             _fitnessValue = _fitnessFunction(_tree);
         }
 
+        /// Assigns the fitness value stored in the cache for an identical tree. If there is none, evaluates the
+        /// fitness function and stores the result in the cache.
+        /// \param cache The fitness cache, which must hold values of the same fitness function.
+        void Evaluate(FitnessCache& cache)
+        {
+            double fitness;
+            if (cache.Find(_tree, fitness))
+            {
+                _fitnessValue = fitness;
+                return;
+            }
+
+            Evaluate();
+            cache.Insert(_tree, _fitnessValue.value());
+        }
+
+        /// Get the tree compiled to closures. It is compiled on the first call and kept until the tree is modified.
+        /// The compiled tree can be evaluated from many threads at once, but this method must not be called
+        /// concurrently on the same individual.
+        /// \return The compiled tree.
+        [[nodiscard]]
+        std::shared_ptr<const ClosureSyntaxTree> GetClosureTree()
+        {
+            const uint64_t modification = _tree.ModificationCounter();
+            if (_closureTree == nullptr || modification != _closureTreeModification)
+            {
+                _closureTree = std::make_shared<const ClosureSyntaxTree>(_tree);
+                _closureTreeModification = modification;
+            }
+            return _closureTree;
+        }
+
+        /// Records how long the evaluation of the current tree took, which estimates the cost of evaluating it again.
+        /// \param seconds The duration of the evaluation.
+        void SetEvaluationTime(double seconds)
+        {
+            _evaluationTime = seconds;
+            _evaluationTimeHash = _tree.StructuralHash();
+            _evaluationTimeSize = _tree.Size();
+        }
+
+        /// Get how long the last evaluation took.
+        /// \return The duration in seconds, or nothing if the tree was never evaluated or changed since then.
+        [[nodiscard]]
+        std::optional<double> GetEvaluationTime() const
+        {
+            if (_evaluationTime == std::nullopt || _tree.StructuralHash() != _evaluationTimeHash
+                || _tree.Size() != _evaluationTimeSize)
+                return std::nullopt;
+
+            return _evaluationTime;
+        }
+
         /// Prunes the tree.
         /// \param grammar The grammar that contains the prune rules.
         void Prune(const Grammar& grammar)
@@ -109,6 +178,15 @@ namespace gbgp
             Prune(grammar);
         }
 
+        /// Generates a random individual using the production rules and prune rules of the grammar.
+        /// \param grammar The generating grammar.
+        /// \param random The random stream.
+        void CreateRandom(const Grammar& grammar, RandomStream& random)
+        {
+            grammar.CreateRandomTree(_tree, 50, std::nullopt, random);
+            Prune(grammar);
+        }
+
         /// Get a string representation of this object.
         /// \return The string representation.
         [[nodiscard]]
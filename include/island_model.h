@@ -0,0 +1,336 @@
+#pragma once
+#include <iterator>
+#include "environment.h"
+
+namespace gbgp
+{
+    /// The islands that receive the migrants of each island.
+    enum class MigrationTopology
+    {
+        /// Each island sends its migrants to the next one, and the last one to the first.
+        Ring,
+
+        /// Each island sends its migrants to every other island.
+        FullyConnected,
+
+        /// Each island sends its migrants to another island chosen at random on every migration.
+        Random
+    };
+
+    /// A mailbox where several islands post batches of migrants concurrently and one island collects them. Posting
+    /// pushes the batch onto a lock-free stack, and collecting detaches the whole stack at once, so neither side
+    /// ever blocks.
+    class MigrantMailbox
+    {
+    private:
+        struct Batch
+        {
+            size_t source = 0;
+            std::vector<Individual> migrants;
+            Batch* next = nullptr;
+        };
+
+        std::atomic<Batch*> _head{ nullptr };
+
+    public:
+        MigrantMailbox() = default;
+        MigrantMailbox(const MigrantMailbox&) = delete;
+        MigrantMailbox& operator=(const MigrantMailbox&) = delete;
+
+        ~MigrantMailbox()
+        {
+            (void)Collect();
+        }
+
+        /// Posts a batch of migrants. It can be called from several threads at the same time.
+        /// \param source The index of the island that sends the migrants.
+        /// \param migrants The migrants.
+        void Post(size_t source, std::vector<Individual>&& migrants)
+        {
+            auto* batch = new Batch{ source, std::move(migrants), _head.load(std::memory_order_relaxed) };
+            while (!_head.compare_exchange_weak(batch->next, batch, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        /// Takes all the posted migrants, ordered by the index of the island that sent them, so the result does not
+        /// depend on the order in which the batches arrived.
+        /// \return The migrants.
+        [[nodiscard]]
+        std::vector<Individual> Collect()
+        {
+            std::vector<Batch*> batches;
+            for (Batch* batch = _head.exchange(nullptr, std::memory_order_acquire); batch != nullptr; batch = batch->next)
+                batches.push_back(batch);
+
+            std::stable_sort(batches.begin(), batches.end(), [](const Batch* a, const Batch* b) { return a->source < b->source; });
+
+            std::vector<Individual> migrants;
+            for (Batch* batch : batches)
+            {
+                std::move(batch->migrants.begin(), batch->migrants.end(), std::back_inserter(migrants));
+                delete batch;
+            }
+            return migrants;
+        }
+
+        /// Check if there are no posted migrants.
+        [[nodiscard]]
+        bool IsEmpty() const
+        {
+            return _head.load(std::memory_order_acquire) == nullptr;
+        }
+    };
+
+    /// Evolves several environments, the islands, concurrently on a shared executor. Every few generations each
+    /// island sends copies of its fittest individuals to other islands according to the migration topology, which
+    /// keeps the diversity of separate populations without running the environments by hand.
+    /// Each island is a single task of the executor that runs all the generations until the next migration, so the
+    /// islands only wait for each other once per migration interval, and workloads whose fitness is too cheap to
+    /// parallelize by individual scale with the number of islands. The migrants of an island are posted to the
+    /// mailboxes of the destination islands, which collect them at the start of the next interval. Migrants
+    /// replace the worst individuals of the island, up to half of its population.
+    /// Every island draws from its own split of the random stream of the model, and the migrants are collected in
+    /// island order, so a run with a given seed is reproducible with any number of threads.
+    class IslandModel
+    {
+    private:
+        std::vector<Environment> _islands;
+        MigrationTopology _topology;
+        unsigned _migrationInterval;
+        unsigned _migrantCount;
+        RuntimeMode _runtimeMode;
+        std::shared_ptr<Executor> _executor;
+        RandomStream _random;
+
+        /// Two mailboxes per island. The migrants sent during an interval go to the mailboxes of its parity, while
+        /// the islands collect those of the previous interval from the other ones.
+        std::vector<std::unique_ptr<MigrantMailbox>> _mailboxes;
+
+        /// Number of intervals run by Optimize.
+        uint64_t _interval = 0;
+
+        /// Generations since the last migration.
+        unsigned _generationsSinceMigration = 0;
+
+        /// Number of migrants that joined an island.
+        std::atomic<size_t> _acceptedMigrants{ 0 };
+
+        /// Makespan and idle time of the islands in each interval.
+        std::vector<ExecutorStatistics> _intervalHistory;
+
+        MigrantMailbox& GetMailbox(size_t island, uint64_t interval)
+        {
+            return *_mailboxes[2 * island + interval % 2];
+        }
+
+        /// Get the islands that receive the migrants of an island.
+        /// \param island The index of the sender island.
+        /// \param random The random stream of the sender island in this interval.
+        std::vector<size_t> GetDestinations(size_t island, RandomStream& random) const
+        {
+            const size_t n = _islands.size();
+            if (n < 2)
+                return {};
+
+            switch (_topology)
+            {
+                case MigrationTopology::Ring:
+                    return { (island + 1) % n };
+                case MigrationTopology::FullyConnected:
+                {
+                    std::vector<size_t> destinations;
+                    for (size_t i = 0; i < n; i++)
+                        if (i != island)
+                            destinations.push_back(i);
+                    return destinations;
+                }
+                case MigrationTopology::Random:
+                default:
+                {
+                    // Choose among the other islands by skipping over the sender.
+                    const size_t destination = std::uniform_int_distribution<size_t>(0, n - 2)(random);
+                    return { destination < island ? destination : destination + 1 };
+                }
+            }
+        }
+
+        /// Replaces the worst individuals of an island with the migrants sent to it in the previous interval.
+        void ReceiveMigrants(size_t island, uint64_t interval)
+        {
+            if (interval == 0)
+                return;
+
+            std::vector<Individual> migrants = GetMailbox(island, interval - 1).Collect();
+            if (migrants.empty())
+                return;
+
+            Population& population = _islands[island].GetPopulation();
+            std::stable_sort(migrants.begin(), migrants.end(), [](const Individual& a, const Individual& b) {
+                return a.GetFitness() > b.GetFitness();
+            });
+            migrants.resize(std::min(migrants.size(), population.Size() / 2));
+
+            _acceptedMigrants += migrants.size();
+            population.RemoveWorst(static_cast<int>(migrants.size()));
+            population.AddIndividuals(std::move(migrants));
+        }
+
+        /// Sends copies of the fittest individuals of an island to its destinations.
+        void SendMigrants(size_t island, uint64_t interval)
+        {
+            Population& population = _islands[island].GetPopulation();
+            const int count = static_cast<int>(std::min<size_t>(_migrantCount, population.Size()));
+            if (count == 0)
+                return;
+
+            RandomStream random = _random.Split(interval + 1).Split(island);
+            for (size_t destination : GetDestinations(island, random))
+                GetMailbox(destination, interval).Post(island, population.GetNthFittestByRank(count));
+        }
+
+    public:
+        /// Island model constructor. The islands evolve in the multithread mode with an executor that has one
+        /// thread per hardware thread.
+        /// \param grammar The grammar used for creating and mutating individuals.
+        /// \param fitnessFunction The fitness function for evaluating individuals, which is called from several
+        /// threads at the same time.
+        /// \param islandCount The number of islands.
+        /// \param populationSize The size of the population of each island.
+        /// \param survivorsPerGeneration The number of individuals that survive the selection operator.
+        /// \param eliteIndividuals The number of individuals that automatically survive to the next generation.
+        /// \param immigrationIndividuals The number of new random individuals inserted on each generation.
+        /// \param mutationProbability The probability that an individual mutates over a generation.
+        /// \param topology The islands that receive the migrants of each island.
+        /// \param migrationInterval The number of generations between migrations.
+        /// \param migrantCount The number of fittest individuals that each island sends to each destination.
+        IslandModel(const Grammar& grammar, const std::function<double(SyntaxTree&)>& fitnessFunction,
+                    unsigned islandCount, int populationSize, int survivorsPerGeneration, int eliteIndividuals,
+                    int immigrationIndividuals, double mutationProbability,
+                    MigrationTopology topology, unsigned migrationInterval, unsigned migrantCount) :
+                IslandModel(grammar, fitnessFunction, islandCount, populationSize, survivorsPerGeneration,
+                            eliteIndividuals, immigrationIndividuals, mutationProbability, topology,
+                            migrationInterval, migrantCount, RuntimeMode::MultiThread, nullptr, random_generator()()) {}
+
+        /// Island model constructor.
+        /// \param grammar The grammar used for creating and mutating individuals.
+        /// \param fitnessFunction The fitness function for evaluating individuals, which is called from several
+        /// threads at the same time in the multithread mode.
+        /// \param islandCount The number of islands.
+        /// \param populationSize The size of the population of each island.
+        /// \param survivorsPerGeneration The number of individuals that survive the selection operator.
+        /// \param eliteIndividuals The number of individuals that automatically survive to the next generation.
+        /// \param immigrationIndividuals The number of new random individuals inserted on each generation.
+        /// \param mutationProbability The probability that an individual mutates over a generation.
+        /// \param topology The islands that receive the migrants of each island.
+        /// \param migrationInterval The number of generations between migrations.
+        /// \param migrantCount The number of fittest individuals that each island sends to each destination.
+        /// \param runtimeMode Whether to evolve the islands one after another or concurrently in the executor.
+        /// \param executor The worker threads used in the multithread mode, which can be shared with other
+        /// environments. Null creates an executor with one thread per hardware thread.
+        /// \param seed The seed of the random stream of the model.
+        IslandModel(const Grammar& grammar, const std::function<double(SyntaxTree&)>& fitnessFunction,
+                    unsigned islandCount, int populationSize, int survivorsPerGeneration, int eliteIndividuals,
+                    int immigrationIndividuals, double mutationProbability,
+                    MigrationTopology topology, unsigned migrationInterval, unsigned migrantCount,
+                    RuntimeMode runtimeMode, const std::shared_ptr<Executor>& executor, uint64_t seed)
+                    : _random(seed)
+        {
+            if (islandCount == 0)
+                throw std::runtime_error("An island model needs at least one island.");
+            if (migrationInterval == 0)
+                throw std::runtime_error("The migration interval must be at least one generation.");
+
+            _topology = topology;
+            _migrationInterval = migrationInterval;
+            _migrantCount = migrantCount;
+            _runtimeMode = runtimeMode;
+            _executor = executor;
+            if (_runtimeMode == RuntimeMode::MultiThread && _executor == nullptr)
+                _executor = std::make_shared<Executor>();
+
+            // The generations of an island run inside a task of the executor, where the parallel loops of its
+            // environment run inline.
+            const RandomStream islandSeeds = _random.Split(0);
+            _islands.reserve(islandCount);
+            for (unsigned i = 0; i < islandCount; i++)
+            {
+                RandomStream islandSeed = islandSeeds.Split(i);
+                _islands.emplace_back(grammar, fitnessFunction, populationSize, survivorsPerGeneration,
+                                      eliteIndividuals, immigrationIndividuals, mutationProbability,
+                                      _runtimeMode, _executor, islandSeed());
+            }
+
+            for (unsigned i = 0; i < 2 * islandCount; i++)
+                _mailboxes.push_back(std::make_unique<MigrantMailbox>());
+        }
+
+        /// Get the number of islands.
+        [[nodiscard]]
+        size_t GetIslandCount() const
+        {
+            return _islands.size();
+        }
+
+        /// Get the environment of an island.
+        /// \param n The index of the island.
+        [[nodiscard]]
+        Environment& GetIsland(size_t n)
+        {
+            return _islands.at(n);
+        }
+
+        /// Get the fittest individual of all the islands.
+        [[nodiscard]]
+        Individual& GetFittest()
+        {
+            Individual* fittest = &_islands[0].GetPopulation().GetFittestByRank(0);
+            for (Environment& island : _islands)
+            {
+                Individual& candidate = island.GetPopulation().GetFittestByRank(0);
+                if (candidate.GetFitness() > fittest->GetFitness())
+                    fittest = &candidate;
+            }
+            return *fittest;
+        }
+
+        /// Get the number of migrants that joined an island.
+        [[nodiscard]]
+        size_t GetAcceptedMigrants() const
+        {
+            return _acceptedMigrants;
+        }
+
+        /// Get the makespan and idle time of the workers in each interval between migrations run by Optimize.
+        [[nodiscard]]
+        const std::vector<ExecutorStatistics>& GetIntervalHistory() const
+        {
+            return _intervalHistory;
+        }
+
+        /// Optimizes every island via genetic optimization.
+        /// \param generations The number of generations to optimize.
+        void Optimize(unsigned generations)
+        {
+            while (generations > 0)
+            {
+                const unsigned intervalGenerations = std::min(_migrationInterval - _generationsSinceMigration, generations);
+                const bool migrate = _generationsSinceMigration + intervalGenerations == _migrationInterval;
+                const uint64_t interval = _interval++;
+
+                auto evolveIsland = [this, interval, intervalGenerations, migrate](size_t island) {
+                    ReceiveMigrants(island, interval);
+                    _islands[island].Optimize(intervalGenerations);
+                    if (migrate)
+                        SendMigrants(island, interval);
+                };
+
+                if (_runtimeMode == RuntimeMode::MultiThread)
+                    _intervalHistory.push_back(_executor->ParallelFor(_islands.size(), evolveIsland));
+                else
+                    _intervalHistory.push_back(Executor::SequentialFor(_islands.size(), evolveIsland));
+
+                _generationsSinceMigration = migrate ? 0 : _generationsSinceMigration + intervalGenerations;
+                generations -= intervalGenerations;
+            }
+        }
+    };
+}
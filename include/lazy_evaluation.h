@@ -0,0 +1,36 @@
+#pragma once
+#include "evaluation.h"
+
+namespace gbgp
+{
+    struct TreeNode;
+    class SyntaxTree;
+
+    //*********************************
+    //*    Lazy evaluation context    *
+    //********************************/
+
+    /// Evaluation context where the semantic actions decide which production elements are evaluated. It is
+    /// evaluated with SyntaxTree::Evaluate like any other context. The rules with a lazy semantic action receive no
+    /// semantic values: the action calls Evaluate with the index of a production element to get its value, so the
+    /// branches that are not needed, such as the right side of a short-circuited && or the unused branch of an
+    /// if-then-else, are never evaluated. The rules without a lazy semantic action evaluate all of their production
+    /// elements and run their semantic action as usual.
+    /// Evaluating a NonTerminal runs other semantic actions with this context, which overwrite its result. A lazy
+    /// semantic action must therefore set the result after evaluating the production elements it needs.
+    class LazyEvaluationContext : public EvaluationContext
+    {
+    private:
+        /// The node whose semantic action is running.
+        TreeNode* _node = nullptr;
+
+        friend class SyntaxTree;
+
+    public:
+        /// Evaluates a production element of the rule whose semantic action is running. Each element is evaluated
+        /// at most once per action.
+        /// \param index Index of the production element.
+        /// \return Reference to the value of the element, valid until the semantic action returns.
+        const std::string& Evaluate(unsigned index);
+    };
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GBGP_NATIVE_COMPILATION
+#include <dlfcn.h>
+#endif
+
+namespace gbgp
+{
+#if defined(GBGP_NATIVE_COMPILATION)
+    template<typename Signature> class NativeFunction;
+
+    /// Function compiled to native code at runtime. The source is built as a shared library by a locally installed
+    /// compiler and loaded with dlopen. The library stays loaded while any copy of the function exists. Calling
+    /// the function is thread-safe if the compiled code is.
+    /// \tparam R The return type of the function.
+    /// \tparam Args The types of the arguments of the function.
+    template<typename R, typename... Args> class NativeFunction<R(Args...)>
+    {
+    private:
+        /// Handle of the loaded library.
+        std::shared_ptr<void> _library;
+
+        /// The loaded function.
+        R (*_function)(Args...) = nullptr;
+
+        /// Reads a whole file.
+        static std::string ReadFile(const std::filesystem::path& path)
+        {
+            std::ifstream file(path);
+            std::stringstream content;
+            content << file.rdbuf();
+            return content.str();
+        }
+
+    public:
+        /// Creates an empty function.
+        NativeFunction() = default;
+
+        /// Get the default compiler command, which is the CXX environment variable or c++ if it is not set.
+        [[nodiscard]]
+        static std::string DefaultCompiler()
+        {
+            const char* compiler = std::getenv("CXX");
+            return std::string(compiler != nullptr ? compiler : "c++") + " -O2 -std=c++17";
+        }
+
+        /// Compiles a source and loads one of its functions. The function must have C linkage.
+        /// \param source The source code.
+        /// \param functionName The name of the function.
+        /// \param compiler The compiler command, including the optimization flags.
+        /// \return The loaded function.
+        static NativeFunction Compile(const std::string& source, const std::string& functionName,
+                                      const std::string& compiler = DefaultCompiler())
+        {
+            std::string directoryTemplate = (std::filesystem::temp_directory_path() / "gbgp-XXXXXX").string();
+            if (mkdtemp(directoryTemplate.data()) == nullptr)
+                throw std::runtime_error("Could not create a temporary directory for native compilation");
+
+            const std::filesystem::path directory(directoryTemplate);
+            const std::filesystem::path sourcePath = directory / "function.cpp";
+            const std::filesystem::path libraryPath = directory / "function.so";
+            const std::filesystem::path errorsPath = directory / "errors.txt";
+            std::ofstream(sourcePath) << source;
+
+            const std::string command = compiler + " -shared -fPIC -o \"" + libraryPath.string() + "\" \""
+                                        + sourcePath.string() + "\" 2> \"" + errorsPath.string() + "\"";
+            if (std::system(command.c_str()) != 0)
+            {
+                const std::string errors = ReadFile(errorsPath);
+                std::filesystem::remove_all(directory);
+                throw std::runtime_error("Native compilation failed: " + errors);
+            }
+
+            void* library = dlopen(libraryPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+            std::filesystem::remove_all(directory);
+            if (library == nullptr)
+                throw std::runtime_error(std::string("Could not load the compiled function: ") + dlerror());
+
+            NativeFunction nativeFunction;
+            nativeFunction._library = std::shared_ptr<void>(library, [](void* handle) { dlclose(handle); });
+            nativeFunction._function = reinterpret_cast<R (*)(Args...)>(dlsym(library, functionName.c_str()));
+            if (nativeFunction._function == nullptr)
+                throw std::runtime_error("Could not find the compiled function " + functionName);
+
+            return nativeFunction;
+        }
+
+        /// Check if a function is loaded.
+        [[nodiscard]]
+        bool IsLoaded() const
+        {
+            return _function != nullptr;
+        }
+
+        /// Calls the function.
+        R operator()(Args... args) const
+        {
+            return _function(args...);
+        }
+    };
+#endif
+}
@@ -0,0 +1,238 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace gbgp
+{
+    /// Allocator of fixed size memory blocks, used to allocate the nodes of the syntax trees.
+    /// Memory is requested from the system in slabs of many blocks. Released blocks are kept in a free list and
+    /// reused instead of being returned to the system. Each thread owns a free list, so allocation and release
+    /// do not take locks, and exchanges blocks in batches with a shared depot. A block allocated by one thread
+    /// can be released by any other thread. Slabs are kept for the lifetime of the program.
+    /// The pool also counts the blocks in use, which is used to detect leaked nodes.
+    template<size_t BlockSize> class BlockPool
+    {
+    private:
+        struct Block
+        {
+            Block* next;
+        };
+
+        /// Size of each block, rounded so that every block is suitably aligned.
+        static constexpr size_t Stride = (std::max(BlockSize, sizeof(Block)) + alignof(std::max_align_t) - 1) /
+                                         alignof(std::max_align_t) * alignof(std::max_align_t);
+
+        /// Number of blocks requested from the system at once.
+        static constexpr size_t BlocksPerSlab = 1024;
+
+        /// Number of blocks exchanged between a thread and the depot at once.
+        static constexpr size_t BatchSize = 256;
+
+        /// A linked list of free blocks.
+        struct Batch
+        {
+            Block* head;
+            size_t size;
+        };
+
+        struct ThreadCache;
+
+        /// Shared storage of slabs and of the batches of blocks returned by the threads.
+        struct Depot
+        {
+            std::mutex mutex;
+            std::vector<Batch> batches;
+            std::vector<std::unique_ptr<std::byte[]>> slabs;
+
+            /// Caches of the running threads, whose counters are added up by GetLiveCount.
+            std::vector<ThreadCache*> caches;
+
+            /// Blocks in use counted by threads that have already exited.
+            long long retiredLive = 0;
+        };
+
+        /// Free blocks owned by a thread: the list in use and a full batch kept in reserve.
+        struct ThreadCache
+        {
+            Batch current{ nullptr, 0 };
+            Batch spare{ nullptr, 0 };
+            bool registered = false;
+            bool retired = false;
+
+            /// Blocks allocated minus blocks released by this thread. Only written by the owner thread.
+            std::atomic<long long> live{ 0 };
+        };
+
+        /// Returns the blocks of the thread cache to the depot when the thread exits.
+        struct ThreadCacheGuard
+        {
+            ~ThreadCacheGuard()
+            {
+                ThreadCache& cache = _cache;
+                ReturnToDepot(cache.current);
+                ReturnToDepot(cache.spare);
+                cache.current = { nullptr, 0 };
+                cache.spare = { nullptr, 0 };
+                cache.retired = true;
+
+                Depot& depot = GetDepot();
+                std::lock_guard<std::mutex> lock(depot.mutex);
+                depot.caches.erase(std::find(depot.caches.begin(), depot.caches.end(), &cache));
+                depot.retiredLive += cache.live.load(std::memory_order_relaxed);
+            }
+        };
+
+        static inline thread_local ThreadCache _cache{};
+        static inline thread_local ThreadCacheGuard _cacheGuard{};
+
+        /// The depot is never destroyed, as nodes owned by static objects may be released at program exit.
+        static Depot& GetDepot()
+        {
+            static auto* depot = new Depot();
+            return *depot;
+        }
+
+        /// Hands a batch of blocks to the depot.
+        static void ReturnToDepot(const Batch& batch)
+        {
+            if (batch.head == nullptr)
+                return;
+
+            Depot& depot = GetDepot();
+            std::lock_guard<std::mutex> lock(depot.mutex);
+            depot.batches.push_back(batch);
+        }
+
+        /// Ensures that the blocks of the thread cache are returned to the depot when the thread exits.
+        static void Register(ThreadCache& cache)
+        {
+            (void) &_cacheGuard;
+            cache.registered = true;
+
+            Depot& depot = GetDepot();
+            std::lock_guard<std::mutex> lock(depot.mutex);
+            depot.caches.push_back(&cache);
+        }
+
+        /// Adds delta to the count of blocks in use.
+        static void CountLive(ThreadCache& cache, long long delta)
+        {
+            if (cache.retired)
+            {
+                Depot& depot = GetDepot();
+                std::lock_guard<std::mutex> lock(depot.mutex);
+                depot.retiredLive += delta;
+            }
+            else
+                cache.live.store(cache.live.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+        }
+
+        /// Takes a batch of blocks from the depot, carving a new slab if the depot is empty.
+        static Batch TakeFromDepot()
+        {
+            Depot& depot = GetDepot();
+            std::lock_guard<std::mutex> lock(depot.mutex);
+
+            if (depot.batches.empty())
+            {
+                std::unique_ptr<std::byte[]> slab(new std::byte[Stride * BlocksPerSlab]);
+                for (size_t first = 0; first < BlocksPerSlab; first += BatchSize)
+                {
+                    Block* head = nullptr;
+                    for (size_t i = first + BatchSize; i-- > first;)
+                    {
+                        auto* block = reinterpret_cast<Block*>(slab.get() + i * Stride);
+                        block->next = head;
+                        head = block;
+                    }
+                    depot.batches.push_back({ head, BatchSize });
+                }
+                depot.slabs.push_back(std::move(slab));
+            }
+
+            Batch batch = depot.batches.back();
+            depot.batches.pop_back();
+            return batch;
+        }
+
+    public:
+        /// Allocates a block of BlockSize bytes.
+        static void* Allocate()
+        {
+            ThreadCache& cache = _cache;
+            if (cache.current.head == nullptr)
+            {
+                if (!cache.registered)
+                    Register(cache);
+
+                if (cache.spare.head != nullptr)
+                {
+                    cache.current = cache.spare;
+                    cache.spare = { nullptr, 0 };
+                }
+                else
+                    cache.current = TakeFromDepot();
+            }
+
+            Block* block = cache.current.head;
+            cache.current.head = block->next;
+            cache.current.size--;
+            CountLive(cache, 1);
+            return block;
+        }
+
+        /// Releases a block previously obtained with Allocate.
+        static void Deallocate(void* pointer)
+        {
+            auto* block = static_cast<Block*>(pointer);
+            ThreadCache& cache = _cache;
+
+            if (cache.retired)
+            {
+                block->next = nullptr;
+                ReturnToDepot({ block, 1 });
+                CountLive(cache, -1);
+                return;
+            }
+            if (!cache.registered)
+                Register(cache);
+            CountLive(cache, -1);
+
+            block->next = cache.current.head;
+            cache.current.head = block;
+            cache.current.size++;
+
+            // Keep at most one full batch in reserve, so that a thread that only releases blocks does not hoard them.
+            if (cache.current.size == BatchSize)
+            {
+                ReturnToDepot(cache.spare);
+                cache.spare = cache.current;
+                cache.current = { nullptr, 0 };
+            }
+        }
+
+        /// Returns the number of blocks requested from the system.
+        static size_t GetCapacity()
+        {
+            Depot& depot = GetDepot();
+            std::lock_guard<std::mutex> lock(depot.mutex);
+            return depot.slabs.size() * BlocksPerSlab;
+        }
+
+        /// Returns the number of blocks currently in use by all threads.
+        static long long GetLiveCount()
+        {
+            Depot& depot = GetDepot();
+            std::lock_guard<std::mutex> lock(depot.mutex);
+
+            long long live = depot.retiredLive;
+            for (const ThreadCache* cache : depot.caches)
+                live += cache->live.load(std::memory_order_relaxed);
+            return live;
+        }
+    };
+}
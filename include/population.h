@@ -1,6 +1,6 @@
 #pragma once
 #include "individual.h"
-#include "thread_pool.h"
+#include "executor.h"
 
 namespace gbgp
 {
@@ -9,6 +9,21 @@ namespace gbgp
         SingleThread, MultiThread
     };
 
+    /// The order in which the individuals are evaluated in the multithread mode. Evaluating the most expensive
+    /// individuals first keeps the workers busy until the end of the evaluation.
+    enum class SchedulingPolicy
+    {
+        /// Evaluate the individuals in population order.
+        PopulationOrder,
+
+        /// Evaluate the individuals with the largest trees first.
+        LargestTreeFirst,
+
+        /// Evaluate first the individuals whose previous evaluation took the longest. The time of the individuals
+        /// that were never evaluated is estimated from their size and the measured time per node.
+        LearnedCost
+    };
+
     /// A container for a collection of individuals. Handles their initialization and provides an interface for
     /// manipulating them.
     class Population
@@ -26,20 +41,91 @@ namespace gbgp
         /// Is the population evaluated?
         bool _isEvaluated;
 
+        /// The cache of fitness values of identical individuals, or null.
+        std::shared_ptr<FitnessCache> _fitnessCache;
+
+        /// The worker threads used in the multithread mode, created on first use if none was set.
+        std::shared_ptr<Executor> _executor;
+
+        /// The order of the multithread evaluation.
+        SchedulingPolicy _schedulingPolicy = SchedulingPolicy::LearnedCost;
+
+        /// The measured evaluation time per tree node, or zero if nothing was measured.
+        double _secondsPerNode = 0.0;
+
+        /// The time spent on the last evaluation.
+        ExecutorStatistics _evaluationStatistics;
+
         void SingleThreadEvaluate()
         {
-            for (auto& ind : _individuals)
-                ind.Evaluate();
+            _evaluationStatistics = Executor::SequentialFor(_individuals.size(), [this](size_t i) {
+                EvaluateIndividual(_individuals[i]);
+            });
+        }
+
+        /// Get the executor, which is created if none was set.
+        Executor& GetOrCreateExecutor()
+        {
+            if (_executor == nullptr)
+                _executor = std::make_shared<Executor>();
+
+            return *_executor;
         }
 
         void MultiThreadEvaluate()
         {
-            BS::thread_pool pool;
+            _evaluationStatistics = GetOrCreateExecutor().ParallelFor(EvaluationCosts(), [this](size_t i) {
+                EvaluateIndividual(_individuals[i]);
+            });
+        }
 
-            for (auto& ind : _individuals)
-                pool.push_task(&Individual::Evaluate, &ind);
+        void EvaluateIndividual(Individual& ind) const
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (_fitnessCache != nullptr)
+                ind.Evaluate(*_fitnessCache);
+            else
+                ind.Evaluate();
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            ind.SetEvaluationTime(elapsed.count());
+        }
+
+        /// Get the estimated evaluation cost of each individual according to the scheduling policy.
+        [[nodiscard]]
+        std::vector<double> EvaluationCosts()
+        {
+            std::vector<double> costs(_individuals.size(), 1.0);
+            if (_schedulingPolicy == SchedulingPolicy::PopulationOrder)
+                return costs;
+
+            for (size_t i = 0; i < _individuals.size(); i++)
+            {
+                Individual& ind = _individuals[i];
+                const double size = ind.GetTree().Size();
+                costs[i] = size;
+
+                if (_schedulingPolicy == SchedulingPolicy::LearnedCost && _secondsPerNode > 0.0)
+                    costs[i] = ind.GetEvaluationTime().value_or(size * _secondsPerNode);
+            }
+            return costs;
+        }
+
+        /// Updates the time per node with the measurements of the last evaluation.
+        void LearnEvaluationCost()
+        {
+            double seconds = 0.0, nodes = 0.0;
+            for (Individual& ind : _individuals)
+            {
+                seconds += ind.GetEvaluationTime().value_or(0.0);
+                nodes += ind.GetTree().Size();
+            }
+            if (nodes == 0.0)
+                return;
 
-            pool.wait_for_tasks();
+            // Exponential moving average, so the estimate follows the changes of the population.
+            const double secondsPerNode = seconds / nodes;
+            _secondsPerNode = _secondsPerNode > 0.0 ? 0.5 * (_secondsPerNode + secondsPerNode) : secondsPerNode;
         }
 
         void SortPopulation()
@@ -66,17 +152,78 @@ namespace gbgp
         /// \param populationSize The size of the population.
         void Initialize(unsigned populationSize)
         {
-            _individuals.reserve(populationSize);
+            Initialize(populationSize, RuntimeMode::SingleThread);
+        }
+
+        /// Initializes a population of randomly generated individuals. On a single thread, the individuals draw their
+        /// random numbers from the shared random generator, one after the other. In the executor, they draw them from
+        /// a stream seeded by the shared random generator.
+        /// \param populationSize The size of the population.
+        /// \param runtimeMode Whether to create the individuals on a single thread or in the executor.
+        void Initialize(unsigned populationSize, RuntimeMode runtimeMode)
+        {
+            if (runtimeMode == RuntimeMode::MultiThread)
+            {
+                RandomStream random(random_generator()());
+                Initialize(populationSize, runtimeMode, random);
+                return;
+            }
 
+            _individuals.reserve(_individuals.size() + populationSize);
             for (unsigned i = 0; i < populationSize; i++)
             {
-                Individual newIndividual(_fitnessFunction);
+                Individual& newIndividual = _individuals.emplace_back(_fitnessFunction);
                 newIndividual.CreateRandom(_generatingGrammar);
-                _individuals.push_back(newIndividual);
             }
             _isEvaluated = false;
         }
 
+        /// Initializes a population of randomly generated individuals.
+        /// \param populationSize The size of the population.
+        /// \param runtimeMode Whether to create the individuals on a single thread or in the executor.
+        /// \param random The random stream, which is split into one stream per individual.
+        void Initialize(unsigned populationSize, RuntimeMode runtimeMode, RandomStream& random)
+        {
+            const size_t first = _individuals.size();
+            _individuals.resize(first + populationSize, Individual(_fitnessFunction));
+
+            ParallelFor(populationSize, runtimeMode, random, [this, first](size_t i, RandomStream& individualRandom) {
+                _individuals[first + i].CreateRandom(_generatingGrammar, individualRandom);
+            });
+            _isEvaluated = false;
+        }
+
+        /// Calls a function for every index of a range, in the executor in the multithread mode.
+        /// \param n The number of indexes.
+        /// \param runtimeMode Whether to run the calls on a single thread or in the executor.
+        /// \param function The function, which receives the index.
+        void ParallelFor(size_t n, RuntimeMode runtimeMode, const std::function<void(size_t)>& function)
+        {
+            if (runtimeMode == RuntimeMode::MultiThread)
+                GetOrCreateExecutor().ParallelFor(n, function);
+            else
+                Executor::SequentialFor(n, function);
+        }
+
+        /// Calls a function for every index of a range, in the executor in the multithread mode. Each call receives
+        /// its own child of the random stream, split with the index, so the result is the same in both modes and for
+        /// any number of threads.
+        /// \param n The number of indexes.
+        /// \param runtimeMode Whether to run the calls on a single thread or in the executor.
+        /// \param random The random stream, which is advanced so the next call gets different children.
+        /// \param function The function, which receives the index and its random stream.
+        void ParallelFor(size_t n, RuntimeMode runtimeMode, RandomStream& random,
+                         const std::function<void(size_t, RandomStream&)>& function)
+        {
+            const RandomStream parent = random;
+            random.Discard(1);
+
+            ParallelFor(n, runtimeMode, [&parent, &function](size_t i) {
+                RandomStream individualRandom = parent.Split(i);
+                function(i, individualRandom);
+            });
+        }
+
         /// Add an individual to the population.
         /// \param individual The individual to add.
         void AddIndividual(const Individual& individual)
@@ -88,6 +235,17 @@ namespace gbgp
                 SortPopulation();
         }
 
+        /// Add an individual to the population, taking ownership of its tree.
+        /// \param individual The individual to add.
+        void AddIndividual(Individual&& individual)
+        {
+            _isEvaluated &= individual.IsEvaluated();
+            _individuals.push_back(std::move(individual));
+
+            if (_isEvaluated)
+                SortPopulation();
+        }
+
         /// Add a collection of individuals to the population.
         /// \param newIndividuals The collection of individuals to add.
         void AddIndividuals(const std::vector<Individual>& newIndividuals)
@@ -99,6 +257,19 @@ namespace gbgp
                 SortPopulation();
         }
 
+        /// Add a collection of individuals to the population, taking ownership of their trees.
+        /// \param newIndividuals The collection of individuals to add.
+        void AddIndividuals(std::vector<Individual>&& newIndividuals)
+        {
+            _individuals.insert(_individuals.end(), std::make_move_iterator(newIndividuals.begin()),
+                                std::make_move_iterator(newIndividuals.end()));
+            newIndividuals.clear();
+            std::for_each(_individuals.begin(), _individuals.end(), [this](const Individual& ind) { _isEvaluated &= ind.IsEvaluated(); } );
+
+            if (_isEvaluated)
+                SortPopulation();
+        }
+
         /// Get the individual at the n-th index.
         /// \param n The index.
         /// \return A reference to the individual.
@@ -131,7 +302,22 @@ namespace gbgp
         /// \param keepIndexes The indexes of the individuals selected to survive on the next generation.
         void ReducePopulation(const std::vector<size_t>& keepIndexes)
         {
-            _individuals = extract_elements_at_indexes(_individuals, keepIndexes);
+            // Individuals are moved into the reduced population, only those selected more than once are copied.
+            std::vector<unsigned> remainingSelections(_individuals.size(), 0);
+            for (size_t index : keepIndexes)
+                remainingSelections.at(index)++;
+
+            std::vector<Individual> survivors;
+            survivors.reserve(keepIndexes.size());
+            for (size_t index : keepIndexes)
+            {
+                if (--remainingSelections[index] == 0)
+                    survivors.push_back(std::move(_individuals[index]));
+                else
+                    survivors.push_back(_individuals[index]);
+            }
+
+            _individuals = std::move(survivors);
         }
 
         /// Removes the n-th worst individuals by fitness of the population.
@@ -149,8 +335,14 @@ namespace gbgp
         /// Prune all the individuals of the population.
         void Prune()
         {
-            for (auto& ind : _individuals)
-                ind.Prune(_generatingGrammar);
+            Prune(RuntimeMode::SingleThread);
+        }
+
+        /// Prune all the individuals of the population.
+        /// \param runtimeMode Whether to prune the individuals on a single thread or in the executor.
+        void Prune(RuntimeMode runtimeMode)
+        {
+            ParallelFor(_individuals.size(), runtimeMode, [this](size_t i) { _individuals[i].Prune(_generatingGrammar); });
         }
 
         /// Evaluate all the individuals of the population.
@@ -173,11 +365,24 @@ namespace gbgp
                     break;
             }
 
+            LearnEvaluationCost();
             SortPopulation();
 
             _isEvaluated = true;
         }
 
+        /// Creates an empty population with the same grammar, fitness function and evaluation settings.
+        [[nodiscard]]
+        Population CreateEmptyCopy() const
+        {
+            Population population(_generatingGrammar, _fitnessFunction);
+            population._fitnessCache = _fitnessCache;
+            population._executor = _executor;
+            population._schedulingPolicy = _schedulingPolicy;
+            population._secondsPerNode = _secondsPerNode;
+            return population;
+        }
+
         /// Get the fitness values of all the individuals in the population.
         /// \return A vector with the fitness values.
         [[nodiscard]]
@@ -223,6 +428,57 @@ namespace gbgp
             return _fitnessFunction;
         }
 
+        /// Sets the cache used to skip the evaluation of individuals identical to one already evaluated.
+        /// \param fitnessCache The cache, which must hold values of the fitness function of this population. Null
+        /// disables the cache.
+        void SetFitnessCache(const std::shared_ptr<FitnessCache>& fitnessCache)
+        {
+            _fitnessCache = fitnessCache;
+        }
+
+        /// Fitness cache getter.
+        [[nodiscard]]
+        std::shared_ptr<FitnessCache> GetFitnessCache() const
+        {
+            return _fitnessCache;
+        }
+
+        /// Sets the worker threads used to evaluate the population in the multithread mode.
+        /// \param executor The executor, which can be shared with other populations. Null creates a new executor on
+        /// the next multithread evaluation.
+        void SetExecutor(const std::shared_ptr<Executor>& executor)
+        {
+            _executor = executor;
+        }
+
+        /// Executor getter.
+        [[nodiscard]]
+        std::shared_ptr<Executor> GetExecutor() const
+        {
+            return _executor;
+        }
+
+        /// Sets the order in which the individuals are evaluated in the multithread mode.
+        /// \param schedulingPolicy The scheduling policy.
+        void SetSchedulingPolicy(SchedulingPolicy schedulingPolicy)
+        {
+            _schedulingPolicy = schedulingPolicy;
+        }
+
+        /// Scheduling policy getter.
+        [[nodiscard]]
+        SchedulingPolicy GetSchedulingPolicy() const
+        {
+            return _schedulingPolicy;
+        }
+
+        /// Get the makespan and idle time of the workers in the last evaluation.
+        [[nodiscard]]
+        const ExecutorStatistics& GetEvaluationStatistics() const
+        {
+            return _evaluationStatistics;
+        }
+
         /// Get a string representation of this object.
         /// \return The string representation.
         [[nodiscard]]
@@ -1,6 +1,10 @@
 #pragma once
+#include <atomic>
+#include <type_traits>
 #include "term.h"
 #include "evaluation.h"
+#include "batch_evaluation.h"
+#include "lazy_evaluation.h"
 
 namespace gbgp
 {
@@ -142,6 +146,80 @@ namespace gbgp
         }
     };
 
+    //*********************************
+    //*        Semantic action        *
+    //********************************/
+
+    /// Semantic action of a production rule. Functions cannot be compared, so every function assigned to an action
+    /// gets a new identity, which is kept by the copies of the action. The symbol table only merges copies of a rule
+    /// whose actions have the same identities.
+    /// \tparam Context The evaluation context of the action.
+    template<typename Context> class SemanticAction : public std::function<void(Context&)>
+    {
+    private:
+        using Function = std::function<void(Context&)>;
+
+        /// Identity of the function, or 0 if there is none.
+        uint64_t _identity = 0;
+
+        /// Returns a new action identity.
+        static uint64_t NextIdentity()
+        {
+            static std::atomic<uint64_t> counter{0};
+            return ++counter;
+        }
+
+        template<typename F> using EnableIfFunction = std::enable_if_t<
+                !std::is_same_v<std::decay_t<F>, SemanticAction> && !std::is_same_v<std::decay_t<F>, std::nullptr_t> &&
+                std::is_constructible_v<Function, F>>;
+
+    public:
+        /// Empty action constructor.
+        SemanticAction() = default;
+
+        /// Empty action constructor.
+        SemanticAction(std::nullptr_t) {}
+
+        /// Constructor from a callable, which gets a new identity.
+        /// \param function The callable.
+        template<typename F, typename = EnableIfFunction<F>>
+        SemanticAction(F&& function)
+            : Function(std::forward<F>(function))
+        {
+            _identity = *this ? NextIdentity() : 0;
+        }
+
+        SemanticAction(const SemanticAction& other) = default;
+        SemanticAction(SemanticAction&& other) noexcept = default;
+        SemanticAction& operator=(const SemanticAction& other) = default;
+        SemanticAction& operator=(SemanticAction&& other) noexcept = default;
+
+        /// Assigns a callable, which gets a new identity.
+        /// \param function The callable.
+        template<typename F, typename = EnableIfFunction<F>>
+        SemanticAction& operator=(F&& function)
+        {
+            Function::operator=(std::forward<F>(function));
+            _identity = *this ? NextIdentity() : 0;
+            return *this;
+        }
+
+        /// Removes the function.
+        SemanticAction& operator=(std::nullptr_t)
+        {
+            Function::operator=(nullptr);
+            _identity = 0;
+            return *this;
+        }
+
+        /// Get the identity of the function, or 0 if there is none.
+        [[nodiscard]]
+        uint64_t Identity() const
+        {
+            return _identity;
+        }
+    };
+
     //*********************************
     //*   Production rule definition  *
     //********************************/
@@ -153,13 +231,36 @@ namespace gbgp
     {
         NonTerminal from;
         std::vector<ProductionElement> to;
-        std::function<void(EvaluationContext&)> semanticAction {};
+        SemanticAction<EvaluationContext> semanticAction {};
+
+        /// Semantic action used to evaluate many rows at once with a BatchEvaluationContext.
+        SemanticAction<BatchEvaluationContext> batchSemanticAction {};
+
+        /// Semantic action used to evaluate boolean rules over whole truth tables with a BitSlicedEvaluationContext.
+        SemanticAction<BitSlicedEvaluationContext> bitSlicedSemanticAction {};
+
+        /// Semantic action used with a LazyEvaluationContext, which evaluates only the production elements it needs.
+        SemanticAction<LazyEvaluationContext> lazySemanticAction {};
+
+        /// Identity of the rule, shared by all of its copies. Nodes refer to rules through this identity, so
+        /// modifying a rule after building nodes from it does not affect those nodes.
+        size_t uid;
+
+        /// Returns a new rule identity.
+        static size_t NextUID()
+        {
+            static std::atomic<size_t> counter{0};
+            return ++counter;
+        }
 
         /// Empty ProductionRule constructor.
         ProductionRule()
         {
             from = NonTerminal();
             semanticAction = nullptr;
+            batchSemanticAction = nullptr;
+            bitSlicedSemanticAction = nullptr;
+            uid = NextUID();
         }
 
         /// Production rule with default semantic action.
@@ -184,6 +285,13 @@ namespace gbgp
             semanticAction = [semanticTransferIndex](EvaluationContext& ctx) {
                 ctx.TransferSemanticValueToResult(semanticTransferIndex);
             };
+            batchSemanticAction = [semanticTransferIndex](BatchEvaluationContext& ctx) {
+                ctx.TransferColumnToResult(semanticTransferIndex);
+            };
+            bitSlicedSemanticAction = [semanticTransferIndex](BitSlicedEvaluationContext& ctx) {
+                ctx.TransferColumnToResult(semanticTransferIndex);
+            };
+            uid = NextUID();
         }
 
         /// Production rule with custom semantic action.
@@ -198,6 +306,62 @@ namespace gbgp
             from = pfrom;
             to = pto;
             semanticAction = std::move(pSemanticAction);
+            uid = NextUID();
+        }
+
+        /// Production rule with custom semantic actions for single and batch evaluation.
+        /// \param pfrom The From non-terminal.
+        /// \param pto The To Terms.
+        /// \param pSemanticAction A function to evaluate this production rule.
+        /// \param pBatchSemanticAction A function to evaluate this production rule for many rows at once.
+        ProductionRule(
+                const NonTerminal& pfrom,
+                const std::vector<ProductionElement>& pto,
+                std::function<void(EvaluationContext&)> pSemanticAction,
+                std::function<void(BatchEvaluationContext&)> pBatchSemanticAction)
+        {
+            from = pfrom;
+            to = pto;
+            semanticAction = std::move(pSemanticAction);
+            batchSemanticAction = std::move(pBatchSemanticAction);
+            uid = NextUID();
+        }
+
+        /// Production rule with custom semantic actions for single and bit-sliced evaluation.
+        /// \param pfrom The From non-terminal.
+        /// \param pto The To Terms.
+        /// \param pSemanticAction A function to evaluate this production rule.
+        /// \param pBitSlicedSemanticAction A function to evaluate this production rule for a whole truth table.
+        ProductionRule(
+                const NonTerminal& pfrom,
+                const std::vector<ProductionElement>& pto,
+                std::function<void(EvaluationContext&)> pSemanticAction,
+                std::function<void(BitSlicedEvaluationContext&)> pBitSlicedSemanticAction)
+        {
+            from = pfrom;
+            to = pto;
+            semanticAction = std::move(pSemanticAction);
+            bitSlicedSemanticAction = std::move(pBitSlicedSemanticAction);
+            uid = NextUID();
+        }
+
+        /// Production rule with custom semantic actions for eager and lazy evaluation.
+        /// \param pfrom The From non-terminal.
+        /// \param pto The To Terms.
+        /// \param pSemanticAction A function to evaluate this production rule.
+        /// \param pLazySemanticAction A function to evaluate this production rule that evaluates only the production
+        /// elements it needs.
+        ProductionRule(
+                const NonTerminal& pfrom,
+                const std::vector<ProductionElement>& pto,
+                std::function<void(EvaluationContext&)> pSemanticAction,
+                std::function<void(LazyEvaluationContext&)> pLazySemanticAction)
+        {
+            from = pfrom;
+            to = pto;
+            semanticAction = std::move(pSemanticAction);
+            lazySemanticAction = std::move(pLazySemanticAction);
+            uid = NextUID();
         }
 
         /// Returns the number of production elements.
@@ -228,6 +392,43 @@ namespace gbgp
             return semanticAction;
         }
 
+        /// Getter for the batch semantic action.
+        [[nodiscard]]
+        std::function<void(BatchEvaluationContext&)> GetBatchSemanticAction() const
+        {
+            return batchSemanticAction;
+        }
+
+        /// Getter for the bit-sliced semantic action.
+        [[nodiscard]]
+        std::function<void(BitSlicedEvaluationContext&)> GetBitSlicedSemanticAction() const
+        {
+            return bitSlicedSemanticAction;
+        }
+
+        /// Getter for the lazy semantic action.
+        [[nodiscard]]
+        std::function<void(LazyEvaluationContext&)> GetLazySemanticAction() const
+        {
+            return lazySemanticAction;
+        }
+
+        /// Get the semantic action for a batch context. A rule only stores actions for BatchEvaluationContext and
+        /// BitSlicedEvaluationContext, so the columns must hold double or uint64_t.
+        /// \tparam T The type of the elements of the columns of the context.
+        template<typename T>
+        [[nodiscard]]
+        const std::function<void(BasicBatchEvaluationContext<T>&)>& BatchSemanticAction() const
+        {
+            static_assert(std::is_same_v<T, double> || std::is_same_v<T, uint64_t>,
+                          "Batch semantic actions are only stored for double and uint64_t columns");
+
+            if constexpr (std::is_same_v<T, uint64_t>)
+                return bitSlicedSemanticAction;
+            else
+                return batchSemanticAction;
+        }
+
         /// Get a string representation.
         [[nodiscard]]
         std::string ToString() const
@@ -3,10 +3,15 @@
 
 namespace gbgp
 {
-    /// Contains a rule and logic for simplifying leaf nodes on a SyntaxTree.
+    /// Contains a rule and logic for simplifying leaf nodes on a SyntaxTree. The rule keeps its own copy of the
+    /// pattern trees, so it does not depend on the lifetime of the trees used to construct it.
     class PruneRule
     {
     private:
+        SyntaxTree _pruneRuleFrom;
+        SyntaxTree _pruneRuleTo;
+
+        /// Traversals of the pattern trees, referencing nodes owned by _pruneRuleFrom and _pruneRuleTo.
         Traversal _pruneRuleFromTraversal;
         Traversal _pruneRuleToTraversal;
 
@@ -41,9 +46,10 @@ namespace gbgp
         /// \param pruneRuleFrom Prune rule from as SyntaxTree.
         /// \param pruneRuleTo Prune rule to as SyntaxTree.
         PruneRule(const SyntaxTree& pruneRuleFrom, const SyntaxTree& pruneRuleTo)
+            : _pruneRuleFrom(pruneRuleFrom), _pruneRuleTo(pruneRuleTo)
         {
-            _pruneRuleFromTraversal = pruneRuleFrom.GetPostOrderTreeTraversal();
-            _pruneRuleToTraversal = pruneRuleTo.GetPostOrderTreeTraversal();
+            _pruneRuleFromTraversal = _pruneRuleFrom.GetPostOrderTreeTraversal();
+            _pruneRuleToTraversal = _pruneRuleTo.GetPostOrderTreeTraversal();
 
             if (!ValidateCaptureID(_pruneRuleFromTraversal))
                 throw std::runtime_error("pruneRuleFrom must have at least one terminal with a captureID.");
@@ -51,10 +57,42 @@ namespace gbgp
                 throw std::runtime_error("pruneRuleTo must have at least one terminal with a captureID.");
         }
 
+        /// Copy constructor. The traversals are rebuilt from the copied pattern trees.
+        /// \param other The other prune rule.
+        PruneRule(const PruneRule& other)
+            : _pruneRuleFrom(other._pruneRuleFrom), _pruneRuleTo(other._pruneRuleTo),
+              _pruneRuleFromTraversal(_pruneRuleFrom.GetPostOrderTreeTraversal()),
+              _pruneRuleToTraversal(_pruneRuleTo.GetPostOrderTreeTraversal())
+        {
+        }
+
+        /// Move constructor. The nodes of the pattern trees do not move, so the traversals remain valid.
+        PruneRule(PruneRule&& other) noexcept = default;
+
+        PruneRule& operator=(const PruneRule& other)
+        {
+            PruneRule copy(other);
+            *this = std::move(copy);
+            return *this;
+        }
+
+        PruneRule& operator=(PruneRule&& other) noexcept = default;
+
         /// Does the target tree can be simplified further with this rule?
-        bool CanBeApplied(const SyntaxTree& target)
+        [[nodiscard]]
+        bool CanBeApplied(const SyntaxTree& target) const
         {
-            Traversal treeTraversal = target.GetPostOrderTreeTraversal();
+            Traversal treeTraversal;
+            return CanBeApplied(target, treeTraversal);
+        }
+
+        /// Does the target tree can be simplified further with this rule?
+        /// \param target The SyntaxTree to check.
+        /// \param treeTraversal Reusable buffer for the traversal of the target.
+        [[nodiscard]]
+        bool CanBeApplied(const SyntaxTree& target, Traversal& treeTraversal) const
+        {
+            target.GetPostOrderTreeTraversal(treeTraversal);
             unsigned index = SyntaxTree::FindIndexOfTraversalSubsequence(treeTraversal, _pruneRuleFromTraversal);
             return index != treeTraversal.size();
         }
@@ -62,7 +100,7 @@ namespace gbgp
         /// Create a new SyntaxTree where the prune rule has been applied.
         /// \param target The SyntaxTree where the prune rule will be applied.
         /// \return The pruned SyntaxTree.
-        void Apply(SyntaxTree& target)
+        void Apply(SyntaxTree& target) const
         {
             Traversal treeTraversal = target.GetPostOrderTreeTraversal();
             Traversal replacedTraversal = SyntaxTree::ReplaceTraversalSubsequence(treeTraversal,
@@ -71,6 +109,22 @@ namespace gbgp
             SyntaxTree::BuildFromTraversal(target, replacedTraversal);
         }
 
+        /// Applies the prune rule if the target tree contains its pattern.
+        /// \param target The SyntaxTree where the prune rule will be applied.
+        /// \param treeTraversal Reusable buffer for the traversal of the target.
+        /// \return True if the rule was applied.
+        bool TryApply(SyntaxTree& target, Traversal& treeTraversal) const
+        {
+            if (!CanBeApplied(target, treeTraversal))
+                return false;
+
+            Traversal replacedTraversal = SyntaxTree::ReplaceTraversalSubsequence(treeTraversal,
+                                                                                  _pruneRuleFromTraversal,
+                                                                                  _pruneRuleToTraversal);
+            SyntaxTree::BuildFromTraversal(target, replacedTraversal);
+            return true;
+        }
+
         /// Get string representation.
         [[nodiscard]]
         std::string ToString() const
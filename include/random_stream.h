@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include "vector_ops.h"
+
+namespace gbgp
+{
+    /// Counter-based random number generator. The n-th number of a stream is a hash of its key and n, so a stream
+    /// can jump ahead in constant time and be split into independent child streams, one per generation, operator or
+    /// individual, without sharing any state between threads. A parallel run that hands every task its own child
+    /// stream is bit-reproducible for a given seed, regardless of the number of threads and of the order in which
+    /// the tasks run.
+    /// It satisfies the UniformRandomBitGenerator requirements, so it can be used with the standard distributions
+    /// and with random_choice.
+    class RandomStream
+    {
+    private:
+        /// Increment of the SplitMix64 generator.
+        static constexpr uint64_t Gamma = 0x9E3779B97F4A7C15ull;
+
+        uint64_t _key = 0;
+        uint64_t _counter = 0;
+
+        /// The SplitMix64 finalizer, a bijective hash where every input bit affects every output bit.
+        static constexpr uint64_t Mix(uint64_t x)
+        {
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+
+    public:
+        using result_type = uint64_t;
+
+        /// Creates a stream.
+        /// \param seed The seed of the stream.
+        explicit RandomStream(uint64_t seed = RANDOM_SEED) : _key(Mix(seed)) {}
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        /// Get the next number of the stream.
+        result_type operator()()
+        {
+            return Mix(_key + Gamma * ++_counter);
+        }
+
+        /// Skips numbers of the stream in constant time.
+        /// \param n The number of skipped numbers.
+        void Discard(uint64_t n)
+        {
+            _counter += n;
+        }
+
+        /// Creates an independent child stream. The child depends only on the index and on the position of this
+        /// stream, so splitting twice at the same position with the same index gives the same child.
+        /// \param index The index of the child, such as the number of a generation or the slot of an individual.
+        /// \return The child stream.
+        [[nodiscard]]
+        RandomStream Split(uint64_t index) const
+        {
+            RandomStream child;
+            child._key = Mix(_key ^ Mix(Gamma * _counter + Mix(index ^ Gamma)));
+            return child;
+        }
+    };
+}
@@ -0,0 +1,411 @@
+#pragma once
+#include <memory>
+#include "grammar.h"
+
+namespace gbgp
+{
+    /// Immutable node of a SharedSyntaxTree. A node never changes once built, so it can be referenced by any number
+    /// of trees, including trees evaluated at the same time from different threads.
+    struct SharedNode
+    {
+        /// Symbols of the node.
+        Node node;
+
+        /// Children of the node, in the order of the elements of its production rule.
+        std::vector<std::shared_ptr<const SharedNode>> children;
+
+        /// Number of nodes of the subtree that starts at this node, including itself.
+        unsigned size = 1;
+    };
+
+    /// Reference counted pointer to an immutable node.
+    using SharedNodePtr = std::shared_ptr<const SharedNode>;
+
+    /// Persistent representation of a syntax tree built from immutable reference counted nodes. A modification
+    /// rebuilds only the nodes on the path from the root to the modified node, every other subtree is shared with
+    /// the original tree. Copying a tree copies a single pointer, and an offspring produced by crossover or mutation
+    /// allocates as many nodes as the depth of the modified node while sharing the rest with its parents.
+    /// Nodes are addressed by their position in depth first pre-order.
+    class SharedSyntaxTree
+    {
+    private:
+        /// Root of the tree.
+        SharedNodePtr _root;
+
+        /// Creates a node and computes the size of its subtree.
+        /// \param node The symbols of the node.
+        /// \param children The children of the node.
+        /// \return The new node.
+        static SharedNodePtr MakeNode(const Node& node, std::vector<SharedNodePtr> children)
+        {
+            auto sharedNode = std::make_shared<SharedNode>();
+            sharedNode->node = node;
+            for (const SharedNodePtr& child : children)
+                sharedNode->size += child->size;
+            sharedNode->children = std::move(children);
+            return sharedNode;
+        }
+
+        /// Recursive implementation. Builds the shared representation of the subtree of a TreeNode.
+        /// \param node The root of the subtree.
+        /// \return The root of the shared subtree.
+        static SharedNodePtr FromTreeNode(const TreeNode* node)
+        {
+            std::vector<SharedNodePtr> children;
+            children.reserve(node->children.size());
+            for (const auto& child : node->children)
+                children.push_back(FromTreeNode(child.get()));
+
+            return MakeNode(static_cast<const Node&>(*node), std::move(children));
+        }
+
+        /// Recursive implementation. Adds the children of a shared node to a TreeNode.
+        /// \param node The shared node.
+        /// \param target The node where the children will be created.
+        static void BuildTreeNode(const SharedNode* node, TreeNode* target)
+        {
+            for (const SharedNodePtr& child : node->children)
+            {
+                auto* childNode = new TreeNode(child->node);
+                target->AddChildNode(childNode);
+                BuildTreeNode(child.get(), childNode);
+            }
+        }
+
+        /// Recursive implementation. Copies the path from node to the node at position, which is replaced.
+        /// \param node The root of the subtree.
+        /// \param position The position of the replaced node, relative to node.
+        /// \param replacement The subtree inserted at position.
+        /// \return The root of the new subtree.
+        static SharedNodePtr ReplaceNode(const SharedNodePtr& node, size_t position, const SharedNodePtr& replacement)
+        {
+            if (position == 0)
+                return replacement;
+
+            std::vector<SharedNodePtr> children = node->children;
+            size_t offset = 1;
+            for (SharedNodePtr& child : children)
+            {
+                if (position < offset + child->size)
+                {
+                    child = ReplaceNode(child, position - offset, replacement);
+                    return MakeNode(node->node, std::move(children));
+                }
+                offset += child->size;
+            }
+
+            throw std::runtime_error("Node position " + std::to_string(position) + " is out of range");
+        }
+
+        /// Recursive implementation. Calls f with the position and node of every node of a subtree in pre-order.
+        /// \param node The root of the subtree.
+        /// \param position The position of node.
+        /// \param f The function that receives the nodes.
+        template<typename F> static void ForEachNode(const SharedNode* node, size_t position, F&& f)
+        {
+            f(position, *node);
+
+            size_t child = position + 1;
+            for (const SharedNodePtr& c : node->children)
+            {
+                ForEachNode(c.get(), child, f);
+                child += c->size;
+            }
+        }
+
+        /// Recursive implementation. Evaluates the subtree of node and leaves its result on top of the stack.
+        /// \param node The NonTerminal root of the subtree.
+        /// \param ctx The evaluation context.
+        /// \param stack The stack of semantic values shared by the whole evaluation.
+        static void EvaluateNode(const SharedNode* node, EvaluationContext& ctx, std::vector<std::string>& stack)
+        {
+            const ProductionRule& rule = node->node.GetGeneratorPR();
+            ValidateChildren(node->node, rule, node->children, [](const SharedNodePtr& child) -> const Node& {
+                return child->node;
+            }, "expression evaluation");
+
+            const size_t base = stack.size();
+            for (const SharedNodePtr& child : node->children)
+            {
+                if (child->node.type == NodeType::Terminal)
+                    stack.push_back(child->node.GetValue());
+                else
+                    EvaluateNode(child.get(), ctx, stack);
+            }
+
+            if (rule.semanticAction == nullptr)
+                throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
+
+            ctx.Prepare();
+            for (size_t i = base; i < stack.size(); i++)
+                ctx.PushSemanticValue(stack[i]);
+            rule.semanticAction(ctx);
+
+            stack.resize(base);
+            stack.push_back(ctx.result());
+        }
+
+        /// Recursive implementation. Checks if two subtrees have the same structure and values.
+        static bool SameSubtree(const SharedNode* a, const SharedNode* b)
+        {
+            if (a == b)
+                return true;
+            if (a->size != b->size || a->node != b->node)
+                return false;
+
+            for (size_t i = 0; i < a->children.size(); i++)
+            {
+                if (!SameSubtree(a->children[i].get(), b->children[i].get()))
+                    return false;
+            }
+            return true;
+        }
+
+        /// Get the positions and types of the NonTerminal nodes that can be replaced, that is, every NonTerminal but
+        /// the root.
+        [[nodiscard]]
+        std::vector<std::pair<size_t, int>> MutableNonTerminals() const
+        {
+            std::vector<std::pair<size_t, int>> nonTerminals;
+            if (!IsEmpty())
+            {
+                ForEachNode(_root.get(), 0, [&](size_t position, const SharedNode& node) {
+                    if (position != 0 && node.node.type == NodeType::NonTerminal)
+                        nonTerminals.emplace_back(position, node.node.GetNonTerminal().id);
+                });
+            }
+            return nonTerminals;
+        }
+
+    public:
+        /// Creates an empty tree.
+        SharedSyntaxTree() = default;
+
+        /// Builds the shared representation of a SyntaxTree.
+        /// \param syntaxTree The source tree.
+        explicit SharedSyntaxTree(const SyntaxTree& syntaxTree)
+        {
+            if (!syntaxTree.IsEmpty())
+                _root = FromTreeNode(syntaxTree.Root());
+        }
+
+        bool operator==(const SharedSyntaxTree& other) const
+        {
+            if (IsEmpty() || other.IsEmpty())
+                return IsEmpty() == other.IsEmpty();
+            return SameSubtree(_root.get(), other._root.get());
+        }
+
+        bool operator!=(const SharedSyntaxTree& other) const
+        {
+            return !(*this == other);
+        }
+
+        /// Get the number of nodes.
+        [[nodiscard]]
+        size_t Size() const
+        {
+            return IsEmpty() ? 0 : _root->size;
+        }
+
+        /// Check if the tree is empty.
+        [[nodiscard]]
+        bool IsEmpty() const
+        {
+            return _root == nullptr;
+        }
+
+        /// Returns the root node.
+        [[nodiscard]]
+        const SharedNodePtr& Root() const
+        {
+            return _root;
+        }
+
+        /// Returns the node at a position.
+        /// \param position The position of the node in pre-order.
+        /// \return The node.
+        [[nodiscard]]
+        const SharedNodePtr& NodeAt(size_t position) const
+        {
+            if (position >= Size())
+                throw std::runtime_error("Node position " + std::to_string(position) + " is out of range");
+
+            const SharedNodePtr* node = &_root;
+            while (position != 0)
+            {
+                position--;
+                for (const SharedNodePtr& child : (*node)->children)
+                {
+                    if (position < child->size)
+                    {
+                        node = &child;
+                        break;
+                    }
+                    position -= child->size;
+                }
+            }
+            return *node;
+        }
+
+        /// Replace the subtree at a position. Only the ancestors of the position are rebuilt.
+        /// \param position The position of the replaced subtree in pre-order.
+        /// \param replacement The root of the inserted subtree.
+        void ReplaceSubtree(size_t position, const SharedNodePtr& replacement)
+        {
+            if (position >= Size())
+                throw std::runtime_error("Node position " + std::to_string(position) + " is out of range");
+
+            _root = ReplaceNode(_root, position, replacement);
+        }
+
+        //************************
+        //*      Conversions     *
+        //***********************/
+
+        /// Rebuilds the pointer based representation of the tree.
+        /// \param syntaxTree The target tree. Its previous content is destroyed.
+        void ToSyntaxTree(SyntaxTree& syntaxTree) const
+        {
+            syntaxTree.Destroy();
+            if (IsEmpty())
+                return;
+
+            syntaxTree.SetRoot(new TreeNode(_root->node));
+            BuildTreeNode(_root.get(), syntaxTree.Root());
+        }
+
+        /// Rebuilds the pointer based representation of the tree.
+        /// \return The SyntaxTree.
+        [[nodiscard]]
+        SyntaxTree ToSyntaxTree() const
+        {
+            SyntaxTree syntaxTree;
+            ToSyntaxTree(syntaxTree);
+            return syntaxTree;
+        }
+
+        //***************************
+        //*     Tree evaluation     *
+        //**************************/
+
+        /// Synthesizes the tree by appending its terminal values to output.
+        /// \param output The string where the expression will be appended.
+        void SynthesizeExpression(std::string& output) const
+        {
+            if (IsEmpty())
+                return;
+
+            ForEachNode(_root.get(), 0, [&](size_t, const SharedNode& node) {
+                if (node.node.type == NodeType::Terminal)
+                    output += node.node.GetValue();
+            });
+        }
+
+        /// Synthesizes the tree into an expression.
+        /// \return The synthesized expression as a std::string.
+        [[nodiscard]]
+        std::string SynthesizeExpression() const
+        {
+            std::string output;
+            SynthesizeExpression(output);
+            return output;
+        }
+
+        /// Evaluates the tree using the semantic actions of the grammar. The result is stored in the context.
+        /// The nodes are not modified, so a tree can be evaluated concurrently.
+        /// \param ctx Reference to the evaluation context.
+        void Evaluate(EvaluationContext& ctx) const
+        {
+            if (IsEmpty() || _root->children.empty())
+                return;
+
+            std::vector<std::string> stack;
+            EvaluateNode(_root.get(), ctx, stack);
+        }
+
+        //***************************
+        //*    Genetic operators    *
+        //**************************/
+
+        /// Generates a new offspring by replacing a random subtree of parent1 with a subtree of the same NonTerminal
+        /// type of parent2. The offspring shares every other subtree with its parents.
+        /// \param parent1 The first parent.
+        /// \param parent2 The second parent.
+        /// \return The offspring. If the parents share no NonTerminal type, a copy of parent1.
+        static SharedSyntaxTree Crossover(const SharedSyntaxTree& parent1, const SharedSyntaxTree& parent2)
+        {
+            const std::vector<std::pair<size_t, int>> candidates1 = parent1.MutableNonTerminals();
+            const std::vector<std::pair<size_t, int>> candidates2 = parent2.MutableNonTerminals();
+
+            // Positions of parent1 whose type is also present on parent2.
+            std::vector<std::pair<size_t, int>> shared;
+            std::copy_if(candidates1.begin(), candidates1.end(), std::back_inserter(shared),
+                         [&](const std::pair<size_t, int>& c1) {
+                             return std::any_of(candidates2.begin(), candidates2.end(),
+                                                [&](const std::pair<size_t, int>& c2) { return c1.second == c2.second; });
+                         });
+
+            SharedSyntaxTree offspring = parent1;
+            if (shared.empty())
+                return offspring;
+
+            const auto [position1, type] = *random_choice(shared.begin(), shared.end());
+
+            std::vector<size_t> sameType;
+            for (const auto& [position2, type2] : candidates2)
+            {
+                if (type2 == type)
+                    sameType.push_back(position2);
+            }
+            const size_t position2 = *random_choice(sameType.begin(), sameType.end());
+
+            offspring.ReplaceSubtree(position1, parent2.NodeAt(position2));
+            return offspring;
+        }
+
+        /// Mutates the value of a random terminal that has more than one possible value.
+        void MutateTerminal()
+        {
+            if (IsEmpty())
+                return;
+
+            std::vector<size_t> mutableTerminals;
+            ForEachNode(_root.get(), 0, [&](size_t position, const SharedNode& node) {
+                if (node.node.type == NodeType::Terminal && node.node.GetTerminal().IsMutable())
+                    mutableTerminals.push_back(position);
+            });
+
+            if (mutableTerminals.empty())
+                return;
+
+            const size_t position = *random_choice(mutableTerminals.begin(), mutableTerminals.end());
+            Node terminal = NodeAt(position)->node;
+            terminal.SetValue(terminal.GetTerminal().GetRandomValue());
+            ReplaceSubtree(position, MakeNode(terminal, {}));
+        }
+
+        /// Replaces a random NonTerminal, other than the root, with a new random subtree built from the same rule.
+        /// \param grammar The grammar used to create the new subtree.
+        /// \param maxDepth Maximum allowed depth of the new subtree.
+        void MutateNonTerminal(const Grammar& grammar, int maxDepth = 50)
+        {
+            const std::vector<std::pair<size_t, int>> candidates = MutableNonTerminals();
+            if (candidates.empty())
+                return;
+
+            const size_t position = random_choice(candidates.begin(), candidates.end())->first;
+
+            SyntaxTree replacement;
+            grammar.CreateRandomTree(replacement, maxDepth, NodeAt(position)->node.GetGeneratorPR());
+            ReplaceSubtree(position, FromTreeNode(replacement.Root()));
+        }
+
+        /// Get a string representation.
+        [[nodiscard]]
+        std::string ToString() const
+        {
+            return "SharedSyntaxTree(nodes='" + std::to_string(Size()) + "', expression='" + SynthesizeExpression() + "')";
+        }
+    };
+}
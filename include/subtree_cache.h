@@ -0,0 +1,424 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "tree_node.h"
+
+namespace gbgp
+{
+    /// Identifies a cached evaluation by the structural hash and size of a tree, and by a key of the input.
+    struct EvaluationKey
+    {
+        size_t hash;
+        size_t size;
+        uint64_t contextKey;
+
+        bool operator==(const EvaluationKey& other) const
+        {
+            return hash == other.hash && size == other.size && contextKey == other.contextKey;
+        }
+    };
+
+    struct EvaluationKeyHash
+    {
+        size_t operator()(const EvaluationKey& key) const
+        {
+            // The structural hash is already well mixed, only the context key needs mixing.
+            uint64_t x = key.contextKey + 0x9e3779b97f4a7c15ULL;
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            return key.hash ^ static_cast<size_t>(x ^ (x >> 31));
+        }
+    };
+
+    /// Thread-safe map of evaluated values with a bounded size. The map is split in shards with their own lock, so
+    /// threads that access different keys rarely wait for each other. Each shard holds a bounded number of entries
+    /// and evicts them with the clock algorithm, which approximates least recently used eviction.
+    /// \tparam Value The type of the cached values.
+    template<typename Value> class ShardedCache
+    {
+    private:
+        /// A cached value and the bit that gives it a second chance before eviction.
+        struct Entry
+        {
+            EvaluationKey key;
+            Value value;
+            bool referenced;
+        };
+
+        /// A part of the cache with its own lock. Aligned to a cache line, so the counters of different shards do
+        /// not share one.
+        struct alignas(64) Shard
+        {
+            std::mutex mutex;
+            std::unordered_map<EvaluationKey, size_t, EvaluationKeyHash> index;
+            std::vector<Entry> entries;
+            size_t hand = 0;
+            std::atomic<size_t> hits{ 0 };
+            std::atomic<size_t> misses{ 0 };
+            std::atomic<size_t> evictions{ 0 };
+        };
+
+        std::unique_ptr<Shard[]> _shards;
+        size_t _numberOfShards;
+        size_t _shardCapacity;
+
+        Shard& ShardOf(const EvaluationKey& key) const
+        {
+            return _shards[(EvaluationKeyHash()(key) >> 7) % _numberOfShards];
+        }
+
+    public:
+        /// Creates an empty cache.
+        /// \param capacity The maximum number of cached values.
+        /// \param numberOfShards The number of independently locked parts of the cache.
+        explicit ShardedCache(size_t capacity, size_t numberOfShards = 16)
+            : _numberOfShards(std::max<size_t>(numberOfShards, 1))
+        {
+            _shards = std::make_unique<Shard[]>(_numberOfShards);
+            _shardCapacity = std::max<size_t>((capacity + _numberOfShards - 1) / _numberOfShards, 1);
+        }
+
+        ShardedCache(const ShardedCache&) = delete;
+        ShardedCache& operator=(const ShardedCache&) = delete;
+
+        /// Looks up a value.
+        /// \param key The key of the value.
+        /// \param value Receives the cached value, if found.
+        /// \return True if the value was found.
+        bool Find(const EvaluationKey& key, Value& value)
+        {
+            return Find(key, value, [](const Value&) { return true; });
+        }
+
+        /// Looks up a value and checks that it belongs to the searched item, as different items may share a key.
+        /// The check runs after the shard is unlocked, and a rejected value counts as a miss.
+        /// \param key The key of the value.
+        /// \param value Receives the cached value, if found.
+        /// \param accept Returns whether the value found belongs to the searched item.
+        /// \return True if the value was found and accepted.
+        template<typename Accept> bool Find(const EvaluationKey& key, Value& value, Accept&& accept)
+        {
+            Shard& shard = ShardOf(key);
+
+            bool found = false;
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                auto it = shard.index.find(key);
+                if (it != shard.index.end())
+                {
+                    Entry& entry = shard.entries[it->second];
+                    entry.referenced = true;
+                    value = entry.value;
+                    found = true;
+                }
+            }
+
+            found = found && accept(static_cast<const Value&>(value));
+            (found ? shard.hits : shard.misses).fetch_add(1, std::memory_order_relaxed);
+            return found;
+        }
+
+        /// Stores a value. When the shard is full, the first entry not used since the last sweep of the clock is
+        /// replaced.
+        /// \param key The key of the value.
+        /// \param value The value to store.
+        void Insert(const EvaluationKey& key, const Value& value)
+        {
+            Shard& shard = ShardOf(key);
+
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.index.find(key);
+            if (it != shard.index.end())
+            {
+                shard.entries[it->second].value = value;
+                return;
+            }
+
+            if (shard.entries.size() < _shardCapacity)
+            {
+                shard.index.emplace(key, shard.entries.size());
+                shard.entries.push_back({ key, value, false });
+                return;
+            }
+
+            while (shard.entries[shard.hand].referenced)
+            {
+                shard.entries[shard.hand].referenced = false;
+                shard.hand = (shard.hand + 1) % shard.entries.size();
+            }
+
+            Entry& victim = shard.entries[shard.hand];
+            shard.index.erase(victim.key);
+            shard.index.emplace(key, shard.hand);
+            victim = { key, value, false };
+            shard.hand = (shard.hand + 1) % shard.entries.size();
+            shard.evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Removes every value. The counters are kept.
+        void Clear()
+        {
+            for (size_t i = 0; i < _numberOfShards; i++)
+            {
+                std::lock_guard<std::mutex> lock(_shards[i].mutex);
+                _shards[i].index.clear();
+                _shards[i].entries.clear();
+                _shards[i].hand = 0;
+            }
+        }
+
+        /// Sets the hit, miss and eviction counters to zero.
+        void ResetCounters()
+        {
+            for (size_t i = 0; i < _numberOfShards; i++)
+            {
+                _shards[i].hits = 0;
+                _shards[i].misses = 0;
+                _shards[i].evictions = 0;
+            }
+        }
+
+        /// Get the number of lookups that found a value.
+        [[nodiscard]]
+        size_t Hits() const
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < _numberOfShards; i++)
+                total += _shards[i].hits.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        /// Get the number of lookups that did not find a value.
+        [[nodiscard]]
+        size_t Misses() const
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < _numberOfShards; i++)
+                total += _shards[i].misses.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        /// Get the number of values replaced to make room for new ones.
+        [[nodiscard]]
+        size_t Evictions() const
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < _numberOfShards; i++)
+                total += _shards[i].evictions.load(std::memory_order_relaxed);
+            return total;
+        }
+
+        /// Get the fraction of lookups that found a value.
+        [[nodiscard]]
+        double HitRate() const
+        {
+            const size_t hits = Hits();
+            const size_t lookups = hits + Misses();
+            return lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+        }
+
+        /// Get the number of cached values.
+        [[nodiscard]]
+        size_t Size() const
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < _numberOfShards; i++)
+            {
+                std::lock_guard<std::mutex> lock(_shards[i].mutex);
+                total += _shards[i].entries.size();
+            }
+            return total;
+        }
+
+        /// Get the maximum number of cached values.
+        [[nodiscard]]
+        size_t Capacity() const
+        {
+            return _shardCapacity * _numberOfShards;
+        }
+    };
+
+    /// The symbols of a subtree, kept with its cached value to check that a subtree with the same hash is the one
+    /// that was evaluated. A snapshot shares the snapshots of its children, so the snapshot of a subtree evaluated
+    /// after its children adds a single node.
+    struct SubtreeSnapshot
+    {
+        /// The symbols, value and rule of the root of the subtree.
+        Node node;
+
+        /// The snapshots of the children of the root.
+        std::vector<std::shared_ptr<const SubtreeSnapshot>> children;
+
+        SubtreeSnapshot(const Node& pNode, std::vector<std::shared_ptr<const SubtreeSnapshot>> pChildren)
+            : node(pNode), children(std::move(pChildren)) {}
+
+        SubtreeSnapshot(const SubtreeSnapshot&) = delete;
+        SubtreeSnapshot& operator=(const SubtreeSnapshot&) = delete;
+
+        /// Releases the snapshots that are not shared one by one instead of recursively, so deep subtrees cannot
+        /// overflow the stack.
+        ~SubtreeSnapshot()
+        {
+            std::vector<std::shared_ptr<const SubtreeSnapshot>> pending = std::move(children);
+            while (!pending.empty())
+            {
+                std::shared_ptr<const SubtreeSnapshot> snapshot = std::move(pending.back());
+                pending.pop_back();
+
+                // Only the last owner takes the children, which makes the release of the snapshot not recurse. No
+                // other owner can appear meanwhile, and snapshots are never created const.
+                if (snapshot.use_count() == 1)
+                {
+                    auto& grandchildren = const_cast<SubtreeSnapshot&>(*snapshot).children;
+                    for (auto& child : grandchildren)
+                        pending.push_back(std::move(child));
+                    grandchildren.clear();
+                }
+            }
+        }
+
+        /// Creates the snapshot of a subtree. The nodes are visited in post-order without recursion.
+        /// \param subtree The root of the subtree.
+        /// \return The snapshot.
+        static std::shared_ptr<const SubtreeSnapshot> Create(const TreeNode* subtree)
+        {
+            // The snapshots of the children of a node are on top of the stack when the node is completed.
+            std::vector<std::pair<const TreeNode*, bool>> pending{ { subtree, false } };
+            std::vector<std::shared_ptr<const SubtreeSnapshot>> snapshots;
+            while (!pending.empty())
+            {
+                const TreeNode* node = pending.back().first;
+                if (!pending.back().second)
+                {
+                    pending.back().second = true;
+                    for (auto child = node->children.rbegin(); child != node->children.rend(); ++child)
+                        pending.emplace_back(child->get(), false);
+                    continue;
+                }
+
+                pending.pop_back();
+                const auto first = snapshots.end() - static_cast<std::ptrdiff_t>(node->children.size());
+                std::vector<std::shared_ptr<const SubtreeSnapshot>> children(std::make_move_iterator(first),
+                                                                             std::make_move_iterator(snapshots.end()));
+                snapshots.erase(first, snapshots.end());
+                snapshots.push_back(std::make_shared<SubtreeSnapshot>(*node, std::move(children)));
+            }
+            return snapshots.back();
+        }
+
+        /// Check if a subtree has the symbols of the snapshot. The nodes are compared in lockstep without recursion.
+        /// \param subtree The root of the subtree.
+        /// \return True if every node matches.
+        [[nodiscard]]
+        bool Matches(const TreeNode* subtree) const
+        {
+            std::vector<std::pair<const SubtreeSnapshot*, const TreeNode*>> pending{ { this, subtree } };
+            while (!pending.empty())
+            {
+                const auto [snapshot, node] = pending.back();
+                pending.pop_back();
+
+                if (!snapshot->node.SameSymbols(*node) || snapshot->children.size() != node->children.size())
+                    return false;
+                for (size_t i = 0; i < node->children.size(); i++)
+                    pending.emplace_back(snapshot->children[i].get(), node->children[i].get());
+            }
+            return true;
+        }
+    };
+
+    /// A cached value of a subtree together with the snapshot of the subtree.
+    struct CachedSubtree
+    {
+        std::shared_ptr<const SubtreeSnapshot> snapshot;
+        std::string value;
+    };
+
+    /// Cache of the evaluation of subtrees, shared by every tree of a population. Crossover and elitism copy subtrees
+    /// between individuals, so the same subtree is often evaluated many times for the same input. An entry is keyed by
+    /// the structural hash of the subtree and by a context key chosen by the caller, which must identify the input of
+    /// the evaluation, for instance the index of a data row. Every entry keeps a snapshot of its subtree, so subtrees
+    /// with colliding hashes never share a value. Trees evaluated from different threads can share it.
+    class SubtreeCache : public ShardedCache<CachedSubtree>
+    {
+    private:
+        size_t _minimumSubtreeSize;
+
+    public:
+        /// Creates an empty cache.
+        /// \param capacity The maximum number of cached values.
+        /// \param minimumSubtreeSize The minimum number of nodes of a cached subtree. Evaluating smaller subtrees is
+        /// usually cheaper than a lookup.
+        /// \param numberOfShards The number of independently locked parts of the cache.
+        explicit SubtreeCache(size_t capacity, size_t minimumSubtreeSize = 4, size_t numberOfShards = 16)
+            : ShardedCache<CachedSubtree>(capacity, numberOfShards), _minimumSubtreeSize(minimumSubtreeSize) {}
+
+        /// Looks up the value of a subtree.
+        /// \param subtree The root of the subtree.
+        /// \param contextKey The key of the input of the evaluation.
+        /// \param value Receives the cached value, if found.
+        /// \param snapshot Receives the snapshot of the subtree, if found.
+        /// \return True if the value was found.
+        bool Find(const TreeNode* subtree, uint64_t contextKey, std::string& value,
+                  std::shared_ptr<const SubtreeSnapshot>& snapshot)
+        {
+            CachedSubtree cached;
+            const EvaluationKey key{ subtree->GetSubtreeHash(), subtree->GetSubtreeSize(), contextKey };
+            if (!ShardedCache<CachedSubtree>::Find(key, cached, [subtree](const CachedSubtree& entry) {
+                    return entry.snapshot->Matches(subtree);
+                }))
+                return false;
+
+            value = std::move(cached.value);
+            snapshot = std::move(cached.snapshot);
+            return true;
+        }
+
+        /// Looks up the value of a subtree.
+        /// \param subtree The root of the subtree.
+        /// \param contextKey The key of the input of the evaluation.
+        /// \param value Receives the cached value, if found.
+        /// \return True if the value was found.
+        bool Find(const TreeNode* subtree, uint64_t contextKey, std::string& value)
+        {
+            std::shared_ptr<const SubtreeSnapshot> snapshot;
+            return Find(subtree, contextKey, value, snapshot);
+        }
+
+        /// Stores the value of a subtree.
+        /// \param subtree The root of the subtree.
+        /// \param snapshot The snapshot of the subtree.
+        /// \param contextKey The key of the input of the evaluation.
+        /// \param value The value to store.
+        void Insert(const TreeNode* subtree, const std::shared_ptr<const SubtreeSnapshot>& snapshot,
+                    uint64_t contextKey, const std::string& value)
+        {
+            ShardedCache<CachedSubtree>::Insert({ subtree->GetSubtreeHash(), subtree->GetSubtreeSize(), contextKey },
+                                                { snapshot, value });
+        }
+
+        /// Stores the value of a subtree, taking a new snapshot of it.
+        /// \param subtree The root of the subtree.
+        /// \param contextKey The key of the input of the evaluation.
+        /// \param value The value to store.
+        void Insert(const TreeNode* subtree, uint64_t contextKey, const std::string& value)
+        {
+            Insert(subtree, SubtreeSnapshot::Create(subtree), contextKey, value);
+        }
+
+        /// Get the minimum number of nodes of a cached subtree.
+        [[nodiscard]]
+        size_t MinimumSubtreeSize() const
+        {
+            return _minimumSubtreeSize;
+        }
+    };
+}
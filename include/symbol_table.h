@@ -0,0 +1,576 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "production_rule.h"
+
+namespace gbgp
+{
+    /// Compact identifier of a symbol stored in the SymbolTable.
+    using SymbolID = std::uint32_t;
+
+    /// Combines a hash value into a seed.
+    /// \param seed The hash that accumulates the values.
+    /// \param value The hash value to combine.
+    /// \return The combined hash.
+    inline size_t HashCombine(size_t seed, size_t value)
+    {
+        return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    }
+
+    //*****************************
+    //*      Stable storage       *
+    //****************************/
+
+    /// Growable container whose elements never move once created. Elements are stored in fixed size chunks, which
+    /// are listed in lazily allocated blocks, so they can be read without locking by any thread that obtained their
+    /// index and the container can hold as many elements as a SymbolID can address.
+    template<typename T> class StableStorage
+    {
+    private:
+        static constexpr size_t ChunkBits = 10;
+        static constexpr size_t ChunkSize = size_t(1) << ChunkBits;
+        static constexpr size_t BlockBits = 10;
+        static constexpr size_t BlockSize = size_t(1) << BlockBits;
+        static constexpr size_t MaxBlocks = size_t(1) << (32 - ChunkBits - BlockBits);
+
+        std::array<std::unique_ptr<std::unique_ptr<T[]>[]>, MaxBlocks> _blocks;
+        SymbolID _size = 0;
+
+    public:
+        /// Adds a default constructed element. Not thread-safe, the caller must synchronize insertions.
+        /// \return The index of the new element.
+        SymbolID Grow()
+        {
+            if (_size == std::numeric_limits<SymbolID>::max())
+                throw std::runtime_error("StableStorage capacity exceeded");
+
+            auto& block = _blocks[_size >> (ChunkBits + BlockBits)];
+            if (block == nullptr)
+                block = std::make_unique<std::unique_ptr<T[]>[]>(BlockSize);
+            auto& chunk = block[(_size >> ChunkBits) & (BlockSize - 1)];
+            if (chunk == nullptr)
+                chunk = std::make_unique<T[]>(ChunkSize);
+            return _size++;
+        }
+
+        /// Access the element at the specified index.
+        T& operator[](SymbolID index)
+        {
+            return _blocks[index >> (ChunkBits + BlockBits)][(index >> ChunkBits) & (BlockSize - 1)]
+                          [index & (ChunkSize - 1)];
+        }
+
+        /// Access the element at the specified index.
+        const T& operator[](SymbolID index) const
+        {
+            return _blocks[index >> (ChunkBits + BlockBits)][(index >> ChunkBits) & (BlockSize - 1)]
+                          [index & (ChunkSize - 1)];
+        }
+    };
+
+    //*****************************
+    //*        Symbol pool        *
+    //****************************/
+
+    /// Interned values of one kind of symbol with their reference counts. A value is stored once while it is
+    /// referenced, and its slot is reused after the last reference is released. The ID 0 is the default value and
+    /// is never released. Values are looked up by hash in a map guarded by the lock of the pool. Each thread also
+    /// remembers the IDs it interned, so interning a value again only checks that the remembered slot still holds an
+    /// equal value, without locking.
+    /// \tparam T The type of the values.
+    /// \tparam Traits Provides the Hash and Equal functions of the values.
+    template<typename T, typename Traits> class SymbolPool
+    {
+    private:
+        /// A value with its reference count. A slot is live while it is in the map, even if it has no references
+        /// while its last owner is releasing it.
+        struct Slot
+        {
+            T value{};
+            size_t hash = 0;
+            std::atomic<uint32_t> references{ 0 };
+            bool live = false;
+        };
+
+        /// Maximum number of IDs remembered by each thread.
+        static constexpr size_t MaxCachedIDs = 4096;
+
+        mutable std::mutex _mutex;
+        StableStorage<Slot> _slots;
+        std::unordered_multimap<size_t, SymbolID> _ids;
+        std::vector<SymbolID> _freeIDs;
+        size_t _numberOfSymbols = 0;
+
+        /// The IDs interned by the calling thread, by hash.
+        static std::unordered_map<size_t, SymbolID>& LocalIDs()
+        {
+            static thread_local std::unordered_map<size_t, SymbolID> ids;
+            return ids;
+        }
+
+        /// Adds a reference to a slot that may have none, unless it has none.
+        /// \return True if the reference was added.
+        bool TryAcquire(SymbolID id)
+        {
+            if (id == 0)
+                return true;
+
+            std::atomic<uint32_t>& references = _slots[id].references;
+            uint32_t count = references.load(std::memory_order_relaxed);
+            while (count != 0)
+            {
+                if (references.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                                     std::memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+
+        /// Stores a new value with one reference. The caller must hold the lock.
+        SymbolID Add(const T& value, size_t hash)
+        {
+            SymbolID id;
+            if (_freeIDs.empty())
+                id = _slots.Grow();
+            else
+            {
+                id = _freeIDs.back();
+                _freeIDs.pop_back();
+            }
+
+            Slot& slot = _slots[id];
+            slot.value = value;
+            slot.hash = hash;
+            slot.live = true;
+            _ids.emplace(hash, id);
+            _numberOfSymbols++;
+            slot.references.store(1, std::memory_order_release);
+            return id;
+        }
+
+        /// Gets a reference to the live value with the given hash that satisfies a predicate, storing the value if
+        /// there is none. A value chosen among many gets the lowest ID. The caller must hold the lock.
+        template<typename Predicate> SymbolID FindOrAdd(const T& value, size_t hash, Predicate&& matches)
+        {
+            const auto [begin, end] = _ids.equal_range(hash);
+            SymbolID found = 0;
+            bool isFound = false;
+            for (auto it = begin; it != end; ++it)
+            {
+                if ((!isFound || it->second < found) && matches(_slots[it->second].value))
+                {
+                    found = it->second;
+                    isFound = true;
+                }
+            }
+
+            if (!isFound)
+                return Add(value, hash);
+            if (found != 0)
+                _slots[found].references.fetch_add(1, std::memory_order_relaxed);
+            return found;
+        }
+
+    public:
+        /// Creates a pool that holds the default value as ID 0.
+        SymbolPool()
+        {
+            _slots.Grow();
+            Slot& slot = _slots[0];
+            slot.hash = Traits::Hash(slot.value);
+            slot.live = true;
+            slot.references.store(1, std::memory_order_relaxed);
+            _ids.emplace(slot.hash, 0);
+        }
+
+        SymbolPool(const SymbolPool&) = delete;
+        SymbolPool& operator=(const SymbolPool&) = delete;
+
+        /// Get a reference to a value, storing it if needed. The caller owns the reference and must release it.
+        /// \param value The value.
+        /// \return The ID of the value.
+        SymbolID Intern(const T& value)
+        {
+            const size_t hash = Traits::Hash(value);
+            std::unordered_map<size_t, SymbolID>& localIDs = LocalIDs();
+            const auto local = localIDs.find(hash);
+            if (local != localIDs.end() && TryAcquire(local->second))
+            {
+                const Slot& slot = _slots[local->second];
+                if (slot.hash == hash && Traits::Equal(slot.value, value))
+                    return local->second;
+                Release(local->second);
+            }
+
+            SymbolID id;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                id = FindOrAdd(value, hash, [&value](const T& stored) { return Traits::Equal(stored, value); });
+            }
+
+            if (localIDs.size() >= MaxCachedIDs)
+                localIDs.clear();
+            localIDs[hash] = id;
+            return id;
+        }
+
+        /// Get a reference to the stored value with the lowest ID that satisfies a predicate and has the same hash
+        /// as a value, storing the value if there is none. The caller owns the reference and must release it.
+        /// \param value The value.
+        /// \param matches The predicate.
+        /// \return The ID of the chosen value.
+        template<typename Predicate> SymbolID InternMatching(const T& value, Predicate&& matches)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return FindOrAdd(value, Traits::Hash(value), matches);
+        }
+
+        /// Adds a reference to a value. The caller must already hold one.
+        void Acquire(SymbolID id)
+        {
+            if (id != 0)
+                _slots[id].references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /// Releases a reference to a value. The slot of the value is reused once it has no references.
+        void Release(SymbolID id)
+        {
+            if (id == 0)
+                return;
+
+            Slot& slot = _slots[id];
+            if (slot.references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            // Another thread may have found the value in the map and referenced it again, or may have released it
+            // first and reused the slot, before the lock was taken.
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!slot.live || slot.references.load(std::memory_order_relaxed) != 0)
+                return;
+
+            const auto [begin, end] = _ids.equal_range(slot.hash);
+            for (auto it = begin; it != end; ++it)
+            {
+                if (it->second == id)
+                {
+                    _ids.erase(it);
+                    break;
+                }
+            }
+            slot.value = T{};
+            slot.live = false;
+            _freeIDs.push_back(id);
+            _numberOfSymbols--;
+        }
+
+        /// Access the value with the specified ID. The caller must hold a reference to it.
+        [[nodiscard]]
+        const T& Get(SymbolID id) const
+        {
+            return _slots[id].value;
+        }
+
+        /// Get the number of stored values, including the default value.
+        [[nodiscard]]
+        size_t Size() const
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            return _numberOfSymbols + 1;
+        }
+    };
+
+    //*****************************
+    //*       Symbol traits       *
+    //****************************/
+
+    struct NonTerminalTraits
+    {
+        static size_t Hash(const NonTerminal& nonTerm)
+        {
+            return HashCombine(std::hash<int>()(nonTerm.id), std::hash<std::string>()(nonTerm.label));
+        }
+
+        static bool Equal(const NonTerminal& a, const NonTerminal& b)
+        {
+            return a.id == b.id && a.label == b.label;
+        }
+    };
+
+    struct TerminalTraits
+    {
+        static size_t Hash(const Terminal& term)
+        {
+            size_t hash = HashCombine(std::hash<int>()(term.id), std::hash<std::string>()(term.label));
+            for (const std::string& value : term.values)
+                hash = HashCombine(hash, std::hash<std::string>()(value));
+            return hash;
+        }
+
+        static bool Equal(const Terminal& a, const Terminal& b)
+        {
+            return a.id == b.id && a.label == b.label && a.values == b.values;
+        }
+    };
+
+    /// Rules are hashed by their definition, so the copies of a rule and the rules loaded with the same definition
+    /// share a bucket, and are equal when they also have the same identity and semantic actions.
+    struct RuleTraits
+    {
+        static size_t Hash(const ProductionRule& rule)
+        {
+            size_t hash = HashCombine(std::hash<int>()(rule.from.id), std::hash<std::string>()(rule.from.label));
+            for (const ProductionElement& element : rule.to)
+            {
+                hash = HashCombine(hash, static_cast<size_t>(element.type));
+                hash = HashCombine(hash, element.type == ProductionElementType::NonTerminal
+                                         ? std::hash<int>()(element.nonterm.id) : std::hash<int>()(element.term.id));
+            }
+            return hash;
+        }
+
+        /// Check if two rules have the same definition: the same symbols, including the values of the Terminals.
+        static bool SameDefinition(const ProductionRule& a, const ProductionRule& b)
+        {
+            if (a.from.id != b.from.id || a.from.label != b.from.label || a.to.size() != b.to.size())
+                return false;
+
+            for (size_t i = 0; i < a.to.size(); i++)
+            {
+                const ProductionElement& ea = a.to[i];
+                const ProductionElement& eb = b.to[i];
+                if (ea.type != eb.type || ea.nonterm.id != eb.nonterm.id || ea.nonterm.label != eb.nonterm.label ||
+                    ea.term.id != eb.term.id || ea.term.label != eb.term.label || ea.term.values != eb.term.values)
+                    return false;
+            }
+            return true;
+        }
+
+        static bool Equal(const ProductionRule& a, const ProductionRule& b)
+        {
+            return a.uid == b.uid &&
+                   a.semanticAction.Identity() == b.semanticAction.Identity() &&
+                   a.batchSemanticAction.Identity() == b.batchSemanticAction.Identity() &&
+                   a.bitSlicedSemanticAction.Identity() == b.bitSlicedSemanticAction.Identity() &&
+                   a.lazySemanticAction.Identity() == b.lazySemanticAction.Identity() &&
+                   SameDefinition(a, b);
+        }
+    };
+
+    struct ValueTraits
+    {
+        static size_t Hash(const std::string& value)
+        {
+            return std::hash<std::string>()(value);
+        }
+
+        static bool Equal(const std::string& a, const std::string& b)
+        {
+            return a == b;
+        }
+    };
+
+    //*****************************
+    //*       Symbol table        *
+    //****************************/
+
+    /// The kinds of symbols stored in the SymbolTable.
+    enum class SymbolKind
+    {
+        NonTerminal, Terminal, Rule, Value
+    };
+
+    /// Process-wide registry of the grammar symbols referenced by tree nodes. Nodes store compact SymbolIDs instead
+    /// of copies of their NonTerminal, Terminal, ProductionRule and terminal value. Every ID is a counted reference:
+    /// nodes acquire the IDs they store and release them when they change or are destroyed, and a symbol is removed
+    /// once it has no references, so the table only holds the symbols of the living nodes. Each kind of symbol has
+    /// its own lock, which interning only takes for symbols the calling thread did not intern recently, and lookups
+    /// are lock-free.
+    /// NonTerminals, Terminals and values are interned by structure. ProductionRules are interned by identity
+    /// (see ProductionRule::uid), as rules with the same structure may carry different semantic actions. A copy
+    /// of a rule keeps the identity of the original, so it is merged with the original while both have the same
+    /// definition and semantic actions, which get a new identity when they are assigned (see SemanticAction).
+    /// Deserialized rules have lost both their identity and their semantic actions, so they are resolved by
+    /// structure with InternRuleByStructure. The ID 0 of every kind is the empty symbol and is never removed.
+    class SymbolTable
+    {
+    private:
+        SymbolPool<NonTerminal, NonTerminalTraits> _nonTerminals;
+        SymbolPool<Terminal, TerminalTraits> _terminals;
+        SymbolPool<ProductionRule, RuleTraits> _rules;
+        SymbolPool<std::string, ValueTraits> _values;
+
+        SymbolTable() = default;
+
+    public:
+        SymbolTable(const SymbolTable&) = delete;
+        SymbolTable& operator=(const SymbolTable&) = delete;
+
+        /// Returns the global symbol table. The table is never destroyed, so nodes with static storage duration can
+        /// release their symbols at exit.
+        static SymbolTable& Instance()
+        {
+            static SymbolTable* instance = new SymbolTable();
+            return *instance;
+        }
+
+        /// Get a reference to a NonTerminal, registering it if needed.
+        SymbolID InternNonTerminal(const NonTerminal& nonTerm)
+        {
+            return _nonTerminals.Intern(nonTerm);
+        }
+
+        /// Get a reference to a Terminal, registering it if needed.
+        SymbolID InternTerminal(const Terminal& term)
+        {
+            return _terminals.Intern(term);
+        }
+
+        /// Get a reference to a ProductionRule, registering it if needed.
+        SymbolID InternRule(const ProductionRule& rule)
+        {
+            return _rules.Intern(rule);
+        }
+
+        /// Get a reference to the registered ProductionRule with the same definition and the lowest ID, registering
+        /// the rule if there is none. Used for deserialized rules, so loading the same tree many times does not grow
+        /// the table and the loaded nodes refer to the rules of the running program, with their semantic actions.
+        SymbolID InternRuleByStructure(const ProductionRule& rule)
+        {
+            return _rules.InternMatching(rule, [&rule](const ProductionRule& registered) {
+                return RuleTraits::SameDefinition(registered, rule);
+            });
+        }
+
+        /// Get a reference to a terminal value, registering it if needed.
+        SymbolID InternValue(const std::string& value)
+        {
+            return value.empty() ? 0 : _values.Intern(value);
+        }
+
+        /// Adds a reference to a symbol. The caller must already hold one.
+        /// \param kind The kind of the symbol.
+        /// \param id The ID of the symbol.
+        void Acquire(SymbolKind kind, SymbolID id)
+        {
+            switch (kind)
+            {
+                case SymbolKind::NonTerminal:
+                    return _nonTerminals.Acquire(id);
+                case SymbolKind::Terminal:
+                    return _terminals.Acquire(id);
+                case SymbolKind::Rule:
+                    return _rules.Acquire(id);
+                case SymbolKind::Value:
+                    return _values.Acquire(id);
+            }
+        }
+
+        /// Releases a reference to a symbol, removing the symbol if it was the last one.
+        /// \param kind The kind of the symbol.
+        /// \param id The ID of the symbol.
+        void Release(SymbolKind kind, SymbolID id)
+        {
+            switch (kind)
+            {
+                case SymbolKind::NonTerminal:
+                    return _nonTerminals.Release(id);
+                case SymbolKind::Terminal:
+                    return _terminals.Release(id);
+                case SymbolKind::Rule:
+                    return _rules.Release(id);
+                case SymbolKind::Value:
+                    return _values.Release(id);
+            }
+        }
+
+        /// Get the number of registered symbols of a kind, including the empty symbol.
+        [[nodiscard]]
+        size_t Size(SymbolKind kind) const
+        {
+            switch (kind)
+            {
+                case SymbolKind::NonTerminal:
+                    return _nonTerminals.Size();
+                case SymbolKind::Terminal:
+                    return _terminals.Size();
+                case SymbolKind::Rule:
+                    return _rules.Size();
+                case SymbolKind::Value:
+                default:
+                    return _values.Size();
+            }
+        }
+
+        [[nodiscard]] const NonTerminal& GetNonTerminal(SymbolID id) const { return _nonTerminals.Get(id); }
+        [[nodiscard]] const Terminal& GetTerminal(SymbolID id) const { return _terminals.Get(id); }
+        [[nodiscard]] const ProductionRule& GetRule(SymbolID id) const { return _rules.Get(id); }
+        [[nodiscard]] const std::string& GetValue(SymbolID id) const { return _values.Get(id); }
+    };
+
+    //*****************************
+    //*     Symbol reference      *
+    //****************************/
+
+    /// Counted reference to a symbol of the SymbolTable, for objects that keep pointers to a symbol without a node
+    /// that references it.
+    class SymbolReference
+    {
+    private:
+        SymbolKind _kind;
+        SymbolID _id;
+
+    public:
+        /// Adds a reference to a symbol that is already referenced, for instance by a node.
+        /// \param kind The kind of the symbol.
+        /// \param id The ID of the symbol.
+        SymbolReference(SymbolKind kind, SymbolID id) : _kind(kind), _id(id)
+        {
+            SymbolTable::Instance().Acquire(_kind, _id);
+        }
+
+        SymbolReference(const SymbolReference& other) : SymbolReference(other._kind, other._id) {}
+
+        SymbolReference(SymbolReference&& other) noexcept : _kind(other._kind), _id(other._id)
+        {
+            other._id = 0;
+        }
+
+        SymbolReference& operator=(const SymbolReference& other)
+        {
+            SymbolTable::Instance().Acquire(other._kind, other._id);
+            SymbolTable::Instance().Release(_kind, _id);
+            _kind = other._kind;
+            _id = other._id;
+            return *this;
+        }
+
+        SymbolReference& operator=(SymbolReference&& other) noexcept
+        {
+            if (this != &other)
+            {
+                SymbolTable::Instance().Release(_kind, _id);
+                _kind = other._kind;
+                _id = other._id;
+                other._id = 0;
+            }
+            return *this;
+        }
+
+        ~SymbolReference()
+        {
+            SymbolTable::Instance().Release(_kind, _id);
+        }
+
+        /// Get the ID of the referenced symbol.
+        [[nodiscard]]
+        SymbolID ID() const
+        {
+            return _id;
+        }
+    };
+}
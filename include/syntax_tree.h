@@ -5,24 +5,29 @@
 #include <queue>
 #include <functional>
 #include <map>
+#include <memory>
 #include <string>
 #include <exception>
 #include <utility>
 #include <optional>
 #include "graph.h"
+#include "tree_traversal.h"
+#include "subtree_cache.h"
 
 namespace gbgp
 {
-    /// Alias for a traversal that consists of a list of traversed nodes.
+    /// Alias for a traversal that consists of a list of traversed nodes. A traversal does not own its nodes.
     using Traversal = std::vector<TreeNode*>;
 
     /// Contains the expression tree, provides interfaces for manipulating its structure, synthesizing and evaluating
-    /// the tree.
+    /// the tree. The tree owns its nodes through the root, and every node owns its children.
     class SyntaxTree
     {
     private:
         /// Root of the tree.
-        TreeNode* _root{};
+        std::unique_ptr<TreeNode> _root;
+
+        friend class LazyEvaluationContext;
 
         /// Find the first position of a NonTerminal of type id.
         /// \param treeTraversal List of nodes traversed in DepthFirst PostOrder.
@@ -39,7 +44,7 @@ namespace gbgp
             for (size_t i = currentPosition - elementsToSynthesize; i < treeTraversal.size(); i++)
             {
                 if (treeTraversal[i]->type == NodeType::NonTerminal &&
-                    treeTraversal[i]->nonTermInstance.id == id && !vector_contains_q(avoid, i))
+                    treeTraversal[i]->GetNonTerminal().id == id && !vector_contains_q(avoid, i))
                     return i;
             }
             return std::nullopt;
@@ -59,7 +64,7 @@ namespace gbgp
         {
             for (size_t i = currentPosition - elementsToSynthesize; i < treeTraversal.size(); i++)
             {
-                if (treeTraversal[i]->type == NodeType::Terminal && treeTraversal[i]->termInstance.id == id &&
+                if (treeTraversal[i]->type == NodeType::Terminal && treeTraversal[i]->GetTerminal().id == id &&
                     !vector_contains_q(avoid, i))
                     return i;
             }
@@ -95,39 +100,240 @@ namespace gbgp
         /// <param name="depth">Current depth.</param>
         void PrintTree(std::ostream& stream, TreeNode* node, int depth) const
         {
-            for (TreeNode* n : node->children)
+            for (const auto& n : node->children)
             {
-                SyntaxTree::PrintNodeAsTree(stream, n, depth);
-                PrintTree(stream, n, depth + 1);
+                SyntaxTree::PrintNodeAsTree(stream, n.get(), depth);
+                PrintTree(stream, n.get(), depth + 1);
             }
         }
 
-        /// Internal static method to generate the Depth-First PreOrder traversal.
-        /// \param node The node.
-        /// \param isRoot Is node the root?
-        /// \return The traversal.
-        static Traversal GetPreOrderTreeTraversal(TreeNode* node, bool isRoot)
+        /// A NonTerminal waiting in the explicit stack of an evaluation or synthesis.
+        struct PendingNode
         {
-            /*
-              Algorithm Preorder(tree)
-              1. Visit the root.
-              2. Traverse the left subtree, i.e., call Preorder(left-subtree)
-              3. Traverse the right subtree, i.e., call Preorder(right-subtree)
-            */
-            // TODO: Replace recursive implementation with iterative.
-            Traversal output;
+            /// The node.
+            TreeNode* node;
+
+            /// Whether the children of the node were already pushed.
+            bool expanded;
+        };
+
+        /// Evaluates the subtree of node in a single post-order pass. The pending nodes are kept in an explicit stack,
+        /// so the depth of the tree is not limited by the call stack. The children of each node are matched
+        /// positionally against the production elements of its generator rule, so every semantic action is executed
+        /// exactly once. In incremental mode, the children whose evaluation is up to date and was made for the same
+        /// context key are not evaluated again. With a cache, the subtrees found in it are not evaluated, and the
+        /// snapshots of the evaluated subtrees are built from the snapshots of their children.
+        /// \param root The root of the subtree to evaluate. Must be a NonTerminal.
+        /// \param evaluationContext Reference to the evaluation context.
+        /// \param incremental Whether to reuse the evaluation of the children that are up to date.
+        /// \param contextKey The key of the input of the evaluation, if any. The evaluations of the nodes are tagged
+        /// with it, and it is the key of the input in the cache.
+        /// \param cache The cache of subtree values, or null.
+        static void EvaluateNode(TreeNode* root, EvaluationContext& evaluationContext, bool incremental = false,
+                                 std::optional<uint64_t> contextKey = std::nullopt, SubtreeCache* cache = nullptr)
+        {
+            std::vector<PendingNode> pending{ { root, false } };
+            std::vector<std::shared_ptr<const SubtreeSnapshot>> snapshots;
+            while (!pending.empty())
+            {
+                TreeNode* node = pending.back().node;
+                const ProductionRule& rule = node->GetGeneratorPR();
 
-            if (isRoot)
-                output.push_back(node);
+                if (!pending.back().expanded)
+                {
+                    node->ValidateChildren(rule, "expression evaluation");
+                    node->_evaluationValid = false;
+
+                    std::shared_ptr<const SubtreeSnapshot> snapshot;
+                    if (cache != nullptr && node->GetSubtreeSize() >= cache->MinimumSubtreeSize() &&
+                        cache->Find(node, *contextKey, node->expressionEvaluation, snapshot))
+                    {
+                        // The descendants keep the values of an older evaluation, maybe of another input.
+                        for (TreeNode* descendant : PreOrder(node))
+                            descendant->_evaluationValid = false;
+
+                        snapshots.push_back(std::move(snapshot));
+                        pending.pop_back();
+                        continue;
+                    }
+
+                    // The children are pushed from right to left, so they are evaluated from left to right.
+                    pending.back().expanded = true;
+                    for (auto child = node->children.rbegin(); child != node->children.rend(); ++child)
+                    {
+                        const bool reused = incremental && (*child)->_evaluationValid && (*child)->_evaluationKey == contextKey;
+                        if ((*child)->type == NodeType::NonTerminal && !reused)
+                            pending.push_back({ child->get(), false });
+                    }
+                    continue;
+                }
+
+                pending.pop_back();
+
+                evaluationContext.Prepare();
+
+                // Push to the context the values of the children, which match the production rule.
+                for (const auto& child : node->children)
+                    evaluationContext.PushSemanticValue(child->type == NodeType::NonTerminal ? child->expressionEvaluation : child->GetValue());
+
+                // Execute semantic action.
+                if (rule.semanticAction != nullptr)
+                {
+                    rule.semanticAction(evaluationContext);
+                    node->expressionEvaluation = evaluationContext.result();
+                }
+                else
+                    throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
+
+                // The descendants of a cached subtree keep older values, so cached evaluations are never up to date.
+                if (cache == nullptr)
+                {
+                    node->_evaluationValid = true;
+                    node->_evaluationKey = contextKey;
+                    continue;
+                }
+
+                // The snapshots of the NonTerminal children are on top of the stack, in order.
+                std::vector<std::shared_ptr<const SubtreeSnapshot>> children(node->children.size());
+                for (size_t i = children.size(); i-- > 0;)
+                {
+                    const TreeNode* child = node->children[i].get();
+                    if (child->type == NodeType::NonTerminal)
+                    {
+                        children[i] = std::move(snapshots.back());
+                        snapshots.pop_back();
+                    }
+                    else
+                        children[i] = std::make_shared<SubtreeSnapshot>(*child, std::vector<std::shared_ptr<const SubtreeSnapshot>>());
+                }
+                snapshots.push_back(std::make_shared<SubtreeSnapshot>(*node, std::move(children)));
 
-            for (TreeNode* n : node->children)
+                if (node->GetSubtreeSize() >= cache->MinimumSubtreeSize())
+                    cache->Insert(node, snapshots.back(), *contextKey, node->expressionEvaluation);
+            }
+        }
+
+        /// Recursive implementation. Evaluates a node with a lazy context. The NonTerminal children are only
+        /// evaluated when the semantic action asks for their value.
+        /// \param node The node to evaluate.
+        /// \param ctx Reference to the lazy evaluation context.
+        static void EvaluateLazyNode(TreeNode* node, LazyEvaluationContext& ctx)
+        {
+            const ProductionRule& rule = node->GetGeneratorPR();
+            node->ValidateChildren(rule, "expression evaluation");
+
+            // The values of the children come from earlier evaluations. They are marked as outdated, so the ones
+            // that are not needed keep an outdated value.
+            node->_evaluationValid = false;
+            for (const auto& child : node->children)
+                child->_evaluationValid = false;
+
+            TreeNode* parent = ctx._node;
+            ctx._node = node;
+            if (rule.lazySemanticAction != nullptr)
             {
-                output.push_back(n);
-                const Traversal childrenTreeNodes = GetPreOrderTreeTraversal(n, false);
-                output.insert(output.end(), childrenTreeNodes.begin(), childrenTreeNodes.end());
+                ctx.Prepare();
+                rule.lazySemanticAction(ctx);
             }
+            else
+            {
+                for (size_t i = 0; i < rule.to.size(); i++)
+                    ctx.Evaluate(static_cast<unsigned>(i));
 
-            return output;
+                ctx.Prepare();
+                for (const auto& child : node->children)
+                    ctx.PushSemanticValue(child->type == NodeType::NonTerminal ? child->expressionEvaluation : child->GetValue());
+
+                if (rule.semanticAction == nullptr)
+                    throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
+                rule.semanticAction(ctx);
+            }
+            ctx._node = parent;
+
+            node->expressionEvaluation = ctx.result();
+            node->_evaluationValid = true;
+            node->_evaluationKey = std::nullopt;
+        }
+
+        /// Evaluates a production element of the node whose lazy semantic action is running.
+        /// \param node The node whose semantic action is running.
+        /// \param index Index of the production element.
+        /// \param ctx Reference to the lazy evaluation context.
+        /// \return Reference to the value of the element.
+        static const std::string& EvaluateLazyElement(TreeNode* node, unsigned index, LazyEvaluationContext& ctx)
+        {
+            if (node == nullptr)
+                throw std::runtime_error("Production elements can only be evaluated inside a semantic action");
+
+            const ProductionRule& rule = node->GetGeneratorPR();
+            if (index >= rule.to.size())
+                throw std::runtime_error("There is no production element " + std::to_string(index) + " in rule " + rule.ToString());
+
+            // The children were validated when the evaluation of the node started.
+            TreeNode* child = node->children[index].get();
+            if (child->type == NodeType::NonTerminal)
+            {
+                if (!child->_evaluationValid)
+                    EvaluateLazyNode(child, ctx);
+                return child->expressionEvaluation;
+            }
+            return child->GetValue();
+        }
+
+        /// Calls f with the value of every terminal of the subtree, from left to right. The children of every
+        /// NonTerminal are checked against its production rule on the way.
+        /// \param node The root of the subtree.
+        /// \param f The function that receives the terminal values.
+        template<typename F> static void ForEachTerminalValue(TreeNode* node, F&& f)
+        {
+            for (const TreeNode* n : PreOrder(node))
+            {
+                if (n->type == NodeType::Terminal)
+                    f(n->GetValue());
+                else
+                    n->ValidateChildren(n->GetGeneratorPR(), "synthesis");
+            }
+        }
+
+        /// Synthesizes the subtree of node and stores the result of every NonTerminal in its expressionSynthesis.
+        /// The subtrees whose synthesis is up to date are not synthesized again. The pending nodes are kept in an
+        /// explicit stack, so the depth of the tree is not limited by the call stack.
+        /// \param root The root of the subtree.
+        /// \return The synthesis of root.
+        static const std::string& SynthesizeNode(TreeNode* root)
+        {
+            if (root->type == NodeType::Terminal)
+                return root->GetValue();
+
+            std::vector<PendingNode> pending;
+            if (!root->_synthesisValid)
+                pending.push_back({ root, false });
+
+            while (!pending.empty())
+            {
+                TreeNode* node = pending.back().node;
+                if (!pending.back().expanded)
+                {
+                    node->ValidateChildren(node->GetGeneratorPR(), "synthesis");
+                    pending.back().expanded = true;
+                    for (auto child = node->children.rbegin(); child != node->children.rend(); ++child)
+                    {
+                        if ((*child)->type == NodeType::NonTerminal && !(*child)->_synthesisValid)
+                            pending.push_back({ child->get(), false });
+                    }
+                    continue;
+                }
+                pending.pop_back();
+
+                std::string synthesis;
+                for (const auto& child : node->children)
+                    synthesis += child->type == NodeType::Terminal ? child->GetValue() : child->expressionSynthesis;
+
+                node->expressionSynthesis = std::move(synthesis);
+                node->_synthesisValid = true;
+            }
+
+            return root->expressionSynthesis;
         }
 
     public:
@@ -136,16 +342,13 @@ namespace gbgp
         //**************************************************/
 
         /// Creates an empty SyntaxTree.
-        SyntaxTree()
-        {
-            _root = nullptr;
-        }
+        SyntaxTree() = default;
 
-        /// Builds a tree from a root node.
+        /// Builds a tree from a root node. The tree takes ownership of the root and its descendants.
         /// \param root Pointer to the root of the tree.
         explicit SyntaxTree(TreeNode* root)
         {
-            _root = root;
+            _root.reset(root);
             _root->parent = nullptr;
             this->ClearEvaluation();
         }
@@ -154,20 +357,25 @@ namespace gbgp
         /// \param root Root of the tree.
         explicit SyntaxTree(const TreeNode& root)
         {
-            _root = new TreeNode(root);
+            _root = std::make_unique<TreeNode>(root);
             _root->parent = nullptr;
-            this->ClearEvaluation();
         }
 
         /// Copy constructor.
         /// \param other SyntaxTree to be copied.
         SyntaxTree(const SyntaxTree& other)
         {
-            _root = new TreeNode(*other._root);
-            _root->parent = nullptr;
-            this->ClearEvaluation();
+            if (other._root != nullptr)
+            {
+                _root = std::make_unique<TreeNode>(*other._root);
+                _root->parent = nullptr;
+            }
         }
 
+        /// Move constructor. Takes ownership of the nodes of the other tree, leaving it empty.
+        /// \param other SyntaxTree to be moved.
+        SyntaxTree(SyntaxTree&& other) noexcept = default;
+
         /// Graph constructor.
         /// \param graph The graph container.
         explicit SyntaxTree(const Graph& graph)
@@ -175,53 +383,45 @@ namespace gbgp
             _root = FromGraph(graph);
         }
 
-        ~SyntaxTree()
-        {
-            this->Destroy();
-        }
-
         SyntaxTree& operator=(const SyntaxTree& other)
         {
             // Self-assignment check
             if (this == &other)
                 return *this;
 
-            _root = new TreeNode(*other._root);
-            _root->parent = nullptr;
-            this->ClearEvaluation();
-
+            SyntaxTree copy(other);
+            Swap(copy);
             return *this;
         }
 
+        SyntaxTree& operator=(SyntaxTree&& other) noexcept = default;
+
+        /// Exchanges the nodes of both trees.
+        /// \param other The other tree.
+        void Swap(SyntaxTree& other) noexcept
+        {
+            std::swap(_root, other._root);
+        }
+
         /// Destroy the tree by deleting all its nodes.
         void Destroy()
         {
-            if (_root != nullptr)
-            {
-                Traversal nodeList = GetPostOrderTreeTraversal(_root);
-                for (TreeNode*& n : nodeList)
-                {
-                    if (n != nullptr)
-                    {
-                        delete n;
-                        n = nullptr;
-                    }
-                }
-                _root = nullptr;
-            }
+            _root.reset();
         }
 
-        /// Clear the expressionSynthesis and expressionEvaluation of every node.
+        /// Clear the expressionSynthesis and expressionEvaluation of every node and mark them as outdated. Not
+        /// needed after modifying the tree, as every modification outdates the nodes it affects.
         void ClearEvaluation() const
         {
-            Traversal nodeList = this->GetPostOrderTreeTraversal();
-            for (TreeNode* n : nodeList)
+            for (TreeNode* n : PostOrder())
             {
                 if (n->type == NodeType::NonTerminal)
                 {
-                    n->expressionSynthesis = "";
-                    n->expressionEvaluation = "";
+                    n->expressionSynthesis.clear();
+                    n->expressionEvaluation.clear();
                 }
+                n->_synthesisValid = false;
+                n->_evaluationValid = false;
             }
         }
 
@@ -233,9 +433,9 @@ namespace gbgp
         /// \param startRule The production rule.
         void SetRootRule(const ProductionRule& startRule)
         {
-            _root = new TreeNode(startRule.from);
+            _root = std::make_unique<TreeNode>(startRule.from);
             _root->parent = nullptr;
-            _root->generatorPR = startRule;
+            _root->SetGeneratorPR(startRule);
         }
 
         /// Check if the tree is empty.
@@ -245,12 +445,41 @@ namespace gbgp
             return _root == nullptr;
         }
 
+        /// Get the number of nodes of the tree.
+        [[nodiscard]]
+        unsigned Size() const
+        {
+            return _root ? _root->GetSubtreeSize() : 0;
+        }
+
+        /// Get the length of the longest path from the root to a leaf. A tree with a single node has height 0.
+        [[nodiscard]]
+        unsigned Height() const
+        {
+            return _root ? _root->GetSubtreeHeight() : 0;
+        }
+
+        /// Get the structural hash of the tree. Trees with the same structure, values and rules have the same hash.
+        [[nodiscard]]
+        size_t StructuralHash() const
+        {
+            return _root ? _root->GetSubtreeHash() : 0;
+        }
+
+        /// Get the modification counter of the tree. It changes whenever the tree is modified, so results derived
+        /// from the tree can be kept until it changes.
+        [[nodiscard]]
+        uint64_t ModificationCounter() const
+        {
+            return _root ? _root->GetModificationCounter() : 0;
+        }
+
         /// Returns a reference to the root.
         /// \return Pointer to the root node.
         [[nodiscard]]
         TreeNode* Root() const
         {
-            return _root;
+            return _root.get();
         }
 
         /// Return the root node instance.
@@ -260,32 +489,24 @@ namespace gbgp
             return *_root;
         }
 
-        /// Set the root node.
+        /// Set the root node, destroying the previous nodes. The tree takes ownership of the root and its descendants.
         /// \param rootNode Pointer to the root node.
         void SetRoot(TreeNode* rootNode)
         {
-            if (_root != nullptr)
-                Destroy();
+            if (rootNode == _root.get())
+                return;
 
-            _root = rootNode;
+            _root.reset(rootNode);
+            if (_root != nullptr)
+                _root->parent = nullptr;
         }
 
-        /// Removes the subtree starting from rootOfSubtree.
+        /// Removes the descendants of rootOfSubtree.
         /// \param rootOfSubtree Pointer to the root of the subtree to be deleted.
         void DeleteSubtree(TreeNode* rootOfSubtree) const
         {
-            Traversal nodeList = SyntaxTree::GetPostOrderTreeTraversal(rootOfSubtree);
-            nodeList.pop_back();
-            for (TreeNode*& n : nodeList)
-            {
-                if (n != nullptr)
-                {
-                    delete n;
-                    n = nullptr;
-                }
-            }
             rootOfSubtree->children.clear();
-            ClearEvaluation();
+            rootOfSubtree->InvalidateMetadata();
         }
 
         /// Get subtree starting from subTreeStartNode.
@@ -294,45 +515,46 @@ namespace gbgp
         [[nodiscard]]
         static SyntaxTree CopySubtree(TreeNode* subTreeStartNode)
         {
-            auto* subtreeRoot = new TreeNode(*subTreeStartNode);
-            subtreeRoot->parent = nullptr;
-            return SyntaxTree(subtreeRoot);
+            return SyntaxTree(new TreeNode(*subTreeStartNode));
         }
 
-        /// Insert a copy of the subtree into the position at insertNode.
+        /// Replace the subtree at insertNode with a copy of another subtree. The nodes of the replaced subtree,
+        /// including insertNode, are deleted.
         /// \param insertNode Node where the subtree will be inserted.
         /// \param subtreeStartNode Pointer to the subtree to copy and insert.
-        void InsertSubtree(TreeNode* insertNode, TreeNode* subtreeStartNode) const
+        void InsertSubtree(TreeNode* insertNode, TreeNode* subtreeStartNode)
         {
             // Check that both nodes are NonTerminals
             if (insertNode->type == NodeType::NonTerminal && subtreeStartNode->type == NodeType::NonTerminal)
             {
                 // Check that both nodes are of the same type.
-                if (insertNode->nonTermInstance.id == subtreeStartNode->nonTermInstance.id)
+                if (insertNode->GetNonTerminal().id == subtreeStartNode->GetNonTerminal().id)
                 {
-                    auto* copySubtreeStartNode = new TreeNode(*subtreeStartNode);
+                    auto copySubtreeStartNode = std::make_unique<TreeNode>(*subtreeStartNode);
+
+                    if (insertNode == _root.get())
+                    {
+                        _root = std::move(copySubtreeStartNode);
+                        return;
+                    }
 
                     // Find parent and replace child reference of insertNode to subtreeStartNode.
-                    bool inserted = false;
-                    for (TreeNode*& child : insertNode->parent->children)
+                    TreeNode* parent = insertNode->parent;
+                    if (parent == nullptr)
+                        throw std::runtime_error("Insert node was not found.");
+
+                    for (auto& child : parent->children)
                     {
-                        if (child == insertNode)
+                        if (child.get() == insertNode)
                         {
-                            child = copySubtreeStartNode;
-                            child->parent = insertNode->parent;
-                            inserted = true;
-                            break;
+                            copySubtreeStartNode->parent = parent;
+                            child = std::move(copySubtreeStartNode);
+                            parent->InvalidateMetadata();
+                            return;
                         }
                     }
 
-                    // Avoid memory leak if no insert node found.
-                    if (!inserted)
-                    {
-                        delete copySubtreeStartNode;
-                        throw std::runtime_error("Insert node was not found.");
-                    }
-                    else
-                        this->ClearEvaluation();
+                    throw std::runtime_error("Insert node was not found.");
                 }
                 else
                     throw std::runtime_error("Cannot insert subtree of different type of insertNode.");
@@ -340,16 +562,16 @@ namespace gbgp
             else
             {
                 if (insertNode->type != NodeType::NonTerminal)
-                    throw std::runtime_error("Cannot insert subtree in Terminal " + insertNode->termInstance.label);
+                    throw std::runtime_error("Cannot insert subtree in Terminal " + insertNode->GetTerminal().label);
                 if (subtreeStartNode->type != NodeType::NonTerminal)
-                    throw std::runtime_error("Cannot insert subtree of type Terminal " + subtreeStartNode->termInstance.label);
+                    throw std::runtime_error("Cannot insert subtree of type Terminal " + subtreeStartNode->GetTerminal().label);
             }
         }
 
         /// Insert a copy of the subtree into the position at insertNode.
         /// \param insertNode Node where the subtree will be inserted.
         /// \param subtree Reference to the subtree to copy and insert.
-        void InsertSubtree(TreeNode* insertNode, const SyntaxTree& subtree) const
+        void InsertSubtree(TreeNode* insertNode, const SyntaxTree& subtree)
         {
             InsertSubtree(insertNode, subtree.Root());
         }
@@ -361,12 +583,12 @@ namespace gbgp
         /// Prints the tree in the output stream.
         void PrintTree(std::ostream& stream = std::cout) const
         {
-            SyntaxTree::PrintNodeAsTree(stream, _root, 0);
+            SyntaxTree::PrintNodeAsTree(stream, _root.get(), 0);
 
-            for (TreeNode* n : _root->children)
+            for (const auto& n : _root->children)
             {
-                SyntaxTree::PrintNodeAsTree(stream, n, 1);
-                PrintTree(stream, n, 2);
+                SyntaxTree::PrintNodeAsTree(stream, n.get(), 1);
+                PrintTree(stream, n.get(), 2);
             }
         }
 
@@ -396,13 +618,27 @@ namespace gbgp
                 nodes.push_back(*node);
             }
 
-            // Get edges.
+            // Get edges. In pre-order, the children of a node follow it and each child follows the subtree of its
+            // previous sibling, so the children indexes are found by skipping subtree sizes.
+            std::vector<int> subtreeSizes(treeNodes.size(), 1);
+            for (int i = static_cast<int>(treeNodes.size()) - 1; i >= 0; i--)
+            {
+                int child = i + 1;
+                for (size_t c = 0; c < treeNodes[i]->children.size(); c++)
+                {
+                    subtreeSizes[i] += subtreeSizes[child];
+                    child += subtreeSizes[child];
+                }
+            }
+
+            edges.reserve(treeNodes.empty() ? 0 : treeNodes.size() - 1);
             for (int i = 0; i < static_cast<int>(treeNodes.size()); i++)
             {
-                for (int j = 0; j < static_cast<int>(treeNodes.size()); j++)
+                int child = i + 1;
+                for (size_t c = 0; c < treeNodes[i]->children.size(); c++)
                 {
-                    if (treeNodes[j]->parent == treeNodes[i])
-                        edges.emplace_back(i, j);
+                    edges.emplace_back(i, child);
+                    child += subtreeSizes[child];
                 }
             }
 
@@ -411,18 +647,18 @@ namespace gbgp
 
         /// Build syntax tree from a graph.
         /// \param graph The graph that contains the structure of the tree to be built.
-        /// \return The root node of the rebuilt tree.
-        static TreeNode* FromGraph(const Graph& graph)
+        /// \return The root node of the rebuilt tree, which owns all the other nodes.
+        static std::unique_ptr<TreeNode> FromGraph(const Graph& graph)
         {
-            std::vector<TreeNode*> treeNodes = graph.GetTreeNodes();
-            return treeNodes.front();
+            return graph.BuildTree();
         }
 
         //***************************
         //*     Tree traversals     *
         //**************************/
 
-        /// Performs a shallow copy of each node.
+        /// Performs a shallow copy of each node. The copies are not linked and must be released either by
+        /// BuildFromTraversal or by DeleteTreeTraversal.
         /// \param other The traversal of the tree to copy.
         /// \return The traversal of the copied tree.
         static Traversal CopyTreeTraversal(const Traversal& other)
@@ -434,10 +670,14 @@ namespace gbgp
             return copyNodes;
         }
 
+        /// Deletes the nodes of a traversal of unlinked or partially linked nodes. Nodes that have a parent are
+        /// owned by it, so only the roots are deleted.
+        /// \param traversal The traversal to delete.
         static void DeleteTreeTraversal(const Traversal& traversal)
         {
             for (auto node : traversal)
-                delete node;
+                if (node->parent == nullptr)
+                    delete node;
         }
 
         /// Find the index of a traversal subsequence inside another traversal.
@@ -471,8 +711,8 @@ namespace gbgp
                         const int captureID = pattern->captureID.value();
                         const auto captured = capturedValues.find(captureID);
                         if (captured == capturedValues.end())
-                            capturedValues[captureID] = actual->termValue;
-                        else if (captured->second != actual->termValue)
+                            capturedValues[captureID] = actual->GetValue();
+                        else if (captured->second != actual->GetValue())
                         {
                             matches = false;
                             break;
@@ -491,7 +731,8 @@ namespace gbgp
         /// \param traversal The traversal to perform the replacement.
         /// \param replaceFrom The source replacement sequence.
         /// \param replaceTo The target replacement sequence.
-        /// \return A new traversal with the replaced sequence.
+        /// \return A new traversal of unlinked copies with the replaced sequence. If replaceFrom is not found, the
+        /// copies are left unchanged.
         static Traversal ReplaceTraversalSubsequence(const Traversal& traversal, const Traversal& replaceFrom,
                                                      const Traversal& replaceTo)
         {
@@ -501,11 +742,10 @@ namespace gbgp
             const unsigned replaceFromLength = replaceFrom.size();
             const unsigned replaceIndex = SyntaxTree::FindIndexOfTraversalSubsequence(copyNodes, replaceFrom);
 
-            if (replaceIndex == copyNodes.size()) // No subsequence to replace. Return source traversal.
+            if (replaceIndex == copyNodes.size()) // No subsequence to replace. Return the unchanged copy.
             {
-                DeleteTreeTraversal(copyNodes);
                 DeleteTreeTraversal(replacementNodes);
-                return traversal;
+                return copyNodes;
             }
 
             // Capture terminal values from the matched source pattern.
@@ -513,7 +753,7 @@ namespace gbgp
             for (unsigned i = 0; i < replaceFromLength; i++)
             {
                 if (replaceFrom[i]->HasCaptureID())
-                    capturedValues[replaceFrom[i]->captureID.value()] = traversal[replaceIndex + i]->termValue;
+                    capturedValues[replaceFrom[i]->captureID.value()] = traversal[replaceIndex + i]->GetValue();
             }
 
             // Transfer captured values to the replacement pattern.
@@ -523,7 +763,7 @@ namespace gbgp
                 {
                     const auto captured = capturedValues.find(replacementNode->captureID.value());
                     if (captured != capturedValues.end())
-                        replacementNode->termValue = captured->second;
+                        replacementNode->SetValue(captured->second);
                 }
             }
 
@@ -536,100 +776,158 @@ namespace gbgp
             return copyNodes;
         }
 
+        /// Lazy range of the nodes of the tree in depth first pre-order.
+        [[nodiscard]]
+        PreOrderRange PreOrder() const
+        {
+            return PreOrderRange(_root.get());
+        }
+
+        /// Lazy range of the nodes of a subtree in depth first pre-order.
+        /// \param node The root of the subtree.
+        static PreOrderRange PreOrder(TreeNode* node)
+        {
+            return PreOrderRange(node);
+        }
+
+        /// Lazy range of the nodes of the tree in depth first post-order.
+        [[nodiscard]]
+        PostOrderRange PostOrder() const
+        {
+            return PostOrderRange(_root.get());
+        }
+
+        /// Lazy range of the nodes of a subtree in depth first post-order.
+        /// \param node The root of the subtree.
+        static PostOrderRange PostOrder(TreeNode* node)
+        {
+            return PostOrderRange(node);
+        }
+
+        /// Lazy range of the nodes of the tree in breadth first order.
+        [[nodiscard]]
+        BreadthFirstRange BreadthFirst() const
+        {
+            return BreadthFirstRange(_root.get());
+        }
+
+        /// Lazy range of the nodes of a subtree in breadth first order.
+        /// \param node The root of the subtree.
+        static BreadthFirstRange BreadthFirst(TreeNode* node)
+        {
+            return BreadthFirstRange(node);
+        }
+
         /// Traverses the tree in a depth first pre-order.
-        /// \param node Start node. The default value is the root of the tree.
         /// \return List of references of the traversed nodes.
         [[nodiscard]]
         Traversal GetPreOrderTreeTraversal() const
         {
-            return GetPreOrderTreeTraversal(_root);
+            return GetPreOrderTreeTraversal(_root.get());
         }
 
         /// Traverses the tree in a depth first pre-order.
-        /// \param node Start node. The default value is the root of the tree.
+        /// \param output The buffer where the traversed nodes are stored. Its previous content is discarded.
+        void GetPreOrderTreeTraversal(Traversal& output) const
+        {
+            GetPreOrderTreeTraversal(_root.get(), output);
+        }
+
+        /// Traverses a subtree in a depth first pre-order.
+        /// \param node Start node.
         /// \return List of references of the traversed nodes.
         static Traversal GetPreOrderTreeTraversal(TreeNode* node)
         {
-            return GetPreOrderTreeTraversal(node, true);
+            Traversal output;
+            GetPreOrderTreeTraversal(node, output);
+            return output;
         }
 
-        /// Traverses the tree in a depth first pre-order.
+        /// Traverses a subtree in a depth first pre-order.
+        /// \param node Start node.
+        /// \param output The buffer where the traversed nodes are stored. Its previous content is discarded.
+        static void GetPreOrderTreeTraversal(TreeNode* node, Traversal& output)
+        {
+            output.clear();
+            for (TreeNode* n : PreOrder(node))
+                output.push_back(n);
+        }
+
+        /// Traverses the tree in a depth first post-order.
         /// \return List of references of the traversed nodes.
         [[nodiscard]]
         Traversal GetPostOrderTreeTraversal() const
         {
-            return GetPostOrderTreeTraversal(_root);
+            return GetPostOrderTreeTraversal(_root.get());
         }
 
         /// Traverses the tree in a depth first post-order.
-        /// \param node Start node. The default value is the root of the tree.
+        /// \param output The buffer where the traversed nodes are stored. Its previous content is discarded.
+        void GetPostOrderTreeTraversal(Traversal& output) const
+        {
+            GetPostOrderTreeTraversal(_root.get(), output);
+        }
+
+        /// Traverses a subtree in a depth first post-order.
+        /// \param node Start node.
         /// \return List of references of the traversed nodes.
         static Traversal GetPostOrderTreeTraversal(TreeNode* node)
         {
-            /*
-              Algorithm Postorder(tree)
-              1. Traverse the left subtree, i.e., call Postorder(left-subtree)
-              2. Traverse the right subtree, i.e., call Postorder(right-subtree)
-              3. Visit the root.
-            */
-            // TODO: Replace recursive implementation with iterative.
             Traversal output;
-
-            if (node->children.empty())
-            {
-                output.push_back(node);
-                return output;
-            }
-
-            for (TreeNode* n : node->children)
-            {
-                const Traversal childrenTreeNodes = GetPostOrderTreeTraversal(n);
-                output.insert(output.end(), childrenTreeNodes.begin(), childrenTreeNodes.end());
-            }
-            output.push_back(node);
-
+            GetPostOrderTreeTraversal(node, output);
             return output;
         }
 
+        /// Traverses a subtree in a depth first post-order.
+        /// \param node Start node.
+        /// \param output The buffer where the traversed nodes are stored. Its previous content is discarded.
+        static void GetPostOrderTreeTraversal(TreeNode* node, Traversal& output)
+        {
+            output.clear();
+            for (TreeNode* n : PostOrder(node))
+                output.push_back(n);
+        }
+
         /// Traverses the tree in a breadth first order.
         /// \return List of references of the traversed nodes.
         [[nodiscard]]
         Traversal GetBreadthFirstTreeTraversal() const
         {
-            return GetBreadthFirstTreeTraversal(_root);
+            return GetBreadthFirstTreeTraversal(_root.get());
         }
 
         /// Traverses the tree in a breadth first order.
+        /// \param output The buffer where the traversed nodes are stored. Its previous content is discarded.
+        void GetBreadthFirstTreeTraversal(Traversal& output) const
+        {
+            GetBreadthFirstTreeTraversal(_root.get(), output);
+        }
+
+        /// Traverses a subtree in a breadth first order.
         /// \param node The root node.
         /// \return List of references of the traversed nodes.
         static Traversal GetBreadthFirstTreeTraversal(TreeNode* node)
         {
-            /*
-                Algorithm BFS(tree)
-                1) Create an empty queue q
-                2) temp_node = root
-                3) Loop while temp_node is not NULL
-                    a) print temp_node->data.
-                    b) Enqueue temp_nodes children (first left then right children) to q
-                    c) Dequeue a node from q.
-            */
-
             Traversal output;
-            std::queue<TreeNode*> q;
-            q.push(node);
+            GetBreadthFirstTreeTraversal(node, output);
+            return output;
+        }
 
-            while (!q.empty())
-            {
-                TreeNode* current = q.front();
-                output.push_back(current);
-                q.pop();
+        /// Traverses a subtree in a breadth first order.
+        /// \param node The root node.
+        /// \param output The buffer where the traversed nodes are stored. Its previous content is discarded.
+        static void GetBreadthFirstTreeTraversal(TreeNode* node, Traversal& output)
+        {
+            // The output doubles as the queue of the search: the nodes after the cursor are pending.
+            output.clear();
+            if (node != nullptr)
+                output.push_back(node);
 
-                for (TreeNode* n : current->children)
-                    q.push(n);
+            for (size_t i = 0; i < output.size(); i++)
+            {
+                for (const auto& child : output[i]->children)
+                    output.push_back(child.get());
             }
-
-            return output;
-
         }
 
         /// Get the string representation of a traversal.
@@ -672,8 +970,7 @@ namespace gbgp
         /// \return The root shared node if root contains search. Null otherwise.
         static TreeNode* FindSubtree(TreeNode* root, TreeNode* search)
         {
-            Traversal traversal = GetBreadthFirstTreeTraversal(root);
-            for (auto node : traversal)
+            for (TreeNode* node : BreadthFirst(root))
             {
                 if (HasSameBaseTree(node, search))
                     return node;
@@ -688,17 +985,41 @@ namespace gbgp
         /// \return True if the base trees are equal.
         static bool HasSameBaseTree(TreeNode* nodeA, TreeNode* nodeB)
         {
-            Traversal traversalA = GetBreadthFirstTreeTraversal(nodeA);
-            Traversal traversalB = GetBreadthFirstTreeTraversal(nodeB);
+            // The base tree has as many nodes as treeB, so a smaller treeA cannot contain it.
+            if (nodeA->GetSubtreeSize() < nodeB->GetSubtreeSize())
+                return false;
+
+            // Both trees are walked in lockstep, so the search stops at the first difference.
+            const BreadthFirstIterator end;
+            BreadthFirstIterator itA(nodeA);
+            for (BreadthFirstIterator itB(nodeB); itB != end; ++itA, ++itB)
+            {
+                if (itA == end || !(*itA)->SameID(**itB))
+                    return false;
+            }
+
+            return true;
+        }
 
-            for (int i = 0; i < traversalB.size(); i++)
+        /// Check if two subtrees have the same structure, values and rules. The cached sizes and hashes discard most
+        /// different subtrees without visiting their nodes.
+        /// \param nodeA The root node of the first subtree.
+        /// \param nodeB The root node of the second subtree.
+        /// \return True if the subtrees are equal.
+        static bool SameSubtree(TreeNode* nodeA, TreeNode* nodeB)
+        {
+            if (nodeA == nodeB)
+                return true;
+            if (nodeA->GetSubtreeHash() != nodeB->GetSubtreeHash() ||
+                nodeA->GetSubtreeSize() != nodeB->GetSubtreeSize())
+                return false;
+
+            // Equal hashes may still collide, so the nodes are compared in lockstep.
+            PreOrderIterator itA(nodeA);
+            for (TreeNode* node : PreOrder(nodeB))
             {
-                if (i < traversalA.size())
-                {
-                    if (!traversalA[i]->SameID(*traversalB[i]))
-                        return false;
-                }
-                else
+                const TreeNode* other = *itA++;
+                if (!other->SameSymbols(*node) || other->children.size() != node->children.size())
                     return false;
             }
 
@@ -708,10 +1029,13 @@ namespace gbgp
         [[nodiscard]]
         Traversal GetTermsOfType(NodeType type) const
         {
-            Traversal traversal = GetPostOrderTreeTraversal();
-            std::vector<size_t> terminalIndexes = find_indexes_if(traversal, [type](TreeNode* node) { return node->type == type; });
-
-            return extract_elements_at_indexes(traversal, terminalIndexes);
+            Traversal output;
+            for (TreeNode* node : PostOrder())
+            {
+                if (node->type == type)
+                    output.push_back(node);
+            }
+            return output;
         }
 
         /// Find the index of the first non-synthesized non-terminal.
@@ -736,7 +1060,7 @@ namespace gbgp
                 return;
 
             TreeNode* nodeToBuild = treeTraversal[nextIndex];
-            ProductionRule rule = nodeToBuild->generatorPR;
+            const ProductionRule& rule = nodeToBuild->GetGeneratorPR();
             std::vector<size_t> toErase;
 
             for (const ProductionElement& se : rule.to)
@@ -766,13 +1090,23 @@ namespace gbgp
             delete_elements_at_indexes(treeTraversal, toErase);
         }
 
-        /// Builds a SyntaxTree from a depth first post order traversal.
+        /// Builds a SyntaxTree from a depth first post order traversal of unlinked nodes. The target tree takes
+        /// ownership of the nodes. If the tree cannot be built, the nodes are deleted.
+        /// \param targetTree The tree where the result is stored.
         /// \param treeTraversal The traversal.
-        /// \return The tree built from the traversal.
         static void BuildFromTraversal(SyntaxTree& targetTree, Traversal& treeTraversal)
         {
-            while (treeTraversal.size() > 1)
-                BuildFirst(treeTraversal);
+            try
+            {
+                while (treeTraversal.size() > 1)
+                    BuildFirst(treeTraversal);
+            }
+            catch (...)
+            {
+                DeleteTreeTraversal(treeTraversal);
+                treeTraversal.clear();
+                throw;
+            }
 
             targetTree.SetRoot(treeTraversal.back());
         }
@@ -781,166 +1115,195 @@ namespace gbgp
         //*     Tree evaluation     *
         //**************************/
 
-        /// Find the index of the first non-synthesized non-terminal.
-        /// \param treeTraversal List of nodes traversed in DepthFirst PostOrder.
-        /// \return The index if the first non-synthesized non-terminal.
+        /// Synthesizes the tree into an expression using the production rules of the grammar. The per-node
+        /// expressionSynthesis values are left untouched.
+        /// \return The synthesized expression as a std::string.
         [[nodiscard]]
-        static unsigned NextToSynthesize(Traversal& treeTraversal)
+        std::string SynthesizeExpression() const
         {
-            for (unsigned i = 0; i < treeTraversal.size(); i++)
-                if (treeTraversal[i]->type == NodeType::NonTerminal && !treeTraversal[i]->IsSynthesized())
-                    return i;
-
-            return treeTraversal.size();
+            std::string output;
+            SynthesizeExpression(output);
+            return output;
         }
 
-        /// Synthesize the first non-synthesized node and deletes the consumed nodes.
-        /// \param treeTraversal List of nodes traversed in DepthFirst PostOrder.
-        static void SynthesizeFirst(Traversal& treeTraversal)
+        /// Synthesizes the tree by appending its terminal values to output. Reusing the same buffer across calls
+        /// avoids any allocation once its capacity is large enough.
+        /// \param output The string where the expression will be appended.
+        void SynthesizeExpression(std::string& output) const
         {
-            // Get the rule of the element to be evaluated.
-            unsigned nextIndex = NextToSynthesize(treeTraversal);
-            if (nextIndex == treeTraversal.size())
-                return;
-
-            ProductionRule rule = treeTraversal[nextIndex]->generatorPR;
-            std::string synthesis;
-            std::vector<size_t> toErase;
-
-            // Process the elements of treeTraversal that match the semantic rules.
-            for (const ProductionElement& se : rule.to)
-            {
-                if (se.type == ProductionElementType::NonTerminal)
-                {
-                    const std::optional<size_t> pos = FindIndexOfNonTerm(treeTraversal, se.nonterm.id, toErase, nextIndex,
-                                                                         rule.NumberOfProductionElements());
-                    if (pos.has_value())
-                    {
-                        synthesis += treeTraversal[pos.value()]->expressionSynthesis;
-                        toErase.push_back(pos.value());
-                    }
-                    else
-                    {
-                        std::string errorReport = "Could not find any NonTerm node of type " + se.nonterm.label;
-                        errorReport += " during synthesis of node : " + treeTraversal[nextIndex]->ToString();
-                        throw std::runtime_error(errorReport);
-                    }
-                }
-                else if (se.type == ProductionElementType::Terminal)
-                {
-                    const std::optional<size_t> pos = FindIndexOfTerm(treeTraversal, se.term.id, toErase, nextIndex,
-                                                                      rule.NumberOfProductionElements());
-                    if (pos.has_value())
-                    {
-                        synthesis += treeTraversal[pos.value()]->termValue;
-                        toErase.push_back(pos.value());
-                    }
-                    else
-                        throw std::runtime_error("Could not find any Term node of type " + se.term.label + " during expressionSynthesis");
-                }
-            }
+            if (_root != nullptr && _root->HasChildren())
+                ForEachTerminalValue(_root.get(), [&output](const std::string& value) { output += value; });
+        }
 
-            // Consume and delete
-            treeTraversal[nextIndex]->expressionSynthesis = synthesis;
-            delete_elements_at_indexes(treeTraversal, toErase);
+        /// Synthesizes the tree by writing its terminal values into a stream.
+        /// \param stream The target stream.
+        void SynthesizeExpression(std::ostream& stream) const
+        {
+            if (_root != nullptr && _root->HasChildren())
+                ForEachTerminalValue(_root.get(), [&stream](const std::string& value) { stream << value; });
         }
 
-        /// Synthesizes the tree into an expression using the production rules of the grammar.
+        /// Synthesizes the tree and stores the partial synthesis of every NonTerminal in its expressionSynthesis.
+        /// Only needed when the synthesis of the intermediate nodes is inspected.
         /// \return The synthesized expression as a std::string.
         [[nodiscard]]
-        std::string SynthesizeExpression() const
+        std::string SynthesizeNodeExpressions() const
+        {
+            return _root != nullptr && _root->HasChildren() ? SynthesizeNode(_root.get()) : std::string();
+        }
+
+        /// Evaluates the tree using the semantic actions of the grammar.
+        /// \param ctx reference to the evaluation context.
+        /// \return true if expression was evaluated correctly, false if not.
+        void Evaluate(EvaluationContext& ctx) const
         {
-            Traversal treeTraversal = this->GetPostOrderTreeTraversal();
-            for (auto node : treeTraversal) node->ClearSynthesis();
+            if (_root != nullptr && _root->HasChildren())
+                EvaluateNode(_root.get(), ctx);
+        }
 
-            while (treeTraversal.size() > 1)
-                SynthesizeFirst(treeTraversal);
+        /// Evaluates the tree with a lazy context, where the semantic actions decide which production elements are
+        /// evaluated. The NonTerminals that are not needed are not evaluated and keep an outdated evaluation.
+        /// \param ctx Reference to the lazy evaluation context.
+        void Evaluate(LazyEvaluationContext& ctx) const
+        {
+            if (_root == nullptr || !_root->HasChildren())
+                return;
 
-            return treeTraversal.back()->expressionSynthesis;
+            ctx._node = nullptr;
+            EvaluateLazyNode(_root.get(), ctx);
+            ctx.result() = _root->expressionEvaluation;
         }
 
-        /// Find the index of the first non-evaluated non-terminal.
-        /// \param treeTraversal List of nodes traversed in DepthFirst PostOrder.
-        /// \return The index if the first non-evaluated non-terminal.
-        [[nodiscard]]
-        static unsigned NextToEvaluate(Traversal& treeTraversal)
+        /// Evaluates only the nodes whose evaluation is outdated, which after a modification of the tree are the
+        /// nodes on the paths from the modified nodes to the root. The other nodes reuse their expressionEvaluation,
+        /// so the context must give the same inputs as in the last evaluation of the tree. Only the values of earlier
+        /// evaluations without a context key are reused, and tree copies do not keep them.
+        /// \param ctx Reference to the evaluation context. Its result is set even if nothing was evaluated.
+        void Reevaluate(EvaluationContext& ctx) const
         {
-            for (unsigned i = 0; i < treeTraversal.size(); i++)
-                if (treeTraversal[i]->type == NodeType::NonTerminal && !treeTraversal[i]->IsEvaluated())
-                    return i;
-            return treeTraversal.size();
+            if (_root == nullptr || !_root->HasChildren())
+                return;
+
+            if (!_root->_evaluationValid || _root->_evaluationKey != std::nullopt)
+                EvaluateNode(_root.get(), ctx, true);
+            ctx.result() = _root->expressionEvaluation;
         }
 
-        /// ExternalEvaluate the first non-evaluate node and deletes the consumed nodes.
-        /// \param treeTraversal List of nodes traversed in DepthFirst PostOrder.
-        /// \param evaluationContext reference to the evaluation context.
-        static void EvaluateFirst(Traversal& treeTraversal, EvaluationContext& evaluationContext)
+        /// Evaluates the tree for the input identified by a context key. The nodes that were already evaluated for
+        /// the same key and not modified since then reuse their expressionEvaluation. Tree copies keep these values,
+        /// so the offspring of crossover and mutation only evaluate the nodes on the paths from the changed nodes to
+        /// the root. The semantic actions must depend only on their semantic values and on the input identified by
+        /// the key.
+        /// \param ctx Reference to the evaluation context. Its result is set even if nothing was evaluated.
+        /// \param contextKey The key that identifies the input of this evaluation.
+        void Evaluate(EvaluationContext& ctx, uint64_t contextKey) const
         {
-            // Get the rule of the element to be evaluated.
-            unsigned nextIndex = NextToEvaluate(treeTraversal);
-            if (nextIndex == treeTraversal.size())
+            if (_root == nullptr || !_root->HasChildren())
                 return;
 
-            ProductionRule rule = treeTraversal[nextIndex]->generatorPR;
-            std::vector<size_t> toErase;
+            if (!_root->_evaluationValid || _root->_evaluationKey != contextKey)
+                EvaluateNode(_root.get(), ctx, true, contextKey);
+            ctx.result() = _root->expressionEvaluation;
+        }
 
-            evaluationContext.Prepare();
+        /// Evaluates the tree reusing the values of the subtrees stored in a cache, and stores the values of the
+        /// evaluated subtrees in it. The semantic actions must depend only on their semantic values and on the input
+        /// identified by the context key, as the actions of the cached subtrees are not executed.
+        /// \param ctx Reference to the evaluation context. Its result is set even if the whole tree was cached.
+        /// \param cache The cache of subtree values, which can be shared by many trees and threads.
+        /// \param contextKey The key that identifies the input of this evaluation, such as a data row index.
+        void Evaluate(EvaluationContext& ctx, SubtreeCache& cache, uint64_t contextKey) const
+        {
+            if (_root != nullptr && _root->HasChildren())
+            {
+                EvaluateNode(_root.get(), ctx, false, contextKey, &cache);
+                ctx.result() = _root->expressionEvaluation;
+            }
+        }
 
-            // Push to the context the elements of treeTraversal that match the production rules.
-            for (const ProductionElement& se : rule.to)
+        /// Evaluates the tree with natively typed semantic values. The nodes are visited in post-order and the values
+        /// of the NonTerminals are kept in a stack owned by the context, so the tree is not modified and no value is
+        /// converted to a string. The result is stored in the typed result of the context.
+        /// \param ctx Reference to the typed evaluation context.
+        template<typename T> void Evaluate(TypedEvaluationContext<T>& ctx) const
+        {
+            if (_root == nullptr || !_root->HasChildren())
+                return;
+
+            std::vector<T>& stack = ctx._stack;
+            stack.clear();
+
+            for (TreeNode* node : PostOrder())
             {
-                if (se.type == ProductionElementType::NonTerminal)
-                {
-                    const std::optional<size_t> pos = FindIndexOfNonTerm(treeTraversal, se.nonterm.id, toErase, nextIndex,
-                                                                         rule.NumberOfProductionElements());
-                    if (pos.has_value())
-                    {
-                        evaluationContext.PushSemanticValue(treeTraversal[pos.value()]->expressionEvaluation);
-                        toErase.push_back(pos.value());
-                    }
-                    else
-                    {
-                        std::string errorReport = "Could not find any NonTerm node of type " + se.nonterm.label;
-                        errorReport += " during expression evaluation of node: " + treeTraversal[nextIndex]->ToString();
-                        throw std::runtime_error(errorReport);
-                    }
-                }
-                else if (se.type == ProductionElementType::Terminal)
+                if (node->type != NodeType::NonTerminal)
+                    continue;
+
+                const ProductionRule& rule = node->GetGeneratorPR();
+                node->ValidateChildren(rule, "expression evaluation");
+
+                // The values of the NonTerminal children are on top of the stack, in order.
+                size_t operands = 0;
+                for (const auto& child : node->children)
+                    operands += child->type == NodeType::NonTerminal ? 1 : 0;
+                const size_t first = stack.size() - operands;
+                size_t next = first;
+
+                ctx.Prepare();
+                for (const auto& child : node->children)
                 {
-                    const std::optional<size_t> pos = FindIndexOfTerm(treeTraversal, se.term.id, toErase, nextIndex,
-                                                                      rule.NumberOfProductionElements());
-                    if (pos.has_value() && pos != -1)
-                    {
-                        evaluationContext.PushSemanticValue(treeTraversal[pos.value()]->termValue);
-                        toErase.push_back(pos.value());
-                    }
+                    if (child->type == NodeType::NonTerminal)
+                        ctx.PushTypedSemanticValue(stack[next++]);
                     else
-                        throw std::runtime_error("Could not find any Term node of type " + se.term.label + " during expression evaluation");
+                        ctx.PushTerminalValue(child->GetValue());
                 }
-            }
+                stack.resize(first);
 
-            // Execute semantic action and delete.
-            if (rule.semanticAction != nullptr)
-            {
-                rule.semanticAction(evaluationContext);
-                treeTraversal[nextIndex]->expressionEvaluation = evaluationContext.result();
+                if (rule.semanticAction == nullptr)
+                    throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
+                rule.semanticAction(ctx);
+                stack.push_back(ctx.typedResult());
             }
-            else
-                throw std::runtime_error("There is no semantic action for rule " + rule.ToString());
-
-            delete_elements_at_indexes(treeTraversal, toErase);
         }
 
-        /// Evaluates the tree using the semantic actions of the grammar.
-        /// \param ctx reference to the evaluation context.
-        /// \return true if expression was evaluated correctly, false if not.
-        void Evaluate(EvaluationContext& ctx) const
+        /// Evaluates the tree for every row of the context at once, using the batch semantic actions of the grammar.
+        /// The nodes are visited in post-order and every semantic action runs once over whole columns. The tree is
+        /// not modified. The result is given by the GetResultColumn method of the context.
+        /// \param ctx Reference to the batch evaluation context.
+        template<typename T> void Evaluate(BasicBatchEvaluationContext<T>& ctx) const
         {
-            Traversal treeTraversal = this->GetPostOrderTreeTraversal();
-            for (auto node : treeTraversal) node->ClearEvaluation();
+            ctx.Begin();
+            if (_root == nullptr || !_root->HasChildren())
+                return;
+
+            for (TreeNode* node : PostOrder())
+            {
+                if (node->type != NodeType::NonTerminal)
+                    continue;
 
-            while (treeTraversal.size() > 1)
-                EvaluateFirst(treeTraversal, ctx);
+                const ProductionRule& rule = node->GetGeneratorPR();
+                node->ValidateChildren(rule, "expression evaluation");
+
+                size_t operands = 0;
+                for (const auto& child : node->children)
+                    operands += child->type == NodeType::NonTerminal ? 1 : 0;
+                const size_t first = ctx._stack.size() - operands;
+                size_t next = first;
+
+                ctx.Prepare();
+                for (const auto& child : node->children)
+                {
+                    if (child->type == NodeType::NonTerminal)
+                        ctx.PushStackValue(next++);
+                    else
+                        ctx.PushTerminalValue(child->GetValue());
+                }
+
+                const auto& batchSemanticAction = rule.BatchSemanticAction<T>();
+                if (batchSemanticAction == nullptr)
+                    throw std::runtime_error("There is no batch semantic action for rule " + rule.ToString());
+                batchSemanticAction(ctx);
+                ctx.FinishAction(first);
+            }
         }
 
         /// Evaluates the tree using an external evaluator.
@@ -954,4 +1317,9 @@ namespace gbgp
             return evaluator(synthesis);
         }
     };
+
+    inline const std::string& LazyEvaluationContext::Evaluate(unsigned index)
+    {
+        return SyntaxTree::EvaluateLazyElement(_node, index, *this);
+    }
 }
@@ -1,7 +1,7 @@
 #pragma once
 #include <string>
 #include <vector>
-#include "vector_ops.h"
+#include "random_stream.h"
 
 namespace gbgp
 {
@@ -66,10 +66,23 @@ namespace gbgp
         [[nodiscard]]
         std::string GetRandomValue() const
         {
-            if (values.size() == 1)
-                return values.front();
-            else
-                return *random_choice(values.begin(), values.end());
+            return GetRandomValue(random_generator());
+        }
+
+        /// Get a random value of the set of possible values.
+        /// \param random The random number generator.
+        [[nodiscard]]
+        std::string GetRandomValue(std::mt19937& random) const
+        {
+            return RandomValue(random);
+        }
+
+        /// Get a random value of the set of possible values.
+        /// \param random The random stream.
+        [[nodiscard]]
+        std::string GetRandomValue(RandomStream& random) const
+        {
+            return RandomValue(random);
         }
 
         /// Get string representation.
@@ -85,6 +98,18 @@ namespace gbgp
         {
             ar(id, label, values);
         }
+
+    private:
+        /// Get a random value of the set of possible values. A terminal with a single value does not draw a number.
+        /// \param random The random number generator.
+        template<typename RandomGenerator>
+        std::string RandomValue(RandomGenerator& random) const
+        {
+            if (values.size() == 1)
+                return values.front();
+            else
+                return *random_choice(values.begin(), values.end(), random);
+        }
     };
 
     //*****************************
@@ -1,6 +1,12 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
-#include "production_rule.h"
+#include "node_pool.h"
+#include "symbol_table.h"
 
 namespace gbgp
 {
@@ -11,109 +17,119 @@ namespace gbgp
     };
 
     /// Simple node that contains either a Terminal or NonTerminal with the ProductionRule used to create it.
-    /// This struct is intended for exporting and serialization.
+    /// The grammar symbols are not stored in the node but referenced by their ID in the SymbolTable, which makes
+    /// nodes small and cheap to copy. A node holds a reference to each of its symbols, so they stay in the table
+    /// while the node exists. This struct is intended for exporting and serialization.
     struct Node
     {
         /// Type of the node.
         NodeType type;
 
-        /// NonTerminal instance used when the node is of NonTerminal type.
-        NonTerminal nonTermInstance;
+        /// ID of the NonTerminal instance used when the node is of NonTerminal type.
+        SymbolID nonTermID;
 
-        /// Terminal instance used when the node is of Terminal type.
-        Terminal termInstance;
+        /// ID of the Terminal instance used when the node is of Terminal type.
+        SymbolID termID;
 
-        /// Production rule from which this node is part of.
-        ProductionRule generatorPR;
+        /// ID of the production rule from which this node is part of.
+        SymbolID generatorPRID;
 
-        /// Value of the terminal used when the node is of Terminal type.
-        std::string termValue;
+        /// ID of the value of the terminal used when the node is of Terminal type.
+        SymbolID termValueID;
 
         /// Empty constructor.
         Node()
         {
             type = NodeType::None;
-            termInstance = Terminal();
-            nonTermInstance = NonTerminal();
-            generatorPR = ProductionRule();
-            termValue = std::string();
+            nonTermID = 0;
+            termID = 0;
+            generatorPRID = 0;
+            termValueID = 0;
         }
 
         /// NonTerminal node constructor.
         /// \param nt The NonTerminal type.
-        explicit Node(const NonTerminal& nt)
+        explicit Node(const NonTerminal& nt) : Node()
         {
             type = NodeType::NonTerminal;
-            nonTermInstance = nt;
-            termInstance = Terminal();
-            generatorPR = ProductionRule();
-            termValue = std::string();
+            SetNonTerminal(nt);
         }
 
         /// Terminal node constructor.
         /// \param t The terminal.
-        explicit Node(const Terminal& t)
+        explicit Node(const Terminal& t) : Node()
         {
             type = NodeType::Terminal;
-            nonTermInstance = NonTerminal();
-            termInstance = t;
-            generatorPR = ProductionRule();
-            termValue = std::string();
+            SetTerminal(t);
         }
 
         /// NonTerminal node constructor with generator production rule.
         /// \param productionRule The production rule that builds this node.
         /// \param nt The NonTerminal type.
-        Node(const ProductionRule& productionRule, const NonTerminal& nt)
+        Node(const ProductionRule& productionRule, const NonTerminal& nt) : Node()
         {
             type = NodeType::NonTerminal;
-            nonTermInstance = nt;
-            termInstance = Terminal();
-            generatorPR = productionRule;
-            termValue = std::string();
+            SetNonTerminal(nt);
+            SetGeneratorPR(productionRule);
         }
 
         /// Terminal node with value constructor.
         /// \param t The terminal.
         /// \param value The value.
-        Node(const Terminal& t, const std::string& value)
+        Node(const Terminal& t, const std::string& value) : Node()
         {
             type = NodeType::Terminal;
-            nonTermInstance = NonTerminal();
-            termInstance = t;
-            termValue = value;
-            generatorPR = ProductionRule();
+            SetTerminal(t);
+            SetValue(value);
         }
 
-        /// Copy constructor.
-        /// \param other The node to be copied.
+        /// Parameter by parameter constructor.
+        Node(NodeType ptype, const NonTerminal& pNonTermInstance, const Terminal& pTermInstance,
+             const ProductionRule& pGeneratorPR, const std::string& pTermValue) : Node()
+        {
+            type = ptype;
+            SetNonTerminal(pNonTermInstance);
+            SetTerminal(pTermInstance);
+            SetGeneratorPR(pGeneratorPR);
+            SetValue(pTermValue);
+        }
+
+        /// Copy constructor. The copy shares the symbols of the other node.
         Node(const Node& other)
         {
             type = other.type;
-            nonTermInstance = other.nonTermInstance;
-            termInstance = other.termInstance;
-            generatorPR = other.generatorPR;
-            termValue = other.termValue;
+            nonTermID = other.nonTermID;
+            termID = other.termID;
+            generatorPRID = other.generatorPRID;
+            termValueID = other.termValueID;
+            AcquireSymbols();
         }
 
-        /// Parameter by parameter constructor.
-        Node(NodeType ptype, const NonTerminal& pNonTermInstance, const Terminal& pTermInstance,
-             const ProductionRule& pGeneratorPR, const std::string& pTermValue)
+        Node& operator=(const Node& other)
         {
-            type = ptype;
-            nonTermInstance = pNonTermInstance;
-            termInstance = pTermInstance;
-            generatorPR = pGeneratorPR;
-            termValue = pTermValue;
+            other.AcquireSymbols();
+            ReleaseSymbols();
+            type = other.type;
+            nonTermID = other.nonTermID;
+            termID = other.termID;
+            generatorPRID = other.generatorPRID;
+            termValueID = other.termValueID;
+            return *this;
+        }
+
+        virtual ~Node()
+        {
+            ReleaseSymbols();
         }
 
         bool operator==(const Node& other) const
         {
             const bool sameType = this->type == other.type;
-            const bool sameTerm = this->termInstance == other.termInstance;
-            const bool sameNonTerm = this->nonTermInstance == other.nonTermInstance;
-            const bool sameValue = this->termValue == other.termValue;
-            const bool sameGeneratorPR = this->generatorPR == other.generatorPR;
+            const bool sameTerm = this->termID == other.termID || this->GetTerminal() == other.GetTerminal();
+            const bool sameNonTerm = this->nonTermID == other.nonTermID || this->GetNonTerminal() == other.GetNonTerminal();
+            const bool sameValue = this->termValueID == other.termValueID;
+            const bool sameGeneratorPR = this->generatorPRID == other.generatorPRID ||
+                                         this->GetGeneratorPR() == other.GetGeneratorPR();
             return sameType && sameTerm && sameNonTerm && sameValue && sameGeneratorPR;
         }
 
@@ -122,11 +138,64 @@ namespace gbgp
             return !(*this == other);
         }
 
+        /// Returns the NonTerminal instance of the node.
+        [[nodiscard]]
+        const NonTerminal& GetNonTerminal() const
+        {
+            return SymbolTable::Instance().GetNonTerminal(nonTermID);
+        }
+
+        /// Sets the NonTerminal instance of the node.
+        void SetNonTerminal(const NonTerminal& nt)
+        {
+            ReplaceSymbol(SymbolKind::NonTerminal, nonTermID, SymbolTable::Instance().InternNonTerminal(nt));
+        }
+
+        /// Returns the Terminal instance of the node.
+        [[nodiscard]]
+        const Terminal& GetTerminal() const
+        {
+            return SymbolTable::Instance().GetTerminal(termID);
+        }
+
+        /// Sets the Terminal instance of the node.
+        void SetTerminal(const Terminal& t)
+        {
+            ReplaceSymbol(SymbolKind::Terminal, termID, SymbolTable::Instance().InternTerminal(t));
+        }
+
+        /// Returns the production rule from which this node is part of.
+        [[nodiscard]]
+        const ProductionRule& GetGeneratorPR() const
+        {
+            return SymbolTable::Instance().GetRule(generatorPRID);
+        }
+
+        /// Sets the production rule from which this node is part of.
+        void SetGeneratorPR(const ProductionRule& productionRule)
+        {
+            ReplaceSymbol(SymbolKind::Rule, generatorPRID, SymbolTable::Instance().InternRule(productionRule));
+        }
+
+        /// Sets the production rule of a deserialized node. Serialized rules lose their identity and semantic
+        /// actions, so the node refers to the first registered rule with the same definition instead of a new copy.
+        /// Grammar::RestoreSemanticAction can then point it to a specific rule of a grammar.
+        void SetDeserializedGeneratorPR(const ProductionRule& productionRule)
+        {
+            ReplaceSymbol(SymbolKind::Rule, generatorPRID, SymbolTable::Instance().InternRuleByStructure(productionRule));
+        }
+
         /// Returns the value of the node.
         [[nodiscard]]
-        std::string GetValue() const
+        const std::string& GetValue() const
         {
-            return termValue;
+            return SymbolTable::Instance().GetValue(termValueID);
+        }
+
+        /// Sets the value of the node.
+        void SetValue(const std::string& value)
+        {
+            ReplaceSymbol(SymbolKind::Value, termValueID, SymbolTable::Instance().InternValue(value));
         }
 
         /// Returns a formatted label of the node.
@@ -134,8 +203,8 @@ namespace gbgp
         std::string GetLabel() const
         {
             return (type == NodeType::NonTerminal) ?
-                   nonTermInstance.label :
-                   termInstance.label + " [" + termValue + "]";
+                   GetNonTerminal().label :
+                   GetTerminal().label + " [" + GetValue() + "]";
         }
 
         /// Check if both nodes have the same term ID.
@@ -149,13 +218,25 @@ namespace gbgp
                 return false;
 
             if (type == NodeType::NonTerminal)
-                return this->nonTermInstance == other.nonTermInstance;
+                return this->GetNonTerminal() == other.GetNonTerminal();
             else if (type == NodeType::Terminal)
-                return this->termInstance == other.termInstance;
+                return this->GetTerminal() == other.GetTerminal();
             else
                 return false;
         }
 
+        /// Check if both nodes have the same symbols and value. NonTerminals must also come from the same production
+        /// rule, as it gives their semantic action.
+        /// \param other The other node.
+        /// \return Whether the nodes are interchangeable in a tree.
+        [[nodiscard]]
+        bool SameSymbols(const Node& other) const
+        {
+            return type == other.type && nonTermID == other.nonTermID && termID == other.termID &&
+                   termValueID == other.termValueID &&
+                   (type != NodeType::NonTerminal || generatorPRID == other.generatorPRID);
+        }
+
         [[nodiscard]]
         virtual std::string GetTypeString() const
         {
@@ -175,24 +256,122 @@ namespace gbgp
         virtual std::string ToString() const
         {
             return "Node(type=" + GetTypeString() + ", label=" + GetLabel() + ", generatorPR="
-                   + generatorPR.ToString() + ")";
+                   + GetGeneratorPR().ToString() + ")";
+        }
+
+        /// Serialization hook. The symbols are stored by value, as IDs are only valid within the running process.
+        template<class Archive> void save(Archive& ar) const
+        {
+            ar(type, GetNonTerminal(), GetTerminal(), GetGeneratorPR(), GetValue());
         }
 
-        /// Serialization hook.
-        template<class Archive> void serialize(Archive& ar)
+        /// Deserialization hook.
+        template<class Archive> void load(Archive& ar)
         {
+            NonTerminal nonTermInstance;
+            Terminal termInstance;
+            ProductionRule generatorPR;
+            std::string termValue;
             ar(type, nonTermInstance, termInstance, generatorPR, termValue);
+
+            SetNonTerminal(nonTermInstance);
+            SetTerminal(termInstance);
+            SetDeserializedGeneratorPR(generatorPR);
+            SetValue(termValue);
+        }
+
+    protected:
+        /// Called by the setters after the symbols, value or rule of the node change, also when they are called
+        /// through a reference to a Node. Nodes that keep values derived from them override it to discard them.
+        virtual void OnSymbolsChanged() {}
+
+    private:
+        /// Adds a reference to every symbol of the node.
+        void AcquireSymbols() const
+        {
+            SymbolTable& table = SymbolTable::Instance();
+            table.Acquire(SymbolKind::NonTerminal, nonTermID);
+            table.Acquire(SymbolKind::Terminal, termID);
+            table.Acquire(SymbolKind::Rule, generatorPRID);
+            table.Acquire(SymbolKind::Value, termValueID);
+        }
+
+        /// Releases the references to the symbols of the node.
+        void ReleaseSymbols() const
+        {
+            SymbolTable& table = SymbolTable::Instance();
+            table.Release(SymbolKind::NonTerminal, nonTermID);
+            table.Release(SymbolKind::Terminal, termID);
+            table.Release(SymbolKind::Rule, generatorPRID);
+            table.Release(SymbolKind::Value, termValueID);
+        }
+
+        /// Replaces a symbol of the node with a newly interned one, releasing the previous symbol.
+        /// \param kind The kind of the symbol.
+        /// \param id The ID field of the symbol.
+        /// \param interned The reference to the new symbol, owned by the node from now on.
+        void ReplaceSymbol(SymbolKind kind, SymbolID& id, SymbolID interned)
+        {
+            SymbolTable::Instance().Release(kind, id);
+            id = interned;
+            OnSymbolsChanged();
         }
     };
 
+
+    /// Checks that the children of a node match the production elements of its generator rule: one child per
+    /// element, a NonTerminal of the same type for every NonTerminal element and a Terminal of the same type for
+    /// every Terminal element. Throws a runtime_error at the first mismatch.
+    /// \param node The node.
+    /// \param rule The generator rule of the node.
+    /// \param children The children of the node.
+    /// \param childNode Gets the Node of a child.
+    /// \param operation The name of the operation that needs the check, used in the error messages.
+    template<typename Children, typename ChildNode>
+    void ValidateChildren(const Node& node, const ProductionRule& rule, const Children& children, ChildNode&& childNode,
+                          const char* operation)
+    {
+        if (children.size() != rule.to.size())
+        {
+            std::string errorReport = "Number of children does not match the production rule " + rule.ToString();
+            errorReport += std::string(" during ") + operation + " of node: " + node.ToString();
+            throw std::runtime_error(errorReport);
+        }
+
+        for (size_t i = 0; i < rule.to.size(); i++)
+        {
+            const ProductionElement& se = rule.to[i];
+            const Node& child = childNode(children[i]);
+
+            if (se.type == ProductionElementType::NonTerminal)
+            {
+                if (child.type != NodeType::NonTerminal || child.GetNonTerminal().id != se.nonterm.id)
+                {
+                    std::string errorReport = "Could not find any NonTerm node of type " + se.nonterm.label;
+                    errorReport += std::string(" during ") + operation + " of node: " + node.ToString();
+                    throw std::runtime_error(errorReport);
+                }
+            }
+            else if (child.type != NodeType::Terminal || child.GetTerminal().id != se.term.id)
+                throw std::runtime_error("Could not find any Term node of type " + se.term.label + " during " + operation);
+        }
+    }
+
     /// Represents a node of an n-ary tree. This struct is not serializable.
+    /// A node owns its children: destroying a node releases its whole subtree.
+    /// Each node caches the size, height and structural hash of its subtree. Modifications through the methods of
+    /// the node, including the Node setters called through a Node reference, invalidate the cache of the node and of
+    /// its ancestors, and the values are recomputed on demand, only
+    /// for the invalidated part of the tree. The same modifications mark the stored synthesis and evaluation of the
+    /// node and of its ancestors as outdated, so they can be recomputed only along the changed paths. Code that edits
+    /// children directly must call InvalidateMetadata.
     struct TreeNode final : Node
     {
         /// Parent of the node. If the node is a root, its value will be null.
         TreeNode* parent;
 
-        /// List of references to the children of this node.
-        std::vector<TreeNode*> children;
+        /// Children of this node, owned by it.
+        std::vector<std::unique_ptr<TreeNode>> children;
 
         /// Result of the synthesis of this node.
         std::string expressionSynthesis;
@@ -203,6 +382,123 @@ namespace gbgp
         /// Capture ID for copying terminals on prune rules.
         std::optional<int> captureID = std::nullopt;
 
+    private:
+        /// Number of nodes of the subtree, including this node.
+        mutable unsigned _subtreeSize = 1;
+
+        /// Length of the longest path from this node to a leaf.
+        mutable unsigned _subtreeHeight = 0;
+
+        /// Merkle-style hash of the symbols, values and rules of the subtree. Equal subtrees have equal hashes.
+        mutable size_t _subtreeHash = 0;
+
+        /// Modification counter of the subtree, taken from ModificationClock when the metadata is recomputed.
+        mutable uint64_t _modificationCounter = 0;
+
+        /// Whether the cached values are up to date. If a node is invalid, so are all its ancestors.
+        mutable bool _metadataValid = false;
+
+        /// Whether expressionSynthesis and expressionEvaluation are up to date. If a node is outdated, so are all
+        /// its ancestors.
+        bool _synthesisValid = false;
+        bool _evaluationValid = false;
+
+        /// The context key of the input of expressionEvaluation, if it was evaluated for a keyed input.
+        std::optional<uint64_t> _evaluationKey;
+
+        friend class SyntaxTree;
+
+        /// Copies the capture ID, the metadata and the evaluation made for a context key of a node, but not its
+        /// children.
+        /// \param other The copied node.
+        void CopyNodeState(const TreeNode& other)
+        {
+            captureID = other.captureID;
+            _subtreeSize = other._subtreeSize;
+            _subtreeHeight = other._subtreeHeight;
+            _subtreeHash = other._subtreeHash;
+            _modificationCounter = other._modificationCounter;
+            _metadataValid = other._metadataValid;
+
+            if (other._evaluationValid && other._evaluationKey != std::nullopt)
+            {
+                expressionEvaluation = other.expressionEvaluation;
+                _evaluationValid = true;
+                _evaluationKey = other._evaluationKey;
+            }
+        }
+
+        /// Process-wide source of modification counters, so two different subtrees never get the same counter.
+        static std::atomic<uint64_t>& ModificationClock()
+        {
+            static std::atomic<uint64_t> clock{ 0 };
+            return clock;
+        }
+
+        /// Computes the metadata of this node from the metadata of its children, which must be valid.
+        /// \param modificationCounter The modification counter of the recomputed nodes.
+        void ComputeMetadata(uint64_t modificationCounter) const
+        {
+            size_t hash = HashCombine(static_cast<size_t>(type), nonTermID);
+            hash = HashCombine(hash, termID);
+            hash = HashCombine(hash, termValueID);
+            if (type == NodeType::NonTerminal)
+                hash = HashCombine(hash, generatorPRID);
+
+            _subtreeSize = 1;
+            _subtreeHeight = 0;
+            for (const auto& child : children)
+            {
+                _subtreeSize += child->_subtreeSize;
+                _subtreeHeight = std::max(_subtreeHeight, child->_subtreeHeight + 1);
+                hash = HashCombine(hash, child->_subtreeHash);
+            }
+            _subtreeHash = hash;
+            _modificationCounter = modificationCounter;
+            _metadataValid = true;
+        }
+
+        /// Recomputes the metadata of the invalid nodes of the subtree, children before parents. The walk follows
+        /// the parent links and only enters invalid subtrees, so it neither recurses nor visits valid nodes. The
+        /// recomputed nodes get a new modification counter.
+        void UpdateMetadata() const
+        {
+            const uint64_t modificationCounter = ModificationClock().fetch_add(1, std::memory_order_relaxed) + 1;
+            const TreeNode* node = this;
+            while (true)
+            {
+                const TreeNode* invalidChild = nullptr;
+                for (const auto& child : node->children)
+                {
+                    if (!child->_metadataValid)
+                    {
+                        invalidChild = child.get();
+                        break;
+                    }
+                }
+
+                if (invalidChild != nullptr)
+                {
+                    node = invalidChild;
+                    continue;
+                }
+
+                node->ComputeMetadata(modificationCounter);
+                if (node == this)
+                    break;
+                node = node->parent;
+            }
+        }
+
+        /// The symbols, value and rule of the node are part of the structural hash, and the children must be checked
+        /// against the rule, so the metadata, synthesis and evaluation of the node and of its ancestors are outdated.
+        void OnSymbolsChanged() override
+        {
+            InvalidateMetadata();
+        }
+
+    public:
+
         /// Constructor of an empty node.
         TreeNode() : Node()
         {
@@ -297,15 +593,32 @@ namespace gbgp
             parent = nullptr;
         }
 
-        /// Copy constructor that copies all linked nodes.
+        /// Copy constructor that copies all linked nodes. The evaluations made for a context key are kept, as they
+        /// describe their input. The other stored values are outdated in the copy.
         /// \param other The other node.
         TreeNode(const TreeNode& other) : Node(other)
         {
             parent = nullptr;
-            captureID = other.captureID;
+            CopyNodeState(other);
 
-            for (auto c : other.children)
-                AddChildNode(new TreeNode(*c));
+            // The nodes are copied from an explicit stack, so deep trees cannot overflow the call stack. The copies
+            // are linked directly, as their metadata is taken from the copied nodes instead of being invalidated.
+            std::vector<std::pair<const TreeNode*, TreeNode*>> pending{ { &other, this } };
+            while (!pending.empty())
+            {
+                const auto [source, target] = pending.back();
+                pending.pop_back();
+
+                target->children.reserve(source->children.size());
+                for (const auto& child : source->children)
+                {
+                    auto* copy = new TreeNode(static_cast<const Node&>(*child));
+                    copy->CopyNodeState(*child);
+                    copy->parent = target;
+                    target->children.emplace_back(copy);
+                    pending.emplace_back(child.get(), copy);
+                }
+            }
         }
 
         /// Performs a copy of the node term without children.
@@ -313,46 +626,108 @@ namespace gbgp
         /// \return A copy of the node without its children.
         static TreeNode* ShallowCopy(TreeNode* other)
         {
-            auto* copyNode = new TreeNode();
-            copyNode->type = other->type;
-            copyNode->nonTermInstance = other->nonTermInstance;
-            copyNode->termInstance = other->termInstance;
-            copyNode->generatorPR = other->generatorPR;
-            copyNode->termValue = other->termValue;
+            auto* copyNode = new TreeNode(static_cast<const Node&>(*other));
             copyNode->captureID = other->captureID;
             return copyNode;
         }
 
+        /// Tree nodes are allocated from a BlockPool instead of the general purpose allocator.
+        static void* operator new(size_t size)
+        {
+            return size == sizeof(TreeNode) ? BlockPool<sizeof(TreeNode)>::Allocate() : ::operator new(size);
+        }
+
+        /// Returns the node memory to its BlockPool.
+        static void operator delete(void* pointer, size_t size)
+        {
+            if (size == sizeof(TreeNode))
+                BlockPool<sizeof(TreeNode)>::Deallocate(pointer);
+            else
+                ::operator delete(pointer);
+        }
+
+        /// Destroys the subtree of the node. Descendants are released leaf by leaf through the parent links instead of
+        /// recursively, so deep trees cannot overflow the stack.
         ~TreeNode()
         {
-            parent = nullptr;
-            children.clear();
+            TreeNode* node = this;
+            while (true)
+            {
+                if (node->children.empty())
+                {
+                    if (node == this)
+                        break;
+
+                    // The node is the last child of its parent and has no children, so releasing it does not recurse.
+                    node = node->parent;
+                    node->children.pop_back();
+                }
+                else if (node->children.back() == nullptr)
+                    node->children.pop_back();
+                else
+                    node = node->children.back().get();
+            }
         }
 
-        /// Reset the synthesis of this node.
+        /// Returns the number of tree nodes currently alive in the process.
+        static long long GetLiveNodeCount()
+        {
+            return BlockPool<sizeof(TreeNode)>::GetLiveCount();
+        }
+
+        /// Reset the synthesis of this node, which also outdates the synthesis of its ancestors.
         void ClearSynthesis()
         {
             expressionSynthesis.clear();
+            InvalidateSynthesis();
         }
 
-        /// Check if this node has been synthesized.
+        /// Check if the synthesis of this node is up to date.
         [[nodiscard]]
         bool IsSynthesized() const
         {
-            return !expressionSynthesis.empty();
+            return _synthesisValid;
         }
 
-        /// Reset the evaluation of this node.
+        /// Reset the evaluation of this node, which also outdates the evaluation of its ancestors.
         void ClearEvaluation()
         {
             expressionEvaluation.clear();
+            InvalidateEvaluation();
         }
 
-        /// Check if this node has been evaluated.
+        /// Check if the evaluation of this node is up to date.
         [[nodiscard]]
         bool IsEvaluated() const
         {
-            return !expressionEvaluation.empty();
+            return _evaluationValid;
+        }
+
+        /// Marks the synthesis and evaluation of this node and of its ancestors as outdated. The walk stops at the
+        /// first ancestor where both are already outdated.
+        void InvalidateExpressions()
+        {
+            for (TreeNode* node = this; node != nullptr; node = node->parent)
+            {
+                if (node != this && !node->_synthesisValid && !node->_evaluationValid)
+                    break;
+                node->_synthesisValid = false;
+                node->_evaluationValid = false;
+            }
+        }
+
+        /// Marks the synthesis of this node and of its ancestors as outdated.
+        void InvalidateSynthesis()
+        {
+            for (TreeNode* node = this; node != nullptr && (node == this || node->_synthesisValid); node = node->parent)
+                node->_synthesisValid = false;
+        }
+
+        /// Marks the evaluation of this node and of its ancestors as outdated.
+        void InvalidateEvaluation()
+        {
+            for (TreeNode* node = this; node != nullptr && (node == this || node->_evaluationValid); node = node->parent)
+                node->_evaluationValid = false;
         }
 
         /// Check if this node has children.
@@ -362,12 +737,84 @@ namespace gbgp
             return !children.empty();
         }
 
-        /// Add node as a child.
+        /// Get the next child of the parent of this node.
+        /// \return The next sibling, or null if this node is the last child or a root.
+        [[nodiscard]]
+        TreeNode* NextSibling() const
+        {
+            if (parent == nullptr)
+                return nullptr;
+
+            const auto& siblings = parent->children;
+            for (size_t i = 0; i + 1 < siblings.size(); i++)
+            {
+                if (siblings[i].get() == this)
+                    return siblings[i + 1].get();
+            }
+            return nullptr;
+        }
+
+        /// Add node as a child. This node takes ownership of the child.
         /// \param node Reference to the child node.
         void AddChildNode(TreeNode* node)
         {
             node->parent = this;
-            children.push_back(node);
+            children.emplace_back(node);
+            InvalidateMetadata();
+        }
+
+        //***************************
+        //*    Subtree metadata     *
+        //**************************/
+
+        /// Marks the cached metadata of this node and of its ancestors as outdated, together with their synthesis
+        /// and evaluation. The walks stop at the first ancestor that is already invalid, so building a tree from the
+        /// root down costs O(1) per node.
+        void InvalidateMetadata()
+        {
+            for (TreeNode* node = this; node != nullptr && node->_metadataValid; node = node->parent)
+                node->_metadataValid = false;
+            InvalidateExpressions();
+        }
+
+        /// Get the number of nodes of the subtree, including this node.
+        [[nodiscard]]
+        unsigned GetSubtreeSize() const
+        {
+            if (!_metadataValid)
+                UpdateMetadata();
+            return _subtreeSize;
+        }
+
+        /// Get the length of the longest path from this node to a leaf. A leaf has height 0.
+        [[nodiscard]]
+        unsigned GetSubtreeHeight() const
+        {
+            if (!_metadataValid)
+                UpdateMetadata();
+            return _subtreeHeight;
+        }
+
+        /// Get the structural hash of the subtree. It covers the symbols, values and shape of the subtree and the
+        /// generator rules of its NonTerminals, but not the capture IDs or cached synthesis and evaluation. Subtrees
+        /// whose nodes have the same symbols have the same hash.
+        [[nodiscard]]
+        size_t GetSubtreeHash() const
+        {
+            if (!_metadataValid)
+                UpdateMetadata();
+            return _subtreeHash;
+        }
+
+        /// Get the modification counter of the subtree. Every modification of the subtree through the methods of its
+        /// nodes gives it a new counter, and copies keep the counter of the original, so an equal counter means that
+        /// the subtree has not changed.
+        [[nodiscard]]
+        uint64_t GetModificationCounter() const
+        {
+            if (!_metadataValid)
+                UpdateMetadata();
+            return _modificationCounter;
         }
 
         /// Add child NonTerminal node to the target.
@@ -405,6 +852,16 @@ namespace gbgp
             return newNode;
         }
 
+        /// Checks that the children of the node match the production elements of its generator rule.
+        /// \param rule The generator rule of the node.
+        /// \param operation The name of the operation that needs the check, used in the error messages.
+        void ValidateChildren(const ProductionRule& rule, const char* operation) const
+        {
+            gbgp::ValidateChildren(*this, rule, children, [](const std::unique_ptr<TreeNode>& child) -> const Node& {
+                return *child;
+            }, operation);
+        }
+
         /// Check if the node has a capture ID.
         [[nodiscard]]
         bool HasCaptureID() const
@@ -430,7 +887,7 @@ namespace gbgp
             output += GetLabel();
             output += " -> ";
 
-            for (auto child : children)
+            for (const auto& child : children)
                 output += child->GetLabel() + ((child == children.back()) ? "" : ", ");
 
             output += ")";
@@ -447,7 +904,7 @@ namespace gbgp
             if (!children.empty())
             {
                 output += " -> ";
-                for (auto child: children)
+                for (const auto& child : children)
                     output += child->ToStringDeep();
             }
 
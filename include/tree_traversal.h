@@ -0,0 +1,198 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "tree_node.h"
+
+namespace gbgp
+{
+    //*****************************
+    //*    Traversal iterators    *
+    //****************************/
+
+    /// Iterator over a subtree in depth first pre-order. The iterator moves through the parent links of the nodes,
+    /// so it keeps no stack and never allocates.
+    class PreOrderIterator
+    {
+    private:
+        TreeNode* _start = nullptr;
+        TreeNode* _node = nullptr;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TreeNode*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = TreeNode* const*;
+        using reference = TreeNode* const&;
+
+        /// Creates the end iterator.
+        PreOrderIterator() = default;
+
+        /// Creates an iterator positioned at the root of the subtree.
+        /// \param start The root of the subtree. Null for an empty range.
+        explicit PreOrderIterator(TreeNode* start) : _start(start), _node(start) {}
+
+        reference operator*() const { return _node; }
+        pointer operator->() const { return &_node; }
+
+        PreOrderIterator& operator++()
+        {
+            if (_node->HasChildren())
+            {
+                _node = _node->children.front().get();
+                return *this;
+            }
+
+            // Climb until an ancestor inside the subtree has a next sibling.
+            while (_node != _start)
+            {
+                if (TreeNode* sibling = _node->NextSibling())
+                {
+                    _node = sibling;
+                    return *this;
+                }
+                _node = _node->parent;
+            }
+
+            _node = nullptr;
+            return *this;
+        }
+
+        PreOrderIterator operator++(int)
+        {
+            PreOrderIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PreOrderIterator& other) const { return _node == other._node; }
+        bool operator!=(const PreOrderIterator& other) const { return _node != other._node; }
+    };
+
+    /// Iterator over a subtree in depth first post-order. The iterator moves through the parent links of the nodes,
+    /// so it keeps no stack and never allocates.
+    class PostOrderIterator
+    {
+    private:
+        TreeNode* _start = nullptr;
+        TreeNode* _node = nullptr;
+
+        /// Get the first node in post-order of the subtree of node.
+        static TreeNode* FirstLeaf(TreeNode* node)
+        {
+            while (node->HasChildren())
+                node = node->children.front().get();
+            return node;
+        }
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TreeNode*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = TreeNode* const*;
+        using reference = TreeNode* const&;
+
+        /// Creates the end iterator.
+        PostOrderIterator() = default;
+
+        /// Creates an iterator positioned at the first leaf of the subtree.
+        /// \param start The root of the subtree. Null for an empty range.
+        explicit PostOrderIterator(TreeNode* start) : _start(start), _node(start ? FirstLeaf(start) : nullptr) {}
+
+        reference operator*() const { return _node; }
+        pointer operator->() const { return &_node; }
+
+        PostOrderIterator& operator++()
+        {
+            if (_node == _start)
+                _node = nullptr;
+            else if (TreeNode* sibling = _node->NextSibling())
+                _node = FirstLeaf(sibling);
+            else
+                _node = _node->parent;
+            return *this;
+        }
+
+        PostOrderIterator operator++(int)
+        {
+            PostOrderIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const PostOrderIterator& other) const { return _node == other._node; }
+        bool operator!=(const PostOrderIterator& other) const { return _node != other._node; }
+    };
+
+    /// Iterator over a subtree in breadth first order. The pending nodes are kept in an explicit queue.
+    class BreadthFirstIterator
+    {
+    private:
+        std::vector<TreeNode*> _queue;
+        size_t _head = 0;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = TreeNode*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = TreeNode* const*;
+        using reference = TreeNode* const&;
+
+        /// Creates the end iterator.
+        BreadthFirstIterator() = default;
+
+        /// Creates an iterator positioned at the root of the subtree.
+        /// \param start The root of the subtree. Null for an empty range.
+        explicit BreadthFirstIterator(TreeNode* start)
+        {
+            if (start != nullptr)
+                _queue.push_back(start);
+        }
+
+        reference operator*() const { return _queue[_head]; }
+        pointer operator->() const { return &_queue[_head]; }
+
+        BreadthFirstIterator& operator++()
+        {
+            for (const auto& child : _queue[_head]->children)
+                _queue.push_back(child.get());
+
+            // Visited nodes are dropped once they fill half of the queue, so it stays proportional to the tree width.
+            if (++_head > 64 && 2 * _head > _queue.size())
+            {
+                _queue.erase(_queue.begin(), _queue.begin() + static_cast<std::ptrdiff_t>(_head));
+                _head = 0;
+            }
+            return *this;
+        }
+
+        bool operator==(const BreadthFirstIterator& other) const { return Current() == other.Current(); }
+        bool operator!=(const BreadthFirstIterator& other) const { return !(*this == other); }
+
+        /// Get the current node, or null if the traversal is over.
+        [[nodiscard]]
+        TreeNode* Current() const
+        {
+            return _head < _queue.size() ? _queue[_head] : nullptr;
+        }
+    };
+
+    /// Lazy range of the nodes of a subtree, visited in the order given by the iterator type.
+    template<typename Iterator> class TraversalRange
+    {
+    private:
+        TreeNode* _start;
+
+    public:
+        /// Creates the range of the subtree of start.
+        /// \param start The root of the subtree. Null for an empty range.
+        explicit TraversalRange(TreeNode* start) : _start(start) {}
+
+        [[nodiscard]] Iterator begin() const { return Iterator(_start); }
+        [[nodiscard]] Iterator end() const { return Iterator(); }
+    };
+
+    using PreOrderRange = TraversalRange<PreOrderIterator>;
+    using PostOrderRange = TraversalRange<PostOrderIterator>;
+    using BreadthFirstRange = TraversalRange<BreadthFirstIterator>;
+}
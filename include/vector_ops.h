@@ -11,7 +11,8 @@ namespace gbgp {
     /// Change this value to reproduce a different deterministic optimization run.
     inline constexpr std::mt19937::result_type RANDOM_SEED = 5489u;
 
-    /// Shared deterministic random number generator.
+    /// Shared deterministic random number generator. It must not be used from several threads at once: parallel
+    /// code draws its numbers from a RandomStream of its own instead.
     inline std::mt19937& random_generator()
     {
         static std::mt19937 generator(RANDOM_SEED);
@@ -76,10 +77,16 @@ namespace gbgp {
         return random_choice(start, end, random_generator());
     }
 
+    template<typename T, typename RandomGenerator>
+    void shuffle(std::vector<T> &data, RandomGenerator &g)
+    {
+        std::shuffle(std::begin(data), std::end(data), g);
+    }
+
     template<typename T>
     void shuffle(std::vector<T> &data)
     {
-        std::shuffle(std::begin(data), std::end(data), random_generator());
+        shuffle(data, random_generator());
     }
 
     // Source: https://stackoverflow.com/a/57616877
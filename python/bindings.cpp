@@ -79,7 +79,7 @@ PYBIND11_MODULE(gbgp, m) {
             .def(py::self == py::self)
             .def(py::self != py::self)
             .def("IsMutable", &Terminal::IsMutable, "Does this terminal have multiple possible values?")
-            .def("GetRandomValue", &Terminal::GetRandomValue, "Get a random value of the set of possible values.")
+            .def("GetRandomValue", py::overload_cast<>(&Terminal::GetRandomValue, py::const_), "Get a random value of the set of possible values.")
             .def("ToString", &Terminal::ToString, "Get the string representation.")
             .def_readwrite("id", &Terminal::id, "The term type.")
             .def_readwrite("label", &Terminal::label, "The label used visual representation and debugging.")
@@ -138,7 +138,7 @@ PYBIND11_MODULE(gbgp, m) {
             .def("SetResult", &EvaluationContext::SetResult, "Set a string result.", py::arg("s"))
             .def("SemanticValue", &EvaluationContext::SemanticValue, "Get semantic value of the associated ProductionRule at the specified index.", py::arg("index"))
             .def("GetSemanticValues", &EvaluationContext::GetSemanticValues, "Get the list of semantic values.")
-            .def("PushSemanticValue", &EvaluationContext::PushSemanticValue, "Push the evaluation result of a ProductionRule for later use inside a semantic action.", py::arg("value"))
+            .def("PushSemanticValue", py::overload_cast<const std::string&>(&EvaluationContext::PushSemanticValue), "Push the evaluation result of a ProductionRule for later use inside a semantic action.", py::arg("value"))
             .def("NumberOfSemanticValues", &EvaluationContext::NumberOfSemanticValues, "Get the total number of semantic values.")
             .def("TransferSemanticValueToResult", &EvaluationContext::TransferSemanticValueToResult, "Transfer the semantic value at the specified index to the result.", py::arg("index") = 0)
             .def("ToString", &EvaluationContext::ToString, "Get a string representation.")
@@ -148,6 +148,18 @@ PYBIND11_MODULE(gbgp, m) {
                  }
             );
 
+    py::class_<DoubleEvaluationContext, EvaluationContext>(m, "DoubleEvaluationContext", py::dynamic_attr())
+            .def(py::init<>())
+            .def("GetTypedResult", &DoubleEvaluationContext::GetTypedResult, "Get the typed result.")
+            .def("SetTypedResult", &DoubleEvaluationContext::SetTypedResult, "Set the typed result.", py::arg("value"))
+            .def("TypedSemanticValue", &DoubleEvaluationContext::TypedSemanticValue, "Get the value of the NonTerminal at the specified index of the associated ProductionRule.", py::arg("index"))
+            .def("TerminalValue", &DoubleEvaluationContext::TerminalValue, "Get the value of the Terminal at the specified index of the associated ProductionRule.", py::arg("index"))
+            .def("NumberOfTypedSemanticValues", &DoubleEvaluationContext::NumberOfTypedSemanticValues, "Get the total number of typed semantic values.");
+
+    py::class_<LazyEvaluationContext, EvaluationContext>(m, "LazyEvaluationContext", py::dynamic_attr())
+            .def(py::init<>())
+            .def("Evaluate", &LazyEvaluationContext::Evaluate, "Evaluates a production element of the rule whose semantic action is running.", py::arg("index"));
+
     py::enum_<ProductionElementType>(m, "ProductionElementType")
             .value("Unassigned", ProductionElementType::Unassigned)
             .value("NonTerminal", ProductionElementType::NonTerminal)
@@ -188,6 +200,7 @@ PYBIND11_MODULE(gbgp, m) {
             .def(py::init<>(), "Empty ProductionRule constructor.")
             .def(py::init<const NonTerminal&, const std::vector<ProductionElement>&>(), "Production rule with default semantic action.", py::arg("pfrom"), py::arg("pto"))
             .def(py::init<const NonTerminal&, const std::vector<ProductionElement>&, std::function<void(EvaluationContext&)>>(), "Production rule with custom semantic action.", py::arg("pfrom"), py::arg("pto"), py::arg("pSemanticAction"))
+            .def(py::init<const NonTerminal&, const std::vector<ProductionElement>&, std::function<void(EvaluationContext&)>, std::function<void(LazyEvaluationContext&)>>(), "Production rule with custom eager and lazy semantic actions.", py::arg("pfrom"), py::arg("pto"), py::arg("pSemanticAction"), py::arg("pLazySemanticAction"))
             .def(py::init<const NonTerminal&, const std::vector<ProductionElement>&, int>(), "Production rule with default transfer semantic action over element at index semanticTransferIndex.", py::arg("pfrom"), py::arg("pto"), py::arg("semanticTransferIndex"))
             .def(py::init(&productionRuleAlias2Args), "Python array constructor alias with two arguments.")
             .def(py::init(&productionRuleAlias3ArgsSI), "Python array constructor alias with three arguments and a semantic transfer index.")
@@ -234,7 +247,15 @@ PYBIND11_MODULE(gbgp, m) {
             .def(py::init<const ProductionRule&, const NonTerminal&>(), "NonTerminal tree node constructor with generator production rule.", py::arg("productionRule"), py::arg("nt"))
             .def(py::self == py::self)
             .def(py::self != py::self)
+            .def("GetNonTerminal", &Node::GetNonTerminal, "Returns the NonTerminal instance of the node.")
+            .def("SetNonTerminal", &Node::SetNonTerminal, "Sets the NonTerminal instance of the node.", py::arg("nt"))
+            .def("GetTerminal", &Node::GetTerminal, "Returns the Terminal instance of the node.")
+            .def("SetTerminal", &Node::SetTerminal, "Sets the Terminal instance of the node.", py::arg("t"))
+            .def("GetGeneratorPR", &Node::GetGeneratorPR, "Returns the production rule from which this node is part of.")
+            .def("SetGeneratorPR", &Node::SetGeneratorPR, "Sets the production rule from which this node is part of.", py::arg("productionRule"))
+            .def("SetDeserializedGeneratorPR", &Node::SetDeserializedGeneratorPR, "Sets the production rule of a deserialized node, resolved by structure to a registered rule.", py::arg("productionRule"))
             .def("GetValue", &Node::GetValue, "Returns the value of the node.")
+            .def("SetValue", &Node::SetValue, "Sets the value of the node.", py::arg("value"))
             .def("GetLabel", &Node::GetLabel, "Returns a formatted label of the node.")
             .def("ToString", &Node::ToString, "Get node representation as string.")
             .def("__repr__",
@@ -247,7 +268,7 @@ PYBIND11_MODULE(gbgp, m) {
                     [](const Node& node)
                     { // __getstate__
                         /* Return a tuple that fully encodes the state of the object */
-                        return py::make_tuple(node.type, node.nonTermInstance, node.termInstance, node.generatorPR, node.termValue);
+                        return py::make_tuple(node.type, node.GetNonTerminal(), node.GetTerminal(), node.GetGeneratorPR(), node.GetValue());
                     },
                     [](const py::tuple& t)
                     { // __setstate__
@@ -260,7 +281,8 @@ PYBIND11_MODULE(gbgp, m) {
                         auto termInstance = t[2].cast<Terminal>();
                         auto generatorPR = t[3].cast<ProductionRule>();
                         auto termValue = t[4].cast<std::string>();
-                        Node node(type, nonTermInstance, termInstance, generatorPR, termValue);
+                        Node node(type, nonTermInstance, termInstance, ProductionRule(), termValue);
+                        node.SetDeserializedGeneratorPR(generatorPR);
                         return node;
                     }
             ));
@@ -280,7 +302,7 @@ PYBIND11_MODULE(gbgp, m) {
             .def("SameID", &TreeNode::SameID, "Check if both nodes have the same term ID.", py::arg("other"))
             .def("SameCaptureID", &TreeNode::SameCaptureID, "Check if both nodes have the same capture ID.", py::arg("other"))
             .def("HasCaptureID", &TreeNode::HasCaptureID, "Check if the node has a capture ID.")
-            .def("AddChildNode", &TreeNode::AddChildNode, "Add node as a child.", py::arg("node"))
+            .def("AddChildNode", [](TreeNode& treeNode, const TreeNode& node) { treeNode.AddChildNode(new TreeNode(node)); }, "Add a copy of the node as a child.", py::arg("node"))
             .def("AddChildTerm", py::overload_cast<const NonTerminal&, const ProductionRule&>(&TreeNode::AddChildTerm), py::return_value_policy::reference, "Add child NonTerminal node to the target.", py::arg("nonTerm"), py::arg("generatorPR"))
             .def("AddChildTerm", py::overload_cast<const Terminal&>(&TreeNode::AddChildTerm), py::return_value_policy::reference, "Add child Terminal node to the target. If the Terminal has only one possible value, sets it as the termValue.", py::arg("term"))
             .def("AddChildTerm", py::overload_cast<const Terminal&, const std::string&>(&TreeNode::AddChildTerm), py::return_value_policy::reference, "Add child Terminal node to the target.", py::arg("term"), py::arg("ptermValue"))
@@ -289,6 +311,14 @@ PYBIND11_MODULE(gbgp, m) {
             .def("ClearEvaluation", &TreeNode::ClearEvaluation, "Reset the evaluation of this node.")
             .def("IsEvaluated", &TreeNode::IsEvaluated, "Check if this node has been evaluated.")
             .def("HasChildren", &TreeNode::HasChildren, "Check if this node has children.")
+            .def("SetNonTerminal", &TreeNode::SetNonTerminal, "Sets the NonTerminal instance of the node.", py::arg("nt"))
+            .def("SetTerminal", &TreeNode::SetTerminal, "Sets the Terminal instance of the node.", py::arg("t"))
+            .def("SetValue", &TreeNode::SetValue, "Sets the value of the node.", py::arg("value"))
+            .def("InvalidateMetadata", &TreeNode::InvalidateMetadata, "Marks the cached subtree metadata of this node and its ancestors as outdated.")
+            .def("GetSubtreeSize", &TreeNode::GetSubtreeSize, "Get the number of nodes of the subtree.")
+            .def("GetSubtreeHeight", &TreeNode::GetSubtreeHeight, "Get the length of the longest path from this node to a leaf.")
+            .def("GetSubtreeHash", &TreeNode::GetSubtreeHash, "Get the structural hash of the subtree.")
+            .def("GetModificationCounter", &TreeNode::GetModificationCounter, "Get the modification counter of the subtree.")
             .def("ToString", &TreeNode::ToString, "Get tree node representation as string.")
             .def("__repr__",
                  [](const TreeNode& treeNode)
@@ -304,7 +334,7 @@ PYBIND11_MODULE(gbgp, m) {
             .def("GetNodeIndexes", &Graph::GetNodeIndexes, "Get the indexes of the nodes.")
             .def("GetEdges", &Graph::GetEdges, "Getter for the edges.")
             .def("GetLabels", &Graph::GetLabels, "Get the labels as a map.")
-            .def("GetTreeNodes", &Graph::GetTreeNodes, "Rebuild the TreeNode pointer chain from this graph.")
+            .def("BuildTree", &Graph::BuildTree, "Rebuild the TreeNode pointer chain from this graph.")
             .def("ToString", &Graph::ToString, "Get string representation.")
             .def("__repr__",
                  [](const Graph& graph)
@@ -314,6 +344,34 @@ PYBIND11_MODULE(gbgp, m) {
             )
             ;
 
+    py::class_<SubtreeCache>(m, "SubtreeCache")
+            .def(py::init<size_t, size_t, size_t>(), "Creates an empty cache.", py::arg("capacity"), py::arg("minimumSubtreeSize") = 4, py::arg("numberOfShards") = 16)
+            .def("Clear", &SubtreeCache::Clear, "Removes every value.")
+            .def("ResetCounters", &SubtreeCache::ResetCounters, "Sets the hit, miss and eviction counters to zero.")
+            .def("Hits", &SubtreeCache::Hits, "Get the number of lookups that found a value.")
+            .def("Misses", &SubtreeCache::Misses, "Get the number of lookups that did not find a value.")
+            .def("Evictions", &SubtreeCache::Evictions, "Get the number of values replaced to make room for new ones.")
+            .def("HitRate", &SubtreeCache::HitRate, "Get the fraction of lookups that found a value.")
+            .def("Size", &SubtreeCache::Size, "Get the number of cached values.")
+            .def("Capacity", &SubtreeCache::Capacity, "Get the maximum number of cached values.")
+            ;
+
+    py::class_<FitnessCacheStatistics>(m, "FitnessCacheStatistics")
+            .def_readonly("hits", &FitnessCacheStatistics::hits, "Number of evaluations found in the cache.")
+            .def_readonly("misses", &FitnessCacheStatistics::misses, "Number of evaluations not found in the cache.")
+            .def("HitRate", &FitnessCacheStatistics::HitRate, "Get the fraction of evaluations that were found in the cache.")
+            ;
+
+    py::class_<FitnessCache, std::shared_ptr<FitnessCache>>(m, "FitnessCache")
+            .def(py::init<size_t, size_t>(), "Creates an empty cache.", py::arg("capacity"), py::arg("numberOfShards") = 16)
+            .def("Clear", &FitnessCache::Clear, "Removes every value.")
+            .def("ResetCounters", &FitnessCache::ResetCounters, "Sets the hit, miss and eviction counters to zero.")
+            .def("GetStatistics", &FitnessCache::GetStatistics, "Get the current hit and miss counters.")
+            .def("HitRate", &FitnessCache::HitRate, "Get the fraction of lookups that found a value.")
+            .def("Size", &FitnessCache::Size, "Get the number of cached values.")
+            .def("Capacity", &FitnessCache::Capacity, "Get the maximum number of cached values.")
+            ;
+
     py::class_<SyntaxTree>(m, "SyntaxTree")
             .def(py::init<>(), "Creates an empty SyntaxTree.")
             .def(py::init<const TreeNode&>(), "Builds a tree from a root node.", py::arg("root"))
@@ -321,19 +379,29 @@ PYBIND11_MODULE(gbgp, m) {
             .def(py::init<const Graph&>(), "Graph constructor.", py::arg("graph"))
             .def_static("CopySubtree", &SyntaxTree::CopySubtree, "Get subtree starting from subTreeStartNode.", py::arg("subTreeStartNode"))
             .def("Root", &SyntaxTree::Root, "Returns a reference to the root.", py::return_value_policy::reference)
-            .def("SetRoot", &SyntaxTree::SetRoot, "Set the root node.", py::arg("rootNode"))
+            .def("SetRoot", [](SyntaxTree& tree, const TreeNode& rootNode) { tree.SetRoot(new TreeNode(rootNode)); }, "Set a copy of the node as the root node.", py::arg("rootNode"))
             .def("GetRoot", &SyntaxTree::GetRoot, "Get the root node instance.")
             .def("DeleteSubtree", &SyntaxTree::DeleteSubtree, "Removes the subtree starting from rootOfSubtree.", py::arg("rootOfSubtree"))
-            .def("InsertSubtree", py::overload_cast<TreeNode*, TreeNode*>(&SyntaxTree::InsertSubtree, py::const_), "Insert a copy of the subtree into the position at insertNode.", py::arg("insertNode"), py::arg("subtreeStartNode"))
-            .def("InsertSubtree", py::overload_cast<TreeNode*, const SyntaxTree&>(&SyntaxTree::InsertSubtree, py::const_), "Insert a copy of the subtree into the position at insertNode.", py::arg("insertNode"), py::arg("subtree"))
+            .def("InsertSubtree", py::overload_cast<TreeNode*, TreeNode*>(&SyntaxTree::InsertSubtree), "Insert a copy of the subtree into the position at insertNode.", py::arg("insertNode"), py::arg("subtreeStartNode"))
+            .def("InsertSubtree", py::overload_cast<TreeNode*, const SyntaxTree&>(&SyntaxTree::InsertSubtree), "Insert a copy of the subtree into the position at insertNode.", py::arg("insertNode"), py::arg("subtree"))
             .def("IsEmpty", &SyntaxTree::IsEmpty, "Check if the tree is empty.")
+            .def("Size", &SyntaxTree::Size, "Get the number of nodes of the tree.")
+            .def("Height", &SyntaxTree::Height, "Get the length of the longest path from the root to a leaf.")
+            .def("StructuralHash", &SyntaxTree::StructuralHash, "Get the structural hash of the tree.")
+            .def("ModificationCounter", &SyntaxTree::ModificationCounter, "Get the modification counter of the tree.")
             .def("SetRootRule", &SyntaxTree::SetRootRule, "Set the production rule of the root node.", py::arg("startRule"))
             .def("ToString", &SyntaxTree::ToString, "Get string representation.")
             .def("ToGraph", &SyntaxTree::ToGraph, "Export the tree into a graph.")
-            .def("FromGraph", &SyntaxTree::FromGraph, "Build syntax tree from a graph.")
+            .def_static("FromGraph", &SyntaxTree::FromGraph, "Build syntax tree from a graph.", py::arg("graph"))
             .def("GetPostOrderTreeTraversal", py::overload_cast<>(&SyntaxTree::GetPostOrderTreeTraversal, py::const_), "Traverses the tree in a depth first post-order.")
-            .def("SynthesizeExpression", &SyntaxTree::SynthesizeExpression, "Synthesizes the tree into an expression using the production rules of the grammar.")
-            .def("Evaluate", &SyntaxTree::Evaluate, "Evaluates the tree using the semantic actions of the grammar.", py::arg("ctx"))
+            .def("SynthesizeExpression", py::overload_cast<>(&SyntaxTree::SynthesizeExpression, py::const_), "Synthesizes the tree into an expression using the production rules of the grammar.")
+            .def("SynthesizeNodeExpressions", &SyntaxTree::SynthesizeNodeExpressions, "Synthesizes the tree and stores the partial synthesis of every NonTerminal.")
+            .def("Evaluate", static_cast<void (SyntaxTree::*)(DoubleEvaluationContext&) const>(&SyntaxTree::Evaluate), "Evaluates the tree with natively typed semantic values.", py::arg("ctx"))
+            .def("Evaluate", py::overload_cast<LazyEvaluationContext&>(&SyntaxTree::Evaluate, py::const_), "Evaluates the tree letting the lazy semantic actions decide which production elements are evaluated.", py::arg("ctx"))
+            .def("Evaluate", py::overload_cast<EvaluationContext&>(&SyntaxTree::Evaluate, py::const_), "Evaluates the tree using the semantic actions of the grammar.", py::arg("ctx"))
+            .def("Reevaluate", &SyntaxTree::Reevaluate, "Evaluates only the nodes whose evaluation is outdated.", py::arg("ctx"))
+            .def("Evaluate", py::overload_cast<EvaluationContext&, uint64_t>(&SyntaxTree::Evaluate, py::const_), "Evaluates the tree for the input identified by a context key, reusing the nodes already evaluated for it.", py::arg("ctx"), py::arg("contextKey"))
+            .def("Evaluate", py::overload_cast<EvaluationContext&, SubtreeCache&, uint64_t>(&SyntaxTree::Evaluate, py::const_), "Evaluates the tree reusing the values of the subtrees stored in a cache.", py::arg("ctx"), py::arg("cache"), py::arg("contextKey"))
             .def("ExternalEvaluate", &SyntaxTree::ExternalEvaluate<string>, "Evaluates the tree using an external evaluator.", py::arg("evaluator"))
             .def("__repr__",
                  [](const SyntaxTree& tree)
@@ -362,7 +430,7 @@ PYBIND11_MODULE(gbgp, m) {
 
     py::class_<PruneRule>(m, "PruneRule")
             .def(py::init<const SyntaxTree&, const SyntaxTree&>(), "Constructor by SyntaxTree.")
-            .def("CanBeApplied", &PruneRule::CanBeApplied, "Does the target tree can be simplified further with this rule?", py::arg("target"))
+            .def("CanBeApplied", py::overload_cast<const SyntaxTree&>(&PruneRule::CanBeApplied, py::const_), "Does the target tree can be simplified further with this rule?", py::arg("target"))
             .def("Apply", &PruneRule::Apply, "Create a new SyntaxTree where the prune rule has been applied.")
             .def("ToString", &PruneRule::ToString, "Get string representation.")
             .def("__repr__",
@@ -388,12 +456,20 @@ PYBIND11_MODULE(gbgp, m) {
             .def("RestoreSemanticAction", py::overload_cast<ProductionRule&>(&Grammar::RestoreSemanticAction, py::const_), "Restore the appropriate semantic action of the production rule.", py::arg("target"))
             .def("RestoreSemanticAction", py::overload_cast<Node&>(&Grammar::RestoreSemanticAction, py::const_), "Restore the appropriate semantic action of the production rule.", py::arg("target"))
             .def("RestoreSemanticAction", py::overload_cast<Graph&>(&Grammar::RestoreSemanticAction, py::const_), "Restore the appropriate semantic action of the production rule.", py::arg("target"))
+            .def("SetCodeTemplate", &Grammar::SetCodeTemplate, "Sets the code template used to generate the source code of the nodes built with a production rule.", py::arg("rule"), py::arg("codeTemplate"))
+            .def("GetCodeTemplate", &Grammar::GetCodeTemplate, "Get the code template of a production rule.", py::arg("rule"))
             .def("__repr__",
                  [](const Grammar& grammar) {
                      return grammar.ToString();
                  }
             );
 
+    py::class_<CodeGenerator>(m, "CodeGenerator")
+            .def(py::init<const Grammar&, std::string, std::string, std::string>(), "Creates a code generator.", py::arg("grammar"), py::arg("returnType"), py::arg("parameters"), py::arg("preamble") = "")
+            .def("GenerateFunction", &CodeGenerator::GenerateFunction, "Generates a function that evaluates a tree.", py::arg("tree"), py::arg("functionName"))
+            .def("GenerateSource", &CodeGenerator::GenerateSource, "Generates a self-contained source file with the preamble and a function that evaluates a tree.", py::arg("tree"), py::arg("functionName"))
+            ;
+
     py::class_<Individual>(m, "Individual")
             .def(py::init<>(), "Empty constructor.")
             .def(py::init<const std::function<double(SyntaxTree&)>&>(), "Blank individual constructor.", py::arg("fitnessFunction"))
@@ -405,9 +481,12 @@ PYBIND11_MODULE(gbgp, m) {
             .def("GetExpression", &Individual::GetExpression, "Synthesizes the tree expression.")
             .def("IsEvaluated", &Individual::IsEvaluated, "Is this individual evaluated?")
             .def("GetFitness", &Individual::GetFitness, "Return the fitness value.")
-            .def("Evaluate", &Individual::Evaluate, "Evaluates the fitness function and assign the fitness value.")
+            .def("GetEvaluationTime", &Individual::GetEvaluationTime, "Get how long the last evaluation took, or None if the tree changed since then.")
+            .def("Evaluate", py::overload_cast<>(&Individual::Evaluate), "Evaluates the fitness function and assign the fitness value.")
+            .def("Evaluate", py::overload_cast<FitnessCache&>(&Individual::Evaluate), "Assigns the fitness value stored in the cache for an identical tree, or evaluates it and stores it.", py::arg("cache"))
             .def("Prune", &Individual::Prune, "Prunes the tree.", py::arg("grammar"))
-            .def("CreateRandom", &Individual::CreateRandom, "Generates a random individual using the production rules and prune rules of the grammar.", py::arg("grammar"))
+            .def("CreateRandom", py::overload_cast<const Grammar&>(&Individual::CreateRandom), "Generates a random individual using the production rules and prune rules of the grammar.", py::arg("grammar"))
+            .def("CreateRandom", py::overload_cast<const Grammar&, RandomStream&>(&Individual::CreateRandom), "Generates a random individual using the production rules and prune rules of the grammar.", py::arg("grammar"), py::arg("random"))
             .def("__repr__",
                  [](const Individual& individual) {
                      return individual.ToString();
@@ -415,24 +494,59 @@ PYBIND11_MODULE(gbgp, m) {
             )
             ;
 
+    py::class_<ExecutorStatistics>(m, "ExecutorStatistics")
+            .def_readonly("threads", &ExecutorStatistics::threads, "Number of worker threads that ran the loop.")
+            .def_readonly("tasks", &ExecutorStatistics::tasks, "Number of indexes of the loop.")
+            .def_readonly("chunks", &ExecutorStatistics::chunks, "Number of chunks of indexes the loop was split into.")
+            .def_readonly("steals", &ExecutorStatistics::steals, "Number of chunks taken from the deque of another worker.")
+            .def_readonly("makespan", &ExecutorStatistics::makespan, "Seconds from the start of the loop until its last index finished.")
+            .def_readonly("busyTime", &ExecutorStatistics::busyTime, "Seconds the workers spent running the loop.")
+            .def_readonly("idleTime", &ExecutorStatistics::idleTime, "Seconds the workers spent without a task of the loop before it finished.")
+            .def("IdleFraction", &ExecutorStatistics::IdleFraction, "Get the fraction of the available worker time that was wasted.")
+            ;
+
+    py::enum_<SchedulingPolicy>(m, "SchedulingPolicy")
+            .value("PopulationOrder", SchedulingPolicy::PopulationOrder)
+            .value("LargestTreeFirst", SchedulingPolicy::LargestTreeFirst)
+            .value("LearnedCost", SchedulingPolicy::LearnedCost);
+
+    py::class_<RandomStream>(m, "RandomStream")
+            .def(py::init<uint64_t>(), "Creates a random stream.", py::arg("seed") = RANDOM_SEED)
+            .def("__call__", &RandomStream::operator(), "Get the next number of the stream.")
+            .def("Discard", &RandomStream::Discard, "Skips numbers of the stream in constant time.", py::arg("n"))
+            .def("Split", &RandomStream::Split, "Creates an independent child stream.", py::arg("index"))
+            ;
+
+    py::class_<Executor, std::shared_ptr<Executor>>(m, "Executor")
+            .def(py::init<unsigned>(), "Creates an executor with the given number of worker threads, or one per hardware thread.", py::arg("threadCount") = 0)
+            .def("GetThreadCount", &Executor::GetThreadCount, "Get the number of worker threads.")
+            ;
+
     py::class_<Population>(m, "Population")
             .def(py::init<const Grammar&, const std::function<double(SyntaxTree&)>&>(), "Population constructor.", py::arg("grammar"), py::arg("fitnessFunction"))
 
-            .def("Initialize", &Population::Initialize, "Initializes a population of randomly generated individuals.", py::arg("populationSize"))
-            .def("AddIndividual", &Population::AddIndividual, "Add an individual to the population.", py::arg("individual"))
-            .def("AddIndividuals", &Population::AddIndividuals, "Add a collection of individuals to the population.", py::arg("newIndividuals"))
+            .def("Initialize", py::overload_cast<unsigned>(&Population::Initialize), "Initializes a population of randomly generated individuals.", py::arg("populationSize"))
+            .def("AddIndividual", py::overload_cast<const Individual&>(&Population::AddIndividual), "Add an individual to the population.", py::arg("individual"))
+            .def("AddIndividuals", py::overload_cast<const std::vector<Individual>&>(&Population::AddIndividuals), "Add a collection of individuals to the population.", py::arg("newIndividuals"))
             .def("GetIndividual", &Population::GetIndividual, "Get the individual at the n-th index.", py::arg("n"))
             .def("GetFittestByRank", &Population::GetFittestByRank, "Get the fittest individual by rank.", py::arg("rank"))
             .def("GetNthFittestByRank", &Population::GetNthFittestByRank, "Get the fittest individuals up to rank maxRank.", py::arg("maxRank"))
             .def("ReducePopulation", &Population::ReducePopulation, "Reduce the population to the selected indexes.", py::arg("keepIndexes"))
             .def("RemoveWorst", &Population::RemoveWorst, "Removes the n-th worst individuals by fitness of the population.", py::arg("maxRank"))
-            .def("Prune", &Population::Prune, "Prune all the individuals of the population.")
+            .def("Prune", py::overload_cast<>(&Population::Prune), "Prune all the individuals of the population.")
             .def("Evaluate", py::overload_cast<>(&Population::Evaluate), "Evaluate all the individuals of the population.")
             .def("GetFitness", &Population::GetFitness, "Get the fitness values of all the individuals in the population.")
             .def("GetIndividuals", &Population::GetIndividuals, "Get a reference to the individuals of the population.")
             .def("Size", &Population::Size, "Get the size of the population.")
             .def("GetGeneratingGrammar", &Population::GetGeneratingGrammar, "Grammar getter.")
             .def("GetFitnessFunction", &Population::GetFitnessFunction, "Fitness function getter.")
+            .def("SetFitnessCache", &Population::SetFitnessCache, "Set the cache used to skip the evaluation of duplicated individuals.", py::arg("fitnessCache"))
+            .def("GetFitnessCache", &Population::GetFitnessCache, "Fitness cache getter.")
+            .def("SetExecutor", &Population::SetExecutor, "Set the worker threads used in the multithread mode.", py::arg("executor"))
+            .def("GetExecutor", &Population::GetExecutor, "Executor getter.")
+            .def("SetSchedulingPolicy", &Population::SetSchedulingPolicy, "Set the order in which the individuals are evaluated in the multithread mode.", py::arg("schedulingPolicy"))
+            .def("GetSchedulingPolicy", &Population::GetSchedulingPolicy, "Scheduling policy getter.")
+            .def("GetEvaluationStatistics", &Population::GetEvaluationStatistics, "Get the makespan and idle time of the workers in the last evaluation.")
             .def("__repr__",
                  [](const Population& population) {
                      return population.ToString();
@@ -441,12 +555,15 @@ PYBIND11_MODULE(gbgp, m) {
             ;
 
     py::class_<GeneticOperators>(m, "GeneticOperators")
-            .def_static("IndividualsCrossover", &GeneticOperators::IndividualsCrossover, "Generates a new offspring individual that combines genome features from both parents.", py::arg("parent1"), py::arg("parent2"))
-            .def_static("Selection", &GeneticOperators::Selection, "The selection operator. Reduces the population to its fittest individuals.", py::arg("population"), py::arg("size"))
+            .def_static("IndividualsCrossover", py::overload_cast<Individual&, Individual&>(&GeneticOperators::IndividualsCrossover), "Generates a new offspring individual that combines genome features from both parents.", py::arg("parent1"), py::arg("parent2"))
+            .def_static("IndividualsCrossover", py::overload_cast<Individual&, Individual&, RandomStream&>(&GeneticOperators::IndividualsCrossover), "Generates a new offspring individual that combines genome features from both parents.", py::arg("parent1"), py::arg("parent2"), py::arg("random"))
+            .def_static("Selection", py::overload_cast<Population&, int>(&GeneticOperators::Selection), "The selection operator. Reduces the population to its fittest individuals.", py::arg("population"), py::arg("size"))
+            .def_static("Selection", py::overload_cast<Population&, int, RandomStream&>(&GeneticOperators::Selection), "The selection operator. Reduces the population to its fittest individuals.", py::arg("population"), py::arg("size"), py::arg("random"))
             .def_static("Crossover", py::overload_cast<Population&>(&GeneticOperators::Crossover), "The crossover operator. Creates a new generation by reproduction of the individuals.", py::arg("population"))
             .def_static("Crossover", py::overload_cast<Population&, unsigned>(&GeneticOperators::Crossover), "The crossover operator. Creates a new generation by reproduction of the individuals.", py::arg("population"), py::arg("offspringSize"))
             .def_static("MutateIndividual", py::overload_cast<Individual&, const Grammar&>(&GeneticOperators::MutateIndividual), "Mutation operator that acts over an individual with default mutation probability of 50%.", py::arg("individual"), py::arg("grammar"))
             .def_static("MutateIndividual", py::overload_cast<Individual&, const Grammar&, double>(&GeneticOperators::MutateIndividual), "Mutation operator that acts over an individual.", py::arg("individual"), py::arg("grammar"), py::arg("nonTermMutationProb"))
+            .def_static("MutateIndividual", py::overload_cast<Individual&, const Grammar&, double, RandomStream&>(&GeneticOperators::MutateIndividual), "Mutation operator that acts over an individual.", py::arg("individual"), py::arg("grammar"), py::arg("nonTermMutationProb"), py::arg("random"))
             .def_static("Mutation", py::overload_cast<Population&, double>(&GeneticOperators::Mutation), "Mutation operator that acts over a population.", py::arg("population"), py::arg("mutationProbability"))
             .def_static("Mutation", py::overload_cast<Population&, double, double>(&GeneticOperators::Mutation), "Mutation operator that acts over a population.", py::arg("population"), py::arg("mutationProbability"), py::arg("nonTermMutationProbability"))
             ;
@@ -456,10 +573,31 @@ PYBIND11_MODULE(gbgp, m) {
             .def("GetPopulation", &Environment::GetPopulation, "Population getter.")
             .def("Optimize", py::overload_cast<>(&Environment::Optimize), "Optimizes a population via genetic optimization.")
             .def("Optimize", py::overload_cast<unsigned>(&Environment::Optimize), "Optimizes a population via genetic optimization.", py::arg("generations"))
+            .def("SetFitnessCache", &Environment::SetFitnessCache, "Set the cache used to skip the evaluation of duplicated individuals.", py::arg("fitnessCache"))
+            .def("GetFitnessCacheHistory", &Environment::GetFitnessCacheHistory, "Get the hits and misses of the fitness cache in each generation.")
+            .def("SetExecutor", &Environment::SetExecutor, "Set the worker threads used in the multithread mode.", py::arg("executor"))
+            .def("GetExecutor", &Environment::GetExecutor, "Executor getter.")
+            .def("SetSchedulingPolicy", &Environment::SetSchedulingPolicy, "Set the order in which the individuals are evaluated in the multithread mode.", py::arg("schedulingPolicy"))
+            .def("GetEvaluationHistory", &Environment::GetEvaluationHistory, "Get the makespan and idle time of the evaluation of each generation.")
             .def("__repr__",
                  [](const Environment& environment) {
                      return environment.ToString();
                  }
             )
             ;
+
+    py::enum_<MigrationTopology>(m, "MigrationTopology")
+            .value("Ring", MigrationTopology::Ring)
+            .value("FullyConnected", MigrationTopology::FullyConnected)
+            .value("Random", MigrationTopology::Random);
+
+    py::class_<IslandModel>(m, "IslandModel")
+            .def(py::init<const Grammar&, const std::function<double(SyntaxTree&)>&, unsigned, int, int, int, int, double, MigrationTopology, unsigned, unsigned>(), "Island model constructor.", py::arg("grammar"), py::arg("fitnessFunction"), py::arg("islandCount"), py::arg("populationSize"), py::arg("survivorsPerGeneration"), py::arg("eliteIndividuals"), py::arg("immigrationIndividuals"), py::arg("mutationProbability"), py::arg("topology"), py::arg("migrationInterval"), py::arg("migrantCount"))
+            .def("Optimize", &IslandModel::Optimize, "Optimizes every island via genetic optimization.", py::arg("generations"))
+            .def("GetIslandCount", &IslandModel::GetIslandCount, "Get the number of islands.")
+            .def("GetIsland", &IslandModel::GetIsland, "Get the environment of an island.", py::arg("n"))
+            .def("GetFittest", &IslandModel::GetFittest, "Get the fittest individual of all the islands.")
+            .def("GetAcceptedMigrants", &IslandModel::GetAcceptedMigrants, "Get the number of migrants that joined an island.")
+            .def("GetIntervalHistory", &IslandModel::GetIntervalHistory, "Get the makespan and idle time of the workers in each interval between migrations.")
+            ;
 }
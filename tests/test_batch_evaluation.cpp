@@ -0,0 +1,282 @@
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class RegressionContext : public DoubleEvaluationContext
+{
+public:
+    double x{}, y{};
+
+    RegressionContext(double px, double py) : x(px), y(py) {}
+
+    double ParseValue(const std::string& value) const override
+    {
+        if (value == "x")
+            return x;
+        if (value == "y")
+            return y;
+        return DoubleEvaluationContext::ParseValue(value);
+    }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, ArithmeticOp, ComparisonOp, LogicOp, Not, Question, Colon, // Terminals
+    Expr, Cond // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "0", "2" });
+const Terminal arithmeticOpTerm(ArithmeticOp, "arithmeticOp", { "+", "-", "*", "/" });
+const Terminal comparisonOpTerm(ComparisonOp, "comparisonOp", { ">", ">=", "<", "<=", "==" });
+const Terminal logicOpTerm(LogicOp, "logicOp", { "&&", "||", "^" });
+const Terminal notTerm(Not, "not", { "!" });
+const Terminal questionTerm(Question, "question", { "?" });
+const Terminal colonTerm(Colon, "colon", { ":" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal condNonTerm(Cond, "COND");
+
+// Grammar definition.
+const ProductionRule arithmeticRule(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(arithmeticOpTerm), ProductionElement(exprNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& regressionContext = dynamic_cast<RegressionContext&>(ctx);
+            const double a = regressionContext.TypedSemanticValue(0);
+            const double b = regressionContext.TypedSemanticValue(2);
+            const string& op = regressionContext.TerminalValue(1);
+
+            if (op == "+")
+                regressionContext.SetTypedResult(a + b);
+            else if (op == "-")
+                regressionContext.SetTypedResult(a - b);
+            else if (op == "*")
+                regressionContext.SetTypedResult(a * b);
+            else
+                regressionContext.SetTypedResult(b != 0.0 ? a / b : 1.0);
+        },
+        [](BatchEvaluationContext& ctx) {
+            const string& op = ctx.TerminalValue(1);
+            if (op == "+")
+                BatchKernels::Add(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else if (op == "-")
+                BatchKernels::Subtract(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else if (op == "*")
+                BatchKernels::Multiply(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else
+                BatchKernels::Divide(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+        }
+);
+
+const ProductionRule varRule(
+        exprNonTerm,
+        { ProductionElement(varTerm) }
+);
+
+const ProductionRule selectRule(
+        exprNonTerm,
+        { ProductionElement(condNonTerm), ProductionElement(questionTerm), ProductionElement(exprNonTerm),
+          ProductionElement(colonTerm), ProductionElement(exprNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& regressionContext = dynamic_cast<RegressionContext&>(ctx);
+            const bool condition = regressionContext.TypedSemanticValue(0) != 0.0;
+            regressionContext.SetTypedResult(regressionContext.TypedSemanticValue(condition ? 2 : 4));
+        },
+        [](BatchEvaluationContext& ctx) {
+            BatchKernels::Select(ctx.Column(0), ctx.Column(2), ctx.Column(4), ctx.Result(), ctx.NumberOfRows());
+        }
+);
+
+const ProductionRule comparisonRule(
+        condNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(comparisonOpTerm), ProductionElement(exprNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& regressionContext = dynamic_cast<RegressionContext&>(ctx);
+            const double a = regressionContext.TypedSemanticValue(0);
+            const double b = regressionContext.TypedSemanticValue(2);
+            const string& op = regressionContext.TerminalValue(1);
+
+            bool result;
+            if (op == ">")
+                result = a > b;
+            else if (op == ">=")
+                result = a >= b;
+            else if (op == "<")
+                result = a < b;
+            else if (op == "<=")
+                result = a <= b;
+            else
+                result = a == b;
+            regressionContext.SetTypedResult(result ? 1.0 : 0.0);
+        },
+        [](BatchEvaluationContext& ctx) {
+            const string& op = ctx.TerminalValue(1);
+            if (op == ">")
+                BatchKernels::Greater(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else if (op == ">=")
+                BatchKernels::GreaterEqual(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else if (op == "<")
+                BatchKernels::Less(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else if (op == "<=")
+                BatchKernels::LessEqual(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else
+                BatchKernels::Equal(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+        }
+);
+
+const ProductionRule logicRule(
+        condNonTerm,
+        { ProductionElement(condNonTerm), ProductionElement(logicOpTerm), ProductionElement(condNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& regressionContext = dynamic_cast<RegressionContext&>(ctx);
+            const bool a = regressionContext.TypedSemanticValue(0) != 0.0;
+            const bool b = regressionContext.TypedSemanticValue(2) != 0.0;
+            const string& op = regressionContext.TerminalValue(1);
+
+            bool result;
+            if (op == "&&")
+                result = a && b;
+            else if (op == "||")
+                result = a || b;
+            else
+                result = a != b;
+            regressionContext.SetTypedResult(result ? 1.0 : 0.0);
+        },
+        [](BatchEvaluationContext& ctx) {
+            const string& op = ctx.TerminalValue(1);
+            if (op == "&&")
+                BatchKernels::And(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else if (op == "||")
+                BatchKernels::Or(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+            else
+                BatchKernels::Xor(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+        }
+);
+
+const ProductionRule notRule(
+        condNonTerm,
+        { ProductionElement(notTerm), ProductionElement(condNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& regressionContext = dynamic_cast<RegressionContext&>(ctx);
+            regressionContext.SetTypedResult(regressionContext.TypedSemanticValue(1) == 0.0 ? 1.0 : 0.0);
+        },
+        [](BatchEvaluationContext& ctx) {
+            BatchKernels::Not(ctx.Column(1), ctx.Result(), ctx.NumberOfRows());
+        }
+);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+TEST_CASE("Test batch kernels")
+{
+    const vector<double> a = { 1.0, -2.0, 0.0, 3.5 };
+    const vector<double> b = { 2.0, -2.0, 0.0, 0.0 };
+    vector<double> out(4);
+
+    BatchKernels::Add(a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 3.0, -4.0, 0.0, 3.5 }));
+
+    BatchKernels::Divide(a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 0.5, 1.0, 1.0, 1.0 }));
+
+    BatchKernels::Max(a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 2.0, -2.0, 0.0, 3.5 }));
+
+    BatchKernels::GreaterEqual(a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 0.0, 1.0, 1.0, 1.0 }));
+
+    BatchKernels::Or(a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 1.0, 1.0, 0.0, 1.0 }));
+
+    BatchKernels::Xor(a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 0.0, 0.0, 0.0, 1.0 }));
+
+    BatchKernels::Not(b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 0.0, 0.0, 1.0, 1.0 }));
+
+    BatchKernels::Select(b.data(), a.data(), b.data(), out.data(), 4);
+    CHECK((out == vector<double>{ 1.0, -2.0, 0.0, 0.0 }));
+}
+
+TEST_CASE("Test batch evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ arithmeticRule, varRule, selectRule, comparisonRule, logicRule, notRule };
+
+    const size_t rows = 37;
+    vector<double> xs(rows), ys(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        xs[i] = static_cast<double>(i) * 0.5 - 4.0;
+        ys[i] = static_cast<double>(i % 5);
+    }
+
+    BatchEvaluationContext batchContext(rows);
+    batchContext.SetColumn("x", xs);
+    batchContext.SetColumn("y", ys);
+    CHECK_THROWS(batchContext.SetColumn("z", { 1.0 }));
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 8);
+        const CompiledSyntaxTree program(tree);
+
+        tree.Evaluate(batchContext);
+        const vector<double> treeColumn(batchContext.GetResultColumn(), batchContext.GetResultColumn() + rows);
+
+        program.Evaluate(batchContext);
+        const vector<double> programColumn(batchContext.GetResultColumn(), batchContext.GetResultColumn() + rows);
+        CHECK((programColumn == treeColumn));
+
+        // Every row matches the evaluation of the row on its own.
+        for (size_t row = 0; row < rows; row++)
+        {
+            RegressionContext ctx(xs[row], ys[row]);
+            tree.Evaluate(ctx);
+            CHECK((ctx.GetTypedResult() == treeColumn[row]));
+        }
+    }
+}
+
+TEST_CASE("Test batch evaluation of transfer rules")
+{
+    // A tree made only of transfer rules returns the input column itself or a constant column.
+    SyntaxTree variable;
+    variable.SetRootRule(varRule);
+    variable.Root()->AddChildTerm(varTerm, "y");
+
+    BatchEvaluationContext ctx(3);
+    ctx.SetColumn("x", { 1.0, 2.0, 3.0 });
+    ctx.SetColumn("y", { 4.0, 5.0, 6.0 });
+
+    variable.Evaluate(ctx);
+    CHECK((ctx.GetResultColumn() == ctx.GetColumn("y")));
+
+    variable.Root()->children[0]->SetValue("2");
+    variable.Evaluate(ctx);
+    CHECK((vector<double>(ctx.GetResultColumn(), ctx.GetResultColumn() + 3) == vector<double>{ 2.0, 2.0, 2.0 }));
+
+    // Rules without a batch semantic action cannot be evaluated in batch.
+    const ProductionRule scalarRule(exprNonTerm, { ProductionElement(varTerm) }, [](EvaluationContext&) {});
+    SyntaxTree scalar;
+    scalar.SetRootRule(scalarRule);
+    scalar.Root()->AddChildTerm(varTerm, "x");
+    CHECK_THROWS(scalar.Evaluate(ctx));
+}
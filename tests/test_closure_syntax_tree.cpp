@@ -0,0 +1,261 @@
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "../include/thread_pool.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class ClosureArithmeticContext : public EvaluationContext
+{
+public:
+    int x{}, y{};
+
+    ClosureArithmeticContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+class TypedClosureArithmeticContext : public IntEvaluationContext
+{
+public:
+    int64_t x{}, y{};
+
+    TypedClosureArithmeticContext(int64_t px, int64_t py) : x(px), y(py) {}
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ClosureArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) + arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ClosureArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) * arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ClosureArithmeticContext&>(ctx);
+            const string& var = ctx.SemanticValue(0);
+
+            if (var == "x")
+                arithmeticContext.SetIntResult(arithmeticContext.x);
+            else if (var == "y")
+                arithmeticContext.SetIntResult(arithmeticContext.y);
+            else
+                arithmeticContext.SetIntResult(1);
+        }
+);
+
+// Typed versions of the rules with custom semantic actions. The rules with default semantic actions are shared.
+const TypedArithmeticRules<TypedClosureArithmeticContext> typedRules(rule1, rule3, rule6);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+
+/// Evaluates a tree by tree walking.
+int walked_evaluation(const SyntaxTree& tree, int x, int y)
+{
+    ClosureArithmeticContext ctx(x, y);
+    tree.Evaluate(ctx);
+    return ctx.GetIntResult();
+}
+
+TEST_CASE("Test closure tree evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 20);
+
+        ClosureSyntaxTree closureTree(tree);
+        CHECK((closureTree.NumberOfClosures() == tree.GetTermsOfType(NodeType::NonTerminal).size()));
+
+        TypedClosureSyntaxTree<int64_t> typedClosureTree(typedRules.TypedCopy(tree));
+
+        for (int x = 0; x <= 3; x++)
+        {
+            const int expected = walked_evaluation(tree, x, 2);
+
+            ClosureArithmeticContext ctx(x, 2);
+            closureTree.Evaluate(ctx);
+            CHECK((ctx.GetIntResult() == expected));
+
+            TypedClosureArithmeticContext typedContext(x, 2);
+            typedClosureTree.Evaluate(typedContext);
+            CHECK((typedContext.GetTypedResult() == expected));
+        }
+
+        // The compiled tree does not depend on the nodes of the tree.
+        const int expected = walked_evaluation(tree, 5, 7);
+        tree.Destroy();
+
+        ClosureArithmeticContext ctx(5, 7);
+        closureTree.Evaluate(ctx);
+        CHECK((ctx.GetIntResult() == expected));
+    }
+}
+
+TEST_CASE("Test closure tree validation")
+{
+    CHECK(ClosureSyntaxTree().IsEmpty());
+    CHECK(ClosureSyntaxTree(SyntaxTree()).IsEmpty());
+
+    // A tree with a NonTerminal that has not been expanded cannot be compiled.
+    SyntaxTree tree;
+    tree.SetRootRule(rule1);
+    tree.Root()->AddChildTerm(exprNonTerm, rule2);
+    tree.Root()->AddChildTerm(plusTerm);
+    tree.Root()->AddChildTerm(termNonTerm, rule4);
+    CHECK_THROWS(ClosureSyntaxTree{ tree });
+
+    tree.Root()->children[0]->AddChildTerm(termNonTerm, rule4)->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "x");
+    tree.Root()->children[2]->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "y");
+
+    ClosureSyntaxTree closureTree(tree);
+    CHECK((closureTree.NumberOfClosures() == 6));
+
+    ClosureArithmeticContext ctx(2, 3);
+    closureTree.Evaluate(ctx);
+    CHECK((ctx.GetIntResult() == 5));
+}
+
+TEST_CASE("Test closure tree of an individual")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    Individual individual([](SyntaxTree&) { return 0.0; });
+    grammar.CreateRandomTree(individual.GetTree(), 20);
+
+    // The compiled tree is kept while the tree does not change, and shared by the copies of the individual.
+    const auto closureTree = individual.GetClosureTree();
+    CHECK((individual.GetClosureTree() == closureTree));
+
+    Individual copy = individual;
+    CHECK((copy.GetClosureTree() == closureTree));
+
+    // Changing a terminal compiles the tree again.
+    for (TreeNode* node : copy.GetTree().PreOrder())
+    {
+        if (node->type == NodeType::Terminal && node->GetTerminal().id == Var)
+        {
+            node->SetValue(node->GetValue() == "x" ? "y" : "x");
+            break;
+        }
+    }
+    const auto changedClosureTree = copy.GetClosureTree();
+    CHECK((changedClosureTree != closureTree));
+    CHECK((individual.GetClosureTree() == closureTree));
+
+    for (int x = 0; x <= 3; x++)
+    {
+        ClosureArithmeticContext ctx(x, 5), changedCtx(x, 5);
+        closureTree->Evaluate(ctx);
+        changedClosureTree->Evaluate(changedCtx);
+        CHECK((ctx.GetIntResult() == walked_evaluation(individual.GetTree(), x, 5)));
+        CHECK((changedCtx.GetIntResult() == walked_evaluation(copy.GetTree(), x, 5)));
+    }
+
+    // Changing the rule of a node compiles the tree again with the new semantic action.
+    ProductionRule constantRule = copy.GetTree().Root()->GetGeneratorPR();
+    constantRule.semanticAction = [](EvaluationContext& ctx) { ctx.result() = "42"; };
+    copy.GetTree().Root()->SetGeneratorPR(constantRule);
+    ClosureArithmeticContext constantCtx(1, 5);
+    copy.GetClosureTree()->Evaluate(constantCtx);
+    CHECK((constantCtx.GetIntResult() == 42));
+}
+
+TEST_CASE("Test closure tree evaluation from many threads")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    SyntaxTree tree;
+    grammar.CreateRandomTree(tree, 30);
+
+    const int rows = 200;
+    vector<int> expected(rows);
+    for (int x = 0; x < rows; x++)
+        expected[x] = walked_evaluation(tree, x, x % 7);
+
+    // Every task evaluates the same compiled tree with its own context.
+    const ClosureSyntaxTree closureTree(tree);
+    vector<int> results(rows * 4);
+    BS::thread_pool pool;
+    for (size_t task = 0; task < results.size(); task++)
+    {
+        pool.push_task([&, task]() {
+            const int x = static_cast<int>(task % rows);
+            ClosureArithmeticContext ctx(x, x % 7);
+            closureTree.Evaluate(ctx);
+            results[task] = ctx.GetIntResult();
+        });
+    }
+    pool.wait_for_tasks();
+
+    for (size_t task = 0; task < results.size(); task++)
+        CHECK((results[task] == expected[task % rows]));
+}
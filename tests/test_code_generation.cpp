@@ -0,0 +1,255 @@
+#include <chrono>
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class GeneratedArithmeticContext : public EvaluationContext
+{
+public:
+    int x{}, y{};
+
+    GeneratedArithmeticContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<GeneratedArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) + arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<GeneratedArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) * arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<GeneratedArithmeticContext&>(ctx);
+            const string& var = ctx.SemanticValue(0);
+
+            if (var == "x")
+                arithmeticContext.SetIntResult(arithmeticContext.x);
+            else if (var == "y")
+                arithmeticContext.SetIntResult(arithmeticContext.y);
+            else
+                arithmeticContext.SetIntResult(1);
+        }
+);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+
+/// Creates the grammar with the code templates of every rule. The values of the Terminals are the names of the
+/// parameters of the generated function, or literals.
+Grammar code_generation_grammar()
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+    grammar.SetCodeTemplate(rule1, "$0 + $2");
+    grammar.SetCodeTemplate(rule2, "$0");
+    grammar.SetCodeTemplate(rule3, "$0 * $2");
+    grammar.SetCodeTemplate(rule4, "$0");
+    grammar.SetCodeTemplate(rule5, "$1");
+    grammar.SetCodeTemplate(rule6, "$0");
+    return grammar;
+}
+
+/// Evaluates a tree with the interpreter.
+int interpreted_evaluation(const SyntaxTree& tree, int x, int y)
+{
+    GeneratedArithmeticContext ctx(x, y);
+    tree.Evaluate(ctx);
+    return ctx.GetIntResult();
+}
+
+TEST_CASE("Test code generation")
+{
+    // x + y * 1
+    SyntaxTree tree;
+    tree.SetRootRule(rule1);
+    tree.Root()->AddChildTerm(exprNonTerm, rule2)->AddChildTerm(termNonTerm, rule4)->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "x");
+    tree.Root()->AddChildTerm(plusTerm);
+    TreeNode* term = tree.Root()->AddChildTerm(termNonTerm, rule3);
+    term->AddChildTerm(termNonTerm, rule4)->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "y");
+    term->AddChildTerm(timesTerm);
+    term->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "1");
+
+    const CodeGenerator generator(code_generation_grammar(), "int", "int x, int y", "#include <cstdint>");
+    const string function = generator.GenerateFunction(tree, "evaluate");
+    CHECK((function == "extern \"C\" int evaluate(int x, int y)\n"
+                       "{\n"
+                       "    const auto v0 = x;\n"
+                       "    const auto v1 = v0;\n"
+                       "    const auto v2 = v1;\n"
+                       "    const auto v3 = y;\n"
+                       "    const auto v4 = v3;\n"
+                       "    const auto v5 = 1;\n"
+                       "    const auto v6 = v4 * v5;\n"
+                       "    const auto v7 = v2 + v6;\n"
+                       "    return v7;\n"
+                       "}\n"));
+    CHECK((generator.GenerateSource(tree, "evaluate") == "#include <cstdint>\n" + function));
+
+    // Every rule of the tree needs a valid code template.
+    Grammar grammar = code_generation_grammar();
+    grammar.SetCodeTemplate(rule3, "$0 * $3");
+    CHECK_THROWS((void)CodeGenerator(grammar, "int", "int x, int y").GenerateFunction(tree, "evaluate"));
+    grammar.SetCodeTemplate(rule3, "$0 * $");
+    CHECK_THROWS((void)CodeGenerator(grammar, "int", "int x, int y").GenerateFunction(tree, "evaluate"));
+    grammar.SetCodeTemplate(rule3, "$0 * $2 + $$");
+    CHECK((CodeGenerator(grammar, "int", "int x, int y").GenerateFunction(tree, "evaluate").find("v4 * v5 + $;") != string::npos));
+
+    Grammar incompleteGrammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+    CHECK((!incompleteGrammar.GetCodeTemplate(rule1).has_value()));
+    CHECK_THROWS((void)CodeGenerator(incompleteGrammar, "int", "int x, int y").GenerateFunction(tree, "evaluate"));
+
+    // Only the values of the grammar and valid identifiers reach the source.
+    CHECK_THROWS((void)generator.GenerateFunction(tree, "evaluate(); int f"));
+    CHECK_THROWS((void)generator.GenerateFunction(tree, ""));
+    term->children[2]->children[0]->SetValue("1; }\nint injected() { return 0");
+    CHECK_THROWS((void)generator.GenerateFunction(tree, "evaluate"));
+    term->children[2]->children[0]->SetValue("1");
+    CHECK((generator.GenerateFunction(tree, "evaluate") == function));
+}
+
+#if defined(GBGP_NATIVE_COMPILATION)
+/// Check if there is a compiler for native compilation.
+bool has_native_compiler()
+{
+    const string command = NativeFunction<int(int, int)>::DefaultCompiler() + " --version > /dev/null 2>&1";
+    return std::system(command.c_str()) == 0;
+}
+
+TEST_CASE("Test native compilation")
+{
+    if (!has_native_compiler())
+    {
+        cout << "There is no compiler, skipping native compilation" << endl;
+        return;
+    }
+
+    SharedGeneratorGuard generatorGuard;
+    const Grammar grammar = code_generation_grammar();
+    const CodeGenerator generator(grammar, "int", "int x, int y");
+
+    for (int i = 0; i < 3; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 20);
+
+        const NativeFunction<int(int, int)> function = generator.CompileNative<int(int, int)>(tree);
+        CHECK(function.IsLoaded());
+        for (int x = 0; x <= 3; x++)
+            CHECK((function(x, 2) == interpreted_evaluation(tree, x, 2)));
+    }
+
+    CHECK_THROWS(NativeFunction<int(int, int)>::Compile("this is not C++", "evaluate"));
+    CHECK_THROWS(NativeFunction<int(int, int)>::Compile("extern \"C\" int evaluate(int x, int y) { return x; }", "missing"));
+}
+
+TEST_CASE("Benchmark native evaluation")
+{
+    if (!has_native_compiler())
+    {
+        cout << "There is no compiler, skipping native compilation" << endl;
+        return;
+    }
+
+    SharedGeneratorGuard generatorGuard;
+    const Grammar grammar = code_generation_grammar();
+    const CodeGenerator generator(grammar, "int", "int x, int y");
+
+    SyntaxTree tree;
+    do
+        grammar.CreateRandomTree(tree, 20);
+    while (tree.Size() < 50);
+
+    auto start = chrono::steady_clock::now();
+    const NativeFunction<int(int, int)> function = generator.CompileNative<int(int, int)>(tree);
+    chrono::duration<double, milli> compileElapsed = chrono::steady_clock::now() - start;
+
+    const int rows = 20000;
+    GeneratedArithmeticContext ctx(0, 3);
+    long long interpretedTotal = 0;
+    start = chrono::steady_clock::now();
+    for (int row = 0; row < rows; row++)
+    {
+        ctx.x = row % 4;
+        tree.Evaluate(ctx);
+        interpretedTotal += ctx.GetIntResult();
+    }
+    chrono::duration<double, micro> interpretedElapsed = chrono::steady_clock::now() - start;
+
+    long long nativeTotal = 0;
+    start = chrono::steady_clock::now();
+    for (int row = 0; row < rows; row++)
+        nativeTotal += function(row % 4, 3);
+    chrono::duration<double, micro> nativeElapsed = chrono::steady_clock::now() - start;
+
+    CHECK((nativeTotal == interpretedTotal));
+    cout << "Nodes: " << tree.Size() << ", compilation ms: " << compileElapsed.count()
+         << ", interpreted us/eval: " << interpretedElapsed.count() / rows
+         << ", native us/eval: " << nativeElapsed.count() / rows << endl;
+}
+#endif
@@ -0,0 +1,182 @@
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class ArithmeticContext : public EvaluationContext
+{
+public:
+    int x{}, y{};
+
+    ArithmeticContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+class TypedArithmeticContext : public IntEvaluationContext
+{
+public:
+    int64_t x{}, y{};
+
+    TypedArithmeticContext(int64_t px, int64_t py) : x(px), y(py) {}
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            int n1 = arithmeticContext.GetIntSemanticValue(0);
+            int n2 = arithmeticContext.GetIntSemanticValue(2);
+            arithmeticContext.SetIntResult(n1 + n2);
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            int n1 = arithmeticContext.GetIntSemanticValue(0);
+            int n2 = arithmeticContext.GetIntSemanticValue(2);
+            arithmeticContext.SetIntResult(n1 * n2);
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            string var = ctx.SemanticValue(0);
+
+            int varValue;
+            if (var == "x")
+                varValue = arithmeticContext.x;
+            else if (var == "y")
+                varValue = arithmeticContext.y;
+            else
+                varValue = 1;
+
+            arithmeticContext.SetIntResult(varValue);
+        }
+);
+
+// Typed versions of the rules with custom semantic actions. The rules with default semantic actions are shared.
+const TypedArithmeticRules<TypedArithmeticContext> typedRules(rule1, rule3, rule6);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+
+TEST_CASE("Test compiled tree evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 20);
+
+        CompiledSyntaxTree program(tree);
+        CHECK((program.NumberOfInstructions() == tree.GetTermsOfType(NodeType::NonTerminal).size()));
+
+        CompiledSyntaxTree typedProgram(typedRules.TypedCopy(tree));
+
+        for (int x = 0; x <= 3; x++)
+        {
+            ArithmeticContext treeContext(x, 2);
+            ArithmeticContext programContext(x, 2);
+            tree.Evaluate(treeContext);
+            program.Evaluate(programContext);
+            CHECK((programContext.GetIntResult() == treeContext.GetIntResult()));
+
+            TypedArithmeticContext typedContext(x, 2);
+            typedProgram.Evaluate(typedContext);
+            CHECK((typedContext.GetTypedResult() == treeContext.GetIntResult()));
+        }
+
+        // The program does not depend on the nodes of the tree.
+        ArithmeticContext expected(5, 7);
+        tree.Evaluate(expected);
+        tree.Destroy();
+
+        ArithmeticContext programContext(5, 7);
+        program.Evaluate(programContext);
+        CHECK((programContext.GetIntResult() == expected.GetIntResult()));
+    }
+}
+
+TEST_CASE("Test compiled tree validation")
+{
+    CHECK(CompiledSyntaxTree().IsEmpty());
+    CHECK(CompiledSyntaxTree(SyntaxTree()).IsEmpty());
+
+    // A tree with a NonTerminal that has not been expanded cannot be compiled.
+    SyntaxTree tree;
+    tree.SetRootRule(rule1);
+    tree.Root()->AddChildTerm(exprNonTerm, rule2);
+    tree.Root()->AddChildTerm(plusTerm);
+    tree.Root()->AddChildTerm(termNonTerm, rule4);
+    CHECK_THROWS(CompiledSyntaxTree{ tree });
+
+    tree.Root()->children[0]->AddChildTerm(termNonTerm, rule4)->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "x");
+    tree.Root()->children[2]->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "y");
+
+    CompiledSyntaxTree program(tree);
+    CHECK((program.NumberOfInstructions() == 6));
+
+    ArithmeticContext ctx(2, 3);
+    program.Evaluate(ctx);
+    CHECK((ctx.GetIntResult() == 5));
+}
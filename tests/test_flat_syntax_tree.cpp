@@ -0,0 +1,186 @@
+#include "doctest.h"
+#include "../include/gbgp.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class ArithmeticContext : public EvaluationContext
+{
+public:
+    int x{}, y{};
+
+    ArithmeticContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            int n1 = arithmeticContext.GetIntSemanticValue(0);
+            int n2 = arithmeticContext.GetIntSemanticValue(2);
+            arithmeticContext.SetIntResult(n1 + n2);
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            int n1 = arithmeticContext.GetIntSemanticValue(0);
+            int n2 = arithmeticContext.GetIntSemanticValue(2);
+            arithmeticContext.SetIntResult(n1 * n2);
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            string var = ctx.SemanticValue(0);
+
+            int varValue;
+            if (var == "x")
+                varValue = arithmeticContext.x;
+            else if (var == "y")
+                varValue = arithmeticContext.y;
+            else
+                varValue = 1;
+
+            arithmeticContext.SetIntResult(varValue);
+        }
+);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+TEST_CASE("Test flat tree conversion")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 20);
+
+        FlatSyntaxTree flat(grammar, tree);
+        CHECK((flat.Size() == tree.GetPreOrderTreeTraversal().size()));
+        CHECK((flat.GetSubtreeSizes().front() == flat.Size()));
+        CHECK((flat.SynthesizeExpression() == tree.SynthesizeExpression()));
+
+        SyntaxTree rebuilt = flat.ToSyntaxTree();
+        CHECK((rebuilt.SynthesizeExpression() == tree.SynthesizeExpression()));
+        CHECK((FlatSyntaxTree(grammar, rebuilt) == flat));
+    }
+}
+
+TEST_CASE("Test flat tree evaluation")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 50; i++)
+    {
+        FlatSyntaxTree flat(grammar);
+        flat.CreateRandom(10, 0);
+        SyntaxTree tree = flat.ToSyntaxTree();
+
+        ArithmeticContext flatContext(3, 4);
+        ArithmeticContext treeContext(3, 4);
+        flat.Evaluate(flatContext);
+        tree.Evaluate(treeContext);
+
+        CHECK((flatContext.GetIntResult() == treeContext.GetIntResult()));
+    }
+}
+
+TEST_CASE("Test flat tree genetic operators")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    // A flat tree is consistent if it survives a round trip through the pointer representation.
+    auto isConsistent = [&](const FlatSyntaxTree& flat) {
+        SyntaxTree tree = flat.ToSyntaxTree();
+        return FlatSyntaxTree(grammar, tree) == flat && flat.GetSubtreeSizes().front() == flat.Size();
+    };
+
+    for (int i = 0; i < 50; i++)
+    {
+        FlatSyntaxTree parent1(grammar);
+        FlatSyntaxTree parent2(grammar);
+        parent1.CreateRandom(10, 0);
+        parent2.CreateRandom(10, 0);
+
+        FlatSyntaxTree offspring = FlatSyntaxTree::Crossover(parent1, parent2);
+        CHECK(isConsistent(offspring));
+
+        offspring.MutateTerminal();
+        CHECK(isConsistent(offspring));
+
+        offspring.MutateNonTerminal(10);
+        CHECK(isConsistent(offspring));
+
+        // The regrown subtree fits in the depth left below the replaced node. Terminals are one level below the
+        // deepest NonTerminal.
+        FlatSyntaxTree mutated = parent1;
+        for (int j = 0; j < 10; j++)
+        {
+            mutated.MutateNonTerminal(10);
+            CHECK((mutated.ToSyntaxTree().Height() <= 11));
+        }
+
+        ArithmeticContext ctx(1, 2);
+        offspring.Evaluate(ctx);
+        CHECK_FALSE(ctx.result().empty());
+    }
+}
@@ -1,5 +1,6 @@
 #include "doctest.h"
 #include "../include/gbgp.h"
+#include "test_helpers.h"
 using namespace std;
 using namespace gbgp;
 
@@ -139,3 +140,126 @@ TEST_CASE("Test crossover")
     string offspringSynth = offspring.GetExpression();
     cout << "Offspring: " << offspringSynth << endl;
 }
+
+TEST_CASE("Test crossover pairs shuffled parents")
+{
+    SharedGeneratorGuard generatorGuard;
+    const Terminal numberTerm(Var, "number", { "0", "1", "2", "3", "4", "5", "6", "7" });
+    const ProductionRule numberRule(factorNonTerm, { ProductionElement(numberTerm) });
+    Grammar grammar({ rule1, rule2, rule3, rule4, numberRule });
+    auto zero_fitness_function = [](SyntaxTree&) { return 0.0; };
+    const unsigned offspringSize = 8;
+
+    // Parent k is the chain EXPR -> TERM -> FACTOR -> k, so every offspring is the number of one of its parents.
+    auto create_numbered_population = [&]() {
+        Population population(grammar, zero_fitness_function);
+        for (int k = 0; k < 8; k++)
+        {
+            population.AddIndividual(Individual(zero_fitness_function, SyntaxTree(new TreeNode(rule2, exprNonTerm, {
+                TreeNode(rule4, termNonTerm, { TreeNode(numberRule, factorNonTerm, {
+                    TreeNode(numberTerm, to_string(k)) }) }) }))));
+        }
+        return population;
+    };
+
+    // The offspring of the n-th pair of the shuffled parents come n-th.
+    auto check_parents = [&](Population& population, const vector<size_t>& pairings) {
+        size_t pairsOfNeighbours = 0;
+        for (size_t i = 0; i < pairings.size(); i += 2)
+            pairsOfNeighbours += pairings[i] / 2 == pairings[i + 1] / 2 ? 1 : 0;
+        CHECK((pairsOfNeighbours < pairings.size() / 2));
+
+        REQUIRE((population.Size() == pairings.size() / 2 * offspringSize));
+        for (size_t k = 0; k < population.Size(); k++)
+        {
+            const size_t i = 2 * (k / offspringSize);
+            const string expression = population.GetIndividual(k).GetExpression();
+            CHECK((expression == to_string(pairings[i]) || expression == to_string(pairings[i + 1])));
+        }
+    };
+
+    // The pairings are replayed from a copy of the stream, or from the same seed of the shared generator.
+    RandomStream random(11);
+    RandomStream replay = random;
+    vector<size_t> pairings = range(size_t(8));
+    shuffle(pairings, replay);
+    Population population = create_numbered_population();
+    population.SetExecutor(make_shared<Executor>(2));
+    GeneticOperators::Crossover(population, offspringSize, RuntimeMode::MultiThread, random);
+    check_parents(population, pairings);
+
+    seed_random_generator(11);
+    pairings = range(size_t(8));
+    shuffle(pairings);
+    seed_random_generator(11);
+    population = create_numbered_population();
+    GeneticOperators::Crossover(population, offspringSize, RuntimeMode::SingleThread);
+    check_parents(population, pairings);
+}
+
+TEST_CASE("Test parallel genetic operators")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar({ rule1, rule2, rule3, rule4, rule5, rule6 });
+    auto length_fitness_function = [](SyntaxTree& tree) { return -static_cast<double>(tree.SynthesizeExpression().size()); };
+
+    // Runs every phase of a few generations from the same seed, and returns the final population. The run only
+    // draws from its own random stream, so the state of the shared generator does not matter.
+    auto optimize = [&](RuntimeMode runtimeMode, const shared_ptr<Executor>& executor) {
+        random_generator().discard(static_cast<unsigned long long>(executor ? executor->GetThreadCount() : 0));
+        Environment environment(grammar, length_fitness_function, 60, 30, 4, 4, 0.5, runtimeMode, executor, 42);
+        environment.Optimize(4);
+
+        vector<string> expressions;
+        for (Individual& ind : environment.GetPopulation().GetIndividuals())
+            expressions.push_back(ind.GetExpression());
+        return expressions;
+    };
+
+    // The individuals do not depend on the number of threads.
+    const vector<string> singleThread = optimize(RuntimeMode::SingleThread, nullptr);
+    CHECK((singleThread.size() == 30));
+    CHECK((optimize(RuntimeMode::MultiThread, make_shared<Executor>(1)) == singleThread));
+    CHECK((optimize(RuntimeMode::MultiThread, make_shared<Executor>(4)) == singleThread));
+
+    // The operators can also be applied on their own.
+    auto apply_operators = [&](unsigned threads) {
+        RandomStream random(7);
+        Population population(grammar, length_fitness_function);
+        population.SetExecutor(make_shared<Executor>(threads));
+        population.Initialize(40, RuntimeMode::MultiThread, random);
+        GeneticOperators::Crossover(population, 2, RuntimeMode::MultiThread, random);
+        GeneticOperators::Mutation(population, 0.5, 0.5, RuntimeMode::MultiThread, random);
+        population.Prune(RuntimeMode::MultiThread);
+
+        vector<string> expressions;
+        for (Individual& ind : population.GetIndividuals())
+            expressions.push_back(ind.GetExpression());
+        return expressions;
+    };
+
+    const vector<string> threeThreads = apply_operators(3);
+    CHECK((threeThreads.size() == 40));
+    for (const string& expression : threeThreads)
+        CHECK((!expression.empty()));
+    CHECK((apply_operators(2) == threeThreads));
+
+    // On a single thread, the overloads without a stream draw from the shared generator, one individual after the
+    // other.
+    seed_random_generator(7);
+    Population population(grammar, length_fitness_function);
+    population.Initialize(10);
+    GeneticOperators::Mutation(population, 0.5, 0.5, RuntimeMode::SingleThread);
+    CHECK((population.Size() == 10));
+
+    seed_random_generator(7);
+    vector<Individual> individuals(10, Individual(length_fitness_function));
+    for (Individual& ind : individuals)
+        ind.CreateRandom(grammar);
+    uniform_real_distribution<double> unit(0, 1);
+    for (Individual& ind : individuals)
+        if (unit(random_generator()) < 0.5)
+            GeneticOperators::MutateIndividual(ind, grammar, 0.5);
+    for (size_t i = 0; i < individuals.size(); i++)
+        CHECK((population.GetIndividual(i).GetExpression() == individuals[i].GetExpression()));
+}
@@ -0,0 +1,104 @@
+#pragma once
+#include <random>
+#include "../include/gbgp.h"
+
+//*****************************
+//*       Test helpers        *
+//****************************/
+
+/// Saves the state of the shared generator and restores it when it goes out of scope, so a test drawing random trees
+/// does not change the sequences seen by the tests that run after it.
+class SharedGeneratorGuard
+{
+private:
+    std::mt19937 _state;
+
+public:
+    SharedGeneratorGuard() : _state(gbgp::random_generator()) {}
+    ~SharedGeneratorGuard() { gbgp::random_generator() = _state; }
+
+    SharedGeneratorGuard(const SharedGeneratorGuard&) = delete;
+    SharedGeneratorGuard& operator=(const SharedGeneratorGuard&) = delete;
+};
+
+//*****************************
+//*  Typed arithmetic rules   *
+//****************************/
+
+/// Typed versions of the rules of the arithmetic grammar of the tests that have custom semantic actions:
+/// EXPR -> EXPR + TERM, TERM -> TERM * FACTOR and FACTOR -> var. The typed rules add and multiply the typed values
+/// of their children, also in batch, and take the values of the variables x and y from the context. The rules with
+/// default semantic actions are shared by both versions of the grammar.
+/// \tparam Context The typed evaluation context, with the values of the variables in its members x and y.
+template<typename Context> class TypedArithmeticRules
+{
+private:
+    size_t _additionUID, _multiplicationUID, _variableUID;
+    gbgp::ProductionRule _typedAddition, _typedMultiplication, _typedVariable;
+
+public:
+    /// Creates the typed versions of the rules.
+    /// \param addition The rule EXPR -> EXPR + TERM.
+    /// \param multiplication The rule TERM -> TERM * FACTOR.
+    /// \param variable The rule FACTOR -> var.
+    TypedArithmeticRules(const gbgp::ProductionRule& addition, const gbgp::ProductionRule& multiplication,
+                         const gbgp::ProductionRule& variable)
+        : _additionUID(addition.uid), _multiplicationUID(multiplication.uid), _variableUID(variable.uid),
+          _typedAddition(addition.from, addition.to,
+                         [](gbgp::EvaluationContext& ctx) {
+                             auto& typedContext = static_cast<Context&>(ctx);
+                             typedContext.SetTypedResult(typedContext.TypedSemanticValue(0) +
+                                                         typedContext.TypedSemanticValue(2));
+                         },
+                         [](gbgp::BatchEvaluationContext& ctx) {
+                             gbgp::BatchKernels::Add(ctx.Column(0), ctx.Column(2), ctx.Result(), ctx.NumberOfRows());
+                         }),
+          _typedMultiplication(multiplication.from, multiplication.to,
+                               [](gbgp::EvaluationContext& ctx) {
+                                   auto& typedContext = static_cast<Context&>(ctx);
+                                   typedContext.SetTypedResult(typedContext.TypedSemanticValue(0) *
+                                                               typedContext.TypedSemanticValue(2));
+                               },
+                               [](gbgp::BatchEvaluationContext& ctx) {
+                                   gbgp::BatchKernels::Multiply(ctx.Column(0), ctx.Column(2), ctx.Result(),
+                                                                ctx.NumberOfRows());
+                               }),
+          _typedVariable(variable.from, variable.to,
+                         [](gbgp::EvaluationContext& ctx) {
+                             auto& typedContext = static_cast<Context&>(ctx);
+                             const std::string& var = typedContext.TerminalValue(0);
+
+                             if (var == "x")
+                                 typedContext.SetTypedResult(typedContext.x);
+                             else if (var == "y")
+                                 typedContext.SetTypedResult(typedContext.y);
+                             else
+                                 typedContext.SetTypedResult(1);
+                         },
+                         [](gbgp::BatchEvaluationContext& ctx) {
+                             ctx.TransferColumnToResult(0);
+                         }) {}
+
+    /// Copies a tree replacing the generator rules with their typed versions.
+    /// \param tree The tree built with the untyped rules.
+    /// \return The typed copy.
+    [[nodiscard]]
+    gbgp::SyntaxTree TypedCopy(const gbgp::SyntaxTree& tree) const
+    {
+        gbgp::SyntaxTree typedTree = tree;
+        for (gbgp::TreeNode* node : typedTree.PreOrder())
+        {
+            if (node->type != gbgp::NodeType::NonTerminal)
+                continue;
+
+            const size_t uid = node->GetGeneratorPR().uid;
+            if (uid == _additionUID)
+                node->SetGeneratorPR(_typedAddition);
+            else if (uid == _multiplicationUID)
+                node->SetGeneratorPR(_typedMultiplication);
+            else if (uid == _variableUID)
+                node->SetGeneratorPR(_typedVariable);
+        }
+        return typedTree;
+    }
+};
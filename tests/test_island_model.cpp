@@ -0,0 +1,233 @@
+#include <thread>
+#include "doctest.h"
+#include "../include/gbgp.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class IslandArithmeticContext : public EvaluationContext
+{
+public:
+    int x{}, y{};
+
+    IslandArithmeticContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<IslandArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) + arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<IslandArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) * arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<IslandArithmeticContext&>(ctx);
+            const string& var = ctx.SemanticValue(0);
+
+            if (var == "x")
+                arithmeticContext.SetIntResult(arithmeticContext.x);
+            else if (var == "y")
+                arithmeticContext.SetIntResult(arithmeticContext.y);
+            else
+                arithmeticContext.SetIntResult(1);
+        }
+);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+
+/// A fitness function too cheap to be worth evaluating in parallel by individual.
+double island_fitness_function(SyntaxTree& solution)
+{
+    double error = 0.0;
+    for (int x = 0; x <= 3; x++)
+    {
+        for (int y = 0; y <= 3; y++)
+        {
+            IslandArithmeticContext ctx(x, y);
+            solution.Evaluate(ctx);
+            error += abs(ctx.GetIntResult() - (1 + 2 * x + y * y));
+        }
+    }
+    return 1.0 / (1.0 + error / 16.0);
+}
+
+/// Get the expression and fitness of every individual of every island.
+vector<pair<string, double>> island_individuals(IslandModel& model)
+{
+    vector<pair<string, double>> individuals;
+    for (size_t i = 0; i < model.GetIslandCount(); i++)
+        for (Individual& ind : model.GetIsland(i).GetPopulation().GetIndividuals())
+            individuals.emplace_back(ind.GetExpression(), ind.GetFitness());
+    return individuals;
+}
+
+TEST_CASE("Test migrant mailbox")
+{
+    MigrantMailbox mailbox;
+    CHECK(mailbox.IsEmpty());
+    CHECK(mailbox.Collect().empty());
+
+    // Several islands post at the same time without locks.
+    vector<thread> senders;
+    for (size_t source = 0; source < 4; source++)
+    {
+        senders.emplace_back([&mailbox, source]() {
+            for (int i = 0; i < 100; i++)
+                mailbox.Post(source, vector<Individual>(source + 1));
+        });
+    }
+    for (thread& sender : senders)
+        sender.join();
+
+    CHECK((!mailbox.IsEmpty()));
+    CHECK((mailbox.Collect().size() == 100 * (1 + 2 + 3 + 4)));
+    CHECK(mailbox.IsEmpty());
+}
+
+TEST_CASE("Test island model")
+{
+    Grammar grammar({ rule1, rule2, rule3, rule4, rule5, rule6 });
+
+    // Runs a few migrations from the same seed. The generations are split across calls, so some intervals are
+    // shorter than the migration interval.
+    auto evolve = [&](RuntimeMode runtimeMode, const shared_ptr<Executor>& executor, MigrationTopology topology) {
+        auto model = make_unique<IslandModel>(grammar, island_fitness_function, 4, 40, 20, 2, 2, 0.4,
+                                              topology, 2, 2, runtimeMode, executor, 5);
+        model->Optimize(3);
+        model->Optimize(3);
+        return model;
+    };
+
+    auto ring = evolve(RuntimeMode::MultiThread, make_shared<Executor>(3), MigrationTopology::Ring);
+    CHECK((ring->GetIslandCount() == 4));
+    CHECK((ring->GetIntervalHistory().size() == 4));
+    for (size_t i = 0; i < ring->GetIslandCount(); i++)
+        CHECK((ring->GetIsland(i).GetPopulation().Size() == 20));
+
+    // Every island received two migrants from its neighbour in each of the first two migrations. The migrants of the
+    // third migration wait in the mailboxes until the next call.
+    CHECK((ring->GetAcceptedMigrants() == 4 * 2 * 2));
+
+    double fittest = 0.0;
+    for (size_t i = 0; i < ring->GetIslandCount(); i++)
+        fittest = max(fittest, ring->GetIsland(i).GetPopulation().GetFittestByRank(0).GetFitness());
+    CHECK((ring->GetFittest().GetFitness() == fittest));
+
+    // The islands do not depend on the number of threads, nor on the order in which the migrants arrive.
+    const vector<pair<string, double>> individuals = island_individuals(*ring);
+    CHECK((island_individuals(*evolve(RuntimeMode::MultiThread, make_shared<Executor>(1), MigrationTopology::Ring)) == individuals));
+    CHECK((island_individuals(*evolve(RuntimeMode::SingleThread, nullptr, MigrationTopology::Ring)) == individuals));
+
+    // Every island sends its migrants to the other three.
+    auto fullyConnected = evolve(RuntimeMode::MultiThread, make_shared<Executor>(2), MigrationTopology::FullyConnected);
+    CHECK((fullyConnected->GetAcceptedMigrants() == 4 * 3 * 2 * 2));
+
+    auto random = evolve(RuntimeMode::MultiThread, make_shared<Executor>(2), MigrationTopology::Random);
+    CHECK((random->GetAcceptedMigrants() > 0));
+    CHECK((island_individuals(*evolve(RuntimeMode::SingleThread, nullptr, MigrationTopology::Random)) == island_individuals(*random)));
+
+    // A single island has nowhere to send its migrants.
+    IslandModel single(grammar, island_fitness_function, 1, 40, 20, 2, 2, 0.4, MigrationTopology::Ring, 1, 2,
+                       RuntimeMode::SingleThread, nullptr, 5);
+    single.Optimize(3);
+    CHECK((single.GetAcceptedMigrants() == 0));
+
+    CHECK_THROWS(IslandModel(grammar, island_fitness_function, 0, 40, 20, 2, 2, 0.4, MigrationTopology::Ring, 1, 2,
+                             RuntimeMode::SingleThread, nullptr, 5));
+    CHECK_THROWS(IslandModel(grammar, island_fitness_function, 2, 40, 20, 2, 2, 0.4, MigrationTopology::Ring, 0, 2,
+                             RuntimeMode::SingleThread, nullptr, 5));
+}
+
+TEST_CASE("Benchmark island model")
+{
+    Grammar grammar({ rule1, rule2, rule3, rule4, rule5, rule6 });
+    const unsigned hardwareThreads = max(1u, thread::hardware_concurrency());
+    const unsigned islands = max(4u, hardwareThreads);
+
+    vector<unsigned> threadCounts = { 1 };
+    if (hardwareThreads > 1)
+        threadCounts.push_back(hardwareThreads);
+
+    cout << "Threads\t|\tms/generation\t|\tIdle fraction" << endl;
+    for (unsigned threads : threadCounts)
+    {
+        IslandModel model(grammar, island_fitness_function, islands, 60, 30, 2, 2, 0.4, MigrationTopology::Ring, 5, 2,
+                          RuntimeMode::MultiThread, make_shared<Executor>(threads), 11);
+        model.Optimize(10);
+
+        double makespan = 0.0, busyTime = 0.0, idleTime = 0.0;
+        for (const ExecutorStatistics& statistics : model.GetIntervalHistory())
+        {
+            makespan += statistics.makespan;
+            busyTime += statistics.busyTime;
+            idleTime += statistics.idleTime;
+        }
+        CHECK((model.GetFittest().GetFitness() > 0.0));
+        cout << threads << "\t|\t" << 1000.0 * makespan / 10 << "\t|\t" << idleTime / max(busyTime + idleTime, 1e-12) << endl;
+    }
+}
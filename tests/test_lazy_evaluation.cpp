@@ -0,0 +1,195 @@
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class CountingLazyContext : public LazyEvaluationContext
+{
+public:
+    int x{}, y{};
+    int variableEvaluations = 0;
+
+    CountingLazyContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, If, Then, Else, Divide, Less, And, // Terminals
+    Expr, Cond // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "0", "1", "2" });
+const Terminal ifTerm(If, "If", { "if" });
+const Terminal thenTerm(Then, "Then", { "then" });
+const Terminal elseTerm(Else, "Else", { "else" });
+const Terminal divideTerm(Divide, "Divide", { "/" });
+const Terminal lessTerm(Less, "Less", { "<" });
+const Terminal andTerm(And, "And", { "and" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal condNonTerm(Cond, "COND");
+
+// Grammar definition. Every rule that can skip a production element has an eager and a lazy semantic action.
+const ProductionRule ifRule(
+        exprNonTerm,
+        { ProductionElement(ifTerm), ProductionElement(condNonTerm), ProductionElement(thenTerm),
+          ProductionElement(exprNonTerm), ProductionElement(elseTerm), ProductionElement(exprNonTerm) },
+        [](EvaluationContext& ctx) {
+            ctx.result() = ctx.SemanticValue(1) == "1" ? ctx.SemanticValue(3) : ctx.SemanticValue(5);
+        },
+        [](LazyEvaluationContext& ctx) {
+            const string& value = ctx.Evaluate(ctx.Evaluate(1) == "1" ? 3 : 5);
+            ctx.result() = value;
+        }
+);
+
+// Protected division, which is zero when the denominator is zero.
+const ProductionRule divideRule(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(divideTerm), ProductionElement(exprNonTerm) },
+        [](EvaluationContext& ctx) {
+            const int denominator = stoi(ctx.SemanticValue(2));
+            ctx.result() = to_string(denominator == 0 ? 0 : stoi(ctx.SemanticValue(0)) / denominator);
+        },
+        [](LazyEvaluationContext& ctx) {
+            const int denominator = stoi(ctx.Evaluate(2));
+            const int numerator = denominator == 0 ? 0 : stoi(ctx.Evaluate(0));
+            ctx.result() = to_string(denominator == 0 ? 0 : numerator / denominator);
+        }
+);
+
+const ProductionRule varRule(
+        exprNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& countingContext = dynamic_cast<CountingLazyContext&>(ctx);
+            const string& var = ctx.SemanticValue(0);
+            countingContext.variableEvaluations++;
+
+            if (var == "x")
+                countingContext.SetIntResult(countingContext.x);
+            else if (var == "y")
+                countingContext.SetIntResult(countingContext.y);
+            else
+                countingContext.SetIntResult(stoi(var));
+        }
+);
+
+const ProductionRule lessRule(
+        condNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(lessTerm), ProductionElement(exprNonTerm) },
+        [](EvaluationContext& ctx) {
+            ctx.result() = stoi(ctx.SemanticValue(0)) < stoi(ctx.SemanticValue(2)) ? "1" : "0";
+        }
+);
+
+const ProductionRule andRule(
+        condNonTerm,
+        { ProductionElement(condNonTerm), ProductionElement(andTerm), ProductionElement(condNonTerm) },
+        [](EvaluationContext& ctx) {
+            ctx.result() = ctx.SemanticValue(0) == "1" && ctx.SemanticValue(2) == "1" ? "1" : "0";
+        },
+        [](LazyEvaluationContext& ctx) {
+            const bool value = ctx.Evaluate(0) == "1" && ctx.Evaluate(2) == "1";
+            ctx.result() = value ? "1" : "0";
+        }
+);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+
+/// Adds a variable to an expression node.
+void add_variable(TreeNode* node, const string& value)
+{
+    node->AddChildTerm(exprNonTerm, varRule)->AddChildTerm(varTerm, value);
+}
+
+TEST_CASE("Test lazy evaluation")
+{
+    // if x < 1 then y / 0 else 2 / x
+    SyntaxTree tree;
+    tree.SetRootRule(ifRule);
+    tree.Root()->AddChildTerm(ifTerm);
+    TreeNode* cond = tree.Root()->AddChildTerm(condNonTerm, lessRule);
+    add_variable(cond, "x");
+    cond->AddChildTerm(lessTerm);
+    add_variable(cond, "1");
+    tree.Root()->AddChildTerm(thenTerm);
+    TreeNode* thenBranch = tree.Root()->AddChildTerm(exprNonTerm, divideRule);
+    add_variable(thenBranch, "y");
+    thenBranch->AddChildTerm(divideTerm);
+    add_variable(thenBranch, "0");
+    tree.Root()->AddChildTerm(elseTerm);
+    TreeNode* elseBranch = tree.Root()->AddChildTerm(exprNonTerm, divideRule);
+    add_variable(elseBranch, "2");
+    elseBranch->AddChildTerm(divideTerm);
+    add_variable(elseBranch, "x");
+
+    // The eager evaluation computes every variable.
+    CountingLazyContext eagerContext(0, 5);
+    tree.Evaluate(static_cast<EvaluationContext&>(eagerContext));
+    CHECK((eagerContext.GetIntResult() == 0));
+    CHECK((eagerContext.variableEvaluations == 6));
+
+    // The lazy evaluation skips the else branch and the numerator of the division by zero.
+    CountingLazyContext lazyContext(0, 5);
+    tree.Evaluate(lazyContext);
+    CHECK((lazyContext.GetIntResult() == 0));
+    CHECK((lazyContext.variableEvaluations == 3));
+    CHECK(thenBranch->IsEvaluated());
+    CHECK((!thenBranch->children[0]->IsEvaluated()));
+    CHECK((!elseBranch->IsEvaluated()));
+
+    lazyContext = CountingLazyContext(2, 5);
+    tree.Evaluate(lazyContext);
+    CHECK((lazyContext.GetIntResult() == 1));
+    CHECK((lazyContext.variableEvaluations == 4));
+    CHECK((!thenBranch->IsEvaluated()));
+
+    // Production elements can only be evaluated inside a semantic action.
+    CHECK_THROWS((void)lazyContext.Evaluate(0));
+}
+
+TEST_CASE("Test lazy evaluation of random trees")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ ifRule, divideRule, varRule, lessRule, andRule };
+
+    int eagerEvaluations = 0, lazyEvaluations = 0;
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 8);
+
+        for (int x = -1; x <= 2; x++)
+        {
+            CountingLazyContext eagerContext(x, 3), lazyContext(x, 3);
+            tree.Evaluate(static_cast<EvaluationContext&>(eagerContext));
+            tree.Evaluate(lazyContext);
+            CHECK((lazyContext.result() == eagerContext.result()));
+            CHECK((lazyContext.variableEvaluations <= eagerContext.variableEvaluations));
+
+            eagerEvaluations += eagerContext.variableEvaluations;
+            lazyEvaluations += lazyContext.variableEvaluations;
+        }
+    }
+    CHECK((lazyEvaluations < eagerEvaluations));
+}
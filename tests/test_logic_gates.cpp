@@ -1,5 +1,7 @@
+#include <chrono>
 #include "doctest.h"
 #include "../include/gbgp.h"
+#include "test_helpers.h"
 using namespace std;
 using namespace gbgp;
 
@@ -13,6 +15,15 @@ public:
     bool x0{}, x1{};
     bool y0{}, y1{};
 };
+
+class BitSlicedBooleanContext : public BitSlicedEvaluationContext
+{
+public:
+    vector<uint64_t> y0, y1;
+
+    explicit BitSlicedBooleanContext(size_t rows) : BitSlicedEvaluationContext(rows) {}
+};
+
 //*****************************
 //*     Types declaration     *
 //****************************/
@@ -49,6 +60,12 @@ const ProductionRule rule1(
             booleanContext.y0 = stoi(ctx.SemanticValue(1));
             booleanContext.y1 = stoi(ctx.SemanticValue(3));
             ctx.result() = "{" + to_string(booleanContext.y0) + "," + to_string(booleanContext.y1) + "}";
+        },
+        [](BitSlicedEvaluationContext& ctx) {
+            auto& booleanContext = dynamic_cast<BitSlicedBooleanContext&>(ctx);
+            booleanContext.y0.assign(ctx.Column(1), ctx.Column(1) + ctx.ColumnSize());
+            booleanContext.y1.assign(ctx.Column(3), ctx.Column(3) + ctx.ColumnSize());
+            ctx.TransferColumnToResult(1);
         }
 );
 
@@ -75,6 +92,15 @@ const ProductionRule rule2(
                 r = a ^ b;
 
             ctx.result() = to_string(r);
+        },
+        [](BitSlicedEvaluationContext& ctx) {
+            const string& op = ctx.TerminalValue(0);
+            if (op == "And")
+                BitKernels::And(ctx.Column(2), ctx.Column(4), ctx.Result(), ctx.ColumnSize());
+            else if (op == "Or")
+                BitKernels::Or(ctx.Column(2), ctx.Column(4), ctx.Result(), ctx.ColumnSize());
+            else
+                BitKernels::Xor(ctx.Column(2), ctx.Column(4), ctx.Result(), ctx.ColumnSize());
         }
 );
 
@@ -89,6 +115,9 @@ const ProductionRule rule3(
         [](EvaluationContext& ctx) {
             bool a = stoi(ctx.SemanticValue(2));
             ctx.result() = to_string(!a);
+        },
+        [](BitSlicedEvaluationContext& ctx) {
+            BitKernels::Not(ctx.Column(2), ctx.Result(), ctx.ColumnSize());
         }
 );
 
@@ -107,6 +136,9 @@ const ProductionRule rule4(
                 r = booleanContext.x1;
 
             ctx.result() = to_string(r);
+        },
+        [](BitSlicedEvaluationContext& ctx) {
+            ctx.TransferColumnToResult(0);
         }
 );
 
@@ -136,6 +168,29 @@ double logic_fitness_function(SyntaxTree& solution)
     return (double) correct / 4.0;
 }
 
+/// The same fitness as logic_fitness_function, evaluating the four rows of the truth table in a single pass. The
+/// variable x0 is the lowest bit of the row index.
+double bit_sliced_logic_fitness_function(SyntaxTree& solution)
+{
+    const size_t rows = 4;
+    BitSlicedBooleanContext ctx(rows);
+    ctx.SetColumn("x0", BitKernels::TruthTableColumn(0, rows));
+    ctx.SetColumn("x1", BitKernels::TruthTableColumn(1, rows));
+    solution.Evaluate(ctx);
+
+    const vector<uint64_t> expectedY0 = BitKernels::Pack({ false, false, false, true });
+    const vector<uint64_t> expectedY1 = BitKernels::Pack({ false, true, true, false });
+
+    // A row is wrong if any output differs.
+    vector<uint64_t> wrongY0(ctx.ColumnSize()), wrongY1(ctx.ColumnSize()), wrong(ctx.ColumnSize());
+    BitKernels::Xor(ctx.y0.data(), expectedY0.data(), wrongY0.data(), ctx.ColumnSize());
+    BitKernels::Xor(ctx.y1.data(), expectedY1.data(), wrongY1.data(), ctx.ColumnSize());
+    BitKernels::Or(wrongY0.data(), wrongY1.data(), wrong.data(), ctx.ColumnSize());
+
+    const vector<uint64_t> none(ctx.ColumnSize(), 0);
+    return (double) (rows - BitKernels::HammingDistance(wrong.data(), none.data(), rows)) / (double) rows;
+}
+
 //*****************************
 //*       Test routines       *
 //****************************/
@@ -253,8 +308,8 @@ TEST_CASE("Test half adder optimization")
     SyntaxTree doubleNotX1(doubleNotExprFrom);
     std::vector<TreeNode*> doubleNotVariables = doubleNotX1.GetTermsOfType(NodeType::Terminal);
     for (TreeNode* node : doubleNotVariables)
-        if (node->termInstance == varTerm)
-            node->termValue = "x1";
+        if (node->GetTerminal() == varTerm)
+            node->SetValue("x1");
     CHECK(doubleNegationExpr.CanBeApplied(doubleNotX1));
     doubleNegationExpr.Apply(doubleNotX1);
     CHECK((doubleNotX1.SynthesizeExpression() == "x1"));
@@ -262,8 +317,8 @@ TEST_CASE("Test half adder optimization")
     SyntaxTree sameX0And(sameArgAndFrom);
     std::vector<TreeNode*> sameX0Variables = sameX0And.GetTermsOfType(NodeType::Terminal);
     for (TreeNode* node : sameX0Variables)
-        if (node->termInstance == varTerm)
-            node->termValue = "x0";
+        if (node->GetTerminal() == varTerm)
+            node->SetValue("x0");
     CHECK(sameArgAnd.CanBeApplied(sameX0And));
     sameArgAnd.Apply(sameX0And);
     CHECK((sameX0And.SynthesizeExpression() == "x0"));
@@ -273,12 +328,12 @@ TEST_CASE("Test half adder optimization")
     int variableIndex = 0;
     for (TreeNode* node : differentVariables)
     {
-        if (node->termInstance == varTerm)
-            node->termValue = variableIndex++ == 0 ? "x0" : "x1";
+        if (node->GetTerminal() == varTerm)
+            node->SetValue(variableIndex++ == 0 ? "x0" : "x1");
     }
     CHECK((variableIndex == 2));
-    CHECK((differentVariables[2]->termValue == "x0"));
-    CHECK((differentVariables[4]->termValue == "x1"));
+    CHECK((differentVariables[2]->GetValue() == "x0"));
+    CHECK((differentVariables[4]->GetValue() == "x1"));
     CHECK_FALSE(sameArgAnd.CanBeApplied(differentArgAnd));
 
     Grammar grammar ({ rule1, rule2, rule3, rule4 }, { doubleNegationExpr, sameArgAnd, sameArgOr });
@@ -297,3 +352,97 @@ TEST_CASE("Test half adder optimization")
 
     CHECK((fittest.GetFitness() == 1.0));
 }
+
+TEST_CASE("Test bit-sliced evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar({ rule1, rule2, rule3, rule4 });
+
+    for (int i = 0; i < 100; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 10);
+        CHECK((bit_sliced_logic_fitness_function(tree) == logic_fitness_function(tree)));
+    }
+
+    // The bits past the last row do not count.
+    const vector<uint64_t> ones = { ~0ULL, ~0ULL };
+    const vector<uint64_t> zeros = { 0, 0 };
+    CHECK((BitKernels::HammingDistance(ones.data(), zeros.data(), 70) == 70));
+    CHECK((BitKernels::HammingDistance(ones.data(), zeros.data(), 128) == 128));
+    CHECK((BitKernels::TruthTableColumn(6, 128) == vector<uint64_t>{ 0, ~0ULL }));
+}
+
+TEST_CASE("Benchmark bit-sliced parity fitness")
+{
+    SharedGeneratorGuard generatorGuard;
+
+    // Evolving the parity of ten inputs needs a truth table of 1024 rows.
+    const unsigned inputs = 10;
+    const size_t rows = size_t(1) << inputs;
+
+    vector<string> names;
+    for (unsigned i = 0; i < inputs; i++)
+        names.push_back("x" + to_string(i));
+
+    struct ParityContext : EvaluationContext
+    {
+        size_t row = 0;
+    };
+
+    const Terminal inputTerm(Var, "input", names);
+    const ProductionRule inputRule(
+            logExprNonTerm,
+            { ProductionElement(inputTerm) },
+            [](EvaluationContext& ctx) {
+                auto& parityContext = dynamic_cast<ParityContext&>(ctx);
+                const int variable = stoi(ctx.SemanticValue(0).substr(1));
+                ctx.result() = to_string((parityContext.row >> variable) & 1);
+            },
+            [](BitSlicedEvaluationContext& ctx) {
+                ctx.TransferColumnToResult(0);
+            }
+    );
+    Grammar grammar({ rule2, rule3, inputRule });
+
+    vector<bool> parity(rows);
+    for (size_t row = 0; row < rows; row++)
+        parity[row] = BitKernels::Popcount(row) % 2 == 1;
+    const vector<uint64_t> expected = BitKernels::Pack(parity);
+
+    BitSlicedEvaluationContext bitContext(rows);
+    for (unsigned i = 0; i < inputs; i++)
+        bitContext.SetColumn(names[i], BitKernels::TruthTableColumn(i, rows));
+
+    vector<SyntaxTree> trees(20);
+    for (SyntaxTree& tree : trees)
+        grammar.CreateRandomTree(tree, 8);
+
+    auto start = chrono::steady_clock::now();
+    vector<size_t> rowDistances;
+    for (SyntaxTree& tree : trees)
+    {
+        size_t distance = 0;
+        ParityContext ctx;
+        for (ctx.row = 0; ctx.row < rows; ctx.row++)
+        {
+            tree.Evaluate(ctx);
+            distance += (ctx.result() == "1") != parity[ctx.row];
+        }
+        rowDistances.push_back(distance);
+    }
+    chrono::duration<double, micro> rowElapsed = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    vector<size_t> bitDistances;
+    for (SyntaxTree& tree : trees)
+    {
+        tree.Evaluate(bitContext);
+        bitDistances.push_back(BitKernels::HammingDistance(bitContext.GetResultColumn(), expected.data(), rows));
+    }
+    chrono::duration<double, micro> bitElapsed = chrono::steady_clock::now() - start;
+
+    CHECK((bitDistances == rowDistances));
+    cout << "Row by row us/fitness: " << rowElapsed.count() / trees.size()
+         << ", bit-sliced us/fitness: " << bitElapsed.count() / trees.size() << endl;
+}
@@ -1,5 +1,6 @@
 #include "doctest.h"
 #include "../include/gbgp.h"
+#include "test_helpers.h"
 using namespace std;
 using namespace gbgp;
 
@@ -83,4 +84,254 @@ TEST_CASE("Test traversal copy/delete")
     std::vector<TreeNode*> copy = SyntaxTree::CopyTreeTraversal(traversal);
 
     SyntaxTree::DeleteTreeTraversal(copy);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test node symbol references")
+{
+    CHECK((sizeof(Node) <= 32));
+
+    // Copies of a rule share its identity while equivalent rules keep their own semantic action.
+    const ProductionRule rule2Copy = rule2;
+    const ProductionRule rule2Clone(exprNonTerm, { ProductionElement(termNonTerm) }, 0);
+    Node node(rule2, exprNonTerm);
+    Node nodeFromCopy(rule2Copy, exprNonTerm);
+    Node nodeFromClone(rule2Clone, exprNonTerm);
+    CHECK((node.generatorPRID == nodeFromCopy.generatorPRID));
+    CHECK((node.generatorPRID != nodeFromClone.generatorPRID));
+    CHECK((node == nodeFromClone));
+
+    // A copy that is modified afterwards keeps the identity of the original, but it does not share its symbol.
+    ProductionRule modifiedCopy = rule2;
+    modifiedCopy.to = { ProductionElement(factorNonTerm) };
+    Node nodeFromModifiedCopy(modifiedCopy, exprNonTerm);
+    CHECK((nodeFromModifiedCopy.generatorPRID != node.generatorPRID));
+    CHECK((nodeFromModifiedCopy.GetGeneratorPR().to == modifiedCopy.to));
+
+    ProductionRule copyWithAction = rule2;
+    copyWithAction.semanticAction = [](EvaluationContext& ctx) { ctx.SetResult("1"); };
+    Node nodeFromCopyWithAction(copyWithAction, exprNonTerm);
+    CHECK((nodeFromCopyWithAction.generatorPRID != node.generatorPRID));
+    CHECK((Node(copyWithAction, exprNonTerm).generatorPRID == nodeFromCopyWithAction.generatorPRID));
+
+    // Deserialized rules have a new identity and no semantic action. They are resolved to a registered rule with
+    // the same definition, so loading a rule many times does not register it again.
+    Node loaded, loadedAgain;
+    loaded.SetDeserializedGeneratorPR(ProductionRule(exprNonTerm, { ProductionElement(termNonTerm) }, nullptr));
+    loadedAgain.SetDeserializedGeneratorPR(ProductionRule(exprNonTerm, { ProductionElement(termNonTerm) }, nullptr));
+    CHECK((loaded.generatorPRID == loadedAgain.generatorPRID));
+    CHECK(loaded.GetGeneratorPR().SameRule(rule2));
+
+    // Terminals and values are shared by structure.
+    Node terminal(varTerm, "a");
+    Node sameTerminal(varTerm, "a");
+    CHECK((terminal.termID == sameTerminal.termID));
+    CHECK((terminal.termValueID == sameTerminal.termValueID));
+    CHECK((terminal.GetTerminal().values == varTerm.values));
+
+    sameTerminal.SetValue("b");
+    CHECK((sameTerminal.GetValue() == "b"));
+    CHECK((terminal.GetValue() == "a"));
+    CHECK((terminal != sameTerminal));
+
+    // Restoring the semantic action points the node to the grammar rule.
+    Grammar grammar{rule1, rule2, rule3, rule4, rule5, rule6};
+    Node restored(ProductionRule(exprNonTerm, { ProductionElement(termNonTerm) }, nullptr), exprNonTerm);
+    CHECK((restored.GetGeneratorPR().semanticAction == nullptr));
+    CHECK(grammar.RestoreSemanticAction(restored));
+    CHECK((restored.GetGeneratorPR().semanticAction != nullptr));
+}
+
+/// Makes a semantic action that always gives the same result. Every call makes a lambda of the same type.
+std::function<void(EvaluationContext&)> memory_constant_action(const std::string& value)
+{
+    return [value](EvaluationContext& ctx) { ctx.SetResult(value); };
+}
+
+/// Evaluates an EXPR -> TERM -> FACTOR -> var tree whose root is built from the given rule.
+std::string evaluate_with_root_rule(const ProductionRule& rootRule)
+{
+    SyntaxTree tree(new TreeNode(rootRule, exprNonTerm, { TreeNode(rule4, termNonTerm, {
+        TreeNode(rule6, factorNonTerm, { TreeNode(varTerm, "a") }) }) }));
+    EvaluationContext ctx;
+    tree.Evaluate(ctx);
+    return ctx.result();
+}
+
+TEST_CASE("Test copies of a rule with replaced semantic actions")
+{
+    // The replaced actions have the same type, so only their identity tells the copies apart.
+    ProductionRule first = rule2;
+    first.semanticAction = memory_constant_action("1");
+    ProductionRule second = first;
+    second.semanticAction = memory_constant_action("2");
+
+    Node nodeFromFirst(first, exprNonTerm);
+    Node nodeFromSecond(second, exprNonTerm);
+    CHECK((nodeFromFirst.generatorPRID != nodeFromSecond.generatorPRID));
+    CHECK((evaluate_with_root_rule(second) == "2"));
+    CHECK((evaluate_with_root_rule(first) == "1"));
+
+    // Copying an action keeps its identity.
+    ProductionRule third = first;
+    third.semanticAction = first.semanticAction;
+    CHECK((Node(third, exprNonTerm).generatorPRID == nodeFromFirst.generatorPRID));
+}
+
+TEST_CASE("Test symbol table releases unused symbols")
+{
+    SymbolTable& table = SymbolTable::Instance();
+    const size_t values = table.Size(SymbolKind::Value);
+    const size_t rules = table.Size(SymbolKind::Rule);
+
+    {
+        std::vector<Node> nodes;
+        for (int i = 0; i < 100000; i++)
+            nodes.emplace_back(varTerm, "released value " + std::to_string(i));
+        CHECK((table.Size(SymbolKind::Value) == values + 100000));
+
+        const Node copy = nodes[0];
+        nodes.clear();
+        CHECK((table.Size(SymbolKind::Value) == values + 1));
+        CHECK((copy.GetValue() == "released value 0"));
+    }
+    CHECK((table.Size(SymbolKind::Value) == values));
+
+    // The IDs of the released symbols are reused.
+    SymbolID reusedID;
+    {
+        reusedID = Node(varTerm, "released value").termValueID;
+        Node node(varTerm, "another released value");
+        CHECK((node.termValueID == reusedID));
+        node.SetValue("released value");
+        CHECK((node.GetValue() == "released value"));
+    }
+    CHECK((table.Size(SymbolKind::Value) == values));
+
+    // A compiled tree keeps the rules and values of the tree after the tree is destroyed.
+    CompiledSyntaxTree program;
+    {
+        ProductionRule temporaryRule = rule2;
+        temporaryRule.semanticAction = memory_constant_action("compiled");
+        SyntaxTree tree(new TreeNode(temporaryRule, exprNonTerm, { TreeNode(rule4, termNonTerm, {
+            TreeNode(rule6, factorNonTerm, { TreeNode(varTerm, "compiled value") }) }) }));
+        program = CompiledSyntaxTree(tree);
+    }
+    CHECK((table.Size(SymbolKind::Rule) >= rules + 1));
+    EvaluationContext ctx;
+    program.Evaluate(ctx);
+    CHECK((ctx.result() == "compiled"));
+
+    program = CompiledSyntaxTree();
+    CHECK((table.Size(SymbolKind::Rule) == rules));
+    CHECK((table.Size(SymbolKind::Value) == values));
+}
+
+TEST_CASE("Test concurrent interning of symbols")
+{
+    SymbolTable& table = SymbolTable::Instance();
+    const size_t values = table.Size(SymbolKind::Value);
+
+    // The threads create and destroy nodes with overlapping values, so symbols are released and registered again
+    // while other threads look them up.
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatches{ 0 };
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([t, &mismatches]() {
+            for (int i = 0; i < 20000; i++)
+            {
+                const std::string value = "concurrent value " + std::to_string((i + t) % 64);
+                Node node(varTerm, value);
+                const Node copy = node;
+                if (copy.GetValue() != value || Node(rule2, exprNonTerm).GetGeneratorPR().to != rule2.to)
+                    mismatches++;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    CHECK((mismatches == 0));
+    CHECK((table.Size(SymbolKind::Value) == values));
+}
+
+/// Counts the tree nodes owned by the individuals of a population.
+long long count_population_nodes(Population& population)
+{
+    long long nodes = 0;
+    for (Individual& individual : population.GetIndividuals())
+        nodes += static_cast<long long>(individual.GetTree().GetPostOrderTreeTraversal().size());
+    return nodes;
+}
+
+TEST_CASE("Test node ownership soak")
+{
+    SharedGeneratorGuard generatorGuard;
+    const long long baseline = TreeNode::GetLiveNodeCount();
+    {
+        SyntaxTree removeParenthesisFrom(
+                TreeNode(rule5, factorNonTerm, {
+                    TreeNode(leftParenthesisTerm, "("),
+                    TreeNode(rule2, exprNonTerm, {
+                        TreeNode(rule4, termNonTerm, {
+                            TreeNode(rule6, factorNonTerm, { TreeNode(varTerm, 1) })
+                        })
+                    }),
+                    TreeNode(rightParenthesisTerm, ")")
+                })
+        );
+        SyntaxTree removeParenthesisTo(TreeNode(rule6, factorNonTerm, { TreeNode(varTerm, 1) }));
+
+        PruneRule removeParenthesis(removeParenthesisFrom, removeParenthesisTo);
+
+        // The rule keeps working after the trees used to build it are gone.
+        removeParenthesisFrom.Destroy();
+        removeParenthesisTo.Destroy();
+
+        Grammar grammar({ rule1, rule2, rule3, rule4, rule5, rule6 }, { removeParenthesis });
+        auto fitness = [](SyntaxTree& tree) {
+            return 1.0 / (1.0 + std::abs(static_cast<double>(tree.SynthesizeExpression().size()) - 15.0));
+        };
+        Environment env(grammar, fitness, 20, 4, 2, 2, 0.4);
+        Population& population = env.GetPopulation();
+
+        // Nodes owned by the grammars and prune rules stay constant, every other live node belongs to an individual.
+        const long long overhead = TreeNode::GetLiveNodeCount() - count_population_nodes(population);
+
+        for (int generation = 0; generation < 1000; generation++)
+        {
+            env.Optimize();
+
+            // Graph round trips, assignments and prunes of a copy of an individual.
+            SyntaxTree& tree = population.GetIndividual(0).GetTree();
+            SyntaxTree roundTrip(tree.ToGraph());
+            REQUIRE((roundTrip.SynthesizeExpression() == tree.SynthesizeExpression()));
+
+            SyntaxTree assigned = roundTrip;
+            assigned = tree;
+            assigned = std::move(roundTrip);
+            removeParenthesis.Apply(assigned);
+
+            // Replacing the root of a tree releases the previous root.
+            SyntaxTree replacement = SyntaxTree::CopySubtree(assigned.Root());
+            assigned.InsertSubtree(assigned.Root(), replacement);
+
+            REQUIRE((TreeNode::GetLiveNodeCount() - count_population_nodes(population) - overhead ==
+                     static_cast<long long>(assigned.GetPostOrderTreeTraversal().size() +
+                                            replacement.GetPostOrderTreeTraversal().size())));
+        }
+    }
+    CHECK((TreeNode::GetLiveNodeCount() == baseline));
+}
+
+TEST_CASE("Test graph to tree validation")
+{
+    Graph cyclic({ Node(exprNonTerm), Node(exprNonTerm), Node(exprNonTerm) }, { { 0, 1 }, { 1, 2 }, { 2, 1 } });
+    Graph disconnected({ Node(exprNonTerm), Node(exprNonTerm) }, {});
+
+    const long long baseline = TreeNode::GetLiveNodeCount();
+    CHECK_THROWS(SyntaxTree{ cyclic });
+    CHECK_THROWS(SyntaxTree{ disconnected });
+    CHECK((TreeNode::GetLiveNodeCount() == baseline));
+    CHECK(SyntaxTree(Graph()).IsEmpty());
+}
@@ -0,0 +1,465 @@
+#include <chrono>
+#include <iomanip>
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class BenchmarkContext : public EvaluationContext
+{
+public:
+    int x{};
+
+    explicit BenchmarkContext(int px) : x(px) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+class TypedBenchmarkContext : public IntEvaluationContext
+{
+public:
+    int64_t x{}, y{};
+
+    explicit TypedBenchmarkContext(int64_t px) : x(px) {}
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& benchmarkContext = dynamic_cast<BenchmarkContext&>(ctx);
+            benchmarkContext.SetIntResult(benchmarkContext.GetIntSemanticValue(0) + benchmarkContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& benchmarkContext = dynamic_cast<BenchmarkContext&>(ctx);
+            benchmarkContext.SetIntResult(benchmarkContext.GetIntSemanticValue(0) * benchmarkContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& benchmarkContext = dynamic_cast<BenchmarkContext&>(ctx);
+            benchmarkContext.SetIntResult(ctx.SemanticValue(0) == "x" ? benchmarkContext.x : 1);
+        }
+);
+
+// Typed versions of the rules with custom semantic actions, which can also be evaluated in batch.
+const TypedArithmeticRules<TypedBenchmarkContext> typedRules(rule1, rule3, rule6);
+
+//*****************************
+//*     Benchmark helpers     *
+//****************************/
+
+/// Builds the left-deep tree of the expression x+x*1+x*1+...+x*1 with the specified number of additions.
+SyntaxTree build_chain_tree(int additions)
+{
+    SyntaxTree tree;
+    tree.SetRootRule(rule1);
+
+    TreeNode* expr = tree.Root();
+    for (int i = 0; i < additions; i++)
+    {
+        TreeNode* leftExpr = expr->AddChildTerm(exprNonTerm, i == additions - 1 ? rule2 : rule1);
+        expr->AddChildTerm(plusTerm);
+        TreeNode* rightTerm = expr->AddChildTerm(termNonTerm, rule3);
+
+        TreeNode* rightLeftTerm = rightTerm->AddChildTerm(termNonTerm, rule4);
+        rightLeftTerm->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "x");
+        rightTerm->AddChildTerm(timesTerm);
+        rightTerm->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "1");
+
+        expr = leftExpr;
+    }
+
+    TreeNode* leafTerm = expr->AddChildTerm(termNonTerm, rule4);
+    leafTerm->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "x");
+
+    return tree;
+}
+
+/// Copies a subtree with the general purpose allocator instead of the node pool.
+TreeNode* heap_copy(const TreeNode* node)
+{
+    auto* copy = ::new TreeNode(static_cast<const Node&>(*node));
+    for (const auto& child : node->children)
+        copy->AddChildNode(heap_copy(child.get()));
+    return copy;
+}
+
+/// Releases a subtree created by heap_copy node by node, from its post-order traversal. Children are detached before
+/// releasing their parent, as they were not allocated from the node pool.
+void heap_release(TreeNode* root)
+{
+    for (TreeNode* node : SyntaxTree::GetPostOrderTreeTraversal(root))
+    {
+        for (auto& child : node->children)
+            (void) child.release();
+        ::delete node;
+    }
+}
+
+/// Measures the mean time in microseconds of running a function.
+template<typename F> double mean_microseconds(F&& f, int repetitions)
+{
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < repetitions; i++)
+        f();
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    return elapsed.count() / repetitions;
+}
+
+//*****************************
+//*       Test routines       *
+//****************************/
+TEST_CASE("Benchmark evaluation scaling")
+{
+    cout << "Nodes\t|\tus/eval\t|\tns/node" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        const size_t nodes = tree.GetPostOrderTreeTraversal().size();
+
+        BenchmarkContext ctx(3);
+        tree.Evaluate(ctx);
+        CHECK((ctx.GetIntResult() == 3 * (additions + 1)));
+
+        const int repetitions = max(1, 200000 / static_cast<int>(nodes));
+        double us = mean_microseconds([&]() { tree.Evaluate(ctx); }, repetitions);
+
+        ostringstream row;
+        row << nodes << "\t|\t" << fixed << setprecision(2) << us << "\t|\t" << 1000.0 * us / nodes;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark typed evaluation")
+{
+    cout << "Nodes\t|\tString us/eval\t|\tTyped us/eval" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        SyntaxTree typedTree = typedRules.TypedCopy(tree);
+        const size_t nodes = tree.GetPostOrderTreeTraversal().size();
+        const int repetitions = max(1, 200000 / static_cast<int>(nodes));
+
+        BenchmarkContext ctx(3);
+        double stringUs = mean_microseconds([&]() { tree.Evaluate(ctx); }, repetitions);
+
+        TypedBenchmarkContext typedCtx(3);
+        double typedUs = mean_microseconds([&]() { typedTree.Evaluate(typedCtx); }, repetitions);
+
+        CHECK((typedCtx.GetTypedResult() == ctx.GetIntResult()));
+
+        ostringstream row;
+        row << nodes << "\t|\t" << fixed << setprecision(2) << stringUs << "\t|\t" << typedUs;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark compiled evaluation")
+{
+    cout << "Nodes\t|\tTree us/eval\t|\tCompiled us/eval\t|\tClosure us/eval\t|\tTyped tree us/eval\t|\tTyped compiled us/eval\t|\tTyped closure us/eval" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        SyntaxTree typedTree = typedRules.TypedCopy(tree);
+        const CompiledSyntaxTree program(tree);
+        const CompiledSyntaxTree typedProgram(typedTree);
+        const ClosureSyntaxTree closureTree(tree);
+        const TypedClosureSyntaxTree<int64_t> typedClosureTree(typedTree);
+        const size_t nodes = tree.GetPostOrderTreeTraversal().size();
+        const int repetitions = max(1, 200000 / static_cast<int>(nodes));
+
+        // Every repetition evaluates a different row.
+        BenchmarkContext ctx(0);
+        double treeUs = mean_microseconds([&]() { ctx.x++; tree.Evaluate(ctx); }, repetitions);
+        const int treeResult = ctx.GetIntResult();
+
+        ctx.x = 0;
+        double compiledUs = mean_microseconds([&]() { ctx.x++; program.Evaluate(ctx); }, repetitions);
+        CHECK((ctx.GetIntResult() == treeResult));
+
+        ctx.x = 0;
+        double closureUs = mean_microseconds([&]() { ctx.x++; closureTree.Evaluate(ctx); }, repetitions);
+        CHECK((ctx.GetIntResult() == treeResult));
+
+        TypedBenchmarkContext typedCtx(0);
+        double typedTreeUs = mean_microseconds([&]() { typedCtx.x++; typedTree.Evaluate(typedCtx); }, repetitions);
+        CHECK((typedCtx.GetTypedResult() == treeResult));
+
+        typedCtx.x = 0;
+        double typedCompiledUs = mean_microseconds([&]() { typedCtx.x++; typedProgram.Evaluate(typedCtx); }, repetitions);
+        CHECK((typedCtx.GetTypedResult() == treeResult));
+
+        typedCtx.x = 0;
+        double typedClosureUs = mean_microseconds([&]() { typedCtx.x++; typedClosureTree.Evaluate(typedCtx); }, repetitions);
+        CHECK((typedCtx.GetTypedResult() == treeResult));
+
+        ostringstream row;
+        row << nodes << "\t|\t" << fixed << setprecision(2) << treeUs << "\t|\t" << compiledUs << "\t|\t"
+            << closureUs << "\t|\t" << typedTreeUs << "\t|\t" << typedCompiledUs << "\t|\t" << typedClosureUs;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark batch evaluation")
+{
+    cout << "Nodes\t|\tRows\t|\tTyped compiled rows/s\t|\tBatch rows/s\t|\tBatch compiled rows/s" << endl;
+
+    for (int additions : { 16, 256 })
+    {
+        SyntaxTree typedTree = typedRules.TypedCopy(build_chain_tree(additions));
+        const CompiledSyntaxTree program(typedTree);
+        const size_t nodes = typedTree.GetPostOrderTreeTraversal().size();
+
+        for (size_t rows : { 64, 1024, 16384 })
+        {
+            vector<double> xs(rows);
+            for (size_t i = 0; i < rows; i++)
+                xs[i] = static_cast<double>(i);
+
+            BatchEvaluationContext batchCtx(rows);
+            batchCtx.SetColumn("x", xs);
+            const int repetitions = max(1, static_cast<int>(20000000 / (nodes * rows)));
+
+            TypedBenchmarkContext typedCtx(0);
+            double rowUs = mean_microseconds([&]() {
+                for (size_t i = 0; i < rows; i++)
+                {
+                    typedCtx.x = static_cast<int64_t>(i);
+                    program.Evaluate(typedCtx);
+                }
+            }, repetitions);
+
+            double batchUs = mean_microseconds([&]() { typedTree.Evaluate(batchCtx); }, repetitions);
+            double batchCompiledUs = mean_microseconds([&]() { program.Evaluate(batchCtx); }, repetitions);
+
+            // The last row is x = rows - 1, so the expression adds up to (additions + 1) * (rows - 1).
+            CHECK((typedCtx.GetTypedResult() == static_cast<int64_t>((additions + 1) * (rows - 1))));
+            CHECK((batchCtx.GetResultColumn()[rows - 1] == static_cast<double>((additions + 1) * (rows - 1))));
+
+            ostringstream row;
+            row << nodes << "\t|\t" << rows << "\t|\t" << scientific << setprecision(2) << rows / rowUs * 1e6
+                << "\t|\t" << rows / batchUs * 1e6 << "\t|\t" << rows / batchCompiledUs * 1e6;
+            cout << row.str() << endl;
+        }
+    }
+}
+
+TEST_CASE("Benchmark synthesis scaling")
+{
+    cout << "Nodes\t|\tus/synthesis\t|\tns/node" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        const size_t nodes = tree.GetPostOrderTreeTraversal().size();
+
+        string expression = tree.SynthesizeExpression();
+        CHECK((expression.size() == 4 * static_cast<size_t>(additions) + 1));
+
+        const int repetitions = max(1, 200000 / static_cast<int>(nodes));
+        double us = mean_microseconds([&]() { expression.clear(); tree.SynthesizeExpression(expression); }, repetitions);
+
+        ostringstream row;
+        row << nodes << "\t|\t" << fixed << setprecision(2) << us << "\t|\t" << 1000.0 * us / nodes;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark tree traversals")
+{
+    cout << "Nodes\t|\tVector us\t|\tBuffer us\t|\tIterator us" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        const size_t nodes = tree.GetPostOrderTreeTraversal().size();
+        const int repetitions = max(1, 2000000 / static_cast<int>(nodes));
+
+        size_t visited = 0;
+        double vectorUs = mean_microseconds([&]() { visited += tree.GetPostOrderTreeTraversal().size(); }, repetitions);
+
+        Traversal buffer;
+        double bufferUs = mean_microseconds([&]() { tree.GetPostOrderTreeTraversal(buffer); visited += buffer.size(); }, repetitions);
+
+        double iteratorUs = mean_microseconds([&]() {
+            for (TreeNode* node : tree.PostOrder())
+                visited += node != nullptr;
+        }, repetitions);
+
+        CHECK((visited == 3 * nodes * repetitions));
+
+        ostringstream row;
+        row << nodes << "\t|\t" << fixed << setprecision(2) << vectorUs << "\t|\t" << bufferUs << "\t|\t" << iteratorUs;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark cached subtree metadata")
+{
+    cout << "Nodes\t|\tTraversal size us\t|\tCached size us\t|\tCached hash us" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        const Traversal nodes = tree.GetPostOrderTreeTraversal();
+        const int repetitions = max(1, 2000000 / static_cast<int>(nodes.size()));
+
+        // The deepest leaf changes before each query, which invalidates the longest path of the tree, the worst case.
+        TreeNode* leaf = nodes.front();
+        size_t total = 0;
+        double traversalUs = mean_microseconds([&, i = 0]() mutable {
+            leaf->SetValue(i++ % 2 ? "x" : "1");
+            total += tree.GetPostOrderTreeTraversal().size();
+        }, repetitions);
+
+        double sizeUs = mean_microseconds([&, i = 0]() mutable {
+            leaf->SetValue(i++ % 2 ? "x" : "1");
+            total += tree.Size();
+        }, repetitions);
+
+        double hashUs = mean_microseconds([&, i = 0]() mutable {
+            leaf->SetValue(i++ % 2 ? "x" : "1");
+            total += tree.StructuralHash() != 0;
+        }, repetitions);
+
+        CHECK((total == (2 * nodes.size() + 1) * repetitions));
+
+        ostringstream row;
+        row << nodes.size() << "\t|\t" << fixed << setprecision(2) << traversalUs << "\t|\t" << sizeUs << "\t|\t" << hashUs;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark node allocation and release")
+{
+    cout << "Nodes\t|\tHeap copy us\t|\tHeap release us\t|\tPool copy us\t|\tPool release us" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        SyntaxTree tree = build_chain_tree(additions);
+        const size_t nodes = tree.GetPostOrderTreeTraversal().size();
+        const int repetitions = max(1, 200000 / static_cast<int>(nodes));
+
+        vector<TreeNode*> heapCopies(repetitions);
+        double heapCopyUs = mean_microseconds([&, i = 0]() mutable { heapCopies[i++] = heap_copy(tree.Root()); }, repetitions);
+        double heapReleaseUs = mean_microseconds([&, i = 0]() mutable { heap_release(heapCopies[i++]); }, repetitions);
+
+        vector<SyntaxTree> poolCopies(repetitions);
+        double poolCopyUs = mean_microseconds([&, i = 0]() mutable { poolCopies[i++].SetRoot(new TreeNode(*tree.Root())); }, repetitions);
+        double poolReleaseUs = mean_microseconds([&, i = 0]() mutable { poolCopies[i++].Destroy(); }, repetitions);
+
+        CHECK(all_of(poolCopies.begin(), poolCopies.end(), [](const SyntaxTree& t) { return t.IsEmpty(); }));
+
+        ostringstream row;
+        row << nodes << "\t|\t" << fixed << setprecision(2) << heapCopyUs << "\t|\t" << heapReleaseUs << "\t|\t"
+            << poolCopyUs << "\t|\t" << poolReleaseUs;
+        cout << row.str() << endl;
+    }
+}
+
+TEST_CASE("Benchmark crossover with structural sharing")
+{
+    cout << "Nodes\t|\tCopy crossover us\t|\tShared crossover us" << endl;
+
+    for (int additions : { 4, 16, 64, 256, 1024 })
+    {
+        const SyntaxTree parent1 = build_chain_tree(additions);
+        const SyntaxTree parent2 = build_chain_tree(additions);
+        const SharedSyntaxTree sharedParent1(parent1);
+        const SharedSyntaxTree sharedParent2(parent2);
+
+        // Pre-order positions of the EXPR nodes that can be replaced.
+        const Traversal nodes = parent1.GetPreOrderTreeTraversal();
+        vector<size_t> positions;
+        for (size_t i = 1; i < nodes.size(); i++)
+        {
+            if (nodes[i]->type == NodeType::NonTerminal && nodes[i]->GetNonTerminal() == exprNonTerm)
+                positions.push_back(i);
+        }
+
+        const int repetitions = max(1, 200000 / static_cast<int>(nodes.size()));
+        vector<pair<size_t, size_t>> crossovers(repetitions);
+        for (auto& [position1, position2] : crossovers)
+        {
+            position1 = *random_choice(positions.begin(), positions.end());
+            position2 = *random_choice(positions.begin(), positions.end());
+        }
+
+        double copyUs = mean_microseconds([&, i = 0]() mutable {
+            const auto [position1, position2] = crossovers[i++];
+            SyntaxTree offspring = parent1;
+            offspring.InsertSubtree(offspring.GetPreOrderTreeTraversal()[position1], nodes[position2]);
+        }, repetitions);
+
+        double sharedUs = mean_microseconds([&, i = 0]() mutable {
+            const auto [position1, position2] = crossovers[i++];
+            SharedSyntaxTree offspring = sharedParent1;
+            offspring.ReplaceSubtree(position1, sharedParent2.NodeAt(position2));
+        }, repetitions);
+
+        ostringstream row;
+        row << nodes.size() << "\t|\t" << fixed << setprecision(2) << copyUs << "\t|\t" << sharedUs;
+        cout << row.str() << endl;
+    }
+}
@@ -1,6 +1,8 @@
+#include <chrono>
 #include <numeric>
 #include "doctest.h"
 #include "../include/gbgp.h"
+#include "test_helpers.h"
 using namespace std;
 using namespace gbgp;
 
@@ -148,4 +150,286 @@ TEST_CASE("Test population initialization")
 
     Individual fittest = population.GetFittestByRank(0);
     CHECK((fittest.GetFitness() > 0.0));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test population move semantics")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    // Moving a tree transfers its nodes without copying them.
+    SyntaxTree tree;
+    grammar.CreateRandomTree(tree);
+    const string expression = tree.SynthesizeExpression();
+    TreeNode* root = tree.Root();
+
+    SyntaxTree movedTree(std::move(tree));
+    CHECK(tree.IsEmpty());
+    CHECK((movedTree.Root() == root));
+
+    SyntaxTree assignedTree;
+    grammar.CreateRandomTree(assignedTree);
+    assignedTree = std::move(movedTree);
+    CHECK(movedTree.IsEmpty());
+    CHECK((assignedTree.Root() == root));
+    CHECK((assignedTree.SynthesizeExpression() == expression));
+
+    SyntaxTree copiedTree;
+    copiedTree = assignedTree;
+    CHECK((copiedTree.Root() != root));
+    CHECK((copiedTree.SynthesizeExpression() == expression));
+
+    // Individuals moved into a population keep their trees.
+    Population population(grammar, fitness_function_pop);
+    Individual individual(fitness_function_pop, std::move(assignedTree));
+    CHECK((individual.GetTree().Root() == root));
+
+    population.AddIndividual(std::move(individual));
+    CHECK((population.GetIndividual(0).GetTree().Root() == root));
+
+    vector<Individual> individuals(2, Individual(fitness_function_pop));
+    for (Individual& ind : individuals)
+        ind.CreateRandom(grammar);
+    TreeNode* secondRoot = individuals[1].GetTree().Root();
+    population.AddIndividuals(std::move(individuals));
+    CHECK((population.Size() == 3));
+    CHECK((population.GetIndividual(2).GetTree().Root() == secondRoot));
+
+    // Individuals selected once survive the reduction without being copied.
+    population.ReducePopulation({ 2, 0, 0 });
+    CHECK((population.Size() == 3));
+    CHECK((population.GetIndividual(0).GetTree().Root() == secondRoot));
+    CHECK((population.GetIndividual(2).GetTree().Root() == root));
+    CHECK((population.GetIndividual(1).GetExpression() == expression));
+}
+
+TEST_CASE("Test fitness cache")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    atomic<int> evaluations{ 0 };
+    auto counting_fitness_function = [&evaluations](SyntaxTree& solution) {
+        evaluations++;
+        return fitness_function_pop(solution);
+    };
+
+    for (RuntimeMode runtimeMode : { RuntimeMode::SingleThread, RuntimeMode::MultiThread })
+    {
+        auto fitnessCache = make_shared<FitnessCache>(1000);
+        Population population(grammar, counting_fitness_function);
+        population.SetFitnessCache(fitnessCache);
+        population.Initialize(50);
+
+        // Duplicates of the first individuals, as added back by elitism.
+        for (size_t i = 0; i < 10; i++)
+        {
+            Individual duplicate = population.GetIndividual(i);
+            population.AddIndividual(duplicate);
+        }
+
+        evaluations = 0;
+        population.Evaluate(runtimeMode);
+        CHECK((evaluations == static_cast<int>(fitnessCache->Misses())));
+        CHECK((fitnessCache->Hits() + fitnessCache->Misses() == 60));
+        if (runtimeMode == RuntimeMode::SingleThread)
+            CHECK((fitnessCache->Hits() >= 10));
+
+        // Every cached fitness equals the fitness of a fresh evaluation.
+        for (Individual& ind : population.GetIndividuals())
+            CHECK((ind.GetFitness() == fitness_function_pop(ind.GetTree())));
+
+        // The next evaluation of the same individuals does not call the fitness function.
+        evaluations = 0;
+        population.Evaluate(runtimeMode);
+        CHECK((evaluations == 0));
+    }
+
+    // Trees that only differ in the rule of a node do not share a fitness.
+    FitnessCache ruleCache(10);
+    SyntaxTree tree;
+    grammar.CreateRandomTree(tree, 10);
+    SyntaxTree changed = tree;
+    ProductionRule modifiedRule = changed.Root()->GetGeneratorPR();
+    modifiedRule.semanticAction = [](EvaluationContext& ctx) { ctx.result() = "0"; };
+    changed.Root()->SetGeneratorPR(modifiedRule);
+
+    double fitness = 0.0;
+    ruleCache.Insert(tree, 1.0);
+    CHECK((ruleCache.Find(SyntaxTree(tree), fitness)));
+    CHECK((fitness == 1.0));
+    CHECK((!ruleCache.Find(changed, fitness)));
+
+    // The environment reports the hit rate of every generation.
+    Environment environment(grammar, counting_fitness_function, 100, 50, 5, 5, 0.2);
+    environment.SetFitnessCache(make_shared<FitnessCache>(10000));
+    environment.Optimize(3);
+
+    const vector<FitnessCacheStatistics>& history = environment.GetFitnessCacheHistory();
+    CHECK((history.size() == 3));
+    for (const FitnessCacheStatistics& statistics : history)
+    {
+        cout << "Fitness cache hits: " << statistics.hits << ", misses: " << statistics.misses
+             << ", hit rate: " << statistics.HitRate() << endl;
+        CHECK((statistics.hits + statistics.misses > 0));
+    }
+    CHECK((history.back().hits > 0));
+}
+
+TEST_CASE("Test shared executor")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    auto executor = make_shared<Executor>(2);
+    CHECK((executor->GetThreadCount() == 2));
+
+    // Every index runs once, and the exceptions reach the caller.
+    vector<atomic<int>> calls(100);
+    executor->ParallelFor(calls.size(), [&calls](size_t i) { calls[i]++; });
+    CHECK(all_of(calls.begin(), calls.end(), [](const atomic<int>& c) { return c == 1; }));
+    CHECK_THROWS(executor->ParallelFor(10, [](size_t i) { if (i == 5) throw runtime_error("Failed task"); }));
+
+    // A nested loop runs in the calling worker instead of waiting on its own pool.
+    atomic<int> nestedCalls{ 0 };
+    executor->ParallelFor(4, [&executor, &nestedCalls](size_t) {
+        executor->ParallelFor(4, [&nestedCalls](size_t) { nestedCalls++; });
+    });
+    CHECK((nestedCalls == 16));
+
+    // The population evaluates in the given executor, with the same fitness as in a single thread.
+    Population population(grammar, fitness_function_pop);
+    population.SetExecutor(executor);
+    population.Initialize(50);
+    population.Evaluate(RuntimeMode::MultiThread);
+    CHECK((population.GetExecutor() == executor));
+    for (Individual& ind : population.GetIndividuals())
+        CHECK((ind.GetFitness() == fitness_function_pop(ind.GetTree())));
+
+    // The environment reuses the executor in every generation.
+    Environment environment(grammar, fitness_function_pop, 100, 50, 5, 5, 0.2, RuntimeMode::MultiThread, executor);
+    environment.Optimize(3);
+    CHECK((environment.GetExecutor() == executor));
+    CHECK((environment.GetPopulation().GetExecutor() == executor));
+
+    // Without an executor, the first multithread evaluation creates one that is kept by the following generations.
+    Environment defaultEnvironment(grammar, fitness_function_pop, 100, 50, 5, 5, 0.2, RuntimeMode::MultiThread);
+    const shared_ptr<Executor> defaultExecutor = defaultEnvironment.GetExecutor();
+    CHECK((defaultExecutor != nullptr));
+    defaultEnvironment.Optimize(2);
+    CHECK((defaultEnvironment.GetExecutor() == defaultExecutor));
+}
+
+TEST_CASE("Benchmark shared executor")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    // With a cheap fitness function, the evaluation time is dominated by the thread startup.
+    auto size_fitness_function = [](SyntaxTree& solution) { return static_cast<double>(solution.Size()); };
+    Population population(grammar, size_fitness_function);
+    population.Initialize(200);
+    const int evaluations = 50;
+
+    // A new pool on each evaluation, as the multithread mode did before the executor was shared.
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < evaluations; i++)
+    {
+        population.SetExecutor(make_shared<Executor>());
+        population.Evaluate(RuntimeMode::MultiThread);
+    }
+    chrono::duration<double, milli> newPoolElapsed = chrono::steady_clock::now() - start;
+
+    const auto executor = make_shared<Executor>();
+    population.SetExecutor(executor);
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < evaluations; i++)
+        population.Evaluate(RuntimeMode::MultiThread);
+    chrono::duration<double, milli> sharedElapsed = chrono::steady_clock::now() - start;
+
+    cout << "Threads: " << executor->GetThreadCount() << ", new pool ms/evaluation: " << newPoolElapsed.count() / evaluations
+         << ", shared executor ms/evaluation: " << sharedElapsed.count() / evaluations << endl;
+}
+
+TEST_CASE("Test cost-aware scheduling")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    // A single worker runs the most expensive tasks first.
+    Executor singleWorker(1);
+    vector<size_t> order;
+    ExecutorStatistics statistics = singleWorker.ParallelFor({ 1.0, 5.0, 3.0, 10.0 }, [&order](size_t i) { order.push_back(i); });
+    CHECK((order == vector<size_t>{ 3, 1, 2, 0 }));
+    CHECK((statistics.threads == 1));
+    CHECK((statistics.tasks == 4));
+    CHECK((statistics.chunks == 4));
+
+    // Tiny tasks are grouped into a few chunks per worker.
+    Executor executor(2);
+    vector<atomic<int>> calls(1000);
+    statistics = executor.ParallelFor(calls.size(), [&calls](size_t i) { calls[i]++; });
+    CHECK(all_of(calls.begin(), calls.end(), [](const atomic<int>& c) { return c == 1; }));
+    CHECK((statistics.tasks == 1000));
+    CHECK((statistics.chunks == 16));
+    CHECK((statistics.makespan >= 0.0));
+    CHECK((statistics.idleTime >= 0.0));
+    CHECK((statistics.IdleFraction() <= 1.0));
+
+    // Every policy gives the same fitness values.
+    for (SchedulingPolicy policy : { SchedulingPolicy::PopulationOrder, SchedulingPolicy::LargestTreeFirst, SchedulingPolicy::LearnedCost })
+    {
+        Population population(grammar, fitness_function_pop);
+        population.SetExecutor(make_shared<Executor>(2));
+        population.SetSchedulingPolicy(policy);
+        population.Initialize(50);
+        population.Evaluate(RuntimeMode::MultiThread);
+        population.Evaluate(RuntimeMode::MultiThread);
+
+        CHECK((population.GetEvaluationStatistics().tasks == 50));
+        for (Individual& ind : population.GetIndividuals())
+        {
+            CHECK((ind.GetFitness() == fitness_function_pop(ind.GetTree())));
+            CHECK(ind.GetEvaluationTime().has_value());
+        }
+    }
+
+    // The environment reports the evaluation of every generation.
+    Environment environment(grammar, fitness_function_pop, 100, 50, 5, 5, 0.2, RuntimeMode::MultiThread, make_shared<Executor>(2));
+    environment.Optimize(3);
+    CHECK((environment.GetEvaluationHistory().size() == 3));
+    CHECK((environment.GetEvaluationHistory().back().tasks > 0));
+}
+
+TEST_CASE("Benchmark cost-aware scheduling")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    // The cost of the fitness function grows with the square of the tree size, so a few individuals dominate.
+    auto skewed_fitness_function = [](SyntaxTree& solution) {
+        double fitness = 0.0;
+        for (unsigned i = 0; i < solution.Size(); i++)
+        {
+            ArithmeticContext ctx(static_cast<int>(i % 5), 2);
+            solution.Evaluate(ctx);
+            fitness += ctx.GetIntResult() % 3;
+        }
+        return fitness;
+    };
+
+    Population population(grammar, skewed_fitness_function);
+    population.Initialize(200);
+    const auto executor = make_shared<Executor>(4);
+    population.SetExecutor(executor);
+
+    cout << "Policy\t|\tMakespan ms\t|\tIdle fraction\t|\tSteals" << endl;
+    for (SchedulingPolicy policy : { SchedulingPolicy::PopulationOrder, SchedulingPolicy::LargestTreeFirst, SchedulingPolicy::LearnedCost })
+    {
+        population.SetSchedulingPolicy(policy);
+        population.Evaluate(RuntimeMode::MultiThread);
+        population.Evaluate(RuntimeMode::MultiThread);
+        const ExecutorStatistics& statistics = population.GetEvaluationStatistics();
+        cout << static_cast<int>(policy) << "\t|\t" << statistics.makespan * 1000 << "\t|\t"
+             << statistics.IdleFraction() << "\t|\t" << statistics.steals << endl;
+    }
+}
@@ -0,0 +1,76 @@
+#include <set>
+#include "doctest.h"
+#include "../include/gbgp.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*       Test routines       *
+//****************************/
+
+/// Draws numbers from a stream.
+vector<uint64_t> draw_numbers(RandomStream& random, size_t n)
+{
+    vector<uint64_t> numbers;
+    for (size_t i = 0; i < n; i++)
+        numbers.push_back(random());
+    return numbers;
+}
+
+TEST_CASE("Test random stream")
+{
+    // The same seed gives the same sequence, and different seeds give different ones.
+    RandomStream a(1), b(1), c(2);
+    const vector<uint64_t> numbers = draw_numbers(a, 100);
+    CHECK((draw_numbers(b, 100) == numbers));
+    CHECK((draw_numbers(c, 100) != numbers));
+    CHECK((set<uint64_t>(numbers.begin(), numbers.end()).size() == numbers.size()));
+
+    // Discard jumps ahead without drawing the skipped numbers.
+    RandomStream skipped(1);
+    skipped.Discard(60);
+    CHECK((skipped() == numbers[60]));
+
+    // Splitting at the same position with the same index gives the same child, and it does not advance the parent.
+    RandomStream parent(3);
+    RandomStream first = parent.Split(0), second = parent.Split(0), sibling = parent.Split(1);
+    const vector<uint64_t> children = draw_numbers(first, 50);
+    CHECK((draw_numbers(second, 50) == children));
+    CHECK((draw_numbers(sibling, 50) != children));
+    CHECK((parent() == RandomStream(3)()));
+
+    // The children depend on the position of the parent, and differ from the numbers of the parent.
+    RandomStream later = parent.Split(0);
+    CHECK((draw_numbers(later, 50) != children));
+    RandomStream parentCopy(3);
+    CHECK((draw_numbers(parentCopy, 50) != children));
+}
+
+TEST_CASE("Test random stream distributions")
+{
+    RandomStream random(5);
+
+    // The stream works with the standard distributions.
+    uniform_int_distribution<int> die(1, 6);
+    vector<int> counts(7, 0);
+    for (int i = 0; i < 6000; i++)
+        counts[die(random)]++;
+    for (int face = 1; face <= 6; face++)
+        CHECK((counts[face] > 800 && counts[face] < 1200));
+
+    uniform_real_distribution<double> unit(0, 1);
+    double sum = 0.0;
+    for (int i = 0; i < 10000; i++)
+        sum += unit(random);
+    CHECK((abs(sum / 10000 - 0.5) < 0.02));
+
+    // And with the helpers of the library.
+    const vector<string> values = { "a", "b", "c" };
+    RandomStream choices(9), sameChoices(9);
+    for (int i = 0; i < 20; i++)
+        CHECK((*random_choice(values.begin(), values.end(), choices) == *random_choice(values.begin(), values.end(), sameChoices)));
+
+    const Terminal varTerm(0, "var", { "x", "y", "1" });
+    RandomStream terminalRandom(11);
+    CHECK((vector_contains_q(varTerm.values, varTerm.GetRandomValue(terminalRandom))));
+}
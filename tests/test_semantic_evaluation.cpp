@@ -1,6 +1,7 @@
 #include <numeric>
 #include "doctest.h"
 #include "../include/gbgp.h"
+#include "test_helpers.h"
 using namespace std;
 using namespace gbgp;
 
@@ -20,6 +21,28 @@ public:
     void SetIntResult(int r) { result() = to_string(r); }
 };
 
+class CountingArithmeticContext : public ArithmeticContext
+{
+public:
+    int actions = 0;
+
+    CountingArithmeticContext(int px, int py) : ArithmeticContext(px, py) {}
+
+    void Prepare() override
+    {
+        actions++;
+        ArithmeticContext::Prepare();
+    }
+};
+
+class TypedArithmeticContext : public IntEvaluationContext
+{
+public:
+    int64_t x{}, y{};
+
+    TypedArithmeticContext(int64_t px, int64_t py) : x(px), y(py) {}
+};
+
 //*****************************
 //*     Types declaration     *
 //****************************/
@@ -89,11 +112,23 @@ const ProductionRule rule6(
         { ProductionElement(varTerm) },
         [](EvaluationContext& ctx) {
             auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
-            int varValue = ctx.SemanticValue(0) == "x" ? arithmeticContext.x : arithmeticContext.y;
+            const string& var = ctx.SemanticValue(0);
+
+            int varValue;
+            if (var == "x")
+                varValue = arithmeticContext.x;
+            else if (var == "y")
+                varValue = arithmeticContext.y;
+            else
+                varValue = 1;
+
             arithmeticContext.SetIntResult(varValue);
         }
 );
 
+// Typed versions of the rules with custom semantic actions. The rules with default semantic actions are shared.
+const TypedArithmeticRules<TypedArithmeticContext> typedRules(rule1, rule3, rule6);
+
 //*****************************
 //*       Test routines       *
 //****************************/
@@ -154,4 +189,227 @@ TEST_CASE("Test arithmetic evaluation")
     cout << arithmeticContext.result() << endl;
 
     CHECK(!arithmeticContext.result().empty());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test typed evaluation")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 20; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 20);
+        const SyntaxTree typedTree = typedRules.TypedCopy(tree);
+
+        for (int x = 0; x <= 3; x++)
+        {
+            ArithmeticContext stringContext(x, 2);
+            tree.Evaluate(stringContext);
+
+            TypedArithmeticContext typedContext(x, 2);
+            typedTree.Evaluate(typedContext);
+
+            CHECK((typedContext.GetTypedResult() == stringContext.GetIntResult()));
+        }
+    }
+
+    // Rules with the default semantic action transfer typed values and parse the values of Terminals.
+    const NonTerminal numberNonTerm(Expr, "NUMBER");
+    const Terminal literalTerm(Var, "literal", { "2.5", "4" });
+    const ProductionRule literalRule(numberNonTerm, { ProductionElement(literalTerm) });
+    const ProductionRule wrapRule(numberNonTerm, { ProductionElement(leftParenthesisTerm), ProductionElement(numberNonTerm), ProductionElement(rightParenthesisTerm) }, 1);
+
+    SyntaxTree literalTree;
+    literalTree.SetRootRule(wrapRule);
+    literalTree.Root()->AddChildTerm(leftParenthesisTerm);
+    literalTree.Root()->AddChildTerm(numberNonTerm, literalRule)->AddChildTerm(literalTerm, "2.5");
+    literalTree.Root()->AddChildTerm(rightParenthesisTerm);
+
+    DoubleEvaluationContext doubleContext;
+    literalTree.Evaluate(doubleContext);
+    CHECK((doubleContext.GetTypedResult() == 2.5));
+
+    // The same tree can still be evaluated with a string context.
+    EvaluationContext stringContext;
+    literalTree.Evaluate(stringContext);
+    CHECK((stringContext.GetResult() == "2.5"));
+
+    // A typed context passed as a plain context falls back to string values.
+    DoubleEvaluationContext fallbackContext;
+    literalTree.Evaluate(static_cast<EvaluationContext&>(fallbackContext));
+    CHECK((fallbackContext.GetResult() == "2.5"));
+
+    // The slots of the last semantic action are typed by production element.
+    CHECK((doubleContext.TerminalValue(0) == "("));
+    CHECK((doubleContext.TypedSemanticValue(1) == 2.5));
+    CHECK_THROWS((void) doubleContext.TypedSemanticValue(0));
+    CHECK_THROWS((void) doubleContext.TerminalValue(1));
+}
+
+TEST_CASE("Test incremental evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 30; i++)
+    {
+        SyntaxTree tree, donor;
+        grammar.CreateRandomTree(tree, 30);
+        grammar.CreateRandomTree(donor, 30);
+
+        CountingArithmeticContext ctx(4, 5);
+        tree.Evaluate(ctx);
+        const int fullActions = ctx.actions;
+
+        // Without changes, nothing is evaluated again.
+        ctx.actions = 0;
+        tree.Reevaluate(ctx);
+        CHECK((ctx.actions == 0));
+
+        // A point mutation only evaluates the path from the leaf to the root.
+        vector<TreeNode*> leaves;
+        for (TreeNode* node : tree.PostOrder())
+        {
+            if (node->type == NodeType::Terminal && node->GetTerminal() == varTerm)
+                leaves.push_back(node);
+        }
+        TreeNode* leaf = *random_choice(leaves.begin(), leaves.end());
+        leaf->SetValue(leaf->GetValue() == "x" ? "y" : "x");
+
+        int pathLength = 0;
+        for (TreeNode* node = leaf->parent; node != nullptr; node = node->parent)
+            pathLength++;
+
+        ctx.actions = 0;
+        tree.Reevaluate(ctx);
+        CHECK((ctx.actions == pathLength));
+        CHECK((ctx.actions <= fullActions));
+
+        ArithmeticContext expected(4, 5);
+        SyntaxTree(tree).Evaluate(expected);
+        CHECK((ctx.result() == expected.result()));
+
+        // Edits through a reference to the base Node outdate the same path.
+        Node& baseLeaf = *leaf;
+        baseLeaf.SetValue(leaf->GetValue() == "x" ? "y" : "x");
+        CHECK((!tree.Root()->IsEvaluated()));
+        ctx.actions = 0;
+        tree.Reevaluate(ctx);
+        CHECK((ctx.actions == pathLength));
+        SyntaxTree(tree).Evaluate(expected);
+        CHECK((ctx.result() == expected.result()));
+
+        // Crossover replaces a subtree. Only the inserted subtree and its ancestors are evaluated again.
+        TreeNode* target = tree.Root()->children.front().get();
+        for (TreeNode* node : donor.PreOrder())
+        {
+            if (node->type == NodeType::NonTerminal && node->GetNonTerminal() == target->GetNonTerminal())
+            {
+                tree.InsertSubtree(target, node);
+                break;
+            }
+        }
+
+        ctx.actions = 0;
+        tree.Reevaluate(ctx);
+        SyntaxTree(tree).Evaluate(expected);
+        CHECK((ctx.result() == expected.result()));
+        CHECK((ctx.actions <= static_cast<int>(tree.Size())));
+
+        // Synthesis is also updated along the changed paths.
+        CHECK((tree.SynthesizeNodeExpressions() == tree.SynthesizeExpression()));
+        leaf = *tree.PostOrder().begin();
+        leaf->SetValue(leaf->GetValue());
+        CHECK((!tree.Root()->IsSynthesized()));
+        CHECK((tree.SynthesizeNodeExpressions() == tree.SynthesizeExpression()));
+    }
+}
+
+TEST_CASE("Test incremental evaluation of offspring")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+    RandomStream random(17);
+
+    // A fitness function that evaluates each tree for a single input, identified by its context key.
+    atomic<int> actions{ 0 };
+    auto keyed_fitness_function = [&actions](SyntaxTree& solution) {
+        CountingArithmeticContext ctx(4, 5);
+        solution.Evaluate(ctx, 0);
+        actions += ctx.actions;
+        return 1.0 / (1.0 + abs(ctx.GetIntResult() - s_target_func(4, 5)));
+    };
+    // The reference fitness evaluates a copy, so the values of the tree are kept.
+    auto full_fitness_function = [](SyntaxTree solution) {
+        ArithmeticContext ctx(4, 5);
+        solution.Evaluate(ctx);
+        return 1.0 / (1.0 + abs(ctx.GetIntResult() - s_target_func(4, 5)));
+    };
+
+    for (int i = 0; i < 30; i++)
+    {
+        Individual parent1(keyed_fitness_function), parent2(keyed_fitness_function);
+        grammar.CreateRandomTree(parent1.GetTree(), 30, std::nullopt, random);
+        grammar.CreateRandomTree(parent2.GetTree(), 30, std::nullopt, random);
+        parent1.Evaluate();
+        parent2.Evaluate();
+
+        // The offspring keeps the values of both parents, so only the ancestors of the inserted subtree are evaluated.
+        Individual offspring = GeneticOperators::IndividualsCrossover(parent1, parent2, random);
+        actions = 0;
+        offspring.Evaluate();
+        CHECK((actions <= static_cast<int>(offspring.GetTree().Height())));
+        CHECK((offspring.GetFitness() == full_fitness_function(offspring.GetTree())));
+
+        // A point mutation only evaluates the path from the leaf to the root.
+        GeneticOperators::MutateIndividual(offspring, grammar, 0.0, random);
+        actions = 0;
+        offspring.Evaluate();
+        CHECK((actions <= static_cast<int>(offspring.GetTree().Height())));
+        CHECK((offspring.GetFitness() == full_fitness_function(offspring.GetTree())));
+
+        // Another key evaluates the whole tree.
+        CountingArithmeticContext otherCtx(4, 5);
+        offspring.GetTree().Evaluate(otherCtx, 1);
+        CHECK((otherCtx.actions == static_cast<int>(offspring.GetTree().GetTermsOfType(NodeType::NonTerminal).size())));
+    }
+
+    // The fitness of every individual of an evolved population matches a full evaluation.
+    Environment environment(grammar, keyed_fitness_function, 60, 30, 5, 5, 0.4, RuntimeMode::MultiThread);
+    environment.Optimize(5);
+    for (Individual& ind : environment.GetPopulation().GetIndividuals())
+        CHECK((ind.GetFitness() == full_fitness_function(ind.GetTree())));
+}
+
+TEST_CASE("Test deep tree evaluation")
+{
+    // The expression (((...(x)...))), nested deep enough to overflow the stack with a recursive evaluation.
+    const int depth = 200000;
+    SyntaxTree tree;
+    tree.SetRootRule(rule2);
+    TreeNode* expr = tree.Root();
+    for (int i = 0; i < depth; i++)
+    {
+        TreeNode* factor = expr->AddChildTerm(termNonTerm, rule4)->AddChildTerm(factorNonTerm, rule5);
+        factor->AddChildTerm(leftParenthesisTerm);
+        expr = factor->AddChildTerm(exprNonTerm, rule2);
+        factor->AddChildTerm(rightParenthesisTerm);
+    }
+    TreeNode* leaf = expr->AddChildTerm(termNonTerm, rule4)->AddChildTerm(factorNonTerm, rule6)->AddChildTerm(varTerm, "x");
+
+    ArithmeticContext ctx(3, 7);
+    tree.Evaluate(ctx);
+    CHECK((ctx.GetIntResult() == 3));
+    CHECK((tree.SynthesizeExpression() == string(depth, '(') + "x" + string(depth, ')')));
+
+    leaf->SetValue("y");
+    tree.Reevaluate(ctx);
+    CHECK((ctx.GetIntResult() == 7));
+
+    SubtreeCache cache(1024);
+    tree.Evaluate(ctx, cache, 0);
+    CHECK((ctx.GetIntResult() == 7));
+
+    leaf->SetValue("x");
+    tree.Evaluate(ctx, 0);
+    CHECK((ctx.GetIntResult() == 3));
+}
@@ -179,6 +179,16 @@ TEST_CASE("Test Node serialization/deserialization")
         iArchive(deserialized);
         cout << "Deserialized Node: " << deserialized.ToString() << endl;
     }
+
+    // Loading the same node again refers to the same registered rule.
+    Node deserializedAgain;
+    {
+        std::stringstream copy(ss.str());
+        cereal::BinaryInputArchive iArchive(copy);
+        iArchive(deserializedAgain);
+    }
+    CHECK((deserializedAgain.generatorPRID == deserialized.generatorPRID));
+
     grammar.RestoreSemanticAction(deserialized);
 
     CHECK((node == deserialized));
@@ -0,0 +1,189 @@
+#include <set>
+#include "doctest.h"
+#include "../include/gbgp.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class ArithmeticContext : public EvaluationContext
+{
+public:
+    int x{}, y{};
+
+    ArithmeticContext(int px, int py) : x(px), y(py) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    int GetIntResult() { return stoi(result()); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, LeftParenthesis, RightParenthesis, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "y", "1" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+const Terminal leftParenthesisTerm(LeftParenthesis, "LeftParenthesis", { "(" });
+const Terminal rightParenthesisTerm(RightParenthesis, "RightParenthesis", { ")" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            int n1 = arithmeticContext.GetIntSemanticValue(0);
+            int n2 = arithmeticContext.GetIntSemanticValue(2);
+            arithmeticContext.SetIntResult(n1 + n2);
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            int n1 = arithmeticContext.GetIntSemanticValue(0);
+            int n2 = arithmeticContext.GetIntSemanticValue(2);
+            arithmeticContext.SetIntResult(n1 * n2);
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(leftParenthesisTerm), ProductionElement(exprNonTerm), ProductionElement(rightParenthesisTerm) },
+        1
+);
+
+const ProductionRule rule6(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<ArithmeticContext&>(ctx);
+            string var = ctx.SemanticValue(0);
+
+            int varValue;
+            if (var == "x")
+                varValue = arithmeticContext.x;
+            else if (var == "y")
+                varValue = arithmeticContext.y;
+            else
+                varValue = 1;
+
+            arithmeticContext.SetIntResult(varValue);
+        }
+);
+
+//*****************************
+/// Collects the addresses of the nodes of a shared tree.
+set<const SharedNode*> collect_nodes(const SharedSyntaxTree& tree)
+{
+    set<const SharedNode*> nodes;
+    vector<const SharedNode*> pending = { tree.Root().get() };
+    while (!pending.empty())
+    {
+        const SharedNode* node = pending.back();
+        pending.pop_back();
+        nodes.insert(node);
+        for (const SharedNodePtr& child : node->children)
+            pending.push_back(child.get());
+    }
+    return nodes;
+}
+
+TEST_CASE("Test shared tree conversion")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 20);
+
+        SharedSyntaxTree shared(tree);
+        CHECK((shared.Size() == tree.GetPreOrderTreeTraversal().size()));
+        CHECK((shared.SynthesizeExpression() == tree.SynthesizeExpression()));
+
+        SyntaxTree rebuilt = shared.ToSyntaxTree();
+        CHECK((rebuilt.SynthesizeExpression() == tree.SynthesizeExpression()));
+        CHECK((SharedSyntaxTree(rebuilt) == shared));
+
+        ArithmeticContext sharedContext(3, 4);
+        ArithmeticContext treeContext(3, 4);
+        shared.Evaluate(sharedContext);
+        tree.Evaluate(treeContext);
+        CHECK((sharedContext.GetIntResult() == treeContext.GetIntResult()));
+    }
+}
+
+TEST_CASE("Test shared tree genetic operators")
+{
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6 };
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree1, tree2;
+        grammar.CreateRandomTree(tree1, 10);
+        grammar.CreateRandomTree(tree2, 10);
+        const SharedSyntaxTree parent1(tree1);
+        const SharedSyntaxTree parent2(tree2);
+        const string expression1 = parent1.SynthesizeExpression();
+        const string expression2 = parent2.SynthesizeExpression();
+
+        // The offspring only allocates the ancestors of the grafted subtree, at most one per level of depth.
+        SharedSyntaxTree offspring = SharedSyntaxTree::Crossover(parent1, parent2);
+        set<const SharedNode*> parentNodes = collect_nodes(parent1);
+        set<const SharedNode*> parent2Nodes = collect_nodes(parent2);
+        parentNodes.insert(parent2Nodes.begin(), parent2Nodes.end());
+
+        size_t newNodes = 0;
+        for (const SharedNode* node : collect_nodes(offspring))
+            newNodes += parentNodes.count(node) == 0;
+
+        CHECK((newNodes <= 11));
+        CHECK((SharedSyntaxTree(offspring.ToSyntaxTree()) == offspring));
+
+        offspring.MutateTerminal();
+        CHECK((SharedSyntaxTree(offspring.ToSyntaxTree()) == offspring));
+
+        offspring.MutateNonTerminal(grammar, 10);
+        CHECK((SharedSyntaxTree(offspring.ToSyntaxTree()) == offspring));
+
+        ArithmeticContext ctx(1, 2);
+        offspring.Evaluate(ctx);
+        CHECK_FALSE(ctx.result().empty());
+
+        // The parents are never modified.
+        CHECK((parent1.SynthesizeExpression() == expression1));
+        CHECK((parent2.SynthesizeExpression() == expression2));
+    }
+}
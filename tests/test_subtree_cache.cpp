@@ -0,0 +1,256 @@
+#include "doctest.h"
+#include "../include/gbgp.h"
+#include "../include/thread_pool.h"
+#include "test_helpers.h"
+using namespace std;
+using namespace gbgp;
+
+//*****************************
+//*    Evaluation context     *
+//****************************/
+
+class CachedArithmeticContext : public EvaluationContext
+{
+public:
+    int x{};
+
+    explicit CachedArithmeticContext(int px) : x(px) {}
+
+    int GetIntSemanticValue(int index) { return stoi(SemanticValue(index)); }
+    void SetIntResult(int r) { result() = to_string(r); }
+};
+
+//*****************************
+//*     Types declaration     *
+//****************************/
+
+enum Terms
+{
+    Var, Plus, Times, // Terminals
+    Expr, Term, Factor // NonTerminals
+};
+
+//*****************************
+//*    Grammar declaration    *
+//****************************/
+
+// Term/Nonterm declaration.
+const Terminal varTerm(Var, "var", { "x", "1", "2" });
+const Terminal plusTerm(Plus, "Plus", { "+" });
+const Terminal timesTerm(Times, "Times", { "*" });
+
+const NonTerminal exprNonTerm(Expr, "EXPR");
+const NonTerminal termNonTerm(Term, "TERM");
+const NonTerminal factorNonTerm(Factor, "FACTOR");
+
+// Grammar definition.
+const ProductionRule rule1(
+        exprNonTerm,
+        { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<CachedArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) + arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule2(
+        exprNonTerm,
+        { ProductionElement(termNonTerm) }
+);
+
+const ProductionRule rule3(
+        termNonTerm,
+        { ProductionElement(termNonTerm), ProductionElement(timesTerm), ProductionElement(factorNonTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<CachedArithmeticContext&>(ctx);
+            arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) * arithmeticContext.GetIntSemanticValue(2));
+        }
+);
+
+const ProductionRule rule4(
+        termNonTerm,
+        { ProductionElement(factorNonTerm) }
+);
+
+const ProductionRule rule5(
+        factorNonTerm,
+        { ProductionElement(varTerm) },
+        [](EvaluationContext& ctx) {
+            auto& arithmeticContext = dynamic_cast<CachedArithmeticContext&>(ctx);
+            const string& var = ctx.SemanticValue(0);
+            arithmeticContext.SetIntResult(var == "x" ? arithmeticContext.x : stoi(var));
+        }
+);
+
+//*****************************
+//*       Test routines       *
+//****************************/
+TEST_CASE("Test subtree cache")
+{
+    SubtreeCache cache(4, 1, 1);
+    string value;
+
+    // Six different subtrees: the factors of each value, and the terms over them.
+    vector<SyntaxTree> subtrees;
+    for (const string& var : varTerm.values)
+        subtrees.emplace_back(TreeNode(rule5, factorNonTerm, { TreeNode(varTerm, var) }));
+    for (const string& var : varTerm.values)
+        subtrees.emplace_back(TreeNode(rule4, termNonTerm, { TreeNode(rule5, factorNonTerm, { TreeNode(varTerm, var) }) }));
+    auto subtree = [&subtrees](size_t i) { return subtrees[i].Root(); };
+
+    CHECK((!cache.Find(subtree(0), 0, value)));
+    cache.Insert(subtree(0), 0, "a");
+    CHECK((cache.Find(subtree(0), 0, value)));
+    CHECK((value == "a"));
+
+    // An equal subtree finds the value, but not a different one or the same subtree with another context key.
+    const SyntaxTree copy = subtrees[0];
+    CHECK((cache.Find(copy.Root(), 0, value)));
+    CHECK((!cache.Find(subtree(1), 0, value)));
+    CHECK((!cache.Find(subtree(0), 1, value)));
+    CHECK((cache.Hits() == 2));
+    CHECK((cache.Misses() == 3));
+
+    // The cache never grows past its capacity. The entry that was used survives the eviction.
+    cache.Insert(subtree(1), 0, "b");
+    cache.Insert(subtree(2), 0, "c");
+    cache.Insert(subtree(3), 0, "d");
+    CHECK((cache.Find(subtree(0), 0, value)));
+    cache.Insert(subtree(4), 0, "e");
+    CHECK((cache.Size() == 4));
+    CHECK((cache.Evictions() == 1));
+    CHECK((cache.Find(subtree(0), 0, value)));
+    CHECK((!cache.Find(subtree(1), 0, value)));
+    CHECK((cache.Find(subtree(4), 0, value)));
+    CHECK((value == "e"));
+
+    // A value stored with the snapshot of another subtree is never returned, as if the hashes collided.
+    cache.Insert(subtree(5), SubtreeSnapshot::Create(subtree(2)), 0, "f");
+    const size_t misses = cache.Misses();
+    CHECK((!cache.Find(subtree(5), 0, value)));
+    CHECK((cache.Misses() == misses + 1));
+
+    cache.Clear();
+    cache.ResetCounters();
+    CHECK((cache.Size() == 0));
+    CHECK((!cache.Find(subtree(0), 0, value)));
+    CHECK((cache.HitRate() == 0.0));
+}
+
+TEST_CASE("Test cached evaluation with different rules")
+{
+    // A rule with the symbols of rule1 that subtracts instead.
+    const ProductionRule minusRule(
+            exprNonTerm,
+            { ProductionElement(exprNonTerm), ProductionElement(plusTerm), ProductionElement(termNonTerm) },
+            [](EvaluationContext& ctx) {
+                auto& arithmeticContext = dynamic_cast<CachedArithmeticContext&>(ctx);
+                arithmeticContext.SetIntResult(arithmeticContext.GetIntSemanticValue(0) - arithmeticContext.GetIntSemanticValue(2));
+            }
+    );
+
+    // Builds (2 + 1) + x, where the inner sum is computed by the given rule.
+    auto build = [](const ProductionRule& innerRule) {
+        auto factor = [](const string& var) {
+            return TreeNode(rule4, termNonTerm, { TreeNode(rule5, factorNonTerm, { TreeNode(varTerm, var) }) });
+        };
+        return SyntaxTree(TreeNode(rule1, exprNonTerm, {
+            TreeNode(innerRule, exprNonTerm, { TreeNode(rule2, exprNonTerm, { factor("2") }), TreeNode(plusTerm, "+"), factor("1") }),
+            TreeNode(plusTerm, "+"),
+            factor("x")
+        }));
+    };
+    const SyntaxTree sum = build(rule1), difference = build(minusRule);
+
+    // The trees only differ in the rule of a descendant of the root.
+    CHECK((sum.StructuralHash() != difference.StructuralHash()));
+    CHECK_FALSE(SyntaxTree::SameSubtree(sum.Root(), difference.Root()));
+
+    SubtreeCache cache(1000, 1);
+    CachedArithmeticContext sumCtx(5), differenceCtx(5);
+    sum.Evaluate(sumCtx, cache, 0);
+    difference.Evaluate(differenceCtx, cache, 0);
+    CHECK((sumCtx.result() == "8"));
+    CHECK((differenceCtx.result() == "6"));
+
+    // Changing the rule of a node gives the values of the other tree.
+    SyntaxTree changed = sum;
+    changed.Root()->children[0]->SetGeneratorPR(minusRule);
+    CHECK((changed.StructuralHash() == difference.StructuralHash()));
+    CachedArithmeticContext changedCtx(5);
+    changed.Evaluate(changedCtx, cache, 0);
+    CHECK((changedCtx.result() == "6"));
+}
+
+TEST_CASE("Test cached evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5 };
+
+    vector<SyntaxTree> trees(30);
+    for (SyntaxTree& tree : trees)
+        grammar.CreateRandomTree(tree, 20);
+
+    // Half of the trees are copies with a shared subtree, as produced by crossover.
+    for (size_t i = 0; i + 1 < trees.size(); i += 2)
+        trees[i + 1] = trees[i];
+
+    SubtreeCache cache(100000);
+    for (int x = 0; x < 10; x++)
+    {
+        for (SyntaxTree& tree : trees)
+        {
+            CachedArithmeticContext ctx(x), cachedCtx(x);
+            tree.Evaluate(ctx);
+            tree.Evaluate(cachedCtx, cache, x);
+            CHECK((cachedCtx.result() == ctx.result()));
+        }
+    }
+    CHECK((cache.Hits() > 0));
+    CHECK((cache.Size() <= cache.Capacity()));
+}
+
+TEST_CASE("Test cached evaluation from many threads")
+{
+    SharedGeneratorGuard generatorGuard;
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5 };
+
+    vector<SyntaxTree> trees(40);
+    for (SyntaxTree& tree : trees)
+        grammar.CreateRandomTree(tree, 20);
+
+    const int rows = 20;
+    vector<vector<string>> expected(trees.size(), vector<string>(rows));
+    for (size_t i = 0; i < trees.size(); i++)
+    {
+        for (int x = 0; x < rows; x++)
+        {
+            CachedArithmeticContext ctx(x);
+            trees[i].Evaluate(ctx);
+            expected[i][x] = ctx.result();
+        }
+    }
+
+    // A small cache forces evictions while other threads read it. Every task evaluates its own copy of a tree, as
+    // the evaluation stores the partial values in the nodes.
+    SubtreeCache cache(256);
+    vector<vector<string>> results(trees.size() * 4, vector<string>(rows));
+    BS::thread_pool pool;
+    for (size_t task = 0; task < results.size(); task++)
+    {
+        pool.push_task([&, task]() {
+            SyntaxTree tree = trees[task % trees.size()];
+            for (int x = 0; x < rows; x++)
+            {
+                CachedArithmeticContext ctx(x);
+                tree.Evaluate(ctx, cache, x);
+                results[task][x] = ctx.result();
+            }
+        });
+    }
+    pool.wait_for_tasks();
+
+    for (size_t task = 0; task < results.size(); task++)
+        CHECK((results[task] == expected[task % trees.size()]));
+    CHECK((cache.Size() <= cache.Capacity()));
+}
@@ -1,5 +1,7 @@
+#include <chrono>
 #include "doctest.h"
 #include "../include/gbgp.h"
+#include "test_helpers.h"
 using namespace std;
 using namespace gbgp;
 
@@ -240,4 +242,170 @@ TEST_CASE("Testing random individual generation")
     cst.PrintTree();
     cout << cst.SynthesizeExpression() << endl;
     CHECK((!cst.SynthesizeExpression().empty()));
-}
\ No newline at end of file
+}
+
+TEST_CASE("Benchmark compiled trading evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6, rule7, rule8,
+                     rule9, rule10, rule11, rule12, rule13, rule14, rule15,
+                     rule16, rule17, rule18, rule19 };
+
+    vector<SyntaxTree> trees(20);
+    vector<CompiledSyntaxTree> programs;
+    for (SyntaxTree& tree : trees)
+    {
+        grammar.CreateRandomTree(tree, 30);
+        programs.emplace_back(tree);
+    }
+
+    const int rows = 2000;
+    EvaluationContext ctx;
+
+    auto start = chrono::steady_clock::now();
+    vector<string> treeResults;
+    for (SyntaxTree& tree : trees)
+    {
+        for (int row = 0; row < rows; row++)
+            tree.Evaluate(ctx);
+        treeResults.push_back(ctx.result());
+    }
+    chrono::duration<double, micro> treeElapsed = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    vector<string> programResults;
+    for (const CompiledSyntaxTree& program : programs)
+    {
+        for (int row = 0; row < rows; row++)
+            program.Evaluate(ctx);
+        programResults.push_back(ctx.result());
+    }
+    chrono::duration<double, micro> programElapsed = chrono::steady_clock::now() - start;
+
+    CHECK((programResults == treeResults));
+    cout << "Tree us/eval: " << treeElapsed.count() / (rows * trees.size())
+         << ", compiled us/eval: " << programElapsed.count() / (rows * trees.size()) << endl;
+}
+
+TEST_CASE("Benchmark subtree cache on a trading population")
+{
+    SharedGeneratorGuard generatorGuard;
+
+    Grammar grammar{ rule1, rule2, rule3, rule4, rule5, rule6, rule7, rule8,
+                     rule9, rule10, rule11, rule12, rule13, rule14, rule15,
+                     rule16, rule17, rule18, rule19 };
+
+    // The fitness backtests every rule over a number of time steps, which are the context keys of the cache. The
+    // default semantic actions synthesize the rule, which stands for the value of its indicators at each step.
+    const int steps = 50;
+    SubtreeCache cache(200000);
+    auto fitness_function = [&cache](SyntaxTree& solution) {
+        EvaluationContext ctx;
+        size_t total = 0;
+        for (int step = 0; step < steps; step++)
+        {
+            solution.Evaluate(ctx, cache, step);
+            total += ctx.result().size() % 7;
+        }
+        return static_cast<double>(total) / steps;
+    };
+
+    Environment environment(grammar, fitness_function, 200, 100, 10, 10, 0.2, RuntimeMode::MultiThread);
+    cout << "Generation\t|\tHits\t|\tMisses\t|\tHit rate" << endl;
+    for (int generation = 0; generation < 5; generation++)
+    {
+        cache.ResetCounters();
+        environment.Optimize();
+        cout << generation << "\t|\t" << cache.Hits() << "\t|\t" << cache.Misses() << "\t|\t" << cache.HitRate() << endl;
+        CHECK((cache.Hits() > 0));
+    }
+    CHECK((cache.Size() <= cache.Capacity()));
+}
+
+/// Evaluation context of trading signals, which counts the comparisons between indicators.
+class TradingSignalContext : public LazyEvaluationContext
+{
+public:
+    int step = 0;
+    size_t comparisons = 0;
+};
+
+/// Creates a grammar of trading signals. The expressions synthesize their indicator, and each comparison is a
+/// pseudo-random signal of the compared indicators and the time step. The logic operators short-circuit when the
+/// tree is evaluated with a LazyEvaluationContext.
+Grammar trading_signal_grammar()
+{
+    auto comparison = [](EvaluationContext& ctx) {
+        auto& signalContext = dynamic_cast<TradingSignalContext&>(ctx);
+        signalContext.comparisons++;
+        const size_t signal = std::hash<string>()(ctx.SemanticValue(0) + ctx.SemanticValue(2) + ctx.SemanticValue(4)
+                                                  + to_string(signalContext.step));
+        ctx.result() = signal % 2 == 0 ? "1" : "0";
+    };
+
+    const ProductionRule logicRule(
+            rule1.from, rule1.to,
+            [](EvaluationContext& ctx) {
+                const bool left = ctx.SemanticValue(1) == "1", right = ctx.SemanticValue(5) == "1";
+                ctx.result() = (ctx.SemanticValue(3) == "&&" ? left && right : left || right) ? "1" : "0";
+            },
+            [](LazyEvaluationContext& ctx) {
+                const bool isAnd = ctx.Evaluate(3) == "&&";
+                const bool left = ctx.Evaluate(1) == "1";
+                const bool value = isAnd == left ? ctx.Evaluate(5) == "1" : left;
+                ctx.result() = value ? "1" : "0";
+            }
+    );
+
+    const ProductionRule notRule(rule2.from, rule2.to, [](EvaluationContext& ctx) {
+        ctx.result() = ctx.SemanticValue(2) == "1" ? "0" : "1";
+    });
+
+    return Grammar{ logicRule, notRule, ProductionRule(rule3.from, rule3.to, comparison),
+                    ProductionRule(rule4.from, rule4.to, comparison), ProductionRule(rule5.from, rule5.to, comparison),
+                    ProductionRule(rule6.from, rule6.to, comparison), ProductionRule(rule7.from, rule7.to, comparison),
+                    rule8, rule9, rule10, rule11, rule12, rule13, rule14, rule15, rule16, rule17, rule18, rule19 };
+}
+
+TEST_CASE("Benchmark short-circuit trading evaluation")
+{
+    SharedGeneratorGuard generatorGuard;
+    const Grammar grammar = trading_signal_grammar();
+
+    vector<SyntaxTree> trees(50);
+    for (SyntaxTree& tree : trees)
+        grammar.CreateRandomTree(tree, 30);
+
+    const int steps = 200;
+    TradingSignalContext eagerContext, lazyContext;
+    vector<string> eagerResults, lazyResults;
+
+    auto start = chrono::steady_clock::now();
+    for (SyntaxTree& tree : trees)
+    {
+        for (eagerContext.step = 0; eagerContext.step < steps; eagerContext.step++)
+        {
+            tree.Evaluate(static_cast<EvaluationContext&>(eagerContext));
+            eagerResults.push_back(eagerContext.result());
+        }
+    }
+    chrono::duration<double, micro> eagerElapsed = chrono::steady_clock::now() - start;
+
+    start = chrono::steady_clock::now();
+    for (SyntaxTree& tree : trees)
+    {
+        for (lazyContext.step = 0; lazyContext.step < steps; lazyContext.step++)
+        {
+            tree.Evaluate(lazyContext);
+            lazyResults.push_back(lazyContext.result());
+        }
+    }
+    chrono::duration<double, micro> lazyElapsed = chrono::steady_clock::now() - start;
+
+    CHECK((lazyResults == eagerResults));
+    CHECK((lazyContext.comparisons < eagerContext.comparisons));
+    cout << "Eager comparisons: " << eagerContext.comparisons << ", lazy comparisons: " << lazyContext.comparisons
+         << ", eager us/eval: " << eagerElapsed.count() / (steps * trees.size())
+         << ", lazy us/eval: " << lazyElapsed.count() / (steps * trees.size()) << endl;
+}
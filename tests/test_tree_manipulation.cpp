@@ -223,7 +223,7 @@ TEST_CASE("Test random subtree replacement")
     // Remove branch and create subtree.
     tree.DeleteSubtree(randomNonTerm);
     SyntaxTree replacement;
-    grammar.CreateRandomTree(replacement, 50, randomNonTerm->generatorPR);
+    grammar.CreateRandomTree(replacement, 50, randomNonTerm->GetGeneratorPR());
     tree.InsertSubtree(randomNonTerm, replacement);
 
     string replacedSynth = tree.SynthesizeExpression();
@@ -299,6 +299,188 @@ TEST_CASE("Test tree traversals")
     CHECK((originalSynth == reconstructionSynth));
 }
 
+/// Reference recursive pre-order traversal.
+void recursive_pre_order(TreeNode* node, Traversal& output)
+{
+    output.push_back(node);
+    for (const auto& child : node->children)
+        recursive_pre_order(child.get(), output);
+}
+
+/// Reference recursive post-order traversal.
+void recursive_post_order(TreeNode* node, Traversal& output)
+{
+    for (const auto& child : node->children)
+        recursive_post_order(child.get(), output);
+    output.push_back(node);
+}
+
+TEST_CASE("Test traversal iterators")
+{
+    Grammar grammar({ rule1, rule2, rule3, rule4, rule5, rule6 });
+    Traversal buffer;
+
+    for (int i = 0; i < 50; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 15);
+
+        // Traversals of the whole tree and of a subtree, which must not leave the subtree.
+        for (TreeNode* start : { tree.Root(), tree.Root()->children.front().get() })
+        {
+            Traversal preOrder, postOrder;
+            recursive_pre_order(start, preOrder);
+            recursive_post_order(start, postOrder);
+
+            CHECK((Traversal(SyntaxTree::PreOrder(start).begin(), SyntaxTree::PreOrder(start).end()) == preOrder));
+            CHECK((Traversal(SyntaxTree::PostOrder(start).begin(), SyntaxTree::PostOrder(start).end()) == postOrder));
+
+            SyntaxTree::GetPreOrderTreeTraversal(start, buffer);
+            CHECK((buffer == preOrder));
+            SyntaxTree::GetPostOrderTreeTraversal(start, buffer);
+            CHECK((buffer == postOrder));
+
+            Traversal breadthFirst;
+            for (TreeNode* node : SyntaxTree::BreadthFirst(start))
+                breadthFirst.push_back(node);
+            SyntaxTree::GetBreadthFirstTreeTraversal(start, buffer);
+            CHECK((breadthFirst == buffer));
+            CHECK((breadthFirst.size() == preOrder.size()));
+            CHECK((breadthFirst.front() == start));
+        }
+    }
+
+    SyntaxTree empty;
+    CHECK((empty.PreOrder().begin() == empty.PreOrder().end()));
+    CHECK((empty.PostOrder().begin() == empty.PostOrder().end()));
+    CHECK((empty.BreadthFirst().begin() == empty.BreadthFirst().end()));
+    CHECK(empty.GetPostOrderTreeTraversal().empty());
+}
+
+TEST_CASE("Test deep tree traversal")
+{
+    // A chain deep enough to overflow the stack with recursive traversals or destruction.
+    const int depth = 1000000;
+    long long liveNodes = TreeNode::GetLiveNodeCount();
+    {
+        SyntaxTree tree;
+        tree.SetRootRule(rule2);
+        TreeNode* node = tree.Root();
+        for (int i = 0; i < depth; i++)
+            node = node->AddChildTerm(exprNonTerm, rule2);
+
+        size_t visited = 0;
+        for (TreeNode* n : tree.PostOrder())
+            visited += n->HasChildren() ? 1 : 0;
+        CHECK((visited == static_cast<size_t>(depth)));
+        CHECK((tree.GetPreOrderTreeTraversal().back() == node));
+
+        // Copying also walks the whole chain.
+        const SyntaxTree copy(tree);
+        CHECK((copy.Size() == tree.Size()));
+        CHECK((copy.Height() == static_cast<unsigned>(depth)));
+        CHECK((copy.GetPreOrderTreeTraversal().back()->parent != nullptr));
+
+        tree.ClearEvaluation();
+    }
+    CHECK((TreeNode::GetLiveNodeCount() == liveNodes));
+}
+
+/// Reference recursive height.
+unsigned recursive_height(TreeNode* node)
+{
+    unsigned height = 0;
+    for (const auto& child : node->children)
+        height = max(height, recursive_height(child.get()) + 1);
+    return height;
+}
+
+/// Checks the cached metadata of a tree against a fresh copy rebuilt from its graph.
+void check_metadata(const SyntaxTree& tree)
+{
+    Traversal preOrder;
+    recursive_pre_order(tree.Root(), preOrder);
+    CHECK((tree.Size() == preOrder.size()));
+    CHECK((tree.Height() == recursive_height(tree.Root())));
+
+    const SyntaxTree rebuilt(tree.ToGraph());
+    CHECK((rebuilt.Size() == tree.Size()));
+    CHECK((rebuilt.Height() == tree.Height()));
+    CHECK((rebuilt.StructuralHash() == tree.StructuralHash()));
+    CHECK(SyntaxTree::SameSubtree(rebuilt.Root(), tree.Root()));
+
+    for (TreeNode* node : tree.PreOrder())
+    {
+        Traversal subtree;
+        recursive_pre_order(node, subtree);
+        CHECK((node->GetSubtreeSize() == subtree.size()));
+    }
+}
+
+TEST_CASE("Test subtree metadata")
+{
+    Grammar grammar({ rule1, rule2, rule3, rule4, rule5, rule6 });
+
+    SyntaxTree empty;
+    CHECK((empty.Size() == 0));
+    CHECK((empty.StructuralHash() == 0));
+
+    SyntaxTree pruneRuleFrom(
+        TreeNode(rule5, factorNonTerm, {
+            TreeNode(leftParenthesisTerm, "("),
+            TreeNode(rule2, exprNonTerm, {
+                TreeNode(rule4, termNonTerm, {
+                    TreeNode(rule6, factorNonTerm, { TreeNode(varTerm, 1) })
+                })
+            }),
+            TreeNode(rightParenthesisTerm, ")")
+        })
+    );
+    SyntaxTree pruneRuleTo(TreeNode(rule6, factorNonTerm, { TreeNode(varTerm, 1) }));
+    PruneRule pruneRule(pruneRuleFrom, pruneRuleTo);
+
+    for (int i = 0; i < 30; i++)
+    {
+        SyntaxTree tree;
+        grammar.CreateRandomTree(tree, 15);
+        check_metadata(tree);
+
+        // Copies keep the metadata, and a different value changes the hash.
+        SyntaxTree copy = tree;
+        CHECK((copy.StructuralHash() == tree.StructuralHash()));
+        CHECK(SyntaxTree::SameSubtree(copy.Root(), tree.Root()));
+
+        std::vector<TreeNode*> terminals = copy.GetTermsOfType(NodeType::Terminal);
+        for (TreeNode* terminal : terminals)
+        {
+            if (terminal->GetTerminal() == varTerm)
+            {
+                terminal->SetValue(terminal->GetValue() == "a" ? "b" : "a");
+                CHECK((copy.StructuralHash() != tree.StructuralHash()));
+                CHECK_FALSE(SyntaxTree::SameSubtree(copy.Root(), tree.Root()));
+                check_metadata(copy);
+                break;
+            }
+        }
+
+        // Replace a random branch.
+        std::vector<TreeNode*> nonTerminals = tree.GetTermsOfType(NodeType::NonTerminal);
+        TreeNode* randomNonTerm = *random_choice(nonTerminals.begin(), nonTerminals.end());
+        tree.DeleteSubtree(randomNonTerm);
+        check_metadata(tree);
+
+        SyntaxTree replacement;
+        grammar.CreateRandomTree(replacement, 15, randomNonTerm->GetGeneratorPR());
+        tree.InsertSubtree(randomNonTerm, replacement);
+        check_metadata(tree);
+        CHECK((SyntaxTree::FindSubtree(tree, replacement) != nullptr));
+
+        while (pruneRule.CanBeApplied(tree))
+            pruneRule.Apply(tree);
+        check_metadata(tree);
+    }
+}
+
 TEST_CASE("Test single pass pruning")
 {
     SyntaxTree tree(
@@ -608,4 +790,80 @@ TEST_CASE("Test find subtree")
 
     CHECK((shared != nullptr));
 
-}
\ No newline at end of file
+}
+
+TEST_CASE("Test expression synthesis")
+{
+    SyntaxTree tree(
+        TreeNode(
+            rule1,
+            exprNonTerm,
+            {
+                TreeNode(
+                    rule2,
+                    exprNonTerm,
+                    {
+                        TreeNode(
+                            rule4,
+                            termNonTerm,
+                            {
+                                TreeNode(
+                                    rule6,
+                                    factorNonTerm,
+                                    {
+                                        TreeNode(varTerm, "c")
+                                    })
+                            })
+                    }),
+                TreeNode(plusTerm, "+"),
+                TreeNode(
+                    rule3,
+                    termNonTerm,
+                    {
+                        TreeNode(
+                            rule4,
+                            termNonTerm,
+                            {
+                                TreeNode(
+                                    rule6,
+                                    factorNonTerm,
+                                    {
+                                        TreeNode(varTerm, "b")
+                                    })
+                            }),
+                        TreeNode(timesTerm, "*"),
+                        TreeNode(
+                            rule6,
+                            factorNonTerm,
+                            {
+                                TreeNode(varTerm, "a")
+                            })
+                    })
+            })
+    );
+
+    // Plain synthesis does not store the per-node synthesis.
+    CHECK((tree.SynthesizeExpression() == "c+b*a"));
+    CHECK((!tree.Root()->IsSynthesized()));
+
+    // Synthesis into caller-supplied sinks.
+    string buffer = "y=";
+    tree.SynthesizeExpression(buffer);
+    CHECK((buffer == "y=c+b*a"));
+
+    stringstream stream;
+    tree.SynthesizeExpression(stream);
+    CHECK((stream.str() == "c+b*a"));
+
+    // Per-node synthesis on request.
+    CHECK((tree.SynthesizeNodeExpressions() == "c+b*a"));
+    CHECK((tree.Root()->expressionSynthesis == "c+b*a"));
+    CHECK((tree.Root()->children.back()->expressionSynthesis == "b*a"));
+
+    // The children of every node must match its production rule.
+    tree.Root()->children.back()->SetGeneratorPR(rule4);
+    CHECK_THROWS((void)tree.SynthesizeExpression());
+    CHECK_THROWS((void)tree.SynthesizeNodeExpressions());
+    tree.Root()->children.back()->SetGeneratorPR(rule3);
+    CHECK((tree.SynthesizeExpression() == "c+b*a"));
+}